@@ -0,0 +1,223 @@
+/* MAIN HEADER */
+
+/* INCLUDE HEADERS */
+
+/* SYSTEM CALLS HEADERS */
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+/* C LIBRARY HEADERS */
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define RECENT_FILES    1024    /** @brief Files that links may point to */
+#define LONG_NAME_SIZE  200     /** @brief Length of names with --long-names */
+#define PATH_SIZE       8192
+
+/**
+ * @brief Shape of the tree, the same options and seed give the same tree
+ */
+typedef struct gen_opts {
+    int         fanout;         /**< @brief Subdirectories of each directory */
+    int         depth;          /**< @brief Levels of subdirectories */
+    int         files;          /**< @brief Entries that aren't directories in each directory */
+    long        file_size;      /**< @brief Largest file, sizes are uniform from 0 */
+    double      hardlinks;      /**< @brief Ratio of entries that are hard links to an earlier file */
+    double      symlinks;       /**< @brief Ratio of entries that are symbolic links to an earlier file */
+    int         long_names;
+    uint64_t    seed;
+} gen_opts_t;
+
+typedef struct gen_stats {
+    long        dirs;
+    long        files;
+    long        hardlinks;
+    long        symlinks;
+    long long   bytes;
+} gen_stats_t;
+
+static gen_opts_t opts = {4, 4, 16, 16384, 0.0, 0.0, 0, 1};
+static gen_stats_t stats;
+static uint64_t state;
+
+static char recent[RECENT_FILES][PATH_SIZE];
+static long recent_size = 0;
+static char *content;
+
+/**
+ * @brief splitmix64, same sequence on every machine
+ */
+static uint64_t next_random(void) {
+    uint64_t z = (state += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+static double next_ratio(void) { return (next_random() >> 11) * 0x1.0p-53; }
+
+static void make_name(char *name, size_t size, char kind, int index) {
+    int n = snprintf(name, size, "%c%d", kind, index);
+    if (opts.long_names) {
+        while (n < LONG_NAME_SIZE && (size_t)n + 1 < size) {
+            name[n++] = 'a' + next_random() % 26;
+        }
+        name[n] = '\0';
+    }
+}
+
+static int fail(const char *what, const char *path) {
+    fprintf(stderr, "gentree: %s '%s': %s\n", what, path, strerror(errno));
+    return -1;
+}
+
+static int make_file(const char *path) {
+    long size = opts.file_size > 0 ? next_random() % (opts.file_size + 1) : 0;
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd == -1) return fail("open error", path);
+
+    long done = 0;
+    while (done < size) {
+        ssize_t n = write(fd, content, size - done);
+        if (n == -1) {
+            close(fd);
+            return fail("write error", path);
+        }
+        done += n;
+    }
+    close(fd);
+
+    stats.files++;
+    stats.bytes += size;
+    snprintf(recent[recent_size % RECENT_FILES], PATH_SIZE, "%s", path);
+    recent_size++;
+    return 0;
+}
+
+static int make_entry(const char *path) {
+    double roll = next_ratio();
+    if (recent_size > 0 && roll < opts.hardlinks + opts.symlinks) {
+        long count = recent_size < RECENT_FILES ? recent_size : RECENT_FILES;
+        const char *target = recent[next_random() % count];
+        if (roll < opts.hardlinks) {
+            if (link(target, path)) return fail("link error", path);
+            stats.hardlinks++;
+        } else {
+            if (symlink(target, path)) return fail("symlink error", path);
+            stats.symlinks++;
+        }
+        return 0;
+    }
+    return make_file(path);
+}
+
+static int make_dir(char *path, size_t len, int level) {
+    if (mkdir(path, 0755) && !(level == 0 && errno == EEXIST)) {
+        return fail("mkdir error", path);
+    }
+    stats.dirs++;
+
+    char name[LONG_NAME_SIZE + 32];
+    for (int i = 0; i < opts.files; i++) {
+        make_name(name, sizeof(name), 'f', i);
+        if (len + strlen(name) + 2 > PATH_SIZE) break;
+        sprintf(path + len, "/%s", name);
+        if (make_entry(path)) return -1;
+    }
+    path[len] = '\0';
+
+    if (level == opts.depth) return 0;
+    for (int i = 0; i < opts.fanout; i++) {
+        make_name(name, sizeof(name), 'd', i);
+        if (len + strlen(name) + 2 > PATH_SIZE) break;
+        sprintf(path + len, "/%s", name);
+        if (make_dir(path, strlen(path), level + 1)) return -1;
+        path[len] = '\0';
+    }
+    return 0;
+}
+
+static int parse_number(const char *arg, const char *flag, double max,
+                        double *value) {
+    size_t len = strlen(flag);
+    if (strncmp(arg, flag, len) != 0) return 0;
+    char *end;
+    errno = 0;
+    *value = strtod(arg + len, &end);
+    if (errno || end == arg + len || *end != '\0' || *value < 0 ||
+        *value > max) {
+        fprintf(stderr, "gentree: invalid value of %s\n", flag);
+        exit(2);
+    }
+    return 1;
+}
+
+static void usage(void) {
+    fprintf(stderr,
+            "usage: gentree [--fanout=N] [--depth=N] [--files=N] "
+            "[--file-size=BYTES] [--hardlinks=RATIO] [--symlinks=RATIO] "
+            "[--long-names] [--seed=N] DIR\n");
+    exit(2);
+}
+
+int main(int argc, char *argv[]) {
+    const char *root = NULL;
+    double value;
+
+    for (int i = 1; i < argc; i++) {
+        if (parse_number(argv[i], "--fanout=", 1024, &value)) {
+            opts.fanout = value;
+        } else if (parse_number(argv[i], "--depth=", 64, &value)) {
+            opts.depth = value;
+        } else if (parse_number(argv[i], "--files=", 1e6, &value)) {
+            opts.files = value;
+        } else if (parse_number(argv[i], "--file-size=", 1 << 30, &value)) {
+            opts.file_size = value;
+        } else if (parse_number(argv[i], "--hardlinks=", 1, &value)) {
+            opts.hardlinks = value;
+        } else if (parse_number(argv[i], "--symlinks=", 1, &value)) {
+            opts.symlinks = value;
+        } else if (parse_number(argv[i], "--seed=", 1e18, &value)) {
+            opts.seed = value;
+        } else if (strcmp(argv[i], "--long-names") == 0) {
+            opts.long_names = 1;
+        } else if (argv[i][0] == '-' || root != NULL) {
+            usage();
+        } else {
+            root = argv[i];
+        }
+    }
+    if (root == NULL || opts.hardlinks + opts.symlinks > 1) usage();
+
+    state = opts.seed;
+    content = (char *)calloc(opts.file_size > 0 ? opts.file_size : 1, 1);
+    char *path = (char *)malloc(PATH_SIZE);
+    if (content == NULL || path == NULL) {
+        fprintf(stderr, "gentree: malloc error\n");
+        return 1;
+    }
+    // Symbolic links are made with the whole path of their target
+    if (root[0] == '/') {
+        snprintf(path, PATH_SIZE, "%s", root);
+    } else if (getcwd(path, PATH_SIZE) != NULL) {
+        size_t len = strlen(path);
+        snprintf(path + len, PATH_SIZE - len, "/%s", root);
+    } else {
+        return fail("getcwd error", root) ? 1 : 0;
+    }
+
+    int ret = make_dir(path, strlen(path), 0);
+    fprintf(stderr,
+            "gentree: %ld directories, %ld files, %ld hard links, %ld "
+            "symbolic links, %lld bytes\n",
+            stats.dirs, stats.files, stats.hardlinks, stats.symlinks,
+            stats.bytes);
+    free(content);
+    free(path);
+    return ret ? 1 : 0;
+}
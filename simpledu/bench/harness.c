@@ -0,0 +1,331 @@
+/* MAIN HEADER */
+
+/* INCLUDE HEADERS */
+
+/* SYSTEM CALLS HEADERS */
+#include <fcntl.h>
+#include <ftw.h>
+#include <signal.h>
+#include <sys/ptrace.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+/* C LIBRARY HEADERS */
+#include <errno.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_ARGS        32
+#define READ_SIZE       65536
+#define LOG_NAME        "./harness.log"
+
+/**
+ * @brief Way of traversing, %d is replaced by the number of threads
+ */
+typedef struct mode {
+    const char *name;
+    const char *args;
+} bench_mode_t;
+
+static const bench_mode_t modes[] = {
+    {"process", ""},
+    {"threads-1", "--threads=1"},
+    {"threads-n", "--threads=%d"},
+    {"threads-n-uring", "--threads=%d --uring=64"},
+    {"threads-n-statx", "--threads=%d --stat-mode=statx"}};
+
+static const char *flag_sets[] = {"", "-a", "-L", "--max-depth=2", "-a -L"};
+
+/**
+ * @brief Measures of one run
+ */
+typedef struct measure {
+    long    lines;          /**< @brief Lines written to stdout */
+    double  wall_ms;
+    double  user_ms;
+    double  sys_ms;
+    long    max_rss_kb;     /**< @brief Largest of the process and its subprocesses */
+    int     status;
+} measure_t;
+
+static const char *simpledu = "./bin/simpledu";
+static char simpledu_path[PATH_MAX];
+static char work_dir[] = "/tmp/simpledu-harness.XXXXXX";
+static int runs = 3;
+static int threads = 4;
+static int cold = 0;
+static int syscalls = 0;
+static long tree_entries;
+
+static double now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+}
+
+static double tv_ms(struct timeval tv) {
+    return tv.tv_sec * 1000.0 + tv.tv_usec / 1000.0;
+}
+
+static int count_entry(const char *path, const struct stat *status, int type,
+                       struct FTW *ftw) {
+    (void)path, (void)status, (void)type, (void)ftw;
+    tree_entries++;
+    return 0;
+}
+
+/**
+ * @brief Entries simpledu visits without -L, the rate is over them and not
+ *        over the printed lines (--max-depth prints few but visits all)
+ */
+static long count_tree(const char *tree) {
+    tree_entries = 0;
+    nftw(tree, count_entry, 64, FTW_PHYS);
+    return tree_entries;
+}
+
+/**
+ * @brief Drops the page, dentry and inode caches, needs root
+ * @return 0 upon success, -1 otherwise
+ */
+static int drop_caches(void) {
+    sync();
+    int fd = open("/proc/sys/vm/drop_caches", O_WRONLY);
+    if (fd == -1) return -1;
+    int ret = write(fd, "3\n", 2) == 2 ? 0 : -1;
+    close(fd);
+    return ret;
+}
+
+/**
+ * @brief Splits the arguments of simpledu, args is modified
+ */
+static void build_argv(char **argv, char *args, const char *tree) {
+    int n = 0;
+    argv[n++] = simpledu_path;
+    for (char *arg = strtok(args, " "); arg != NULL && n < MAX_ARGS - 2;
+         arg = strtok(NULL, " ")) {
+        argv[n++] = arg;
+    }
+    argv[n++] = (char *)tree;
+    argv[n] = NULL;
+}
+
+/**
+ * @brief Runs simpledu in the scratch directory (its log goes there) with
+ *        stdout going to out and stdin from /dev/null
+ */
+static void exec_child(char **argv, int out, int traced) {
+    int null = open("/dev/null", O_RDONLY);
+    if (null == -1 || dup2(null, STDIN_FILENO) == -1 ||
+        dup2(out, STDOUT_FILENO) == -1 || chdir(work_dir)) {
+        _exit(127);
+    }
+    setenv("LOG_FILENAME", LOG_NAME, 1);
+    if (traced) {
+        ptrace(PTRACE_TRACEME, 0, NULL, NULL);
+        raise(SIGSTOP);
+    }
+    execv(argv[0], argv);
+    _exit(127);
+}
+
+static int run_measured(char **argv, measure_t *m) {
+    int fds[2];
+    if (pipe(fds)) return -1;
+
+    double start = now_ms();
+    pid_t pid = fork();
+    if (pid == -1) return -1;
+    if (pid == 0) {
+        close(fds[0]);
+        exec_child(argv, fds[1], 0);
+    }
+    close(fds[1]);
+
+    // Every subprocess shares the pipe, EOF comes after the last one exits
+    static char buf[READ_SIZE];
+    ssize_t n;
+    m->lines = 0;
+    while ((n = read(fds[0], buf, sizeof(buf))) != 0) {
+        if (n == -1) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        for (ssize_t i = 0; i < n; i++) m->lines += (buf[i] == '\n');
+    }
+    close(fds[0]);
+
+    struct rusage usage;
+    if (wait4(pid, &m->status, 0, &usage) == -1) return -1;
+    m->wall_ms = now_ms() - start;
+    m->user_ms = tv_ms(usage.ru_utime);
+    m->sys_ms = tv_ms(usage.ru_stime);
+    m->max_rss_kb = usage.ru_maxrss;
+    return 0;
+}
+
+/**
+ * @brief Counts the system calls of simpledu and of every subprocess with
+ *        ptrace, much slower so it is never timed
+ * @return Number of system calls, -1 upon error
+ */
+static long run_traced(char **argv) {
+    int null = open("/dev/null", O_WRONLY);
+    if (null == -1) return -1;
+
+    pid_t pid = fork();
+    if (pid == -1) return -1;
+    if (pid == 0) exec_child(argv, null, 1);
+    close(null);
+
+    int status;
+    if (waitpid(pid, &status, 0) == -1 || !WIFSTOPPED(status)) return -1;
+    ptrace(PTRACE_SETOPTIONS, pid, NULL,
+           PTRACE_O_TRACESYSGOOD | PTRACE_O_TRACEFORK | PTRACE_O_TRACEVFORK |
+               PTRACE_O_TRACECLONE | PTRACE_O_EXITKILL);
+    ptrace(PTRACE_SYSCALL, pid, NULL, NULL);
+
+    long count = 0;
+    pid_t stopped;
+    while ((stopped = waitpid(-1, &status, __WALL)) != -1) {
+        if (!WIFSTOPPED(status)) continue;
+
+        int sig = WSTOPSIG(status);
+        if (sig == (SIGTRAP | 0x80)) {
+            struct __ptrace_syscall_info info;
+            if (ptrace(PTRACE_GET_SYSCALL_INFO, stopped, sizeof(info),
+                       &info) > 0 &&
+                info.op == PTRACE_SYSCALL_INFO_ENTRY) {
+                count++;
+            }
+            sig = 0;
+        } else if (sig == SIGTRAP || (sig == SIGSTOP && (status >> 16) == 0)) {
+            // Events and the stop of new subprocesses aren't signals
+            sig = 0;
+        }
+        ptrace(PTRACE_SYSCALL, stopped, NULL, sig);
+    }
+    return count;
+}
+
+static void run_config(const char *tree, long entries,
+                       const bench_mode_t *mode, const char *flags,
+                       int cold_cache) {
+    char args[256], mode_args[128];
+    char *argv[MAX_ARGS];
+
+    snprintf(mode_args, sizeof(mode_args), mode->args, threads);
+    snprintf(args, sizeof(args), "%s %s", mode_args, flags);
+
+    long calls = -1;
+    if (syscalls) {
+        build_argv(argv, strcpy(mode_args, args), tree);
+        calls = run_traced(argv);
+    }
+
+    // Warm run, not reported
+    measure_t m;
+    if (!cold_cache) {
+        build_argv(argv, strcpy(mode_args, args), tree);
+        run_measured(argv, &m);
+    }
+
+    for (int run = 1; run <= runs; run++) {
+        if (cold_cache) drop_caches();
+        build_argv(argv, strcpy(mode_args, args), tree);
+        if (run_measured(argv, &m)) {
+            perror("harness: run error");
+            continue;
+        }
+        printf("%s,%s,%s,%s,%d,%d,%ld,%ld,%.1f,%.0f,%.1f,%.1f,%ld,", tree,
+               mode->name, flags, cold_cache ? "cold" : "warm", run,
+               WIFEXITED(m.status) ? WEXITSTATUS(m.status) : -1, entries,
+               m.lines, m.wall_ms, entries / (m.wall_ms / 1000.0), m.user_ms,
+               m.sys_ms, m.max_rss_kb);
+        if (calls >= 0) printf("%ld", calls);
+        printf("\n");
+        fflush(stdout);
+    }
+}
+
+static void usage(void) {
+    fprintf(stderr,
+            "usage: harness [--simpledu=PATH] [--runs=N] [--threads=N] "
+            "[--cold] [--syscalls] TREE...\n");
+    exit(2);
+}
+
+int main(int argc, char *argv[]) {
+    char **trees = (char **)calloc(argc, sizeof(char *));
+    int ntrees = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (strncmp(argv[i], "--simpledu=", 11) == 0) {
+            simpledu = argv[i] + 11;
+        } else if (strncmp(argv[i], "--runs=", 7) == 0) {
+            if ((runs = atoi(argv[i] + 7)) < 1) usage();
+        } else if (strncmp(argv[i], "--threads=", 10) == 0) {
+            if ((threads = atoi(argv[i] + 10)) < 1) usage();
+        } else if (strcmp(argv[i], "--cold") == 0) {
+            cold = 1;
+        } else if (strcmp(argv[i], "--syscalls") == 0) {
+            syscalls = 1;
+        } else if (argv[i][0] == '-') {
+            usage();
+        } else if ((trees[ntrees] = realpath(argv[i], NULL)) == NULL) {
+            fprintf(stderr, "harness: '%s': %s\n", argv[i], strerror(errno));
+            return 1;
+        } else {
+            ntrees++;
+        }
+    }
+    if (ntrees == 0) usage();
+
+    // The process mode runs argv[0] again, it has to be a whole path
+    if (realpath(simpledu, simpledu_path) == NULL ||
+        access(simpledu_path, X_OK)) {
+        fprintf(stderr, "harness: '%s': %s\n", simpledu, strerror(errno));
+        return 1;
+    }
+    if (mkdtemp(work_dir) == NULL) {
+        perror("harness: mkdtemp error");
+        return 1;
+    }
+    if (cold && drop_caches()) {
+        fprintf(stderr, "harness: can't drop caches (needs root), only warm "
+                        "runs are made\n");
+        cold = 0;
+    }
+
+    printf("tree,mode,flags,cache,run,exit,entries,lines,wall_ms,entries_per_s,"
+           "user_ms,sys_ms,max_rss_kb,syscalls\n");
+    for (int t = 0; t < ntrees; t++) {
+        long entries = count_tree(trees[t]);
+        for (size_t m = 0; m < sizeof(modes) / sizeof(modes[0]); m++) {
+            for (size_t f = 0; f < sizeof(flag_sets) / sizeof(flag_sets[0]);
+                 f++) {
+                fprintf(stderr, "harness: %s %s %s\n", trees[t], modes[m].name,
+                        flag_sets[f]);
+                run_config(trees[t], entries, &modes[m], flag_sets[f], 0);
+                if (cold) {
+                    run_config(trees[t], entries, &modes[m], flag_sets[f], 1);
+                }
+            }
+        }
+        free(trees[t]);
+    }
+    free(trees);
+
+    char log_path[sizeof(work_dir) + 32];
+    snprintf(log_path, sizeof(log_path), "%s/%s", work_dir, LOG_NAME);
+    unlink(log_path);
+    rmdir(work_dir);
+    return 0;
+}
@@ -0,0 +1,195 @@
+/* MAIN HEADER */
+
+/* INCLUDE HEADERS */
+#include "exclude.h"
+
+/* SYSTEM CALLS HEADERS */
+#include <fnmatch.h>
+#include <time.h>
+
+/* C LIBRARY HEADERS */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define NAME_SIZE   64
+
+/**
+ * @brief Sizes of the run, the same options and seed give the same patterns
+ *        and names
+ */
+typedef struct bench_opts {
+    long        patterns;
+    long        names;
+    long        naive;      /**< @brief Names also matched against every pattern with fnmatch */
+    uint64_t    seed;
+} bench_opts_t;
+
+static bench_opts_t opts = {10000, 1000000, 2000, 1};
+static uint64_t state;
+
+/**
+ * @brief splitmix64, same sequence on every machine
+ */
+static uint64_t next_random(void) {
+    uint64_t z = (state += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+static double now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+}
+
+static int random_word(char *buf, int min, int max) {
+    int len = min + next_random() % (max - min + 1);
+    for (int i = 0; i < len; i++) buf[i] = 'a' + next_random() % 26;
+    buf[len] = '\0';
+    return len;
+}
+
+/**
+ * @brief Pattern of an exclude list: 40% names (node_modules, .git), 30%
+ *        "*.EXT", 15% "PREFIX*" and 15% other globs
+ */
+static void make_pattern(char *buf) {
+    char word[NAME_SIZE];
+    int kind = next_random() % 100;
+
+    random_word(word, 4, 12);
+    if (kind < 40) {
+        snprintf(buf, NAME_SIZE, "%s%s", next_random() % 4 ? "" : ".", word);
+    } else if (kind < 70) {
+        snprintf(buf, NAME_SIZE, "*.%.*s", 2 + (int)(next_random() % 4), word);
+    } else if (kind < 85) {
+        snprintf(buf, NAME_SIZE, "%.*s*", 3 + (int)(next_random() % 5), word);
+    } else if (kind < 90) {
+        snprintf(buf, NAME_SIZE, "%c?%s*", word[0], word + 2);
+    } else if (kind < 95) {
+        snprintf(buf, NAME_SIZE, "%.3s[0-9]*", word);
+    } else {
+        snprintf(buf, NAME_SIZE, "*%.4s*", word);
+    }
+}
+
+/**
+ * @brief Name of an entry, mostly "word.ext", some copied from a pattern
+ *        so a few of them match
+ */
+static void make_name(char *buf, char **patterns) {
+    if (next_random() % 10 == 0) {
+        const char *p = patterns[next_random() % opts.patterns];
+        int n = 0;
+        for (; *p != '\0' && n < NAME_SIZE - 2; p++) {
+            if (*p == '*') {
+                n += random_word(buf + n, 0, 3);
+            } else if (*p == '?') {
+                buf[n++] = 'x';
+            } else if (*p == '[') {
+                buf[n++] = '5';
+                p = strchr(p, ']');
+            } else {
+                buf[n++] = *p;
+            }
+        }
+        buf[n] = '\0';
+        return;
+    }
+    int n = random_word(buf, 3, 16);
+    if (next_random() % 2) {
+        buf[n++] = '.';
+        random_word(buf + n, 1, 4);
+    }
+}
+
+static void usage(void) {
+    fprintf(stderr, "usage: matchbench [--patterns=N] [--names=N] [--naive=N] "
+                    "[--seed=N]\n");
+    exit(2);
+}
+
+int main(int argc, char *argv[]) {
+    for (int i = 1; i < argc; i++) {
+        if (strncmp(argv[i], "--patterns=", 11) == 0) {
+            if ((opts.patterns = atol(argv[i] + 11)) < 1) usage();
+        } else if (strncmp(argv[i], "--names=", 8) == 0) {
+            if ((opts.names = atol(argv[i] + 8)) < 1) usage();
+        } else if (strncmp(argv[i], "--naive=", 8) == 0) {
+            if ((opts.naive = atol(argv[i] + 8)) < 0) usage();
+        } else if (strncmp(argv[i], "--seed=", 7) == 0) {
+            opts.seed = strtoull(argv[i] + 7, NULL, 10);
+        } else {
+            usage();
+        }
+    }
+    if (opts.naive > opts.names) opts.naive = opts.names;
+    state = opts.seed;
+
+    char **patterns = (char **)malloc(sizeof(char *) * opts.patterns);
+    char (*names)[NAME_SIZE] =
+        (char (*)[NAME_SIZE])malloc(NAME_SIZE * opts.names);
+    exclude_t *ex = exclude_create();
+    if (patterns == NULL || names == NULL || ex == NULL) {
+        perror("matchbench: malloc error");
+        return 1;
+    }
+    for (long i = 0; i < opts.patterns; i++) {
+        char buf[NAME_SIZE];
+        make_pattern(buf);
+        if ((patterns[i] = strdup(buf)) == NULL || exclude_add(ex, buf)) {
+            perror("matchbench: malloc error");
+            return 1;
+        }
+    }
+    for (long i = 0; i < opts.names; i++) make_name(names[i], patterns);
+
+    double start = now_ms();
+    if (exclude_compile(ex)) {
+        perror("matchbench: malloc error");
+        return 1;
+    }
+    double compile_ms = now_ms() - start;
+
+    long matched = 0;
+    start = now_ms();
+    for (long i = 0; i < opts.names; i++) matched += exclude_match(ex, names[i]);
+    double match_ms = now_ms() - start;
+
+    // Every pattern in turn, what a list of patterns without tables costs,
+    // it must give the same answers
+    long naive_matched = 0, compiled_matched = 0;
+    start = now_ms();
+    for (long i = 0; i < opts.naive; i++) {
+        for (long p = 0; p < opts.patterns; p++) {
+            if (fnmatch(patterns[p], names[i], 0) == 0) {
+                naive_matched++;
+                break;
+            }
+        }
+    }
+    double naive_ms = now_ms() - start;
+    for (long i = 0; i < opts.naive; i++) {
+        compiled_matched += exclude_match(ex, names[i]);
+    }
+    if (naive_matched != compiled_matched) {
+        fprintf(stderr, "matchbench: %ld names matched by fnmatch, %ld by the "
+                        "compiled set\n", naive_matched, compiled_matched);
+        return 1;
+    }
+
+    printf("patterns,names,matched,compile_ms,ns_per_entry,naive_names,"
+           "naive_ns_per_entry\n");
+    printf("%ld,%ld,%ld,%.2f,%.1f,%ld,%.1f\n", opts.patterns, opts.names,
+           matched, compile_ms, match_ms * 1e6 / opts.names, opts.naive,
+           opts.naive ? naive_ms * 1e6 / opts.naive : 0.0);
+
+    exclude_destroy(ex);
+    for (long i = 0; i < opts.patterns; i++) free(patterns[i]);
+    free(patterns);
+    free(names);
+    return 0;
+}
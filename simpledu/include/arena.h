@@ -0,0 +1,91 @@
+#ifndef ARENA_H_INCLUDED
+#define ARENA_H_INCLUDED
+
+/* INCLUDE HEADERS */
+
+/* SYSTEM CALLS HEADERS */
+
+/* C LIBRARY HEADERS */
+#include <stddef.h>
+
+#define ARENA_MIN_CHUNK     16      /** @brief Smallest first chunk, it fits the first block and each new one doubles */
+#define ARENA_MAX_CHUNK     65536   /** @brief Chunks don't grow past this, larger blocks get their own */
+
+typedef struct arena_chunk arena_chunk_t;
+
+/**
+ * @brief Region of memory taken in chunks and given in blocks that are never
+ *        freed one by one, only all at once. Not thread safe, each arena
+ *        belongs to one directory or one process
+ */
+typedef struct arena {
+    arena_chunk_t  *first;
+    arena_chunk_t  *head;       /**< @brief Chunk blocks are taken from */
+    size_t          used;       /**< @brief Bytes taken from head */
+    size_t          next_size;  /**< @brief Size of the next chunk made */
+} arena_t;
+
+/**
+ * @brief Position of an arena, blocks taken after it are given back by
+ *        arena_reset
+ */
+typedef struct arena_mark {
+    arena_chunk_t  *chunk;
+    size_t          used;
+} arena_mark_t;
+
+/**
+ * @brief           Initializes an empty arena, no memory is taken until the
+ *                  first block
+ * @param arena     Pointer to arena
+ */
+void arena_init(arena_t *arena);
+
+/**
+ * @brief           Takes a block aligned for any type
+ * @param arena     Pointer to arena
+ * @param size      Size of the block
+ * @return          Pointer to block upon success, NULL if out of memory
+ */
+void* arena_alloc(arena_t *arena, size_t size);
+
+/**
+ * @brief           Copies a string, not aligned
+ * @return          Pointer to copy upon success, NULL if out of memory
+ */
+char* arena_strdup(arena_t *arena, const char *str);
+
+/**
+ * @brief           Formats a string as sprintf, not aligned
+ * @return          Pointer to string upon success, NULL if out of memory
+ */
+char* arena_printf(arena_t *arena, const char *format, ...)
+    __attribute__((format(printf, 2, 3)));
+
+/**
+ * @brief           Sets the size of the next chunk, when the caller knows
+ *                  about how much it will take. Never past ARENA_MAX_CHUNK
+ * @param arena     Pointer to arena
+ * @param size      Bytes expected
+ */
+void arena_hint(arena_t *arena, size_t size);
+
+/**
+ * @brief           Gets the current position of the arena
+ */
+arena_mark_t arena_mark(const arena_t *arena);
+
+/**
+ * @brief           Gives back every block taken after the mark, in constant
+ *                  time. Chunks are kept for the next blocks
+ * @param arena     Pointer to arena
+ * @param mark      Position got from arena_mark, {NULL, 0} for the start
+ */
+void arena_reset(arena_t *arena, arena_mark_t mark);
+
+/**
+ * @brief           Frees every chunk, the arena is empty again
+ */
+void arena_free(arena_t *arena);
+
+#endif // ARENA_H_INCLUDED
@@ -0,0 +1,83 @@
+#ifndef CACHE_H_INCLUDED
+#define CACHE_H_INCLUDED
+
+/* INCLUDE HEADERS */
+
+/* SYSTEM CALLS HEADERS */
+#include <sys/types.h>
+
+/* C LIBRARY HEADERS */
+#include <stdint.h>
+
+#define CACHE_MULTILINK 0x1 /** @brief Some entry has several links, sizes depend on the other paths */
+#define CACHE_RACY      0x2 /** @brief Directory changed too close to the scan to trust its stamps */
+
+/**
+ * @brief Sizes of a directory in a previous traversal
+ *        Sizes are kept in 512 byte blocks and bytes, so the same cache is
+ *        used whatever -b or -B are
+ */
+typedef struct cache_rec {
+    uint64_t    dev;
+    uint64_t    ino;
+    int64_t     mtime_sec;
+    int64_t     mtime_nsec;
+    int64_t     ctime_sec;
+    int64_t     ctime_nsec;
+    uint64_t    own_blocks;     /**< @brief Entries that aren't directories */
+    uint64_t    own_bytes;
+    uint64_t    own_count;      /**< @brief Entries that aren't directories counted */
+    uint64_t    tree_blocks;    /**< @brief Directory and everything below it */
+    uint64_t    tree_bytes;
+    uint32_t    flags;          /**< @brief CACHE_* flags */
+    uint32_t    used;           /**< @brief 0 for an empty slot of the file */
+} cache_rec_t;
+
+typedef struct cache cache_t;
+
+/**
+ * @brief           Opens the cache of a previous traversal, a missing or
+ *                  unreadable file gives an empty cache
+ * @param path      Path of the cache file, rewritten by cache_save
+ * @param workers   Number of threads that add records
+ * @param key       Hash of the options that change the sizes (-L, -x, the
+ *                  excluded filesystems and names), a cache written with
+ *                  another key is ignored and written again
+ * @return          Pointer to cache upon success, NULL if out of memory
+ */
+cache_t* cache_open(const char *path, int workers, uint64_t key);
+
+/**
+ * @brief           Finds the record of a directory in the previous traversal
+ *                  Thread safe, the previous records are never modified
+ * @param cache     Pointer to cache
+ * @param dev       Device of the directory
+ * @param ino       Inode of the directory
+ * @return          Pointer to record, NULL if the directory wasn't there
+ */
+const cache_rec_t* cache_lookup(cache_t *cache, dev_t dev, ino_t ino);
+
+/**
+ * @brief           Adds the record of a directory for the next traversal
+ * @param cache     Pointer to cache
+ * @param worker    Index of the calling thread, each one has its own list
+ * @param rec       Record to copy
+ * @return          0 upon success, -1 if out of memory
+ */
+int cache_add(cache_t *cache, int worker, const cache_rec_t *rec);
+
+/**
+ * @brief           Writes the added records as the new cache file, replacing
+ *                  the previous one only once fully written
+ * @param cache     Pointer to cache
+ * @return          0 upon success, -1 if error occurs
+ */
+int cache_save(cache_t *cache);
+
+/**
+ * @brief           Unmaps the previous records and frees the cache
+ * @param cache     Pointer to cache
+ */
+void cache_close(cache_t *cache);
+
+#endif // CACHE_H_INCLUDED
@@ -0,0 +1,164 @@
+#ifndef CHECKPOINT_H_INCLUDED
+#define CHECKPOINT_H_INCLUDED
+
+/* INCLUDE HEADERS */
+
+/* SYSTEM CALLS HEADERS */
+
+/* C LIBRARY HEADERS */
+#include <stddef.h>
+#include <stdint.h>
+
+#define CHECKPOINT_MAGIC    0x00545043554453ULL  /** @brief "SDUCPT" */
+#define CHECKPOINT_VERSION  3
+#define CHECKPOINT_INTERVAL 30      /** @brief Default seconds between checkpoints */
+
+#define CHECKPOINT_UNREAD   0       /** @brief Directory read again on resume, or a path that isn't one */
+#define CHECKPOINT_SCANNED  1       /** @brief Every entry was read, subdirectories may be pending */
+#define CHECKPOINT_DONE     2       /** @brief Size of the whole subtree is known */
+
+#define CHECKPOINT_FAILED   0x1     /** @brief Directory couldn't be fully read */
+#define CHECKPOINT_PARTIAL  0x2     /** @brief Directory cut by --deadline */
+#define CHECKPOINT_HIST     0x4     /** @brief Histogram of the directory follows its name */
+#define CHECKPOINT_LINKED   0x8     /** @brief Hard links of the directory were counted elsewhere */
+
+/**
+ * @brief Beginning of the file, followed by the paths given to the scan,
+ *        each one its length (uint32_t) and itself ending with '\0', and
+ *        then by the paths not fully written yet, each one a node
+ */
+typedef struct checkpoint_header {
+    uint64_t    magic;
+    uint32_t    version;
+    uint32_t    flags;      /**< @brief Flags of the scan that change its output */
+    int32_t     block_size;
+    int32_t     max_depth;
+    uint64_t    entries;    /**< @brief Entries written to stdout before the checkpoint */
+    uint64_t    paths;
+    uint64_t    roots;
+    uint32_t    histogram;  /**< @brief Directories have a size histogram */
+    uint32_t    unused;
+} checkpoint_header_t;
+
+/**
+ * @brief Directory, followed by its name (or path for a root) ending with
+ *        '\0', its histogram (SINK_HIST_BUCKETS uint64_t) with
+ *        CHECKPOINT_HIST, the one of its links counted elsewhere with both
+ *        CHECKPOINT_HIST and CHECKPOINT_LINKED and, unless it is unread, by
+ *        its items not written yet
+ */
+typedef struct checkpoint_node {
+    uint64_t    blocks;     /**< @brief Own blocks until done, plus the subdirectories already written */
+    uint64_t    own;
+    uint64_t    apparent;   /**< @brief Bytes, like blocks */
+    uint64_t    own_apparent;
+    uint64_t    count;
+    uint64_t    dev;
+    uint64_t    ino;
+    int64_t     mtime_sec;
+    int64_t     mtime_nsec;
+    int64_t     ctime_sec;
+    int64_t     ctime_nsec;
+    uint64_t    own_blocks;
+    uint64_t    own_bytes;
+    uint64_t    tree_blocks;
+    uint64_t    tree_bytes;
+    uint64_t    linked_blocks;  /**< @brief Hard links written and counted elsewhere, taken off the sizes */
+    uint64_t    linked_apparent;
+    uint64_t    linked_count;
+    uint64_t    linked_own;
+    uint64_t    linked_own_apparent;
+    uint32_t    cache_flags;
+    uint32_t    state;      /**< @brief CHECKPOINT_UNREAD, SCANNED or DONE */
+    uint32_t    flags;      /**< @brief CHECKPOINT_FAILED, CHECKPOINT_PARTIAL, CHECKPOINT_HIST and CHECKPOINT_LINKED */
+    uint32_t    items;
+    uint32_t    name_len;
+    uint32_t    unused;
+} checkpoint_node_t;
+
+/**
+ * @brief Entry of a directory, followed by its name ending with '\0' for a
+ *        file or by its node for a subdirectory
+ */
+typedef struct checkpoint_item {
+    uint64_t    blocks;
+    uint64_t    apparent;
+    uint64_t    count;
+    uint64_t    ino;
+    uint64_t    dev;
+    int64_t     mtime;
+    uint32_t    type;
+    uint32_t    print;
+    uint32_t    dir;        /**< @brief Subdirectory, its node follows */
+    uint32_t    link;       /**< @brief Entry with several links, not counted yet */
+    uint32_t    name_len;   /**< @brief 0 for a subdirectory or a link that isn't printed */
+    uint32_t    unused;
+} checkpoint_item_t;
+
+typedef struct checkpoint_writer checkpoint_writer_t;
+
+/**
+ * @brief Checkpoint mapped for reading, records are read in order
+ */
+typedef struct checkpoint {
+    void                       *map;
+    size_t                      map_size;
+    size_t                      pos;    /**< @brief Offset of the next record */
+    const checkpoint_header_t  *header;
+} checkpoint_t;
+
+/**
+ * @brief           Starts writing a checkpoint, the file is only replaced by
+ *                  checkpoint_finish
+ * @param path      Path of the checkpoint file
+ * @param header    Header, written at once
+ * @return          Pointer to writer upon success, NULL otherwise
+ */
+checkpoint_writer_t* checkpoint_create(const char *path,
+                                       const checkpoint_header_t *header);
+
+/**
+ * @brief           Writes a record followed by a name, errors are kept until
+ *                  checkpoint_finish
+ * @param w         Pointer to writer
+ * @param rec       Record
+ * @param size      Bytes of the record
+ * @param name      Name written with its '\0', NULL if none
+ * @param name_len  Length of the name
+ */
+void checkpoint_write(checkpoint_writer_t *w, const void *rec, size_t size,
+                      const char *name, size_t name_len);
+
+/**
+ * @brief           Replaces the checkpoint file, the writer is freed
+ * @param w         Pointer to writer
+ * @param save      0 drops the new checkpoint, the previous file is kept
+ * @return          0 upon success, -1 otherwise
+ */
+int checkpoint_finish(checkpoint_writer_t *w, int save);
+
+/**
+ * @brief           Maps a checkpoint file
+ * @param ck        Pointer to checkpoint, filled
+ * @param path      Path of the checkpoint file
+ * @return          0 upon success, -1 if it can't be read or isn't a
+ *                  checkpoint
+ */
+int checkpoint_open(checkpoint_t *ck, const char *path);
+
+/**
+ * @brief           Reads the next record and the name after it, a name whose
+ *                  length is in its record is read by a second call
+ * @param ck        Pointer to checkpoint
+ * @param rec       Filled with the record, NULL if size is 0
+ * @param size      Bytes of the record
+ * @param name_len  Length of the name, 0 if none
+ * @return          Name inside the mapped file upon success (an empty
+ *                  string if none), NULL if the file ends before
+ */
+const char* checkpoint_read(checkpoint_t *ck, void *rec, size_t size,
+                            size_t name_len);
+
+void checkpoint_close(checkpoint_t *ck);
+
+#endif // CHECKPOINT_H_INCLUDED
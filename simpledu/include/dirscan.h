@@ -0,0 +1,88 @@
+#ifndef DIRSCAN_H_INCLUDED
+#define DIRSCAN_H_INCLUDED
+
+/* INCLUDE HEADERS */
+#include "exclude.h"
+#include "uring.h"
+
+/* SYSTEM CALLS HEADERS */
+#include <sys/stat.h>
+
+/* C LIBRARY HEADERS */
+#include <dirent.h>
+
+/**
+ * @brief Entry of a directory with its status
+ */
+typedef struct dir_entry {
+    char           *name;       /**< @brief Name inside the directory */
+    unsigned char   d_type;     /**< @brief Type given by readdir */
+    struct stat     status;     /**< @brief Status, see fget_status_at */
+    int             error;      /**< @brief 0, or errno if the status couldn't be read */
+} dir_entry_t;
+
+/**
+ * @brief Reads the entries of a directory and their status, one by one or in
+ *        batches through io_uring. Entries ".", ".." and the types that are
+ *        never counted are skipped, and so are the excluded names, before
+ *        their status is read. Buffers are reused between directories
+ */
+typedef struct dir_scan {
+    DIR            *dir;
+    int             deref_sym;
+    uring_t        *ring;       /**< @brief NULL reads the status synchronously */
+    const exclude_t *exclude;   /**< @brief Names skipped, NULL if none, set after init */
+
+    dir_entry_t     entry;      /**< @brief Current entry when synchronous */
+
+    dir_entry_t    *batch;
+    char          **names;
+    struct statx   *stx;
+    int            *errors;
+    unsigned        batch_size;
+    unsigned        batch_pos;
+
+    char           *name_buf;   /**< @brief Names of the batch, readdir reuses its own */
+    size_t          name_len;
+    size_t          name_memsize;
+} dir_scan_t;
+
+/**
+ * @brief           Initializes the scanner
+ * @param ds        Pointer to scanner
+ * @param ring      Ring used to read the status in batches, NULL if none
+ * @param deref_sym Follow symbolic links
+ * @return          0 upon success, -1 if out of memory
+ */
+int dirscan_init(dir_scan_t *ds, uring_t *ring, int deref_sym);
+
+/**
+ * @brief           Starts reading an open directory
+ * @param ds        Pointer to scanner
+ * @param dir       Directory to read, not closed by the scanner
+ */
+void dirscan_start(dir_scan_t *ds, DIR *dir);
+
+/**
+ * @brief           Gets the next entry of the directory, in readdir order
+ * @param ds        Pointer to scanner
+ * @return          Pointer to entry, valid until the next call, NULL at the end
+ */
+dir_entry_t* dirscan_next(dir_scan_t *ds);
+
+/**
+ * @brief           Gets the next subdirectory, the status is only read for
+ *                  entries that may be directories (by their readdir type),
+ *                  always synchronously
+ * @param ds        Pointer to scanner
+ * @return          Pointer to entry, valid until the next call, NULL at the end
+ */
+dir_entry_t* dirscan_next_dir(dir_scan_t *ds);
+
+/**
+ * @brief           Frees the buffers of the scanner, the ring isn't freed
+ * @param ds        Pointer to scanner
+ */
+void dirscan_free(dir_scan_t *ds);
+
+#endif // DIRSCAN_H_INCLUDED
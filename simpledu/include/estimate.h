@@ -0,0 +1,33 @@
+#ifndef ESTIMATE_H_INCLUDED
+#define ESTIMATE_H_INCLUDED
+
+/* INCLUDE HEADERS */
+#include "traverse.h"
+
+/* SYSTEM CALLS HEADERS */
+
+/* C LIBRARY HEADERS */
+
+#define ESTIMATE_ERROR  0.05    /** @brief Default relative error of --estimate */
+
+/**
+ * @brief           Estimates the size of every path and of its
+ *                  subdirectories from random walks down the tree, each
+ *                  directory read once at most, and prints them with the
+ *                  bounds of a 95% confidence interval
+ *                  Lines are "SIZE\tLOW\tHIGH\tPATH", subdirectories before
+ *                  their path, an exact size has the same three values
+ * @param opts      Options of the traversal, every link is counted (-l) and
+ *                  files aren't printed
+ * @param paths     Paths to estimate
+ * @param npaths    Number of paths
+ * @param error     Walks stop once the interval of a path is within this
+ *                  fraction of its size
+ * @param refine    Subdirectories with the largest estimates traversed
+ *                  again to the end for their exact size
+ * @return          0 upon success, exit status otherwise
+ */
+int estimate_paths(const du_opts_t *opts, char **paths, int npaths,
+                   double error, int refine);
+
+#endif // ESTIMATE_H_INCLUDED
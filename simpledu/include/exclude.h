@@ -0,0 +1,72 @@
+#ifndef EXCLUDE_H_INCLUDED
+#define EXCLUDE_H_INCLUDED
+
+/* INCLUDE HEADERS */
+
+/* SYSTEM CALLS HEADERS */
+
+/* C LIBRARY HEADERS */
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Set of glob patterns matched against the names of entries
+ *        Patterns without wildcards, "*SUFFIX", "PREFIX*" and "*INFIX*" go
+ *        to hash sets, the others are matched with fnmatch, grouped by their
+ *        first byte
+ */
+typedef struct exclude exclude_t;
+
+/**
+ * @brief           Creates an empty set
+ * @return          Pointer to set upon success, NULL otherwise
+ */
+exclude_t* exclude_create(void);
+
+/**
+ * @brief           Adds a pattern, only until exclude_compile is called
+ * @param ex        Pointer to set
+ * @param pattern   Glob matched against a name (not a path), as in fnmatch
+ * @return          0 upon success, -1 if out of memory
+ */
+int exclude_add(exclude_t *ex, const char *pattern);
+
+/**
+ * @brief           Adds every line of a file as a pattern, empty lines and
+ *                  lines starting with '#' are ignored
+ * @param ex        Pointer to set
+ * @param path      Path of the file
+ * @return          0 upon success, -1 otherwise (errno is set)
+ */
+int exclude_add_file(exclude_t *ex, const char *path);
+
+/**
+ * @brief           Builds the lookup tables, called once after every pattern
+ *                  was added. The set is then only read, by any thread
+ * @param ex        Pointer to set
+ * @return          0 upon success, -1 if out of memory
+ */
+int exclude_compile(exclude_t *ex);
+
+/**
+ * @brief           Checks if a name matches any pattern
+ * @param ex        Pointer to compiled set
+ * @param name      Name of the entry
+ * @return          1 if excluded, 0 otherwise
+ */
+int exclude_match(const exclude_t *ex, const char *name);
+
+/**
+ * @brief           Gets the number of patterns of the set
+ */
+size_t exclude_size(const exclude_t *ex);
+
+/**
+ * @brief           Gets a hash of the patterns of a compiled set, the same
+ *                  for the same patterns in any order or repeated
+ */
+uint64_t exclude_key(const exclude_t *ex);
+
+void exclude_destroy(exclude_t *ex);
+
+#endif // EXCLUDE_H_INCLUDED
@@ -0,0 +1,149 @@
+#ifndef INDEX_H_INCLUDED
+#define INDEX_H_INCLUDED
+
+/* INCLUDE HEADERS */
+
+/* SYSTEM CALLS HEADERS */
+#include <sys/types.h>
+
+/* C LIBRARY HEADERS */
+#include <stddef.h>
+#include <stdint.h>
+
+#define INDEX_MAGIC     0x5845444e49554453ULL   /** @brief "SDUINDEX" */
+#define INDEX_VERSION   2
+#define INDEX_FAILED    0x1     /** @brief Directory couldn't be fully read, sizes are 0 */
+#define INDEX_PARTIAL   0x2     /** @brief Directory not fully read before --deadline, sizes are lower bounds */
+
+/**
+ * @brief Beginning of the file, followed by the nodes, the offset of every
+ *        name and the names, each ending with '\0'
+ */
+typedef struct index_header {
+    uint64_t    magic;
+    uint32_t    version;
+    uint32_t    block_size;     /**< @brief Block size of the sizes, 0 if they are bytes (-b) */
+    uint64_t    nodes;
+    uint64_t    roots_first;    /**< @brief Paths given to the scan, in their order */
+    uint64_t    roots;
+    uint64_t    names;          /**< @brief Distinct names */
+    uint64_t    names_offset;   /**< @brief Offset of the offsets of the names in the file */
+    uint64_t    blob_offset;    /**< @brief Offset of the names in the file */
+    uint64_t    blob_size;
+} index_header_t;
+
+/**
+ * @brief Entry of the scan, the children of a directory are consecutive and
+ *        sorted by name
+ */
+typedef struct index_node {
+    int64_t     size;       /**< @brief Size as printed by the scan (blocks of -B or bytes of -b) */
+    uint64_t    apparent;   /**< @brief Bytes */
+    int64_t     blocks;     /**< @brief Allocated size in blocks of -B, rounded up, even with -b */
+    uint64_t    inode;
+    uint64_t    count;      /**< @brief Entries counted in size, the entry included */
+    int64_t     mtime;      /**< @brief Seconds of the last modification */
+    uint32_t    name;       /**< @brief Index of the name, the whole path for a root */
+    uint32_t    first;      /**< @brief First child */
+    uint32_t    children;
+    uint16_t    type;       /**< @brief SINK_FILE, SINK_DIR or SINK_LINK */
+    uint16_t    flags;      /**< @brief INDEX_* flags */
+} index_node_t;
+
+typedef struct index_writer index_writer_t;
+
+/**
+ * @brief Called by index_diff for every path of either index
+ * @param arg       Argument given to index_diff
+ * @param path      Path of the entry
+ * @param before    Entry in the first index, NULL if it isn't there
+ * @param after     Entry in the second index, NULL if it isn't there
+ * @return 0 to go on, -1 to stop
+ */
+typedef int (*index_diff_fn)(void *arg, const char *path,
+                             const index_node_t *before,
+                             const index_node_t *after);
+
+/**
+ * @brief Index mapped for reading
+ */
+typedef struct index {
+    void                   *map;
+    size_t                  map_size;
+    const index_header_t   *header;
+    const index_node_t     *nodes;
+    const uint64_t         *name_offsets;
+    const char             *blob;
+} index_t;
+
+/**
+ * @brief           Starts writing an index, the file is only replaced by
+ *                  index_finish
+ * @param path      Path of the index file
+ * @param block_size Block size of the sizes, 0 if they are bytes
+ * @return          Pointer to writer upon success, NULL otherwise
+ */
+index_writer_t* index_create(const char *path, uint32_t block_size);
+
+/**
+ * @brief           Adds an entry of the scan, in output order: every entry
+ *                  of a directory comes before it. Not thread safe
+ * @param w         Pointer to writer
+ * @param name      Name of the entry, the whole path for a path given
+ * @param depth     0 for the paths given
+ * @param node      Sizes, type and flags of the entry, name and children are
+ *                  filled by the writer
+ * @return          0 upon success, -1 otherwise
+ */
+int index_add(index_writer_t *w, const char *name, int depth,
+              const index_node_t *node);
+
+/**
+ * @brief           Writes the roots and the names and replaces the index
+ *                  file, the writer is freed
+ * @param w         Pointer to writer
+ * @param save      0 drops the index, the previous file is kept
+ * @return          0 upon success, -1 otherwise
+ */
+int index_finish(index_writer_t *w, int save);
+
+/**
+ * @brief           Maps an index file
+ * @param idx       Pointer to index, filled
+ * @param path      Path of the index file
+ * @return          0 upon success, -1 if it can't be read or isn't an index
+ */
+int index_open(index_t *idx, const char *path);
+
+/**
+ * @brief           Finds the entry of a path, which starts with one of the
+ *                  paths given to the scan. No system call is made
+ * @param idx       Pointer to index
+ * @param path      Path to find
+ * @return          Pointer to entry, NULL if it isn't in the index
+ */
+const index_node_t* index_lookup(const index_t *idx, const char *path);
+
+/**
+ * @brief           Gets the name of an entry
+ */
+const char* index_name(const index_t *idx, const index_node_t *node);
+
+/**
+ * @brief           Walks two indexes together, in the order of the paths:
+ *                  the children of a directory are merged by name, as both
+ *                  are sorted, so the memory used only grows with the depth
+ *                  Paths given to both scans come first, in the order of the
+ *                  second one
+ * @param before    Pointer to first index
+ * @param after     Pointer to second index
+ * @param fn        Called for every path, a directory before its entries
+ * @param arg       Argument given to fn
+ * @return          0 upon success, -1 if out of memory or fn stopped
+ */
+int index_diff(const index_t *before, const index_t *after, index_diff_fn fn,
+               void *arg);
+
+void index_close(index_t *idx);
+
+#endif // INDEX_H_INCLUDED
@@ -0,0 +1,83 @@
+#ifndef INOSET_H_INCLUDED
+#define INOSET_H_INCLUDED
+
+/* INCLUDE HEADERS */
+
+/* SYSTEM CALLS HEADERS */
+#include <sys/stat.h>
+#include <sys/types.h>
+
+/* C LIBRARY HEADERS */
+
+typedef struct inoset inoset_t;
+
+/**
+ * @brief           Creates an empty set of (device, inode) pairs
+ *                  The set lives in a memfd so it is shared by every thread
+ *                  and by every subprocess the descriptor is given to
+ * @param cloexec   Close the descriptor on exec (no subprocess will use it)
+ * @param all       Every entry is added by inoset_seen, directories and
+ *                  entries with a single link too, as du does with several
+ *                  paths or -L
+ * @return          Pointer to set upon success, NULL otherwise
+ */
+inoset_t* inoset_create(int cloexec, int all);
+
+/**
+ * @brief           Attaches to a set created by another process
+ * @param fd        Descriptor of the set, see inoset_fd
+ * @return          Pointer to set upon success, NULL otherwise
+ */
+inoset_t* inoset_attach(int fd);
+
+/**
+ * @brief           Gets the descriptor to give to subprocesses
+ * @param set       Pointer to set
+ * @return          Descriptor of the memfd
+ */
+int inoset_fd(inoset_t *set);
+
+/**
+ * @brief           Checks if every entry is added, see inoset_create
+ * @param set       Pointer to set
+ * @return          1 if every entry is added, 0 if only hard links are
+ */
+int inoset_all(const inoset_t *set);
+
+/**
+ * @brief           Adds the pair to the set
+ * @param set       Pointer to set
+ * @param dev       Device of the entry
+ * @param ino       Inode of the entry
+ * @return          1 if the pair is new, 0 if it was already there, -1 if
+ *                  error occurs
+ */
+int inoset_insert(inoset_t *set, dev_t dev, ino_t ino);
+
+/**
+ * @brief           Checks if the entry is a hard link to an inode that was
+ *                  already counted. Unless the set was created with all,
+ *                  only entries that aren't directories and have more than
+ *                  one link are added to the set
+ * @param set       Pointer to set
+ * @param status    Status of the entry
+ * @return          1 if already counted, 0 if it must be counted, -1 if error
+ *                  occurs
+ */
+int inoset_seen(inoset_t *set, const struct stat *status);
+
+/**
+ * @brief           Gets the number of pairs and the memory used by the set
+ * @param set       Pointer to set
+ * @param count     Filled with the number of pairs
+ * @param bytes     Filled with the bytes used by tables and header
+ */
+void inoset_usage(inoset_t *set, long *count, long *bytes);
+
+/**
+ * @brief           Unmaps the set and closes its descriptor
+ * @param set       Pointer to set
+ */
+void inoset_destroy(inoset_t *set);
+
+#endif // INOSET_H_INCLUDED
@@ -7,11 +7,102 @@
 #include <sys/time.h>
 
 /* C LIBRARY HEADERS */
+#include <stddef.h>
+#include <stdint.h>
 
 #define DEFAULT_MODE 0644 /**< @brief Permissions associated with the file */
+#define LOG_PATH_SIZE 4096  /** @brief Bytes of the path of the log file */
+
+#define LOG_MAGIC       "SDULOG\0\0"  /** @brief First bytes of a binary log */
+#define LOG_VERSION     1
+#define LOG_RECORD_SIZE 64
+#define LOG_RECORD_TEXT 38
+
+/**
+ * @brief Actions of the log
+ */
+typedef enum log_action {
+    LOG_CREATE,
+    LOG_EXIT,
+    LOG_RECV_SIGNAL,
+    LOG_SEND_SIGNAL,
+    LOG_RECV_PIPE,
+    LOG_SEND_PIPE,
+    LOG_ENTRY,
+    LOG_ACTIONS
+} log_action_t;
 
 /**
- * @brief           Init the log
+ * @brief Layout of the info of a record, rendered like the text log
+ */
+typedef enum log_kind {
+    LOG_INFO_TEXT,      /**< @brief text as is */
+    LOG_INFO_LONG,      /**< @brief "value\n" */
+    LOG_INFO_DOUBLE,    /**< @brief "value\n", value holds the bits of a double */
+    LOG_INFO_ARRAY,     /**< @brief every int of text, then "\n" */
+    LOG_INFO_TIMEVAL,   /**< @brief seconds and microseconds (two int64_t in text) */
+    LOG_INFO_SIGNAL,    /**< @brief "text value\n" */
+    LOG_INFO_ENTRY      /**< @brief "value\ttext\n" */
+} log_kind_t;
+
+/**
+ * @brief Header of a binary log, written once by the main process
+ */
+typedef struct log_header {
+    char        magic[8];
+    uint32_t    version;
+    uint32_t    record_size;
+    int64_t     init_sec;       /**< @brief Instant the program started */
+    int64_t     init_usec;
+    char        reserved[32];
+} log_header_t;
+
+/**
+ * @brief Record of a binary log
+ *        A text longer than LOG_RECORD_TEXT goes on in the next records,
+ *        which only have text, so the text of a record is always contiguous
+ */
+typedef struct log_record {
+    int64_t     instant;    /**< @brief Microseconds since the program started */
+    int64_t     value;
+    int32_t     pid;        /**< @brief Same pid as the text log (parent's) */
+    uint32_t    length;     /**< @brief Bytes of text */
+    uint8_t     action;
+    uint8_t     kind;
+    char        text[LOG_RECORD_TEXT];
+} log_record_t;
+
+/** @brief Name of every action, as written in the text log */
+extern const char *const log_action_names[LOG_ACTIONS];
+
+/**
+ * @brief           Number of records taken by a record and its text
+ * @param length    Bytes of text
+ * @return          Number of records
+ */
+static inline size_t log_record_count(size_t length) {
+    if (length <= LOG_RECORD_TEXT) return 1;
+    return 1 + (length - LOG_RECORD_TEXT + LOG_RECORD_SIZE - 1) / LOG_RECORD_SIZE;
+}
+
+/**
+ * @brief           Builds the path of the log file: LOG_FILENAME as it is if
+ *                  it has a '/', otherwise LOG_FILENAME (log.bin or log.txt
+ *                  without it) in $XDG_STATE_HOME/simpledu, or in
+ *                  /tmp/simpledu-UID without XDG_STATE_HOME
+ * @param path      Filled with the path
+ * @param size      Bytes of path
+ * @param binary    Name by default is the one of a binary log
+ * @param create    Creates the directory, which must belong to the user
+ * @return          0 upon success, -1 otherwise
+ */
+int log_path(char *path, size_t size, int binary, int create);
+
+/**
+ * @brief           Init the log, see log_path for where it is written
+ *                  The log is binary unless the environment variable
+ *                  LOG_FORMAT is "text", records are kept in a buffer of each
+ *                  thread and written in batches (see flush_log)
  * @return          File descriptor uppon sucess or 1 otherwise
  */
 int init_log();
@@ -35,13 +126,22 @@ void set_time(struct timeval *it);
 long double elapsed_time();
 
 /**
- * @brief               Write an action to log
+ * @brief               Write an action to log, it is written at once (no
+ *                      buffer) so it can be used by signal handlers
  * @param log_action    Description of type of event
  * @param log_info      Additional information about any action
  * @return              0 uppon sucess or 1 otherwhise
  */
 int write_log(char *log_action, char *log_info);
 
+/**
+ * @brief               Write an ENTRY action to log, the path can have any length
+ * @param size          Number of bytes (or blocks) of the entry
+ * @param path          Path of the entry
+ * @return              0 uppon sucess or 1 otherwhise
+ */
+int write_log_entry(long size, const char *path);
+
 /**
  * @brief               Write an action to log
  * @param log_action    Timeval struct
@@ -75,13 +175,23 @@ int write_log_long(char *log_action, long log_info);
 int write_log_double(char *log_action, double log_info);
 
 /**
- * @brief               Write an action to log
+ * @brief               Write an action to log, it is written at once (no
+ *                      buffer) so it can be used by signal handlers
  * @param log_action    Sinal type
  * @param pid           PID of global process
  * @return              0 uppon sucess or 1 otherwhise
  */
 int write_log_sign(char *log_action, char *log_info, int pid);
 
+/**
+ * @brief           Writes the records buffered by every thread, async signal
+ *                  safe, buffers being written by another thread are left to it
+ *                  Buffers are also written by a background thread once one is
+ *                  half full, and at exit
+ * @return          0 uppon sucess or 1 otherwhise
+ */
+int flush_log(void);
+
 /**
  * @brief           Close log file
  * @return          0 uppon sucess or 1 otherwhise
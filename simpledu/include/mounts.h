@@ -0,0 +1,44 @@
+#ifndef MOUNTS_H_INCLUDED
+#define MOUNTS_H_INCLUDED
+
+/* INCLUDE HEADERS */
+
+/* SYSTEM CALLS HEADERS */
+#include <sys/types.h>
+
+/* C LIBRARY HEADERS */
+
+#define MOUNTINFO_PATH  "/proc/self/mountinfo"
+
+/**
+ * @brief Devices of the mounts whose filesystem type is excluded, sorted
+ */
+typedef struct mounts {
+    dev_t  *devs;
+    int     size;
+} mounts_t;
+
+/**
+ * @brief           Reads the mount table once, keeping the device of every
+ *                  mount whose type is in the list
+ * @param mounts    Pointer to table, filled
+ * @param fstypes   Types separated by commas, "fuse" also matches every
+ *                  "fuse.*" subtype
+ * @return          0 upon success, -1 otherwise
+ */
+int mounts_load(mounts_t *mounts, const char *fstypes);
+
+/**
+ * @brief           Checks if a directory isn't read, no system call is made
+ * @param mounts    Excluded types, NULL if none
+ * @param one_fs    With -x, directories on another device than their parent
+ *                  aren't read
+ * @param parent    Device of the parent directory
+ * @param dev       Device of the directory
+ * @return          1 if the directory is pruned, 0 otherwise
+ */
+int mounts_prune(const mounts_t *mounts, int one_fs, dev_t parent, dev_t dev);
+
+void mounts_free(mounts_t *mounts);
+
+#endif // MOUNTS_H_INCLUDED
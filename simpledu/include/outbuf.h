@@ -0,0 +1,102 @@
+#ifndef OUTBUF_H_INCLUDED
+#define OUTBUF_H_INCLUDED
+
+/* INCLUDE HEADERS */
+
+/* SYSTEM CALLS HEADERS */
+#include <sys/types.h>
+
+/* C LIBRARY HEADERS */
+
+#define OUTBUF_DEFAULT_SIZE 32768   /** @brief Default flush size of the output */
+#define OUTBUF_MAX_SIZE     (1 << 24)
+
+/**
+ * @brief Output buffer, holds whole lines only and writes them once it has
+ *        flush_size bytes
+ *        When the descriptor is a pipe every write has whole lines and at
+ *        most PIPE_BUF bytes (unless a single line is longer), so lines of
+ *        several writers sharing the pipe are never mixed
+ */
+typedef struct outbuf {
+    int             fd;
+    char           *buf;
+    size_t          size;       /**< @brief Flush size, 0 writes every line at once */
+    volatile size_t len;        /**< @brief Only grows once a whole line was copied */
+    int             atomic;     /**< @brief Descriptor is a pipe */
+} outbuf_t;
+
+/**
+ * @brief           Initializes the buffer
+ * @param ob        Pointer to buffer
+ * @param fd        Descriptor written by the buffer
+ * @param size      Flush size in bytes, 0 for no buffering
+ * @return          0 upon success, -1 if out of memory
+ */
+int outbuf_init(outbuf_t *ob, int fd, size_t size);
+
+/**
+ * @brief           Appends the line "size\tpath\n"
+ * @param ob        Pointer to buffer
+ * @param size      Size of the entry
+ * @param path      Path of the entry
+ * @return          0 upon success, -1 if a write failed
+ */
+int outbuf_entry(outbuf_t *ob, long size, const char *path);
+
+/**
+ * @brief           Gets room for len bytes at the end of the buffer, flushing
+ *                  it first if they don't fit, see outbuf_commit
+ * @param ob        Pointer to buffer
+ * @param len       Largest number of bytes that will be written
+ * @return          Pointer to the room, NULL if len is larger than the flush
+ *                  size or a write failed
+ */
+char* outbuf_reserve(outbuf_t *ob, size_t len);
+
+/**
+ * @brief           Adds the bytes written in the room given by outbuf_reserve
+ * @param ob        Pointer to buffer
+ * @param len       Bytes written, at most the ones reserved
+ */
+void outbuf_commit(outbuf_t *ob, size_t len);
+
+/**
+ * @brief           Appends bytes, written at once if they don't fit even in
+ *                  an empty buffer
+ * @param ob        Pointer to buffer
+ * @param data      Bytes to append, whole lines (or records)
+ * @param len       Number of bytes
+ * @return          0 upon success, -1 if a write failed
+ */
+int outbuf_write(outbuf_t *ob, const void *data, size_t len);
+
+/**
+ * @brief           Writes every buffered line, async signal safe as long as
+ *                  it doesn't interrupt another flush of the same buffer
+ * @param ob        Pointer to buffer
+ * @return          0 upon success, -1 if a write failed
+ */
+int outbuf_flush(outbuf_t *ob);
+
+/**
+ * @brief           Flushes and frees the buffer, the descriptor isn't closed
+ * @param ob        Pointer to buffer
+ */
+void outbuf_free(outbuf_t *ob);
+
+/**
+ * @brief           Sets up the buffer of stdout, flushed at exit, before
+ *                  forking and by the signal handlers
+ * @param size      Flush size in bytes, 0 for no buffering
+ * @return          0 upon success, -1 if error occurs
+ */
+int outbuf_init_stdout(size_t size);
+
+/**
+ * @brief           Gets the buffer of stdout
+ * @return          Pointer to buffer
+ */
+outbuf_t* outbuf_stdout(void);
+
+#endif // OUTBUF_H_INCLUDED
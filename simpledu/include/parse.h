@@ -1,9 +1,13 @@
 #ifndef PARSE_H_INCLUDED
 #define PARSE_H_INCLUDED
 
+/* INCLUDE HEADERS */
+#include "arena.h"
+#include "sink.h"
+
 #define BIT(n)      (0x1 << (n))    /** @brief Get a mask with bit n activated */
 
-// simpledu -l [path] [-a] [-b] [-B size] [-L] [-S] [--max-depth=N]
+// simpledu [-l] [path] [-a] [-b] [-B size] [-L] [-S] [--max-depth=N]
 
 // -l, --count-links
 #define FLAG_LINKS      BIT(0)  /** @brief Count the same file multiple times */
@@ -23,6 +27,50 @@
 #define FLAG_PATH       BIT(7)  /** @brief Use custom path */
 // Flag error
 #define FLAG_ERR        BIT(8)  /** @brief Error flag */
+// --threads=N
+#define FLAG_THREADS    BIT(9)  /** @brief Traverse inside this process with N threads instead of a process per directory */
+// --stat-mode=stat|statx|nosync
+#define FLAG_STATMODE   BIT(10) /** @brief Choose how the status of the entries is read */
+// --uring=DEPTH
+#define FLAG_URING      BIT(11) /** @brief Read the status of the entries in batches through io_uring */
+// --inode-stats
+#define FLAG_INODESTATS BIT(12) /** @brief Print the memory used to track hard links */
+// --cache=PATH
+#define FLAG_CACHE      BIT(13) /** @brief Reuse the sizes of unchanged directories from the previous run */
+// --verify
+#define FLAG_VERIFY     BIT(14) /** @brief Read every entry and compare its size with the cache */
+// --watch
+#define FLAG_WATCH      BIT(15) /** @brief Keep the sizes up to date from filesystem events and answer queries from stdin */
+// --flush-size=BYTES
+#define FLAG_FLUSHSIZE  BIT(16) /** @brief Size of the output buffer, 0 writes every line at once */
+// --top=N
+#define FLAG_TOP        BIT(17) /** @brief Only print the N largest directories */
+// --top-files=N
+#define FLAG_TOPFILES   BIT(18) /** @brief Only print the N largest files, needs -a */
+// --format=FORMAT
+#define FLAG_FORMAT     BIT(19) /** @brief Output format: text, ndjson, csv or bin */
+// --stats[=text|json]
+#define FLAG_STATS      BIT(20) /** @brief Print counters and latencies of the traversal at exit */
+// --device-jobs=N
+#define FLAG_DEVJOBS    BIT(21) /** @brief Paths on the same device traversed at the same time */
+// -x, --one-file-system
+#define FLAG_ONEFS      BIT(22) /** @brief Skip directories on another filesystem than their parent */
+// --exclude-fstype=TYPES
+#define FLAG_EXCLFS     BIT(23) /** @brief Skip directories on filesystems of the types given */
+// --exclude=GLOB, --exclude-from=FILE
+#define FLAG_EXCLUDE    BIT(24) /** @brief Skip entries whose name matches a pattern */
+// --jobs=N
+#define FLAG_JOBS       BIT(25) /** @brief Subprocesses of a directory traversing at the same time */
+// --workers=N
+#define FLAG_WORKERS    BIT(26) /** @brief Read the directories in N worker processes forked once */
+// --save-index=FILE
+#define FLAG_INDEX      BIT(27) /** @brief Write every entry to an index answered by simpledu query */
+// --estimate[=ERROR]
+#define FLAG_ESTIMATE   BIT(28) /** @brief Estimate the sizes from random walks instead of reading every directory */
+// --deadline=SECONDS
+#define FLAG_DEADLINE   BIT(29) /** @brief Stop reading directories after N seconds and print the sizes so far */
+// --checkpoint=FILE, --resume=FILE
+#define FLAG_CHECKPOINT BIT(30) /** @brief Save the traversal left to a file from time to time and upon SIGTERM */
 
 typedef struct parse_info parse_info_t;
 /**
@@ -34,6 +82,30 @@ struct parse_info {
     int       paths_memsize;
     int       block_size;
     int       max_depth;
+    int       threads;
+    int       stat_mode;
+    int       uring_depth;
+    char     *cache_path;
+    char     *index_path;
+    int       flush_size;
+    int       top;
+    int       top_files;
+    int       format;
+    int       stats_format;
+    int       device_jobs;
+    int       jobs;
+    int       workers;
+    int       worker_timeout;   /**< @brief Seconds, see --worker-timeout */
+    double    estimate_error;   /**< @brief Relative error, see --estimate */
+    int       refine;           /**< @brief Subdirectories traversed to the end, see --refine */
+    double    deadline;         /**< @brief Seconds, see --deadline */
+    char     *checkpoint_path;  /**< @brief See --checkpoint, the one resumed if not given */
+    int       checkpoint_interval;  /**< @brief Seconds, see --checkpoint-interval */
+    char     *resume_path;      /**< @brief See --resume */
+    sink_columns_t  columns;    /**< @brief Columns of the text format, see --columns */
+    char     *exclude_fstype;
+    char    **excludes;         /**< @brief Arguments --exclude and --exclude-from, in order */
+    int       excludes_size;
 };
 
 void init_parse_info(parse_info_t *info);
@@ -43,9 +115,16 @@ void free_parse_info(parse_info_t *info);
 void parse_info_addpath(parse_info_t *info, char *path);
 
 /**
- * Builds array argv needed to execute this program
+ * @brief           Builds the argv of a subprocess traversing one path, with
+ *                  the options of this process
+ * @param arena     Arena where the vector and its strings are taken, it is
+ *                  reset by the caller once the subprocess is spawned
+ * @param path      Path traversed by the subprocess, not copied
+ * @param max_depth Depth given with --max-depth, if set
+ * @return          Vector ended by NULL upon success, NULL if out of memory
  */
-char** build_argv(char *argv0, int flags, parse_info_t *info);
+char** build_argv(arena_t *arena, char *argv0, int flags,
+                  const parse_info_t *info, char *path, int max_depth);
 
 /**
  * @brief Parses command from command line and returns the activated flags
@@ -0,0 +1,72 @@
+#ifndef POOL_H_INCLUDED
+#define POOL_H_INCLUDED
+
+/* INCLUDE HEADERS */
+
+/* SYSTEM CALLS HEADERS */
+
+/* C LIBRARY HEADERS */
+
+typedef struct pool pool_t;
+
+/**
+ * @brief           Function run for every task taken from the pool
+ * @param ctx       Context given to pool_create
+ * @param task      Task pushed with pool_push
+ * @param worker    Index of the worker running the task (0 ... workers - 1)
+ */
+typedef void (*pool_task_fn)(void *ctx, void *task, int worker);
+
+/**
+ * @brief           Creates a work stealing pool, each worker owns a deque
+ *                  Workers pop from the bottom of their own deque (LIFO) and
+ *                  steal from the top of the others (FIFO)
+ * @param workers   Number of workers (calling thread of pool_run included)
+ * @param fn        Function run for every task
+ * @param ctx       Context passed to fn
+ * @return          Pointer to pool upon success, NULL otherwise
+ */
+pool_t* pool_create(int workers, pool_task_fn fn, void *ctx);
+
+/**
+ * @brief           Pushes a task to the deque of the worker
+ *                  Safe to call from inside a task with its own worker index
+ * @param pool      Pointer to pool
+ * @param worker    Index of the deque
+ * @param task      Task to be run
+ * @return          0 upon success, -1 otherwise
+ */
+int pool_push(pool_t *pool, int worker, void *task);
+
+/**
+ * @brief           Runs the tasks until every deque is empty and no task is
+ *                  running, the calling thread acts as worker 0
+ * @param pool      Pointer to pool
+ * @return          0 upon success, -1 if out of memory
+ */
+int pool_run(pool_t *pool);
+
+/**
+ * @brief           Number of tasks pushed and not yet taken by a worker
+ * @param pool      Pointer to pool
+ * @return          Number of queued tasks
+ */
+long pool_queued(pool_t *pool);
+
+/**
+ * @brief           Stops or lets the workers steal. A held worker only takes
+ *                  tasks from its own deque and sleeps once it is empty, so
+ *                  tasks must only be pushed to the deque of the worker
+ *                  running the task pushing them
+ * @param pool      Pointer to pool
+ * @param hold      1 stops stealing, 0 lets it go on and wakes the workers
+ */
+void pool_hold(pool_t *pool, int hold);
+
+/**
+ * @brief           Frees the pool, must not be running
+ * @param pool      Pointer to pool
+ */
+void pool_destroy(pool_t *pool);
+
+#endif // POOL_H_INCLUDED
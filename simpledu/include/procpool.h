@@ -0,0 +1,95 @@
+#ifndef PROCPOOL_H_INCLUDED
+#define PROCPOOL_H_INCLUDED
+
+/* INCLUDE HEADERS */
+#include "dirscan.h"
+#include "exclude.h"
+
+/* SYSTEM CALLS HEADERS */
+#include <pthread.h>
+#include <sys/types.h>
+
+/* C LIBRARY HEADERS */
+#include <stddef.h>
+
+#define PROCPOOL_MSG_SIZE   32768   /** @brief Largest message sent by a worker, a batch of entries */
+#define PROCPOOL_EOPEN      1       /** @brief The worker couldn't open the directory */
+#define PROCPOOL_TIMEOUT    30      /** @brief Default seconds a worker may go without answering */
+
+/**
+ * @brief Process forked once that reads directories for one thread, a job
+ *        is the path of a directory and the answer is its entries with their
+ *        status, in batches
+ */
+typedef struct proc_worker {
+    pid_t       pid;        /**< @brief -1 if it couldn't be forked again */
+    int         sock;       /**< @brief End of the socket pair in this process */
+    int         busy;       /**< @brief Last message of the job not received yet */
+    char       *msg;        /**< @brief Last message received */
+    size_t      msg_len;
+    size_t      msg_pos;    /**< @brief Next entry of the message */
+    int         last;       /**< @brief Message is the last one of the job */
+    int         error;      /**< @brief errno of opening the directory, in the last message */
+    dir_entry_t entry;      /**< @brief Current entry, its name points to msg */
+} proc_worker_t;
+
+/**
+ * @brief Worker processes, each one owned by a thread, so a directory that
+ *        hangs only blocks the process reading it until the timeout
+ */
+typedef struct procpool {
+    proc_worker_t      *workers;
+    int                 size;
+    int                 timeout;    /**< @brief Milliseconds a worker may go without answering */
+    int                 deref_sym;
+    int                 uring_depth;
+    const exclude_t    *exclude;
+    pid_t               pgid;       /**< @brief Group of the workers, stopped on SIGINT */
+    pthread_mutex_t     lock;       /**< @brief Taken while forking a worker again */
+} procpool_t;
+
+/**
+ * @brief           Forks every worker, before any thread is created
+ * @param workers   Number of workers, one for each thread
+ * @param timeout   Milliseconds a worker may go without sending a message
+ *                  before it is killed and forked again
+ * @param deref_sym Follow symbolic links
+ * @param uring_depth Depth of the io_uring of each worker, 0 if none
+ * @param exclude   Names skipped by the workers, NULL if none
+ * @return          Pointer to pool upon success, NULL otherwise
+ */
+procpool_t* procpool_create(int workers, int timeout, int deref_sym,
+                            int uring_depth, const exclude_t *exclude);
+
+/**
+ * @brief           Sends a directory to the worker, the entries of the
+ *                  previous one not taken are dropped
+ * @param pp        Pointer to pool
+ * @param worker    Index of the worker, only used by one thread
+ * @param path      Path of the directory
+ * @param only_dirs Only the subdirectories are sent, see dirscan_next_dir
+ * @return          0 upon success, -1 otherwise
+ */
+int procpool_start(procpool_t *pp, int worker, const char *path,
+                   int only_dirs);
+
+/**
+ * @brief           Gets the next entry of the directory sent to the worker
+ *                  A worker that doesn't answer in time is killed and forked
+ *                  again (errno is ETIMEDOUT)
+ * @param pp        Pointer to pool
+ * @param worker    Index of the worker
+ * @param entry     Entry, valid until the next call, NULL at the end or upon
+ *                  error
+ * @return          0 upon success, PROCPOOL_EOPEN if the directory couldn't
+ *                  be opened, -1 if the worker failed, errno is set
+ */
+int procpool_next(procpool_t *pp, int worker, dir_entry_t **entry);
+
+/**
+ * @brief           Ends every worker and frees the pool
+ * @param pp        Pointer to pool, may be NULL
+ */
+void procpool_destroy(procpool_t *pp);
+
+#endif // PROCPOOL_H_INCLUDED
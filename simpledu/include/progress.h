@@ -0,0 +1,53 @@
+#ifndef PROGRESS_H_INCLUDED
+#define PROGRESS_H_INCLUDED
+
+/* INCLUDE HEADERS */
+
+/* SYSTEM CALLS HEADERS */
+
+/* C LIBRARY HEADERS */
+#include <stdint.h>
+
+/**
+ * @brief           Starts the counters printed on SIGUSR1, in the main process
+ * @param shared    The counters live in a file inherited by the subprocesses,
+ *                  0 keeps them in this process
+ * @return          0 upon success, -1 otherwise
+ */
+int progress_create(int shared);
+
+/**
+ * @brief           Maps the counters of the main process in a subprocess
+ * @param fd        Descriptor given by progress_fd
+ * @return          0 upon success, -1 otherwise
+ */
+int progress_attach(int fd);
+
+/**
+ * @brief           Gets the file of the counters
+ * @return          Descriptor, -1 if they aren't shared or don't exist
+ */
+int progress_fd(void);
+
+/**
+ * @brief           Counts directories found, queued until they are read
+ */
+void progress_found(long dirs);
+
+/**
+ * @brief           Counts a directory read, nothing is counted before
+ *                  progress_create or progress_attach
+ * @param entries   Entries read in it
+ * @param bytes     Disk usage of its entries that aren't directories
+ * @param found     Subdirectories found in it, see progress_found
+ */
+void progress_dir(long entries, uint64_t bytes, long found);
+
+/**
+ * @brief           Handler for SIGUSR1 that writes the counters to stderr,
+ *                  the traversal goes on. Only async signal safe calls
+ * param signo      int value for the signal received in the handler (SIGUSR1)
+ */
+void progress_handler(int signo);
+
+#endif // PROGRESS_H_INCLUDED
@@ -13,13 +13,69 @@ void setGlobalProcess(int pgid);
 void resetGlobalProcess(void);
 
 /**
- * @brief           Handler for SIGINT that stops all processes and allows the user to terminate or continue the program
+ * @brief           Counts the times the subprocesses were stopped and continued
+ *                  by SIGINT, odd while they are stopped
+ * @return          Number of stops and continues
+ */
+int sig_pauses(void);
+
+/**
+ * @brief           Makes SIGINT and SIGTERM also write a byte ('i' or 't') to
+ *                  fd, for a thread polling it while the others work
+ * param fd         Descriptor written by the handlers, -1 if none
+ */
+void sig_setwake_fd(int fd);
+
+/**
+ * @brief           Checks if SIGINT or SIGTERM was received and not handled yet
+ * @return          1 if so, 0 otherwise
+ */
+int sig_pending(void);
+
+/**
+ * @brief           Takes the SIGINT received since the last call, if any
+ * @return          1 if SIGINT was received, 0 otherwise
+ */
+int sig_interrupted(void);
+
+/**
+ * @brief           Checks if SIGTERM was received
+ * @return          1 if so, 0 otherwise
+ */
+int sig_terminated(void);
+
+/**
+ * @brief           Stops all processes and asks the user to terminate or
+ *                  continue the program, the output is flushed first so no
+ *                  one else may be writing it
+ * @return          1 if the user confirmed, 0 otherwise
+ */
+int sig_prompt(void);
+
+/**
+ * @brief           Flushes the output and the log and ends the program like
+ *                  SIGTERM would, never returns
+ */
+void sig_terminate(void);
+
+/**
+ * @brief           Handles the signals received since the last call: asks the
+ *                  question of SIGINT, ends the program upon SIGTERM or when
+ *                  the user confirms. Called by the loops of a single thread
+ *                  between two entries and when a wait is interrupted
+ */
+void sig_poll(void);
+
+/**
+ * @brief           Handler for SIGINT, only records it for sig_poll or the
+ *                  thread polling the descriptor of sig_setwake_fd
  * param signo      int value for the signal received in the handler (SIGINT)
  */
 void sigint_handler(int signo);
 
 /**
- * @brief           Handler for SIGTERM and SIGCONT, which allows writing in log.txt
+ * @brief           Handler for SIGTERM and SIGCONT, which only records them
+ *                  like sigint_handler, they are logged once handled
  * param signo      int value for the signal received in the handler (SIGTERM or SIGSTOP)
  */
 void siglog_handler(int signo);
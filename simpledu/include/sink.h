@@ -0,0 +1,154 @@
+#ifndef SINK_H_INCLUDED
+#define SINK_H_INCLUDED
+
+/* INCLUDE HEADERS */
+#include "outbuf.h"
+
+/* SYSTEM CALLS HEADERS */
+
+/* C LIBRARY HEADERS */
+#include <stdint.h>
+
+#define SINK_TEXT   0   /** @brief Index of the default format, "size\tpath" lines */
+
+#define SINK_BIN_MAGIC      "SDUBIN\0\0"    /** @brief First bytes of --format=bin */
+#define SINK_BIN_VERSION    1
+#define SINK_BIN_PARTIAL    0x100   /** @brief Flag of the type of a record whose size is a lower bound */
+
+#define SINK_HIST_BUCKETS   48      /** @brief Buckets of the size histogram: 0 bytes, then [2^(i-1), 2^i) bytes, the last one unbounded */
+#define SINK_COLUMNS_MAX    8       /** @brief Columns given to --columns */
+
+/**
+ * @brief Column of the text format
+ */
+typedef enum sink_column {
+    SINK_COL_SIZE,      /**< @brief Size as printed (blocks of -B or bytes of -b) */
+    SINK_COL_BLOCKS,    /**< @brief Allocated size in blocks of -B, even with -b */
+    SINK_COL_APPARENT,
+    SINK_COL_COUNT,
+    SINK_COL_HIST
+} sink_column_t;
+
+/**
+ * @brief Columns of the text format in the order given, before the path
+ */
+typedef struct sink_columns {
+    int         ids[SINK_COLUMNS_MAX];
+    int         size;       /**< @brief 0 writes the size only */
+} sink_columns_t;
+
+/**
+ * @brief Type of a printed entry
+ */
+typedef enum sink_type {
+    SINK_FILE,
+    SINK_DIR,
+    SINK_LINK
+} sink_type_t;
+
+/**
+ * @brief Printed entry
+ */
+typedef struct sink_rec {
+    const char *path;
+    long        size;       /**< @brief Size as printed (blocks of -B or bytes of -b) */
+    long        blocks;     /**< @brief Allocated size in blocks of -B, even with -b */
+    uint64_t    apparent;   /**< @brief Bytes given by the status of the entries */
+    uint64_t    inode;
+    uint64_t    count;      /**< @brief Entries counted in size, the entry included */
+    int         depth;      /**< @brief 0 for the paths given */
+    int         type;       /**< @brief SINK_FILE, SINK_DIR or SINK_LINK */
+    int         partial;    /**< @brief Directory not fully read (--deadline), sizes are lower bounds */
+    const uint64_t *hist;   /**< @brief Files of each size bucket in the subtree, NULL if none */
+} sink_rec_t;
+
+/**
+ * @brief Header of --format=bin, followed by the records
+ */
+typedef struct sink_bin_header {
+    char        magic[8];
+    uint32_t    version;
+    uint32_t    header_size;    /**< @brief Bytes of each record before the path */
+} sink_bin_header_t;
+
+/**
+ * @brief Record of --format=bin, in the byte order of the machine
+ *        Records are aligned to 8 bytes so a mapped file can be read in place,
+ *        the next record is length bytes after this one
+ */
+typedef struct sink_bin_rec {
+    uint32_t    length;     /**< @brief Bytes of the record, a multiple of 8 */
+    uint32_t    path_len;   /**< @brief Bytes of the path, without the '\0' */
+    int64_t     size;
+    uint64_t    apparent;
+    uint64_t    inode;
+    uint64_t    count;
+    uint32_t    depth;
+    uint32_t    type;       /**< @brief Type of sink_rec_t, with SINK_BIN_PARTIAL */
+    char        path[];     /**< @brief Path ending with '\0', then padding */
+} sink_bin_rec_t;
+
+/**
+ * @brief Output format, begin is called before the first entry (NULL if it
+ *        writes nothing) and entry for every entry, both return 0 upon
+ *        success or -1 if a write failed
+ */
+typedef struct sink {
+    const char *name;
+    int (*begin)(outbuf_t *out);
+    int (*entry)(outbuf_t *out, const sink_rec_t *rec);
+} sink_t;
+
+/**
+ * @brief           Finds a format by name (text, ndjson, csv or bin)
+ * @param name      Name of the format
+ * @return          Index of the format, -1 if there's none with that name
+ */
+int sink_find(const char *name);
+
+/**
+ * @brief           Selects the format of stdout and writes what comes before
+ *                  the first entry
+ * @param index     Index given by sink_find
+ * @return          0 upon success, -1 if a write failed
+ */
+int sink_begin(int index);
+
+/**
+ * @brief           Selects the format of stdout without writing anything, for
+ *                  an output that goes on from a previous run
+ * @param index     Index given by sink_find
+ * @return          0
+ */
+int sink_select(int index);
+
+/**
+ * @brief           Parses the columns of --columns, names separated by commas
+ *                  (size, blocks, apparent, count, hist)
+ * @param list      Names of the columns
+ * @param columns   Filled with the columns in order
+ * @return          0 upon success, -1 if a name is unknown or there are too
+ *                  many
+ */
+int sink_parse_columns(const char *list, sink_columns_t *columns);
+
+/**
+ * @brief           Checks whether a column was asked for
+ * @return          1 if it was, 0 otherwise
+ */
+int sink_has_column(const sink_columns_t *columns, sink_column_t id);
+
+/**
+ * @brief           Sets the columns written by the text format
+ * @param columns   Columns, copied
+ */
+void sink_set_columns(const sink_columns_t *columns);
+
+/**
+ * @brief           Writes an entry to stdout with the selected format
+ * @param rec       Entry to write
+ * @return          0 upon success, -1 if a write failed
+ */
+int sink_entry(const sink_rec_t *rec);
+
+#endif // SINK_H_INCLUDED
@@ -0,0 +1,118 @@
+#ifndef STATS_H_INCLUDED
+#define STATS_H_INCLUDED
+
+/* INCLUDE HEADERS */
+
+/* SYSTEM CALLS HEADERS */
+#include <sys/time.h>
+
+/* C LIBRARY HEADERS */
+#include <stdint.h>
+
+#define STATS_BUCKETS   40          /** @brief Bucket i holds latencies below 2^(i+1) ns */
+#define STATS_SLOTS     128         /** @brief Intervals of the throughput over time */
+#define STATS_SLOT_NS   10000000ULL /** @brief First width of an interval, doubled when full */
+
+/**
+ * @brief Classes of calls whose latency is measured
+ */
+typedef enum stats_class {
+    STATS_OPEN,         /**< @brief Opening a directory */
+    STATS_READDIR,      /**< @brief One readdir, most come from its buffer */
+    STATS_STAT,         /**< @brief Status of one entry, or of one io_uring batch */
+    STATS_OUTPUT,       /**< @brief One write of the output */
+    STATS_LOG,          /**< @brief Logging one entry */
+    STATS_FORK,         /**< @brief Pipes and fork of a subprocess */
+    STATS_PIPE,         /**< @brief Handshake and sizes through the pipes */
+    STATS_CLASSES
+} stats_class_t;
+
+typedef enum stats_counter {
+    STATS_DIRS,
+    STATS_FILES,
+    STATS_SYMLINKS,
+    STATS_ERRORS,
+    STATS_BYTES,        /**< @brief Apparent size of every entry read */
+    STATS_COUNTERS
+} stats_counter_t;
+
+typedef enum stats_format {
+    STATS_TEXT,
+    STATS_JSON
+} stats_format_t;
+
+typedef struct stats_hist {
+    uint64_t    count;
+    uint64_t    total_ns;
+    uint64_t    max_ns;
+    uint64_t    buckets[STATS_BUCKETS];
+} stats_hist_t;
+
+/**
+ * @brief Counters of one thread, or the sum of several threads and
+ *        subprocesses. Plain data, sent as it is through the pipes
+ */
+typedef struct stats {
+    uint64_t        counters[STATS_COUNTERS];
+    stats_hist_t    hists[STATS_CLASSES];
+    uint64_t        slot_ns;                /**< @brief Width of each interval */
+    uint64_t        slots[STATS_SLOTS];     /**< @brief Entries read in each interval */
+} stats_t;
+
+/** @brief Set once by stats_start, before any thread is created */
+extern int stats_enabled;
+
+/**
+ * @brief           Enables the counters, intervals of the throughput start at
+ *                  origin so subprocesses share them
+ * @param origin    Instant the program started
+ */
+void stats_start(const struct timeval *origin);
+
+/**
+ * @brief   Instant to give to stats_time, 0 (nothing is measured) unless
+ *          enabled
+ */
+uint64_t stats_clock(void);
+
+/**
+ * @brief           Adds the latency of a call to the histogram of the thread
+ * @param class     Class of the call
+ * @param begin     Value of stats_clock before the call, 0 is ignored
+ */
+void stats_time(stats_class_t class, uint64_t begin);
+
+/**
+ * @brief           Adds to a counter of the thread
+ */
+void stats_count(stats_counter_t counter, uint64_t value);
+
+/**
+ * @brief           Counts an entry read, of the counter given by its type, its
+ *                  bytes and its interval (the last instant measured by the
+ *                  thread, no clock is read)
+ * @param counter   STATS_DIRS, STATS_FILES or STATS_SYMLINKS
+ * @param bytes     Apparent size of the entry
+ */
+void stats_entry(stats_counter_t counter, uint64_t bytes);
+
+/**
+ * @brief           Sums the counters of every thread, threads that may still
+ *                  count must be joined before
+ * @param total     Filled with the sum
+ */
+void stats_collect(stats_t *total);
+
+/**
+ * @brief           Adds the counters of a subprocess to this thread
+ */
+void stats_merge(const stats_t *other);
+
+/**
+ * @brief           Prints the counters of every thread (and every subprocess
+ *                  merged) to stderr
+ * @param format    STATS_TEXT or STATS_JSON (a single line)
+ */
+void stats_print(stats_format_t format);
+
+#endif // STATS_H_INCLUDED
@@ -0,0 +1,69 @@
+#ifndef TOPN_H_INCLUDED
+#define TOPN_H_INCLUDED
+
+/* INCLUDE HEADERS */
+#include "sink.h"
+
+/* SYSTEM CALLS HEADERS */
+
+/* C LIBRARY HEADERS */
+
+/**
+ * @brief Largest entries seen, a min-heap of at most capacity entries whose
+ *        root is the smallest one kept
+ *        Entries of the same size are ranked by path so the entries kept
+ *        don't depend on the order they were seen
+ */
+typedef struct topn {
+    sink_rec_t *items;      /**< @brief Entries kept, their paths are owned */
+    int         size;
+    int         capacity;
+} topn_t;
+
+/**
+ * @brief           Initializes an empty top
+ * @param top       Pointer to top
+ * @param capacity  Number of entries kept
+ * @return          0 upon success, -1 if out of memory
+ */
+int topn_init(topn_t *top, int capacity);
+
+/**
+ * @brief           Tells if an entry of this size may be kept, so its path
+ *                  only needs to be built when it is
+ * @param top       Pointer to top
+ * @param size      Size of the entry
+ * @return          1 if it may be kept, 0 otherwise
+ */
+int topn_wants(const topn_t *top, long size);
+
+/**
+ * @brief           Adds an entry, it is copied (with its path) only if it is
+ *                  kept
+ * @param top       Pointer to top
+ * @param rec       Entry, ranked by size as printed
+ * @return          0 upon success, -1 if out of memory
+ */
+int topn_add(topn_t *top, const sink_rec_t *rec);
+
+/**
+ * @brief           Moves every entry of from into top, from is left empty
+ * @param top       Pointer to top
+ * @param from      Top to be merged
+ */
+void topn_merge(topn_t *top, topn_t *from);
+
+/**
+ * @brief           Sorts the entries from the largest, top is no longer a
+ *                  heap afterwards and can only be read or freed
+ * @param top       Pointer to top
+ */
+void topn_sort(topn_t *top);
+
+/**
+ * @brief           Frees the entries of the top
+ * @param top       Pointer to top
+ */
+void topn_free(topn_t *top);
+
+#endif // TOPN_H_INCLUDED
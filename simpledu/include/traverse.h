@@ -0,0 +1,75 @@
+#ifndef TRAVERSE_H_INCLUDED
+#define TRAVERSE_H_INCLUDED
+
+/* INCLUDE HEADERS */
+#include "cache.h"
+#include "checkpoint.h"
+#include "exclude.h"
+#include "index.h"
+#include "inoset.h"
+#include "mounts.h"
+
+/* SYSTEM CALLS HEADERS */
+
+/* C LIBRARY HEADERS */
+#include <stdint.h>
+
+/**
+ * @brief           Receives a directory once its size is known, in output order
+ * @param ctx       Context given in the options
+ * @param path      Path of the directory
+ * @param depth     Depth from the path given to traverse_paths
+ * @param own       Size of the directory and of its entries that aren't
+ *                  directories
+ * @param size      Size that would be printed
+ * @param failed    Directory couldn't be fully read, sizes are 0
+ */
+typedef void (*du_visit_fn)(void *ctx, const char *path, int depth,
+                            double own, double size, int failed);
+
+/**
+ * @brief Options of a traversal made inside this process
+ */
+typedef struct du_opts {
+    int flags;          /**< @brief Flags returned by parse_cmd */
+    int block_size;     /**< @brief Block size used to present sizes */
+    int max_depth;      /**< @brief Value of --max-depth, ignored if FLAG_MAXDEPTH isn't set */
+    int threads;        /**< @brief Number of worker threads */
+    int uring_depth;    /**< @brief Depth of the io_uring of each worker, 0 if none */
+    inoset_t *inodes;   /**< @brief Hard links already counted, NULL counts them every time */
+    cache_t *cache;     /**< @brief Sizes of the previous traversal, NULL if none */
+    du_visit_fn visit;  /**< @brief Receives the directories instead of printing them, NULL prints */
+    void *visit_ctx;
+    int top;            /**< @brief Only prints the largest top directories, 0 prints every one */
+    int top_files;      /**< @brief Only prints the largest top_files files (with -a), 0 prints every one */
+    int device_jobs;    /**< @brief Paths on the same device traversed at the same time */
+    const mounts_t *excluded;   /**< @brief Devices of excluded filesystem types, NULL if none */
+    const exclude_t *exclude;   /**< @brief Names skipped before their status is read, NULL if none */
+    int workers;        /**< @brief Directories are read by a worker process of each thread, 0 reads them in the thread */
+    int worker_timeout; /**< @brief Milliseconds a worker may go without answering before it is killed */
+    index_writer_t *index;      /**< @brief Receives every entry in output order (--save-index), NULL if none */
+    uint64_t deadline;  /**< @brief Monotonic clock in nanoseconds after which no directory is read (--deadline), 0 if none */
+    const char *checkpoint;     /**< @brief File written every checkpoint_interval seconds and upon SIGTERM (--checkpoint), NULL if none */
+    int checkpoint_interval;    /**< @brief Seconds between checkpoints */
+    checkpoint_t *resume;       /**< @brief Checkpoint the traversal goes on from (--resume), NULL if none */
+    int histogram;      /**< @brief Keeps the files of each size bucket of every directory (--columns=hist) */
+} du_opts_t;
+
+/**
+ * @brief           Traverses every path inside this process, directories are
+ *                  tasks of a work stealing pool and sizes are added bottom-up
+ *                  Output lines and order are the same as the ones given by
+ *                  one process per directory. Past the deadline the
+ *                  directories left are cut and their sizes, and the ones
+ *                  of their ancestors, are marked as lower bounds
+ *                  With a checkpoint the tree not written yet is saved from
+ *                  time to time, a traversal resumed from it only reads the
+ *                  directories left and writes the entries left
+ * @param opts      Options of the traversal
+ * @param paths     Paths to traverse
+ * @param npaths    Number of paths
+ * @return          0 upon success, exit status otherwise
+ */
+int traverse_paths(const du_opts_t *opts, char **paths, int npaths);
+
+#endif // TRAVERSE_H_INCLUDED
@@ -0,0 +1,53 @@
+#ifndef URING_H_INCLUDED
+#define URING_H_INCLUDED
+
+/* INCLUDE HEADERS */
+
+/* SYSTEM CALLS HEADERS */
+#include <sys/stat.h>
+
+/* C LIBRARY HEADERS */
+
+typedef struct uring uring_t;
+
+/**
+ * @brief           Creates an io_uring used to read the status of entries in
+ *                  batches, with raw system calls (no liburing needed)
+ * @param depth     Number of entries of the submission queue
+ * @return          Pointer to ring upon success, NULL if io_uring isn't
+ *                  available (callers fall back to synchronous calls)
+ */
+uring_t* uring_create(unsigned depth);
+
+/**
+ * @brief           Depth of the ring, maximum number of entries of a batch
+ * @param ring      Pointer to ring
+ * @return          Depth of the ring
+ */
+unsigned uring_depth(uring_t *ring);
+
+/**
+ * @brief           Reads the status of every name of the batch with
+ *                  IORING_OP_STATX, relative to dirfd, and waits for all
+ * @param ring      Pointer to ring
+ * @param dirfd     Descriptor of the directory
+ * @param names     Names of the entries, at most uring_depth(ring)
+ * @param n         Number of names
+ * @param flags     AT_* flags of statx
+ * @param mask      STATX_* fields needed
+ * @param out       Array of n statx filled with the result of each name
+ * @param errors    Array of n set to 0 or to the errno of each name
+ * @return          0 upon success, -1 if the batch couldn't be submitted or
+ *                  the kernel doesn't support IORING_OP_STATX
+ */
+int uring_statx_batch(uring_t *ring, int dirfd, char **names, unsigned n,
+                      int flags, unsigned mask, struct statx *out,
+                      int *errors);
+
+/**
+ * @brief           Frees the ring
+ * @param ring      Pointer to ring
+ */
+void uring_destroy(uring_t *ring);
+
+#endif // URING_H_INCLUDED
@@ -9,6 +9,7 @@
 #include <unistd.h>
 
 /* C LIBRARY HEADERS */
+#include <stdint.h>
 
 /*----------------------------------------------------------------------------*/
 /*                              STRING FUNCTIONS                              */
@@ -66,6 +67,56 @@ int str_isAlpha(const char *str);
  */
 char* str_cat(char *s1, char *s2, int n);
 
+/*----------------------------------------------------------------------------*/
+/*                              PATH FUNCTIONS                                */
+/*----------------------------------------------------------------------------*/
+
+/**
+ * @brief Growable path, reused to build the path of every entry
+ *        Names are appended and removed as the traversal goes down and up
+ */
+typedef struct path_buf {
+    char   *str;
+    size_t  len;
+    size_t  memsize;
+} path_buf_t;
+
+/**
+ * @brief Initializes an empty path
+ * @param   pb          Pointer to path
+ */
+void pathbuf_init(path_buf_t *pb);
+
+/**
+ * @brief Replaces the contents of the path
+ * @param   pb          Pointer to path
+ * @param   path        New contents
+ * @return  0 upon success, -1 if error occurs
+ */
+int pathbuf_set(path_buf_t *pb, const char *path);
+
+/**
+ * @brief Appends a name to the path, separated by '/'
+ * @param   pb          Pointer to path
+ * @param   name        Name of the entry
+ * @return  Length of the path before the push, to be given to pathbuf_pop,
+ *          (size_t)-1 if error occurs
+ */
+size_t pathbuf_push(path_buf_t *pb, const char *name);
+
+/**
+ * @brief Removes the names appended after the path had length len
+ * @param   pb          Pointer to path
+ * @param   len         Value returned by pathbuf_push
+ */
+void pathbuf_pop(path_buf_t *pb, size_t len);
+
+/**
+ * @brief Frees the memory of the path
+ * @param   pb          Pointer to path
+ */
+void pathbuf_free(path_buf_t *pb);
+
 /*----------------------------------------------------------------------------*/
 /*                              FILES FUNCTIONS                               */
 /*----------------------------------------------------------------------------*/
@@ -90,18 +141,136 @@ enum file_type {
 
 typedef enum file_type file_type_t;
 
+#define STAT_MODE_STAT      0   /** @brief Status read with a full fstatat */
+#define STAT_MODE_STATX     1   /** @brief Status read with statx, asking only the fields used */
+#define STAT_MODE_NOSYNC    2   /** @brief Same as STAT_MODE_STATX, without syncing with network filesystems */
+
+/**
+ * @brief Sets how fget_status_at reads the status of the entries
+ * @param   mode        See macros STAT_MODE_STAT, STAT_MODE_STATX, STAT_MODE_NOSYNC
+ * @param   extra_mask  STATX_* fields needed besides type, blocks and size
+ */
+void fset_stat_mode(int mode, unsigned int extra_mask);
+
+/**
+ * @brief Gets the mode set by fset_stat_mode
+ * @return  See macros STAT_MODE_STAT, STAT_MODE_STATX, STAT_MODE_NOSYNC
+ */
+int fget_stat_mode(void);
+
+/**
+ * @brief Gets the STATX_* fields asked when reading with statx
+ * @return  Mask of fields
+ */
+unsigned int fget_statx_mask(void);
+
+/**
+ * @brief Gets the AT_* flags used when reading with statx
+ * @param   deref_sym   Follow symbolic links
+ * @return  Flags of statx
+ */
+int fget_statx_flags(int deref_sym);
+
+/**
+ * @brief Copies the fields read by statx to a struct stat
+ * @param   stx         Pointer to statx result
+ * @param   pstat       Pointer to status to be filled
+ */
+void statx_to_stat(const struct statx *stx, struct stat *pstat);
+
+/**
+ * @brief Verifies with the type given by readdir if an entry can be skipped
+ *        without reading its status (fifos, devices and sockets aren't counted)
+ *        Symbolic links, directories and unknown types always need it
+ * @param   d_type      Type of the entry given by readdir
+ * @return  1 if the entry is ignored, 0 if its status is needed
+ */
+int dtype_ignored(unsigned char d_type);
+
 int fget_status(const char *path, struct stat *pstat, int deref_sym);
 
+/**
+ * @brief Gets the status of an entry relative to an open directory,
+ *        without walking the whole path again
+ *        With statx only the fields used are filled: st_mode (type), st_size,
+ *        st_blocks and the ones asked in fset_stat_mode
+ * @param   dirfd       Descriptor of the directory
+ * @param   name        Name of the entry inside the directory
+ * @param   pstat       Pointer to the status to be filled
+ * @param   deref_sym   Follow symbolic links
+ * @return  0 upon success, -1 if error occurs
+ */
+int fget_status_at(int dirfd, const char *name, struct stat *pstat,
+                   int deref_sym);
+
 file_type_t fget_type(const char *path, int deref_sym);
 
 file_type_t sget_type(const struct stat *pstat);
 
 double fget_size(int bytes, struct stat *status, int block_size);
 
+/**
+ * @brief Sizes summed exactly over entries, rounded once when printed
+ */
+typedef struct size_sum {
+    uint64_t    blocks;     /**< @brief Allocated blocks of 512 bytes */
+    uint64_t    bytes;      /**< @brief Apparent size */
+} size_sum_t;
+
+/**
+ * @brief   Adds the allocated blocks and the apparent size of an entry
+ * @param   sum         Pointer to sizes, updated
+ * @param   status      Status of the entry
+ */
+void size_add(size_sum_t *sum, const struct stat *status);
+
+/**
+ * @brief   Size as printed, bytes with -b and the blocks rounded up to
+ *          units of block_size otherwise, as the thread mode prints them
+ * @param   sum         Pointer to sizes
+ * @param   bytes       Print the apparent size
+ * @param   block_size  Unit of -B, in bytes
+ * @return  Size printed
+ */
+long size_print(const size_sum_t *sum, int bytes, int block_size);
+
 /*----------------------------------------------------------------------------*/
 /*                              MATH FUNCTIONS                                */
 /*----------------------------------------------------------------------------*/
 
 long dceill(double x);
 
+/**
+ * @brief Mixes a pair of integers into a well distributed hash (splitmix64),
+ *        used to index (device, inode) pairs
+ * @param   a           First integer
+ * @param   b           Second integer
+ * @return  Hash of the pair
+ */
+uint64_t hash_pair(uint64_t a, uint64_t b);
+
+/*----------------------------------------------------------------------------*/
+/*                              OUTPUT FUNCTIONS                              */
+/*----------------------------------------------------------------------------*/
+
+#define LONG_DECIMAL_SIZE   20  /** @brief Maximum number of characters of a long in decimal */
+
+/**
+ * @brief Writes a long in decimal, without the terminating null byte
+ * @param   buf         Buffer with at least LONG_DECIMAL_SIZE characters
+ * @param   value       Number to write
+ * @return  Number of characters written
+ */
+size_t format_long(char *buf, long value);
+
+/**
+ * @brief Writes the line "size\tpath\n" with a single write, whatever the
+ *        length of the path
+ * @param   fd          Descriptor to write to
+ * @param   size        Size of the entry
+ * @param   path        Path of the entry
+ * @return  0 upon success, -1 if error occurs
+ */
+int write_entry(int fd, long size, const char *path);
+
 #endif // UTILS_H_INCLUDED
@@ -0,0 +1,27 @@
+#ifndef WATCH_H_INCLUDED
+#define WATCH_H_INCLUDED
+
+/* INCLUDE HEADERS */
+#include "traverse.h"
+
+/* SYSTEM CALLS HEADERS */
+
+/* C LIBRARY HEADERS */
+
+/**
+ * @brief           Traverses every directory once and prints it like
+ *                  traverse_paths, then keeps the size of every directory up
+ *                  to date from inotify events until stdin is closed or has
+ *                  the command "quit"
+ *                  The command "dump [path]" prints the current sizes of the
+ *                  directories under path (every path if none), with the
+ *                  same format as the traversal
+ * @param opts      Options of the traversal, files aren't kept (-a) and
+ *                  every link is counted (-l)
+ * @param paths     Directories to watch
+ * @param npaths    Number of paths
+ * @return          0 upon success, exit status otherwise
+ */
+int watch_paths(const du_opts_t *opts, char **paths, int npaths);
+
+#endif // WATCH_H_INCLUDED
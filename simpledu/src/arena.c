@@ -0,0 +1,109 @@
+/* MAIN HEADER */
+#include "arena.h"
+
+/* INCLUDE HEADERS */
+
+/* SYSTEM CALLS HEADERS */
+
+/* C LIBRARY HEADERS */
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct arena_chunk {
+    arena_chunk_t  *next;
+    size_t          size;
+    max_align_t     data[];
+};
+
+void arena_init(arena_t *arena) {
+    arena->first = NULL;
+    arena->head = NULL;
+    arena->used = 0;
+    arena->next_size = ARENA_MIN_CHUNK;
+}
+
+static void* arena_take(arena_t *arena, size_t size, size_t align) {
+    if (arena->head != NULL) {
+        size_t start = (arena->used + align - 1) & ~(align - 1);
+        if (start + size <= arena->head->size) {
+            arena->used = start + size;
+            return (char *)arena->head->data + start;
+        }
+    }
+
+    // Chunks kept by a reset are used again, a new one is linked after head
+    // if the next one is too small
+    arena_chunk_t *next = arena->head != NULL ? arena->head->next : arena->first;
+    if (next == NULL || next->size < size) {
+        size_t chunk_size = arena->next_size < size ? size : arena->next_size;
+        arena->next_size = chunk_size < ARENA_MAX_CHUNK / 2 ? chunk_size * 2
+                                                            : ARENA_MAX_CHUNK;
+        arena_chunk_t *chunk =
+            (arena_chunk_t *)malloc(sizeof(arena_chunk_t) + chunk_size);
+        if (chunk == NULL) return NULL;
+        chunk->size = chunk_size;
+        chunk->next = next;
+        if (arena->head != NULL) {
+            arena->head->next = chunk;
+        } else {
+            arena->first = chunk;
+        }
+        next = chunk;
+    }
+    arena->head = next;
+    arena->used = size;
+    return next->data;
+}
+
+void* arena_alloc(arena_t *arena, size_t size) {
+    return arena_take(arena, size, _Alignof(max_align_t));
+}
+
+char* arena_strdup(arena_t *arena, const char *str) {
+    size_t len = strlen(str) + 1;
+    char *copy = (char *)arena_take(arena, len, 1);
+    if (copy != NULL) memcpy(copy, str, len);
+    return copy;
+}
+
+char* arena_printf(arena_t *arena, const char *format, ...) {
+    va_list args;
+    va_start(args, format);
+    int len = vsnprintf(NULL, 0, format, args);
+    va_end(args);
+    if (len < 0) return NULL;
+
+    char *str = (char *)arena_take(arena, (size_t)len + 1, 1);
+    if (str == NULL) return NULL;
+    va_start(args, format);
+    vsnprintf(str, (size_t)len + 1, format, args);
+    va_end(args);
+    return str;
+}
+
+void arena_hint(arena_t *arena, size_t size) {
+    if (size > ARENA_MAX_CHUNK) size = ARENA_MAX_CHUNK;
+    if (size > arena->next_size) arena->next_size = size;
+}
+
+arena_mark_t arena_mark(const arena_t *arena) {
+    arena_mark_t mark = {arena->head, arena->used};
+    return mark;
+}
+
+void arena_reset(arena_t *arena, arena_mark_t mark) {
+    arena->head = mark.chunk;
+    arena->used = mark.used;
+}
+
+void arena_free(arena_t *arena) {
+    arena_chunk_t *chunk = arena->first;
+    while (chunk != NULL) {
+        arena_chunk_t *next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+    arena_init(arena);
+}
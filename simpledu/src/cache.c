@@ -0,0 +1,226 @@
+/* MAIN HEADER */
+#include "cache.h"
+
+/* INCLUDE HEADERS */
+#include "utils.h"
+
+/* SYSTEM CALLS HEADERS */
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/* C LIBRARY HEADERS */
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define CACHE_MAGIC     0x4548434143554453ULL   /** @brief "SDUCACHE" */
+#define CACHE_VERSION   3
+#define CACHE_MIN_SLOTS 64
+#define RECS_INIT_SIZE  256
+
+/**
+ * @brief Beginning of the file, followed by an open addressing table
+ *        (linear probing) of capacity records
+ */
+typedef struct cache_header {
+    uint64_t    magic;
+    uint32_t    version;
+    uint32_t    unused;
+    uint64_t    key;
+    uint64_t    count;
+    uint64_t    capacity;   // power of 2
+    uint64_t    reserved[4];
+} cache_header_t;
+
+/**
+ * @brief Records added by one thread
+ */
+typedef struct cache_list {
+    cache_rec_t    *recs;
+    size_t          size;
+    size_t          memsize;
+} cache_list_t;
+
+struct cache {
+    char               *path;
+    uint64_t            key;
+
+    // Previous traversal, read only
+    void               *map;
+    size_t              map_size;
+    const cache_rec_t  *table;
+    uint64_t            capacity;
+
+    // This traversal
+    cache_list_t       *lists;
+    int                 workers;
+};
+
+/**
+ * @brief Maps the previous cache file if it is valid for these options
+ */
+static void cache_load(cache_t *cache) {
+    int fd = open(cache->path, O_RDONLY | O_CLOEXEC);
+    if (fd == -1) return;
+
+    struct stat status;
+    if (fstat(fd, &status) || (size_t)status.st_size < sizeof(cache_header_t)) {
+        close(fd);
+        return;
+    }
+
+    void *map = mmap(NULL, status.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) return;
+
+    const cache_header_t *header = (const cache_header_t *)map;
+    uint64_t capacity = header->capacity;
+    if (header->magic != CACHE_MAGIC || header->version != CACHE_VERSION ||
+        header->key != cache->key || capacity == 0 ||
+        (capacity & (capacity - 1)) != 0 ||
+        (status.st_size - sizeof(cache_header_t)) / sizeof(cache_rec_t) <
+            capacity) {
+        munmap(map, status.st_size);
+        return;
+    }
+
+    cache->map = map;
+    cache->map_size = status.st_size;
+    cache->table = (const cache_rec_t *)(header + 1);
+    cache->capacity = capacity;
+}
+
+cache_t* cache_open(const char *path, int workers, uint64_t key) {
+    cache_t *cache = (cache_t *)calloc(1, sizeof(cache_t));
+    if (cache == NULL) return NULL;
+
+    cache->path = strdup(path);
+    cache->lists = (cache_list_t *)calloc(workers, sizeof(cache_list_t));
+    if (cache->path == NULL || cache->lists == NULL) {
+        cache_close(cache);
+        return NULL;
+    }
+    cache->workers = workers;
+    cache->key = key;
+
+    cache_load(cache);
+    return cache;
+}
+
+const cache_rec_t* cache_lookup(cache_t *cache, dev_t dev, ino_t ino) {
+    if (cache->table == NULL) return NULL;
+
+    uint64_t mask = cache->capacity - 1;
+    for (uint64_t i = hash_pair(dev, ino) & mask, n = 0; n < cache->capacity;
+         i = (i + 1) & mask, n++) {
+        const cache_rec_t *rec = &cache->table[i];
+        if (!rec->used) return NULL;
+        if (rec->dev == (uint64_t)dev && rec->ino == (uint64_t)ino) return rec;
+    }
+    return NULL;
+}
+
+int cache_add(cache_t *cache, int worker, const cache_rec_t *rec) {
+    cache_list_t *list = &cache->lists[worker];
+    if (list->size == list->memsize) {
+        size_t memsize = list->memsize ? list->memsize * 2 : RECS_INIT_SIZE;
+        cache_rec_t *recs =
+            (cache_rec_t *)realloc(list->recs, sizeof(cache_rec_t) * memsize);
+        if (recs == NULL) return -1;
+        list->recs = recs;
+        list->memsize = memsize;
+    }
+    list->recs[list->size++] = *rec;
+    return 0;
+}
+
+int cache_save(cache_t *cache) {
+    uint64_t count = 0;
+    for (int w = 0; w < cache->workers; w++) count += cache->lists[w].size;
+
+    uint64_t capacity = CACHE_MIN_SLOTS;
+    while (capacity < count * 2) capacity *= 2;
+    size_t size = sizeof(cache_header_t) + capacity * sizeof(cache_rec_t);
+
+    size_t tmp_len = strlen(cache->path) + 5;
+    char *tmp_path = (char *)malloc(tmp_len);
+    if (tmp_path == NULL) return -1;
+    snprintf(tmp_path, tmp_len, "%s.tmp", cache->path);
+
+    int fd = open(tmp_path, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd == -1) {
+        free(tmp_path);
+        return -1;
+    }
+    void *map = MAP_FAILED;
+    if (ftruncate(fd, size) == 0) {
+        map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    if (map == MAP_FAILED) goto error;
+
+    cache_header_t *header = (cache_header_t *)map;
+    cache_rec_t *table = (cache_rec_t *)(header + 1);
+    uint64_t mask = capacity - 1;
+    uint64_t stored = 0;
+
+    for (int w = 0; w < cache->workers; w++) {
+        cache_list_t *list = &cache->lists[w];
+        for (size_t r = 0; r < list->size; r++) {
+            cache_rec_t *rec = &list->recs[r];
+            uint64_t i = hash_pair(rec->dev, rec->ino) & mask;
+            // A directory reached from two paths is stored once
+            while (table[i].used &&
+                   (table[i].dev != rec->dev || table[i].ino != rec->ino)) {
+                i = (i + 1) & mask;
+            }
+            stored += !table[i].used;
+            table[i] = *rec;
+            table[i].used = 1;
+        }
+    }
+
+    header->version = CACHE_VERSION;
+    header->key = cache->key;
+    header->count = stored;
+    header->capacity = capacity;
+    header->magic = CACHE_MAGIC;
+
+    int unmapped = munmap(map, size);
+    map = MAP_FAILED;
+    if (unmapped || fsync(fd)) goto error;
+    if (close(fd)) {
+        unlink(tmp_path);
+        free(tmp_path);
+        return -1;
+    }
+
+    int ret = rename(tmp_path, cache->path);
+    if (ret) unlink(tmp_path);
+    free(tmp_path);
+    return ret;
+
+error:
+    {
+        int error = errno;
+        if (map != MAP_FAILED) munmap(map, size);
+        close(fd);
+        unlink(tmp_path);
+        free(tmp_path);
+        errno = error;
+    }
+    return -1;
+}
+
+void cache_close(cache_t *cache) {
+    if (cache == NULL) return;
+    if (cache->map != NULL) munmap(cache->map, cache->map_size);
+    if (cache->lists != NULL) {
+        for (int w = 0; w < cache->workers; w++) free(cache->lists[w].recs);
+    }
+    free(cache->lists);
+    free(cache->path);
+    free(cache);
+}
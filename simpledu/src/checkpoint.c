@@ -0,0 +1,137 @@
+/* MAIN HEADER */
+#include "checkpoint.h"
+
+/* INCLUDE HEADERS */
+
+/* SYSTEM CALLS HEADERS */
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/* C LIBRARY HEADERS */
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define CHECKPOINT_BUF_SIZE (1 << 20)   /** @brief Buffer of the file while writing */
+
+struct checkpoint_writer {
+    char   *path;
+    char   *tmp_path;
+    FILE   *file;
+    int     error;      /**< @brief errno of the first failure, 0 if none */
+};
+
+checkpoint_writer_t* checkpoint_create(const char *path,
+                                       const checkpoint_header_t *header) {
+    checkpoint_writer_t *w =
+        (checkpoint_writer_t *)calloc(1, sizeof(checkpoint_writer_t));
+    if (w == NULL) return NULL;
+
+    size_t tmp_len = strlen(path) + 5;
+    w->path = strdup(path);
+    w->tmp_path = (char *)malloc(tmp_len);
+    if (w->path == NULL || w->tmp_path == NULL) {
+        checkpoint_finish(w, 0);
+        return NULL;
+    }
+    snprintf(w->tmp_path, tmp_len, "%s.tmp", path);
+
+    if ((w->file = fopen(w->tmp_path, "we")) == NULL ||
+        setvbuf(w->file, NULL, _IOFBF, CHECKPOINT_BUF_SIZE) ||
+        fwrite(header, sizeof(*header), 1, w->file) != 1) {
+        checkpoint_finish(w, 0);
+        return NULL;
+    }
+    return w;
+}
+
+void checkpoint_write(checkpoint_writer_t *w, const void *rec, size_t size,
+                      const char *name, size_t name_len) {
+    if (w->error) return;
+    if ((size > 0 && fwrite(rec, size, 1, w->file) != 1) ||
+        (name != NULL && fwrite(name, name_len + 1, 1, w->file) != 1)) {
+        w->error = errno ? errno : EIO;
+    }
+}
+
+int checkpoint_finish(checkpoint_writer_t *w, int save) {
+    int ret = -1;
+    if (w == NULL) return -1;
+
+    if (save && w->file != NULL && !w->error) {
+        if (fflush(w->file) == 0 && fsync(fileno(w->file)) == 0) ret = 0;
+    } else if (save) {
+        errno = w->error ? w->error : EIO;
+    }
+
+    int error = errno;
+    if (w->file != NULL && fclose(w->file)) ret = -1;
+    if (ret == 0 && rename(w->tmp_path, w->path)) {
+        error = errno;
+        ret = -1;
+    }
+    if (ret == -1 && w->file != NULL) unlink(w->tmp_path);
+
+    free(w->path);
+    free(w->tmp_path);
+    free(w);
+    errno = error;
+    return ret;
+}
+
+int checkpoint_open(checkpoint_t *ck, const char *path) {
+    memset(ck, 0, sizeof(checkpoint_t));
+
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd == -1) return -1;
+
+    struct stat status;
+    if (fstat(fd, &status) ||
+        (size_t)status.st_size < sizeof(checkpoint_header_t)) {
+        close(fd);
+        errno = EINVAL;
+        return -1;
+    }
+
+    void *map = mmap(NULL, status.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) return -1;
+
+    const checkpoint_header_t *header = (const checkpoint_header_t *)map;
+    if (header->magic != CHECKPOINT_MAGIC ||
+        header->version != CHECKPOINT_VERSION) {
+        munmap(map, status.st_size);
+        errno = EINVAL;
+        return -1;
+    }
+
+    ck->map = map;
+    ck->map_size = status.st_size;
+    ck->pos = sizeof(checkpoint_header_t);
+    ck->header = header;
+    return 0;
+}
+
+const char* checkpoint_read(checkpoint_t *ck, void *rec, size_t size,
+                            size_t name_len) {
+    // Records aren't aligned, they are copied out
+    if (size > ck->map_size - ck->pos) return NULL;
+    if (size > 0) memcpy(rec, (const char *)ck->map + ck->pos, size);
+    ck->pos += size;
+    if (name_len == 0) return "";
+
+    const char *name = (const char *)ck->map + ck->pos;
+    if (name_len >= ck->map_size - ck->pos || name[name_len] != '\0') {
+        return NULL;
+    }
+    ck->pos += name_len + 1;
+    return name;
+}
+
+void checkpoint_close(checkpoint_t *ck) {
+    if (ck->map != NULL) munmap(ck->map, ck->map_size);
+    memset(ck, 0, sizeof(checkpoint_t));
+}
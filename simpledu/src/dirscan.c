@@ -0,0 +1,198 @@
+/* MAIN HEADER */
+#include "dirscan.h"
+
+/* INCLUDE HEADERS */
+#include "stats.h"
+#include "utils.h"
+
+/* SYSTEM CALLS HEADERS */
+#include <unistd.h>
+
+/* C LIBRARY HEADERS */
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+int dirscan_init(dir_scan_t *ds, uring_t *ring, int deref_sym) {
+    memset(ds, 0, sizeof(dir_scan_t));
+    ds->deref_sym = deref_sym;
+    ds->ring = ring;
+
+    if (ring == NULL) return 0;
+
+    unsigned depth = uring_depth(ring);
+    ds->batch = (dir_entry_t *)malloc(sizeof(dir_entry_t) * depth);
+    ds->names = (char **)malloc(sizeof(char *) * depth);
+    ds->stx = (struct statx *)malloc(sizeof(struct statx) * depth);
+    ds->errors = (int *)malloc(sizeof(int) * depth);
+    if (ds->batch == NULL || ds->names == NULL || ds->stx == NULL ||
+        ds->errors == NULL) {
+        dirscan_free(ds);
+        return -1;
+    }
+    return 0;
+}
+
+void dirscan_start(dir_scan_t *ds, DIR *dir) {
+    ds->dir = dir;
+    ds->batch_size = 0;
+    ds->batch_pos = 0;
+}
+
+static struct dirent* dirscan_readdir(dir_scan_t *ds) {
+    struct dirent *direntp;
+    while (1) {
+        uint64_t begin = stats_clock();
+        direntp = readdir(ds->dir);
+        stats_time(STATS_READDIR, begin);
+        if (direntp == NULL) break;
+
+        // Skip . and .. directories
+        if (strcmp(direntp->d_name, ".") == 0 ||
+            strcmp(direntp->d_name, "..") == 0)
+            continue;
+
+        // Types that aren't counted don't need their status
+        if (dtype_ignored(direntp->d_type)) continue;
+
+        if (ds->exclude != NULL &&
+            exclude_match(ds->exclude, direntp->d_name)) {
+            continue;
+        }
+
+        return direntp;
+    }
+    return NULL;
+}
+
+/**
+ * @brief Reads the status of one entry synchronously
+ * @return 0 upon success, errno otherwise
+ */
+static int dirscan_status(int fd, const char *name, struct stat *status,
+                          int deref_sym) {
+    uint64_t begin = stats_clock();
+    int error = fget_status_at(fd, name, status, deref_sym) ? errno : 0;
+    stats_time(STATS_STAT, begin);
+    return error;
+}
+
+static void print_status_error(int error) {
+    char *msg = strerror(error);
+    write(STDERR_FILENO, msg, strlen(msg));
+    write(STDERR_FILENO, "\n", 1);
+}
+
+/**
+ * @brief Reads up to depth entries and their status with a single submission
+ * @return Number of entries of the batch
+ */
+static unsigned dirscan_fill(dir_scan_t *ds) {
+    unsigned depth = uring_depth(ds->ring);
+    size_t offsets[depth];
+    struct dirent *direntp;
+    unsigned n = 0;
+
+    ds->name_len = 0;
+    while (n < depth && (direntp = dirscan_readdir(ds)) != NULL) {
+        size_t len = strlen(direntp->d_name) + 1;
+        if (ds->name_len + len > ds->name_memsize) {
+            size_t memsize = ds->name_memsize ? ds->name_memsize : 4096;
+            while (memsize < ds->name_len + len) memsize *= 2;
+            char *buf = (char *)realloc(ds->name_buf, memsize);
+            if (buf == NULL) break;
+            ds->name_buf = buf;
+            ds->name_memsize = memsize;
+        }
+        memcpy(ds->name_buf + ds->name_len, direntp->d_name, len);
+        offsets[n] = ds->name_len;
+        ds->batch[n].d_type = direntp->d_type;
+        ds->name_len += len;
+        n++;
+    }
+    for (unsigned i = 0; i < n; i++) {
+        ds->names[i] = ds->name_buf + offsets[i];
+        ds->batch[i].name = ds->names[i];
+    }
+    if (n == 0) return 0;
+
+    int fd = dirfd(ds->dir);
+    uint64_t begin = stats_clock();
+    int failed = uring_statx_batch(ds->ring, fd, ds->names, n,
+                                   fget_statx_flags(ds->deref_sym),
+                                   fget_statx_mask(), ds->stx, ds->errors);
+    stats_time(STATS_STAT, begin);
+    if (failed) {
+        // io_uring unusable, this batch and the next ones are synchronous
+        ds->ring = NULL;
+        for (unsigned i = 0; i < n; i++) {
+            ds->batch[i].error =
+                dirscan_status(fd, ds->names[i], &ds->batch[i].status,
+                               ds->deref_sym);
+        }
+        return n;
+    }
+
+    for (unsigned i = 0; i < n; i++) {
+        ds->batch[i].error = ds->errors[i];
+        if (ds->errors[i]) {
+            print_status_error(ds->errors[i]);
+        } else {
+            statx_to_stat(&ds->stx[i], &ds->batch[i].status);
+        }
+    }
+    return n;
+}
+
+dir_entry_t* dirscan_next(dir_scan_t *ds) {
+    if (ds->batch_pos < ds->batch_size) return &ds->batch[ds->batch_pos++];
+
+    if (ds->ring != NULL) {
+        ds->batch_size = dirscan_fill(ds);
+        ds->batch_pos = 0;
+        if (ds->batch_size > 0) return &ds->batch[ds->batch_pos++];
+        return NULL;
+    }
+
+    struct dirent *direntp = dirscan_readdir(ds);
+    if (direntp == NULL) return NULL;
+
+    ds->entry.name = direntp->d_name;
+    ds->entry.d_type = direntp->d_type;
+    ds->entry.error = dirscan_status(dirfd(ds->dir), direntp->d_name,
+                                     &ds->entry.status, ds->deref_sym);
+    return &ds->entry;
+}
+
+dir_entry_t* dirscan_next_dir(dir_scan_t *ds) {
+    struct dirent *direntp;
+    while ((direntp = dirscan_readdir(ds)) != NULL) {
+        unsigned char type = direntp->d_type;
+        if (type != DT_DIR && type != DT_UNKNOWN &&
+            (type != DT_LNK || !ds->deref_sym))
+            continue;
+
+        ds->entry.name = direntp->d_name;
+        ds->entry.d_type = type;
+        ds->entry.error = dirscan_status(dirfd(ds->dir), direntp->d_name,
+                                         &ds->entry.status, ds->deref_sym);
+        if (ds->entry.error == 0 && !S_ISDIR(ds->entry.status.st_mode)) {
+            continue;
+        }
+        return &ds->entry;
+    }
+    return NULL;
+}
+
+void dirscan_free(dir_scan_t *ds) {
+    free(ds->batch);
+    free(ds->names);
+    free(ds->stx);
+    free(ds->errors);
+    free(ds->name_buf);
+    ds->batch = NULL;
+    ds->names = NULL;
+    ds->stx = NULL;
+    ds->errors = NULL;
+    ds->name_buf = NULL;
+}
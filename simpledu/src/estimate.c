@@ -0,0 +1,528 @@
+/* MAIN HEADER */
+#include "estimate.h"
+
+/* INCLUDE HEADERS */
+#include "arena.h"
+#include "dirscan.h"
+#include "mounts.h"
+#include "outbuf.h"
+#include "parse.h"
+#include "stats.h"
+#include "utils.h"
+
+/* SYSTEM CALLS HEADERS */
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/* C LIBRARY HEADERS */
+#include <dirent.h>
+#include <errno.h>
+#include <float.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ESTIMATE_Z          1.96        /** @brief Half width of a 95% interval, in standard deviations */
+#define ESTIMATE_MIN_WALKS  32          /** @brief Walks of a subdirectory before its variance is trusted */
+#define ESTIMATE_MAX_WALKS  (1 << 20)   /** @brief Walks of a path, whatever error was reached */
+#define ESTIMATE_SEED       0x5eed5eedULL   /** @brief The same tree gives the same estimate */
+
+typedef struct est_node est_node_t;
+
+/**
+ * @brief Directory read by a walk, read once whatever the number of walks
+ *        going through it
+ */
+struct est_node {
+    est_node_t    **children;   /**< @brief One for each subdirectory, NULL until a walk reads it */
+    char          **names;
+    int             nsub;
+    int             ncomplete;  /**< @brief Children whose whole subtree was read */
+    int             complete;   /**< @brief Whole subtree read, total is exact */
+    int             failed;     /**< @brief Couldn't be read, counts as empty */
+    dev_t           dev;
+    double          own;        /**< @brief Directory itself and entries that aren't directories */
+    double          total;
+};
+
+/**
+ * @brief Subdirectory of a path given, estimated on its own so its walks
+ *        go where the variance is
+ */
+typedef struct est_stratum {
+    est_node_t     *node;
+    char           *name;
+    long            walks;
+    double          mean;       /**< @brief Mean of the walks (Welford) */
+    double          m2;         /**< @brief Sum of the squared deviations */
+    double          seen;       /**< @brief Sizes read so far, a lower bound */
+    double          exact;      /**< @brief Size traversed by --refine, -1 if none */
+    int             heap_pos;
+} est_stratum_t;
+
+typedef struct estimate {
+    const du_opts_t    *opts;
+    dir_scan_t          scan;
+    arena_t             arena;      /**< @brief Every node and name, freed once the path is printed */
+    path_buf_t          path;
+    uint64_t            draws;
+    int                 status;
+
+    est_node_t        **stack;      /**< @brief Nodes of the current walk */
+    size_t              stack_memsize;
+    char              **names;      /**< @brief Subdirectories of the directory being read */
+    size_t              names_memsize;
+
+    est_stratum_t      *strata;
+    int                 nstrata;
+    int                *heap;       /**< @brief Strata by the variance one more walk removes */
+} estimate_t;
+
+static void print_error(estimate_t *e, const char *error_msg,
+                        const char *path) {
+    char *error = strerror(errno);
+    stats_count(STATS_ERRORS, 1);
+    char buffer[512];
+    snprintf(buffer, sizeof(buffer), "simpledu: %s '%s': %s\n", error_msg,
+             path, error);
+    write(STDERR_FILENO, buffer, strlen(buffer));
+    e->status = 1;
+}
+
+static int grow(void **array, size_t size, size_t *memsize, size_t elem) {
+    if (size < *memsize) return 0;
+    size_t new_memsize = *memsize ? *memsize * 2 : 64;
+    void *new_array = realloc(*array, new_memsize * elem);
+    if (new_array == NULL) return -1;
+    *array = new_array;
+    *memsize = new_memsize;
+    return 0;
+}
+
+/**
+ * @brief Reads a directory: its own size and the names of its
+ *        subdirectories. One that can't be read counts as empty
+ * @return Pointer to node, NULL if out of memory
+ */
+static est_node_t* est_read(estimate_t *e, const char *path) {
+    const du_opts_t *opts = e->opts;
+    est_node_t *node = (est_node_t *)arena_alloc(&e->arena, sizeof(est_node_t));
+    if (node == NULL) return NULL;
+    memset(node, 0, sizeof(est_node_t));
+    node->complete = 1;
+
+    uint64_t begin = stats_clock();
+    int fd = open(path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    DIR *dir = fd != -1 ? fdopendir(fd) : NULL;
+    struct stat status;
+    if (dir == NULL || fstat(fd, &status)) {
+        print_error(e, "opendir error", path);
+        node->failed = 1;
+        if (dir != NULL) closedir(dir);
+        else if (fd != -1) close(fd);
+        return node;
+    }
+    stats_time(STATS_OPEN, begin);
+    stats_entry(STATS_DIRS, status.st_size);
+    node->dev = status.st_dev;
+    node->own = fget_size(opts->flags & FLAG_BYTES, &status, opts->block_size);
+
+    size_t n = 0;
+    dir_entry_t *entry;
+    dirscan_start(&e->scan, dir);
+    while ((entry = dirscan_next(&e->scan)) != NULL) {
+        if (entry->error) {
+            errno = entry->error;
+            print_error(e, "fget_status error on reading", entry->name);
+            continue;
+        }
+        struct stat *new_status = &entry->status;
+        switch (sget_type(new_status)) {
+            case FTYPE_REG:
+            case FTYPE_LINK:
+                stats_entry(S_ISLNK(new_status->st_mode) ? STATS_SYMLINKS
+                                                         : STATS_FILES,
+                            new_status->st_size);
+                node->own += fget_size(opts->flags & FLAG_BYTES, new_status,
+                                       opts->block_size);
+                break;
+            case FTYPE_DIR:
+                if (mounts_prune(opts->excluded, opts->flags & FLAG_ONEFS,
+                                 node->dev, new_status->st_dev)) {
+                    break;
+                }
+                if (grow((void **)&e->names, n, &e->names_memsize,
+                         sizeof(char *)) ||
+                    (e->names[n] = arena_strdup(&e->arena, entry->name)) ==
+                        NULL) {
+                    closedir(dir);
+                    return NULL;
+                }
+                n++;
+                break;
+            default:
+                break;
+        }
+    }
+    closedir(dir);
+
+    node->nsub = n;
+    node->total = node->own;
+    node->complete = n == 0;
+    if (n > 0) {
+        node->names = (char **)arena_alloc(&e->arena, sizeof(char *) * n);
+        node->children =
+            (est_node_t **)arena_alloc(&e->arena, sizeof(est_node_t *) * n);
+        if (node->names == NULL || node->children == NULL) return NULL;
+        memcpy(node->names, e->names, sizeof(char *) * n);
+        memset(node->children, 0, sizeof(est_node_t *) * n);
+    }
+    return node;
+}
+
+/**
+ * @brief Walks down from a subdirectory of a path given, choosing one
+ *        subdirectory at random on each level and weighting each level by
+ *        the choices it had (Knuth's estimator, unbiased). A subtree read to
+ *        the end gives its exact size and isn't walked again
+ * @param path      Path of the path given
+ * @return          0 upon success, -1 if out of memory
+ */
+static int est_walk(estimate_t *e, est_stratum_t *s, const char *path,
+                    double *estimate) {
+    est_node_t **slot = &s->node;
+    size_t depth = 0;
+    double weight = 1;
+    int fresh = 0;
+
+    *estimate = 0;
+    if (pathbuf_set(&e->path, path) ||
+        pathbuf_push(&e->path, s->name) == (size_t)-1) {
+        return -1;
+    }
+    while (1) {
+        if (*slot == NULL) {
+            if ((*slot = est_read(e, e->path.str)) == NULL) return -1;
+            s->seen += (*slot)->own;
+            fresh = (*slot)->complete;
+        }
+        est_node_t *node = *slot;
+        if (grow((void **)&e->stack, depth, &e->stack_memsize,
+                 sizeof(est_node_t *))) {
+            return -1;
+        }
+        e->stack[depth++] = node;
+
+        if (node->complete) {
+            *estimate += weight * node->total;
+            break;
+        }
+        *estimate += weight * node->own;
+        int i = hash_pair(ESTIMATE_SEED, e->draws++) % node->nsub;
+        weight *= node->nsub;
+        if (pathbuf_push(&e->path, node->names[i]) == (size_t)-1) return -1;
+        slot = &node->children[i];
+    }
+
+    // Directories whose last subtree was just read become exact
+    for (size_t k = depth - 1; fresh && k-- > 0;) {
+        est_node_t *parent = e->stack[k];
+        if (++parent->ncomplete < parent->nsub) break;
+        parent->complete = 1;
+        parent->total = parent->own;
+        for (int i = 0; i < parent->nsub; i++) {
+            parent->total += parent->children[i]->total;
+        }
+    }
+    return 0;
+}
+
+static double est_size(const est_stratum_t *s) {
+    if (s->exact >= 0) return s->exact;
+    if (s->node != NULL && s->node->complete) return s->node->total;
+    return s->mean;
+}
+
+static int est_exact(const est_stratum_t *s) {
+    return s->exact >= 0 || (s->node != NULL && s->node->complete);
+}
+
+/**
+ * @brief Tells if the stratum is in the totals kept while walking
+ */
+static int est_counted(const est_stratum_t *s) {
+    return s->walks >= 2 || est_exact(s);
+}
+
+/**
+ * @brief Variance of the estimate of the stratum, DBL_MAX until it had
+ *        enough walks
+ */
+static double est_var(const est_stratum_t *s) {
+    if (est_exact(s)) return 0;
+    if (s->walks < 2) return DBL_MAX;
+    return s->m2 / (s->walks - 1) / s->walks;
+}
+
+/**
+ * @brief Variance removed by one more walk of the stratum
+ */
+static double est_gain(const est_stratum_t *s) {
+    if (est_exact(s)) return 0;
+    if (s->walks < ESTIMATE_MIN_WALKS) return DBL_MAX;
+    return s->m2 / (s->walks - 1) / s->walks / (s->walks + 1);
+}
+
+static void heap_swap(estimate_t *e, int a, int b) {
+    int tmp = e->heap[a];
+    e->heap[a] = e->heap[b];
+    e->heap[b] = tmp;
+    e->strata[e->heap[a]].heap_pos = a;
+    e->strata[e->heap[b]].heap_pos = b;
+}
+
+/**
+ * @brief Moves the stratum to its place once its gain changed
+ */
+static void heap_fix(estimate_t *e, int pos) {
+    while (pos > 0 && est_gain(&e->strata[e->heap[(pos - 1) / 2]]) <
+                          est_gain(&e->strata[e->heap[pos]])) {
+        heap_swap(e, pos, (pos - 1) / 2);
+        pos = (pos - 1) / 2;
+    }
+    while (2 * pos + 1 < e->nstrata) {
+        int child = 2 * pos + 1;
+        if (child + 1 < e->nstrata &&
+            est_gain(&e->strata[e->heap[child + 1]]) >
+                est_gain(&e->strata[e->heap[child]])) {
+            child++;
+        }
+        if (est_gain(&e->strata[e->heap[child]]) <=
+            est_gain(&e->strata[e->heap[pos]])) {
+            break;
+        }
+        heap_swap(e, pos, child);
+        pos = child;
+    }
+}
+
+static void est_totals(const estimate_t *e, const est_node_t *root,
+                       double *size, double *var) {
+    *size = root->own;
+    *var = 0;
+    for (int i = 0; i < e->nstrata; i++) {
+        *size += est_size(&e->strata[i]);
+        *var += est_var(&e->strata[i]);
+    }
+}
+
+/**
+ * @brief Prints "SIZE\tLOW\tHIGH\tPATH", neither the size nor the low bound
+ *        are below the sizes read
+ */
+static void est_print(double size, double var, double seen, const char *path) {
+    double half = ESTIMATE_Z * sqrt(var);
+    if (size < seen) size = seen;
+    double low = size - half > seen ? size - half : seen;
+    char buf[3 * (LONG_DECIMAL_SIZE + 1)];
+    size_t n = format_long(buf, dceill(size));
+    buf[n++] = '\t';
+    n += format_long(buf + n, dceill(low));
+    buf[n++] = '\t';
+    n += format_long(buf + n, dceill(size + half));
+    buf[n++] = '\t';
+
+    outbuf_t *out = outbuf_stdout();
+    outbuf_write(out, buf, n);
+    outbuf_write(out, path, strlen(path));
+    outbuf_write(out, "\n", 1);
+}
+
+static void refine_visit(void *ctx, const char *path, int depth, double own,
+                         double size, int failed) {
+    (void)path;
+    (void)own;
+    if (depth == 0 && !failed) *(double *)ctx = size;
+}
+
+static int stratum_cmp(const void *a, const void *b, void *ctx) {
+    const estimate_t *e = (const estimate_t *)ctx;
+    double sa = est_size(&e->strata[*(const int *)a]);
+    double sb = est_size(&e->strata[*(const int *)b]);
+    return (sa < sb) - (sa > sb);
+}
+
+/**
+ * @brief Traverses the subdirectories with the largest estimates to the
+ *        end, with the options of the traversal
+ */
+static int est_refine(estimate_t *e, const char *path, int refine) {
+    int *order = (int *)malloc(sizeof(int) * e->nstrata);
+    if (order == NULL) return -1;
+    for (int i = 0; i < e->nstrata; i++) order[i] = i;
+    qsort_r(order, e->nstrata, sizeof(int), stratum_cmp, e);
+
+    du_opts_t opts = *e->opts;
+    opts.flags &= ~FLAG_ALL;
+    opts.cache = NULL;
+    opts.index = NULL;
+    opts.top = opts.top_files = 0;
+    opts.visit = refine_visit;
+
+    for (int i = 0; i < e->nstrata && refine > 0; i++) {
+        est_stratum_t *s = &e->strata[order[i]];
+        if (est_exact(s)) continue;
+        refine--;
+
+        double size = -1;
+        opts.visit_ctx = &size;
+        if (pathbuf_set(&e->path, path) ||
+            pathbuf_push(&e->path, s->name) == (size_t)-1) {
+            free(order);
+            return -1;
+        }
+        char *paths[] = {e->path.str};
+        int status = traverse_paths(&opts, paths, 1);
+        if (status != 0) e->status = status;
+        if (size >= 0) s->exact = size;
+    }
+    free(order);
+    return 0;
+}
+
+/**
+ * @brief Estimates one directory given and prints it
+ * @return 0 upon success, -1 if out of memory
+ */
+static int est_path(estimate_t *e, char *path, double error, int refine) {
+    const du_opts_t *opts = e->opts;
+    est_node_t *root = est_read(e, path);
+    if (root == NULL) return -1;
+    if (root->failed) return 0;
+
+    e->nstrata = root->nsub;
+    e->strata = (est_stratum_t *)calloc(root->nsub + 1, sizeof(est_stratum_t));
+    e->heap = (int *)malloc(sizeof(int) * (root->nsub + 1));
+    if (e->strata == NULL || e->heap == NULL) return -1;
+    for (int i = 0; i < e->nstrata; i++) {
+        e->strata[i].name = root->names[i];
+        e->strata[i].exact = -1;
+        e->strata[i].heap_pos = i;
+        e->heap[i] = i;
+    }
+
+    // Only the own size of each one is printed with -S
+    for (int i = 0; (opts->flags & FLAG_SEPDIR) && i < e->nstrata; i++) {
+        est_stratum_t *s = &e->strata[i];
+        if (pathbuf_set(&e->path, path) ||
+            pathbuf_push(&e->path, s->name) == (size_t)-1 ||
+            (s->node = est_read(e, e->path.str)) == NULL) {
+            return -1;
+        }
+        s->exact = s->seen = s->node->own;
+    }
+
+    // Walks go to the subdirectory whose variance drops the most, every one
+    // has a few walks first. Totals are kept as the walks go and added again
+    // before stopping
+    long max_walks = ESTIMATE_MAX_WALKS;
+    if (max_walks < (long)ESTIMATE_MIN_WALKS * e->nstrata) {
+        max_walks = (long)ESTIMATE_MIN_WALKS * e->nstrata;
+    }
+    double size = 0, var = 0;
+    for (long walks = 0; e->nstrata > 0 && walks < max_walks; walks++) {
+        est_stratum_t *s = &e->strata[e->heap[0]];
+        double gain = est_gain(s);
+        if (gain == 0) break;
+        if (gain != DBL_MAX &&
+            ESTIMATE_Z * sqrt(var > 0 ? var : 0) <= error * size) {
+            est_totals(e, root, &size, &var);
+            if (ESTIMATE_Z * sqrt(var) <= error * size) break;
+        }
+
+        if (est_counted(s)) {
+            size -= est_size(s);
+            var -= est_var(s);
+        }
+        double x;
+        if (est_walk(e, s, path, &x)) return -1;
+        s->walks++;
+        double delta = x - s->mean;
+        s->mean += delta / s->walks;
+        s->m2 += delta * (x - s->mean);
+        if (est_counted(s)) {
+            size += est_size(s);
+            var += est_var(s);
+        }
+        heap_fix(e, 0);
+    }
+
+    if (refine > 0 && est_refine(e, path, refine)) return -1;
+
+    double seen = root->own;
+    for (int i = 0; i < e->nstrata; i++) {
+        est_stratum_t *s = &e->strata[i];
+        double low = est_exact(s) ? est_size(s) : s->seen;
+        seen += low;
+        if ((opts->flags & FLAG_MAXDEPTH) && opts->max_depth < 1) continue;
+        if (pathbuf_set(&e->path, path) ||
+            pathbuf_push(&e->path, s->name) == (size_t)-1) {
+            return -1;
+        }
+        est_print(est_size(s), est_var(s), low, e->path.str);
+    }
+
+    est_totals(e, root, &size, &var);
+    if (opts->flags & FLAG_SEPDIR) size = seen = root->own;
+    est_print(size, var, seen, path);
+    return 0;
+}
+
+int estimate_paths(const du_opts_t *opts, char **paths, int npaths,
+                   double error, int refine) {
+    estimate_t e;
+    memset(&e, 0, sizeof(e));
+    e.opts = opts;
+    pathbuf_init(&e.path);
+    if (dirscan_init(&e.scan, NULL, opts->flags & FLAG_DEREF)) {
+        perror("simpledu: malloc error");
+        return -1;
+    }
+    e.scan.exclude = opts->exclude;
+
+    for (int i = 0; i < npaths && e.status != -1; i++) {
+        struct stat status;
+        if (fget_status(paths[i], &status, opts->flags & FLAG_DEREF)) {
+            print_error(&e, "fget_status error on reading", paths[i]);
+            continue;
+        }
+
+        file_type_t type = sget_type(&status);
+        if (type == FTYPE_REG || type == FTYPE_LINK) {
+            double size = fget_size(opts->flags & FLAG_BYTES, &status,
+                                    opts->block_size);
+            est_print(size, 0, size, paths[i]);
+        } else if (type == FTYPE_DIR &&
+                   !mounts_prune(opts->excluded, 0, status.st_dev,
+                                 status.st_dev) &&
+                   est_path(&e, paths[i], error, refine)) {
+            perror("simpledu: malloc error");
+            e.status = -1;
+        }
+
+        free(e.strata);
+        free(e.heap);
+        e.strata = NULL;
+        e.heap = NULL;
+        arena_free(&e.arena);
+    }
+
+    dirscan_free(&e.scan);
+    pathbuf_free(&e.path);
+    free(e.stack);
+    free(e.names);
+    return e.status;
+}
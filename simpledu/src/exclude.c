@@ -0,0 +1,308 @@
+/* MAIN HEADER */
+#include "exclude.h"
+
+/* INCLUDE HEADERS */
+#include "utils.h"
+
+/* SYSTEM CALLS HEADERS */
+#include <fnmatch.h>
+
+/* C LIBRARY HEADERS */
+#include <errno.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define PATTERNS_INIT_SIZE  64
+#define SET_INIT_SIZE       64      /** @brief Slots of a hash set, doubled when half full */
+#define GLOB_CHARS          "*?[\\"
+
+typedef struct ex_key {
+    const char *str;        /**< @brief NULL if the slot is empty */
+    size_t      len;
+    uint64_t    hash;
+} ex_key_t;
+
+/**
+ * @brief Open addressing set of literals, with the lengths they have so a
+ *        name is only hashed once per length (suffixes, prefixes, infixes)
+ */
+typedef struct ex_set {
+    ex_key_t       *slots;
+    size_t          size;
+    size_t          memsize;
+    unsigned char   has_len[NAME_MAX + 1];
+    int             lens[NAME_MAX + 1];     /**< @brief Lengths of the literals, ascending */
+    int             nlens;
+} ex_set_t;
+
+struct exclude {
+    char          **patterns;   /**< @brief Copies of the patterns, in the order added */
+    size_t          size;
+    size_t          memsize;
+
+    ex_set_t        exact;      /**< @brief Patterns without wildcards */
+    ex_set_t        suffix;     /**< @brief "*SUFFIX", without the star */
+    ex_set_t        prefix;     /**< @brief "PREFIX*", without the star */
+    ex_set_t        infix;      /**< @brief "*INFIX*", without the stars */
+
+    // Other patterns, the ones starting with a literal byte b are
+    // globs[starts[b]] ... globs[starts[b + 1] - 1], a name starting with
+    // another byte can't match them
+    const char    **globs;
+    size_t          starts[UCHAR_MAX + 2];
+    const char    **any;        /**< @brief Patterns starting with a wildcard */
+    size_t          any_size;
+
+    uint64_t        key;        /**< @brief Hash of the distinct patterns, sorted */
+};
+
+static uint64_t hash_str(const char *str, size_t len) {
+    uint64_t hash = 14695981039346656037ULL;  // FNV-1a
+    for (size_t i = 0; i < len; i++) {
+        hash ^= (unsigned char)str[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+static const ex_key_t* set_find(const ex_set_t *set, const char *str,
+                                size_t len, uint64_t hash) {
+    size_t mask = set->memsize - 1;
+    for (size_t i = hash & mask; set->slots[i].str != NULL;
+         i = (i + 1) & mask) {
+        const ex_key_t *key = &set->slots[i];
+        if (key->hash == hash && key->len == len &&
+            memcmp(key->str, str, len) == 0) {
+            return key;
+        }
+    }
+    return NULL;
+}
+
+static int set_grow(ex_set_t *set) {
+    size_t memsize = set->memsize ? set->memsize * 2 : SET_INIT_SIZE;
+    ex_key_t *slots = (ex_key_t *)calloc(memsize, sizeof(ex_key_t));
+    if (slots == NULL) return -1;
+
+    for (size_t i = 0; i < set->memsize; i++) {
+        if (set->slots[i].str == NULL) continue;
+        size_t j = set->slots[i].hash & (memsize - 1);
+        while (slots[j].str != NULL) j = (j + 1) & (memsize - 1);
+        slots[j] = set->slots[i];
+    }
+    free(set->slots);
+    set->slots = slots;
+    set->memsize = memsize;
+    return 0;
+}
+
+static int set_insert(ex_set_t *set, const char *str, size_t len) {
+    // Longer than any name, it can never match
+    if (len > NAME_MAX) return 0;
+    if (2 * (set->size + 1) > set->memsize && set_grow(set)) return -1;
+
+    uint64_t hash = hash_str(str, len);
+    if (set_find(set, str, len, hash) != NULL) return 0;
+
+    size_t i = hash & (set->memsize - 1);
+    while (set->slots[i].str != NULL) i = (i + 1) & (set->memsize - 1);
+    set->slots[i].str = str;
+    set->slots[i].len = len;
+    set->slots[i].hash = hash;
+    set->size++;
+    set->has_len[len] = 1;
+    return 0;
+}
+
+static void set_lens(ex_set_t *set) {
+    set->nlens = 0;
+    for (int len = 0; len <= NAME_MAX; len++) {
+        if (set->has_len[len]) set->lens[set->nlens++] = len;
+    }
+}
+
+exclude_t* exclude_create(void) {
+    return (exclude_t *)calloc(1, sizeof(exclude_t));
+}
+
+int exclude_add(exclude_t *ex, const char *pattern) {
+    if (ex->size == ex->memsize) {
+        size_t memsize = ex->memsize ? ex->memsize * 2 : PATTERNS_INIT_SIZE;
+        char **patterns =
+            (char **)realloc(ex->patterns, sizeof(char *) * memsize);
+        if (patterns == NULL) return -1;
+        ex->patterns = patterns;
+        ex->memsize = memsize;
+    }
+    if ((ex->patterns[ex->size] = strdup(pattern)) == NULL) return -1;
+    ex->size++;
+    return 0;
+}
+
+int exclude_add_file(exclude_t *ex, const char *path) {
+    FILE *file = fopen(path, "r");
+    if (file == NULL) return -1;
+
+    char *line = NULL;
+    size_t line_size = 0;
+    ssize_t len;
+    int ret = 0;
+    while ((len = getline(&line, &line_size, file)) != -1) {
+        while (len > 0 && (line[len - 1] == '\n' || line[len - 1] == '\r')) {
+            line[--len] = 0;
+        }
+        if (len == 0 || line[0] == '#') continue;
+        if (exclude_add(ex, line)) {
+            errno = ENOMEM;
+            ret = -1;
+            break;
+        }
+    }
+    if (ret == 0 && ferror(file)) ret = -1;
+    free(line);
+    fclose(file);
+    return ret;
+}
+
+static int compare_str(const void *a, const void *b) {
+    return strcmp(*(const char **)a, *(const char **)b);
+}
+
+/**
+ * @brief Hashes the patterns that aren't empty, each once and whatever the
+ *        order they were given in, so the same set gives the same key
+ */
+static int set_key(exclude_t *ex) {
+    const char **sorted =
+        (const char **)malloc(sizeof(char *) * (ex->size + 1));
+    if (sorted == NULL) return -1;
+    memcpy(sorted, ex->patterns, sizeof(char *) * ex->size);
+    qsort(sorted, ex->size, sizeof(char *), compare_str);
+
+    uint64_t key = hash_str("", 0);
+    for (size_t i = 0; i < ex->size; i++) {
+        if (sorted[i][0] == 0) continue;
+        if (i > 0 && strcmp(sorted[i], sorted[i - 1]) == 0) continue;
+        // The terminator too, so "ab" "c" and "a" "bc" differ
+        key = hash_pair(key, hash_str(sorted[i], strlen(sorted[i]) + 1));
+    }
+    free(sorted);
+    ex->key = key;
+    return 0;
+}
+
+static int compare_first(const void *a, const void *b) {
+    return (int)(unsigned char)(*(const char **)a)[0] -
+           (int)(unsigned char)(*(const char **)b)[0];
+}
+
+int exclude_compile(exclude_t *ex) {
+    ex->globs = (const char **)malloc(sizeof(char *) * (ex->size + 1));
+    ex->any = (const char **)malloc(sizeof(char *) * (ex->size + 1));
+    if (ex->globs == NULL || ex->any == NULL) return -1;
+
+    size_t globs_size = 0;
+    for (size_t i = 0; i < ex->size; i++) {
+        const char *p = ex->patterns[i];
+        size_t len = strlen(p);
+        size_t literal = strcspn(p, GLOB_CHARS);  // bytes before a wildcard
+        int ret = 0;
+
+        if (len == 0) continue;
+        if (literal == len) {
+            ret = set_insert(&ex->exact, p, len);
+        } else if (p[0] == '*' && len > 1 &&
+                   strcspn(p + 1, GLOB_CHARS) == len - 1) {
+            ret = set_insert(&ex->suffix, p + 1, len - 1);
+        } else if (literal == len - 1 && p[len - 1] == '*' && literal > 0) {
+            ret = set_insert(&ex->prefix, p, len - 1);
+        } else if (p[0] == '*' && len > 2 && p[len - 1] == '*' &&
+                   strcspn(p + 1, GLOB_CHARS) == len - 2) {
+            ret = set_insert(&ex->infix, p + 1, len - 2);
+        } else if (literal == 0) {
+            ex->any[ex->any_size++] = p;
+        } else {
+            ex->globs[globs_size++] = p;
+        }
+        if (ret) return -1;
+    }
+
+    set_lens(&ex->exact);
+    set_lens(&ex->suffix);
+    set_lens(&ex->prefix);
+    set_lens(&ex->infix);
+
+    qsort(ex->globs, globs_size, sizeof(char *), compare_first);
+    size_t g = 0;
+    for (int b = 0; b <= UCHAR_MAX; b++) {
+        ex->starts[b] = g;
+        while (g < globs_size && (unsigned char)ex->globs[g][0] == b) g++;
+    }
+    ex->starts[UCHAR_MAX + 1] = g;
+    return set_key(ex);
+}
+
+int exclude_match(const exclude_t *ex, const char *name) {
+    size_t len = strlen(name);
+
+    if (ex->exact.size > 0 && len <= NAME_MAX && ex->exact.has_len[len] &&
+        set_find(&ex->exact, name, len, hash_str(name, len)) != NULL) {
+        return 1;
+    }
+    for (int i = 0; i < ex->suffix.nlens && (size_t)ex->suffix.lens[i] <= len;
+         i++) {
+        size_t l = ex->suffix.lens[i];
+        const char *suffix = name + len - l;
+        if (set_find(&ex->suffix, suffix, l, hash_str(suffix, l)) != NULL) {
+            return 1;
+        }
+    }
+    for (int i = 0; i < ex->prefix.nlens && (size_t)ex->prefix.lens[i] <= len;
+         i++) {
+        size_t l = ex->prefix.lens[i];
+        if (set_find(&ex->prefix, name, l, hash_str(name, l)) != NULL) {
+            return 1;
+        }
+    }
+
+    // Every substring of each length, names are short
+    for (int i = 0; i < ex->infix.nlens && (size_t)ex->infix.lens[i] <= len;
+         i++) {
+        size_t l = ex->infix.lens[i];
+        for (size_t pos = 0; pos + l <= len; pos++) {
+            if (set_find(&ex->infix, name + pos, l,
+                         hash_str(name + pos, l)) != NULL) {
+                return 1;
+            }
+        }
+    }
+
+    unsigned char first = (unsigned char)name[0];
+    for (size_t i = ex->starts[first]; i < ex->starts[first + 1]; i++) {
+        if (fnmatch(ex->globs[i], name, 0) == 0) return 1;
+    }
+    for (size_t i = 0; i < ex->any_size; i++) {
+        if (fnmatch(ex->any[i], name, 0) == 0) return 1;
+    }
+    return 0;
+}
+
+size_t exclude_size(const exclude_t *ex) { return ex->size; }
+
+uint64_t exclude_key(const exclude_t *ex) { return ex->key; }
+
+void exclude_destroy(exclude_t *ex) {
+    if (ex == NULL) return;
+    for (size_t i = 0; i < ex->size; i++) free(ex->patterns[i]);
+    free(ex->patterns);
+    free(ex->exact.slots);
+    free(ex->suffix.slots);
+    free(ex->prefix.slots);
+    free(ex->infix.slots);
+    free(ex->globs);
+    free(ex->any);
+    free(ex);
+}
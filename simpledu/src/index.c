@@ -0,0 +1,567 @@
+/* MAIN HEADER */
+#include "index.h"
+
+/* INCLUDE HEADERS */
+#include "utils.h"
+
+/* SYSTEM CALLS HEADERS */
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/* C LIBRARY HEADERS */
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define INDEX_BUF_SIZE      (1 << 20)   /** @brief Buffer of the file while writing */
+#define PENDING_INIT_SIZE   256
+#define NAMES_INIT_SIZE     1024        /** @brief Slots of the table of names, a power of 2 */
+
+/**
+ * @brief Entry whose parent wasn't added yet
+ */
+typedef struct index_pending {
+    index_node_t    node;
+    int             depth;
+} index_pending_t;
+
+struct index_writer {
+    char               *path;
+    char               *tmp_path;
+    FILE               *file;
+    uint32_t            block_size;
+    uint64_t            written;    /**< @brief Nodes in the file */
+    int                 error;      /**< @brief errno of the first failure, 0 if none */
+
+    // Entries are kept until their parent comes, the children of a
+    // directory are the entries one level deeper at the top
+    index_pending_t    *pending;
+    size_t              pending_size;
+    size_t              pending_memsize;
+
+    // Every name is kept once, the table holds index + 1, 0 if free
+    uint32_t           *slots;
+    size_t              slots_memsize;
+    uint64_t           *offsets;
+    size_t              names;
+    size_t              names_memsize;
+    char               *blob;
+    size_t              blob_size;
+    size_t              blob_memsize;
+};
+
+/**
+ * @brief FNV-1a, names are short
+ */
+static uint64_t name_hash(const char *name, size_t len) {
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (size_t i = 0; i < len; i++) {
+        hash ^= (unsigned char)name[i];
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+static int names_grow(index_writer_t *w) {
+    size_t memsize = w->slots_memsize * 2;
+    uint32_t *slots = (uint32_t *)calloc(memsize, sizeof(uint32_t));
+    if (slots == NULL) return -1;
+
+    for (size_t id = 0; id < w->names; id++) {
+        const char *name = w->blob + w->offsets[id];
+        size_t i = name_hash(name, strlen(name)) & (memsize - 1);
+        while (slots[i] != 0) i = (i + 1) & (memsize - 1);
+        slots[i] = id + 1;
+    }
+    free(w->slots);
+    w->slots = slots;
+    w->slots_memsize = memsize;
+    return 0;
+}
+
+/**
+ * @brief Gets the index of the name, adding it the first time
+ * @return 0 upon success, -1 if out of memory
+ */
+static int name_intern(index_writer_t *w, const char *name, uint32_t *id) {
+    size_t len = strlen(name);
+    size_t mask = w->slots_memsize - 1;
+    size_t i = name_hash(name, len) & mask;
+
+    for (; w->slots[i] != 0; i = (i + 1) & mask) {
+        const char *other = w->blob + w->offsets[w->slots[i] - 1];
+        if (strcmp(other, name) == 0) {
+            *id = w->slots[i] - 1;
+            return 0;
+        }
+    }
+
+    if (w->names == UINT32_MAX - 1) {
+        errno = EOVERFLOW;
+        return -1;
+    }
+    if (w->names == w->names_memsize) {
+        size_t memsize = w->names_memsize * 2;
+        uint64_t *offsets =
+            (uint64_t *)realloc(w->offsets, sizeof(uint64_t) * memsize);
+        if (offsets == NULL) return -1;
+        w->offsets = offsets;
+        w->names_memsize = memsize;
+    }
+    if (w->blob_size + len + 1 > w->blob_memsize) {
+        size_t memsize = w->blob_memsize * 2;
+        while (memsize < w->blob_size + len + 1) memsize *= 2;
+        char *blob = (char *)realloc(w->blob, memsize);
+        if (blob == NULL) return -1;
+        w->blob = blob;
+        w->blob_memsize = memsize;
+    }
+
+    memcpy(w->blob + w->blob_size, name, len + 1);
+    w->offsets[w->names] = w->blob_size;
+    w->blob_size += len + 1;
+    w->slots[i] = w->names + 1;
+    *id = w->names++;
+
+    // At most half full, so probes stay short
+    if (w->names * 2 > w->slots_memsize) return names_grow(w);
+    return 0;
+}
+
+static int pending_cmp(const void *a, const void *b, void *ctx) {
+    const index_writer_t *w = (const index_writer_t *)ctx;
+    const index_pending_t *pa = (const index_pending_t *)a;
+    const index_pending_t *pb = (const index_pending_t *)b;
+    return strcmp(w->blob + w->offsets[pa->node.name],
+                  w->blob + w->offsets[pb->node.name]);
+}
+
+/**
+ * @brief Writes the last n pending entries as consecutive nodes
+ * @return Index of the first one, -1 upon error
+ */
+static int64_t pending_write(index_writer_t *w, size_t n) {
+    index_pending_t *group = w->pending + w->pending_size - n;
+    uint64_t first = w->written;
+
+    if (w->written + n > UINT32_MAX) {
+        errno = EOVERFLOW;
+        return -1;
+    }
+    for (size_t i = 0; i < n; i++) {
+        if (fwrite(&group[i].node, sizeof(index_node_t), 1, w->file) != 1) {
+            return -1;
+        }
+    }
+    w->written += n;
+    w->pending_size -= n;
+    return first;
+}
+
+index_writer_t* index_create(const char *path, uint32_t block_size) {
+    index_writer_t *w = (index_writer_t *)calloc(1, sizeof(index_writer_t));
+    if (w == NULL) return NULL;
+
+    size_t tmp_len = strlen(path) + 5;
+    w->path = strdup(path);
+    w->tmp_path = (char *)malloc(tmp_len);
+    w->slots = (uint32_t *)calloc(NAMES_INIT_SIZE, sizeof(uint32_t));
+    w->offsets = (uint64_t *)malloc(sizeof(uint64_t) * NAMES_INIT_SIZE);
+    w->blob = (char *)malloc(NAMES_INIT_SIZE * 16);
+    w->pending =
+        (index_pending_t *)malloc(sizeof(index_pending_t) * PENDING_INIT_SIZE);
+    if (w->path == NULL || w->tmp_path == NULL || w->slots == NULL ||
+        w->offsets == NULL || w->blob == NULL || w->pending == NULL) {
+        index_finish(w, 0);
+        return NULL;
+    }
+    w->slots_memsize = NAMES_INIT_SIZE;
+    w->names_memsize = NAMES_INIT_SIZE;
+    w->blob_memsize = NAMES_INIT_SIZE * 16;
+    w->pending_memsize = PENDING_INIT_SIZE;
+    w->block_size = block_size;
+    snprintf(w->tmp_path, tmp_len, "%s.tmp", path);
+
+    // The header is written again once the sizes are known
+    index_header_t header;
+    memset(&header, 0, sizeof(header));
+    if ((w->file = fopen(w->tmp_path, "we")) == NULL ||
+        setvbuf(w->file, NULL, _IOFBF, INDEX_BUF_SIZE) ||
+        fwrite(&header, sizeof(header), 1, w->file) != 1) {
+        index_finish(w, 0);
+        return NULL;
+    }
+    return w;
+}
+
+int index_add(index_writer_t *w, const char *name, int depth,
+              const index_node_t *node) {
+    if (w->error) return -1;
+
+    index_pending_t entry;
+    entry.node = *node;
+    entry.node.first = 0;
+    entry.node.children = 0;
+    entry.depth = depth;
+
+    // Children of a directory are sorted by name, so a path is found with a
+    // binary search on each level
+    size_t n = 0;
+    while (n < w->pending_size &&
+           w->pending[w->pending_size - n - 1].depth == depth + 1) {
+        n++;
+    }
+    if (n > 0) {
+        index_pending_t *group = w->pending + w->pending_size - n;
+        qsort_r(group, n, sizeof(index_pending_t), pending_cmp, w);
+        int64_t first = pending_write(w, n);
+        if (first == -1) goto error;
+        entry.node.first = first;
+        entry.node.children = n;
+    }
+
+    if (name_intern(w, name, &entry.node.name)) goto error;
+
+    if (w->pending_size == w->pending_memsize) {
+        size_t memsize = w->pending_memsize * 2;
+        index_pending_t *pending = (index_pending_t *)realloc(
+            w->pending, sizeof(index_pending_t) * memsize);
+        if (pending == NULL) goto error;
+        w->pending = pending;
+        w->pending_memsize = memsize;
+    }
+    w->pending[w->pending_size++] = entry;
+    return 0;
+
+error:
+    w->error = errno ? errno : ENOMEM;
+    return -1;
+}
+
+int index_finish(index_writer_t *w, int save) {
+    int ret = -1;
+    if (w == NULL) return -1;
+
+    if (save && w->file != NULL && !w->error) {
+        index_header_t header;
+        memset(&header, 0, sizeof(header));
+        header.version = INDEX_VERSION;
+        header.block_size = w->block_size;
+        header.names = w->names;
+
+        // Whatever is left are the paths given, in their order
+        size_t roots = w->pending_size;
+        int64_t first = pending_write(w, roots);
+        header.nodes = w->written;
+        header.roots_first = first;
+        header.roots = roots;
+        header.names_offset =
+            sizeof(index_header_t) + w->written * sizeof(index_node_t);
+        header.blob_offset =
+            header.names_offset + w->names * sizeof(uint64_t);
+        header.blob_size = w->blob_size;
+        header.magic = INDEX_MAGIC;
+
+        if (first != -1 &&
+            fwrite(w->offsets, sizeof(uint64_t), w->names, w->file) ==
+                w->names &&
+            fwrite(w->blob, 1, w->blob_size, w->file) == w->blob_size &&
+            fseek(w->file, 0, SEEK_SET) == 0 &&
+            fwrite(&header, sizeof(header), 1, w->file) == 1 &&
+            fflush(w->file) == 0 && fsync(fileno(w->file)) == 0) {
+            ret = 0;
+        }
+    } else if (save) {
+        errno = w->error ? w->error : EIO;
+    }
+
+    int error = errno;
+    if (w->file != NULL && fclose(w->file)) ret = -1;
+    if (ret == 0 && rename(w->tmp_path, w->path)) {
+        error = errno;
+        ret = -1;
+    }
+    if (ret == -1 && w->file != NULL) unlink(w->tmp_path);
+
+    free(w->path);
+    free(w->tmp_path);
+    free(w->pending);
+    free(w->slots);
+    free(w->offsets);
+    free(w->blob);
+    free(w);
+    errno = error;
+    return ret;
+}
+
+int index_open(index_t *idx, const char *path) {
+    memset(idx, 0, sizeof(index_t));
+
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd == -1) return -1;
+
+    struct stat status;
+    if (fstat(fd, &status) ||
+        (size_t)status.st_size < sizeof(index_header_t)) {
+        close(fd);
+        errno = EINVAL;
+        return -1;
+    }
+
+    void *map = mmap(NULL, status.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) return -1;
+
+    // Every offset is checked once, lookups trust them
+    const index_header_t *header = (const index_header_t *)map;
+    uint64_t size = status.st_size;
+    if (header->magic != INDEX_MAGIC || header->version != INDEX_VERSION ||
+        header->nodes > UINT32_MAX ||
+        header->names_offset !=
+            sizeof(index_header_t) + header->nodes * sizeof(index_node_t) ||
+        header->roots_first + header->roots > header->nodes ||
+        header->names > (size - header->names_offset) / sizeof(uint64_t) ||
+        header->blob_offset !=
+            header->names_offset + header->names * sizeof(uint64_t) ||
+        header->blob_offset + header->blob_size > size ||
+        (header->blob_size > 0 &&
+         ((const char *)map)[header->blob_offset + header->blob_size - 1] !=
+             '\0')) {
+        munmap(map, status.st_size);
+        errno = EINVAL;
+        return -1;
+    }
+
+    idx->map = map;
+    idx->map_size = status.st_size;
+    idx->header = header;
+    idx->nodes = (const index_node_t *)(header + 1);
+    idx->name_offsets =
+        (const uint64_t *)((const char *)map + header->names_offset);
+    idx->blob = (const char *)map + header->blob_offset;
+    return 0;
+}
+
+const char* index_name(const index_t *idx, const index_node_t *node) {
+    if (node->name >= idx->header->names) return "";
+    uint64_t offset = idx->name_offsets[node->name];
+    return offset < idx->header->blob_size ? idx->blob + offset : "";
+}
+
+/**
+ * @brief Compares a name of the index with a component of a path, as strcmp
+ */
+static int name_cmp(const char *name, const char *component, size_t len) {
+    int cmp = strncmp(name, component, len);
+    if (cmp != 0) return cmp;
+    return name[len] != '\0';
+}
+
+/**
+ * @brief Finds the rest of the path below the node, one level at a time
+ */
+static const index_node_t* index_descend(const index_t *idx,
+                                         const index_node_t *node,
+                                         const char *rest) {
+    while (1) {
+        while (*rest == '/') rest++;
+        if (*rest == '\0') return node;
+
+        size_t len = strcspn(rest, "/");
+        uint64_t low = node->first;
+        uint64_t high = (uint64_t)node->first + node->children;
+        if (high > idx->header->nodes) return NULL;
+
+        const index_node_t *found = NULL;
+        while (low < high) {
+            uint64_t mid = low + (high - low) / 2;
+            int cmp = name_cmp(index_name(idx, &idx->nodes[mid]), rest, len);
+            if (cmp == 0) {
+                found = &idx->nodes[mid];
+                break;
+            }
+            if (cmp < 0) {
+                low = mid + 1;
+            } else {
+                high = mid;
+            }
+        }
+        if (found == NULL) return NULL;
+        node = found;
+        rest += len;
+    }
+}
+
+const index_node_t* index_lookup(const index_t *idx, const char *path) {
+    const index_header_t *header = idx->header;
+
+    for (uint64_t i = 0; i < header->roots; i++) {
+        const index_node_t *root = &idx->nodes[header->roots_first + i];
+        const char *name = index_name(idx, root);
+        size_t len = strlen(name);
+
+        if (strncmp(path, name, len) != 0) continue;
+        if (path[len] != '\0' && path[len] != '/' &&
+            (len == 0 || name[len - 1] != '/')) {
+            continue;
+        }
+        const index_node_t *node = index_descend(idx, root, path + len);
+        if (node != NULL) return node;
+    }
+    return NULL;
+}
+
+/**
+ * @brief Directory walked by index_diff, in either index or both
+ */
+typedef struct diff_frame {
+    const index_node_t *before;     /**< @brief NULL if it isn't in the first index */
+    const index_node_t *after;      /**< @brief NULL if it isn't in the second index */
+    uint64_t            next_before;    /**< @brief Next child of each one */
+    uint64_t            next_after;
+    size_t              path_len;   /**< @brief Length of the path of the parent */
+} diff_frame_t;
+
+/**
+ * @brief Gets the children of the node, none if they aren't before it in the
+ *        file, as they are written first, so a damaged index can't loop
+ */
+static void diff_children(const index_t *idx, const index_node_t *node,
+                          uint64_t *first, uint64_t *end) {
+    *first = *end = 0;
+    if (node == NULL) return;
+    uint64_t self = node - idx->nodes;
+    if ((uint64_t)node->first + node->children <= self) {
+        *first = node->first;
+        *end = (uint64_t)node->first + node->children;
+    }
+}
+
+static int diff_push(diff_frame_t **stack, size_t *size, size_t *memsize,
+                     const diff_frame_t *frame) {
+    if (*size == *memsize) {
+        size_t new_memsize = *memsize ? *memsize * 2 : 64;
+        diff_frame_t *new_stack = (diff_frame_t *)realloc(
+            *stack, sizeof(diff_frame_t) * new_memsize);
+        if (new_stack == NULL) return -1;
+        *stack = new_stack;
+        *memsize = new_memsize;
+    }
+    (*stack)[(*size)++] = *frame;
+    return 0;
+}
+
+/**
+ * @brief Reports an entry of either index and walks it if it has children
+ */
+static int diff_entry(const index_t *before, const index_t *after,
+                      const index_node_t *b, const index_node_t *a,
+                      path_buf_t *path, size_t path_len,
+                      diff_frame_t **stack, size_t *size, size_t *memsize,
+                      index_diff_fn fn, void *arg) {
+    if (fn(arg, path->str, b, a)) return -1;
+
+    diff_frame_t frame;
+    uint64_t end_before, end_after;
+    frame.before = b;
+    frame.after = a;
+    frame.path_len = path_len;
+    diff_children(before, b, &frame.next_before, &end_before);
+    diff_children(after, a, &frame.next_after, &end_after);
+    if (frame.next_before == end_before && frame.next_after == end_after) {
+        pathbuf_pop(path, path_len);
+        return 0;
+    }
+    return diff_push(stack, size, memsize, &frame);
+}
+
+int index_diff(const index_t *before, const index_t *after, index_diff_fn fn,
+               void *arg) {
+    const index_header_t *hb = before->header, *ha = after->header;
+    diff_frame_t *stack = NULL;
+    size_t size = 0, memsize = 0;
+    path_buf_t path;
+    int ret = 0;
+
+    // Paths given are few, those in both are matched by name
+    char *matched = (char *)calloc(hb->roots + 1, 1);
+    if (matched == NULL) return -1;
+    pathbuf_init(&path);
+
+    for (uint64_t r = 0; r < ha->roots + hb->roots && ret == 0; r++) {
+        const index_node_t *a = NULL, *b = NULL;
+        if (r < ha->roots) {
+            a = &after->nodes[ha->roots_first + r];
+            for (uint64_t i = 0; i < hb->roots; i++) {
+                const index_node_t *root = &before->nodes[hb->roots_first + i];
+                if (!matched[i] && strcmp(index_name(before, root),
+                                          index_name(after, a)) == 0) {
+                    matched[i] = 1;
+                    b = root;
+                    break;
+                }
+            }
+        } else if (!matched[r - ha->roots]) {
+            b = &before->nodes[hb->roots_first + r - ha->roots];
+        } else {
+            continue;
+        }
+
+        if (pathbuf_set(&path, index_name(a != NULL ? after : before,
+                                          a != NULL ? a : b)) ||
+            diff_entry(before, after, b, a, &path, 0, &stack, &size, &memsize,
+                       fn, arg)) {
+            ret = -1;
+        }
+
+        while (size > 0 && ret == 0) {
+            diff_frame_t *top = &stack[size - 1];
+            uint64_t first, end_before, end_after;
+            diff_children(before, top->before, &first, &end_before);
+            diff_children(after, top->after, &first, &end_after);
+
+            const index_node_t *cb = top->next_before < end_before
+                                         ? &before->nodes[top->next_before]
+                                         : NULL;
+            const index_node_t *ca = top->next_after < end_after
+                                         ? &after->nodes[top->next_after]
+                                         : NULL;
+            if (cb == NULL && ca == NULL) {
+                pathbuf_pop(&path, top->path_len);
+                size--;
+                continue;
+            }
+
+            // Both lists are sorted by name, the smaller name goes first and
+            // an equal one is the same entry in both
+            int cmp = cb == NULL ? 1 : ca == NULL ? -1
+                    : strcmp(index_name(before, cb), index_name(after, ca));
+            if (cmp > 0) cb = NULL;
+            if (cmp < 0) ca = NULL;
+            if (cb != NULL) top->next_before++;
+            if (ca != NULL) top->next_after++;
+
+            size_t len = pathbuf_push(&path, cb != NULL ? index_name(before, cb)
+                                                        : index_name(after, ca));
+            if (len == (size_t)-1 ||
+                diff_entry(before, after, cb, ca, &path, len, &stack, &size,
+                           &memsize, fn, arg)) {
+                ret = -1;
+            }
+        }
+        size = 0;
+    }
+
+    pathbuf_free(&path);
+    free(stack);
+    free(matched);
+    return ret;
+}
+
+void index_close(index_t *idx) {
+    if (idx->map != NULL) munmap(idx->map, idx->map_size);
+    memset(idx, 0, sizeof(index_t));
+}
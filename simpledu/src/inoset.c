@@ -0,0 +1,309 @@
+/* MAIN HEADER */
+#include "inoset.h"
+
+/* INCLUDE HEADERS */
+#include "utils.h"
+
+/* SYSTEM CALLS HEADERS */
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+/* C LIBRARY HEADERS */
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define INOSET_MAGIC        0x5445534f4e49ULL   /** @brief "INOSET" */
+#define INOSET_SHARD_BITS   4                   /** @brief 16 shards, each with its own lock */
+#define INOSET_SHARDS       (1 << INOSET_SHARD_BITS)
+#define INOSET_INIT_SLOTS   256                 /** @brief One page of slots per shard */
+
+/**
+ * @brief Slot of a table, dev holds the device plus one so 0 means empty
+ */
+typedef struct inoset_slot {
+    uint64_t dev;
+    uint64_t ino;
+} inoset_slot_t;
+
+/**
+ * @brief Open addressing table (linear probing) of one shard, inside the file
+ */
+typedef struct inoset_shard {
+    pthread_mutex_t lock;
+    uint64_t        offset;     // of the slots in the file
+    uint64_t        capacity;   // power of 2
+    uint64_t        count;
+} inoset_shard_t;
+
+/**
+ * @brief Beginning of the file, shared by every process
+ */
+typedef struct inoset_header {
+    uint64_t        magic;
+    pthread_mutex_t alloc_lock;
+    uint64_t        file_end;   // tables are appended to the file when growing
+    int             all;        // every entry is added, not only hard links
+    inoset_shard_t  shards[INOSET_SHARDS];
+} inoset_header_t;
+
+/**
+ * @brief Table of a shard as mapped by this process, remapped when another
+ *        process grew it
+ */
+typedef struct inoset_map {
+    inoset_slot_t  *slots;
+    uint64_t        offset;
+    uint64_t        capacity;
+} inoset_map_t;
+
+struct inoset {
+    int              fd;
+    inoset_header_t *header;
+    size_t           header_size;
+    inoset_map_t     maps[INOSET_SHARDS];
+};
+
+static size_t header_size(void) {
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    return (sizeof(inoset_header_t) + page - 1) / page * page;
+}
+
+static int shard_lock(inoset_shard_t *shard) {
+    int ret = pthread_mutex_lock(&shard->lock);
+    // A subprocess died holding it, the table itself is still usable
+    if (ret == EOWNERDEAD) ret = pthread_mutex_consistent(&shard->lock);
+    return ret;
+}
+
+static int init_mutex(pthread_mutex_t *mutex) {
+    pthread_mutexattr_t attr;
+    if (pthread_mutexattr_init(&attr)) return -1;
+    int ret = pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED) ||
+              pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST) ||
+              pthread_mutex_init(mutex, &attr);
+    pthread_mutexattr_destroy(&attr);
+    return ret ? -1 : 0;
+}
+
+static inoset_t* inoset_map_header(int fd) {
+    inoset_t *set = (inoset_t *)calloc(1, sizeof(inoset_t));
+    if (set == NULL) return NULL;
+
+    set->fd = fd;
+    set->header_size = header_size();
+    set->header = (inoset_header_t *)mmap(NULL, set->header_size,
+                                          PROT_READ | PROT_WRITE, MAP_SHARED,
+                                          fd, 0);
+    if (set->header == MAP_FAILED) {
+        free(set);
+        return NULL;
+    }
+    return set;
+}
+
+/**
+ * @brief Maps the current table of the shard if it changed, lock must be held
+ */
+static int shard_sync(inoset_t *set, int s) {
+    inoset_shard_t *shard = &set->header->shards[s];
+    inoset_map_t *map = &set->maps[s];
+
+    if (map->slots != NULL && map->offset == shard->offset) return 0;
+
+    void *slots = mmap(NULL, shard->capacity * sizeof(inoset_slot_t),
+                       PROT_READ | PROT_WRITE, MAP_SHARED, set->fd,
+                       (off_t)shard->offset);
+    if (slots == MAP_FAILED) return -1;
+
+    if (map->slots != NULL) {
+        munmap(map->slots, map->capacity * sizeof(inoset_slot_t));
+    }
+    map->slots = (inoset_slot_t *)slots;
+    map->offset = shard->offset;
+    map->capacity = shard->capacity;
+    return 0;
+}
+
+/**
+ * @brief Reserves space at the end of the file for a table
+ */
+static int alloc_table(inoset_t *set, uint64_t capacity, uint64_t *offset) {
+    inoset_header_t *header = set->header;
+    uint64_t size = capacity * sizeof(inoset_slot_t);
+
+    int ret = pthread_mutex_lock(&header->alloc_lock);
+    if (ret == EOWNERDEAD) pthread_mutex_consistent(&header->alloc_lock);
+
+    *offset = header->file_end;
+    ret = ftruncate(set->fd, (off_t)(header->file_end + size));
+    if (ret == 0) header->file_end += size;
+
+    pthread_mutex_unlock(&header->alloc_lock);
+    return ret;
+}
+
+/**
+ * @brief Doubles the table of the shard, lock must be held
+ */
+static int shard_grow(inoset_t *set, int s) {
+    inoset_shard_t *shard = &set->header->shards[s];
+    inoset_map_t *map = &set->maps[s];
+    uint64_t capacity = shard->capacity * 2;
+    uint64_t offset;
+
+    if (alloc_table(set, capacity, &offset)) return -1;
+
+    inoset_slot_t *slots = (inoset_slot_t *)mmap(
+        NULL, capacity * sizeof(inoset_slot_t), PROT_READ | PROT_WRITE,
+        MAP_SHARED, set->fd, (off_t)offset);
+    if (slots == MAP_FAILED) return -1;
+
+    for (uint64_t i = 0; i < map->capacity; i++) {
+        inoset_slot_t *old = &map->slots[i];
+        if (old->dev == 0) continue;
+        uint64_t j = hash_pair(old->dev - 1, old->ino) & (capacity - 1);
+        while (slots[j].dev != 0) j = (j + 1) & (capacity - 1);
+        slots[j] = *old;
+    }
+
+    // Pages of the old table go back to the system, other processes still
+    // mapping it will remap before their next access
+    munmap(map->slots, map->capacity * sizeof(inoset_slot_t));
+    fallocate(set->fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE,
+              (off_t)shard->offset, (off_t)(map->capacity * sizeof(inoset_slot_t)));
+
+    shard->offset = offset;
+    shard->capacity = capacity;
+    map->slots = slots;
+    map->offset = offset;
+    map->capacity = capacity;
+    return 0;
+}
+
+inoset_t* inoset_create(int cloexec, int all) {
+    int fd = memfd_create("simpledu-inoset", cloexec ? MFD_CLOEXEC : 0);
+    if (fd == -1) return NULL;
+
+    if (ftruncate(fd, (off_t)header_size())) {
+        close(fd);
+        return NULL;
+    }
+
+    inoset_t *set = inoset_map_header(fd);
+    if (set == NULL) {
+        close(fd);
+        return NULL;
+    }
+
+    inoset_header_t *header = set->header;
+    header->file_end = set->header_size;
+    header->all = all;
+    if (init_mutex(&header->alloc_lock)) goto error;
+
+    for (int s = 0; s < INOSET_SHARDS; s++) {
+        inoset_shard_t *shard = &header->shards[s];
+        if (init_mutex(&shard->lock)) goto error;
+        shard->capacity = INOSET_INIT_SLOTS;
+        shard->count = 0;
+        if (alloc_table(set, shard->capacity, &shard->offset)) goto error;
+    }
+    header->magic = INOSET_MAGIC;
+
+    return set;
+
+error:
+    inoset_destroy(set);
+    return NULL;
+}
+
+inoset_t* inoset_attach(int fd) {
+    inoset_t *set = inoset_map_header(fd);
+    if (set == NULL) return NULL;
+
+    if (set->header->magic != INOSET_MAGIC) {
+        munmap(set->header, set->header_size);
+        free(set);
+        errno = EINVAL;
+        return NULL;
+    }
+    return set;
+}
+
+int inoset_fd(inoset_t *set) { return set->fd; }
+
+int inoset_all(const inoset_t *set) { return set->header->all; }
+
+int inoset_insert(inoset_t *set, dev_t dev, ino_t ino) {
+    uint64_t hash = hash_pair(dev, ino);
+    int s = (int)(hash >> (64 - INOSET_SHARD_BITS));
+    inoset_shard_t *shard = &set->header->shards[s];
+    inoset_map_t *map = &set->maps[s];
+
+    if (shard_lock(shard)) return -1;
+    if (shard_sync(set, s)) {
+        pthread_mutex_unlock(&shard->lock);
+        return -1;
+    }
+
+    uint64_t mask = map->capacity - 1;
+    uint64_t i = hash & mask;
+    int ret;
+    while (1) {
+        inoset_slot_t *slot = &map->slots[i];
+        if (slot->dev == 0) {
+            slot->ino = ino;
+            slot->dev = (uint64_t)dev + 1;
+            shard->count++;
+            ret = 1;
+            // Load factor kept under 1/2
+            if (shard->count * 2 > map->capacity && shard_grow(set, s)) {
+                ret = -1;
+            }
+            break;
+        }
+        if (slot->dev == (uint64_t)dev + 1 && slot->ino == ino) {
+            ret = 0;
+            break;
+        }
+        i = (i + 1) & mask;
+    }
+
+    pthread_mutex_unlock(&shard->lock);
+    return ret;
+}
+
+int inoset_seen(inoset_t *set, const struct stat *status) {
+    if (!set->header->all &&
+        (S_ISDIR(status->st_mode) || status->st_nlink < 2)) {
+        return 0;
+    }
+    int ret = inoset_insert(set, status->st_dev, status->st_ino);
+    return (ret == -1) ? -1 : !ret;
+}
+
+void inoset_usage(inoset_t *set, long *count, long *bytes) {
+    *count = 0;
+    *bytes = (long)set->header_size;
+    for (int s = 0; s < INOSET_SHARDS; s++) {
+        inoset_shard_t *shard = &set->header->shards[s];
+        *count += (long)shard->count;
+        *bytes += (long)(shard->capacity * sizeof(inoset_slot_t));
+    }
+}
+
+void inoset_destroy(inoset_t *set) {
+    if (set == NULL) return;
+    for (int s = 0; s < INOSET_SHARDS; s++) {
+        if (set->maps[s].slots != NULL) {
+            munmap(set->maps[s].slots,
+                   set->maps[s].capacity * sizeof(inoset_slot_t));
+        }
+    }
+    munmap(set->header, set->header_size);
+    close(set->fd);
+    free(set);
+}
@@ -6,34 +6,419 @@
 
 /* SYSTEM CALLS HEADERS */
 #include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
+#include <sys/eventfd.h>
+#include <sys/stat.h>
 #include <sys/time.h>
+#include <sys/uio.h>
 #include <unistd.h>
 
 /* C LIBRARY HEADERS */
 #include <errno.h>
+#include <stdatomic.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
+
+#define RING_RECORDS    1024    /** @brief Records of the buffer of a thread */
+#define DIRECT_RECORDS  16      /** @brief Records written at once without malloc */
+#define WRITER_WAIT_MS  100     /** @brief Longest time a record stays buffered */
+
+#define WRITER_NONE     0
+#define WRITER_RUNNING  1
+#define WRITER_STOPPING 2
+
+_Static_assert(sizeof(log_record_t) == LOG_RECORD_SIZE, "log record size");
+_Static_assert(sizeof(log_header_t) == LOG_RECORD_SIZE, "log header size");
+
+const char *const log_action_names[LOG_ACTIONS] = {
+    "CREATE", "EXIT", "RECV_SIGNAL", "SEND_SIGNAL",
+    "RECV_PIPE", "SEND_PIPE", "ENTRY"};
 
 struct timeval init_time;
 int file_log;
 
-int init_log() {
-    if (getenv("LOG_FILENAME") != NULL) {  // Write log to LOG_FILENAME
-        struct stat st;
-        if (stat("./log", &st) == -1) {
-            mkdir("./log", 0700);
+/**
+ * @brief Records of one thread, the thread only moves head and the one
+ *        holding draining only moves tail
+ */
+typedef struct log_ring {
+    log_record_t       *records;
+    atomic_size_t       head;
+    atomic_size_t       tail;
+    atomic_flag         draining;
+    atomic_int          notified;   // writer woken since it was half full
+    struct log_ring    *next;
+} log_ring_t;
+
+static int log_binary = 0;
+static atomic_int log_direct = 0;   // every record is written at once
+static int log_ppid;
+
+static _Atomic(log_ring_t *) rings = NULL;
+static _Thread_local log_ring_t *thread_ring = NULL;
+static pthread_mutex_t rings_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static pthread_t writer;
+static atomic_int writer_state = WRITER_NONE;
+static int writer_fd = -1;          // eventfd waking the writer
+
+static int64_t instant_usec(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    return (int64_t)(now.tv_sec - init_time.tv_sec) * 1000000 +
+           now.tv_nsec / 1000 - init_time.tv_usec;
+}
+
+static int write_all(const char *data, size_t len) {
+    while (len > 0) {
+        ssize_t n = write(file_log, data, len);
+        if (n == -1) {
+            if (errno == EINTR) continue;
+            return 1;
+        }
+        data += n;
+        len -= n;
+    }
+    return 0;
+}
+
+/**
+ * @brief Writes the records of the ring, async signal safe
+ * @param wait  Waits for another thread writing the ring instead of
+ *              leaving the records to it
+ */
+static int drain_ring(log_ring_t *ring, int wait) {
+    while (atomic_flag_test_and_set_explicit(&ring->draining,
+                                             memory_order_acquire)) {
+        if (!wait) return 0;
+        sched_yield();
+    }
+
+    size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    size_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    int ret = 0;
+
+    if (head != tail) {
+        // At most two pieces, a single writev so that the records of a
+        // process never get between the ones of another
+        size_t start = tail % RING_RECORDS, count = head - tail;
+        size_t first = RING_RECORDS - start < count ? RING_RECORDS - start
+                                                     : count;
+        struct iovec iov[2] = {
+            {ring->records + start, first * LOG_RECORD_SIZE},
+            {ring->records, (count - first) * LOG_RECORD_SIZE}};
+        ssize_t n;
+        do {
+            n = writev(file_log, iov, count > first ? 2 : 1);
+        } while (n == -1 && errno == EINTR);
+
+        size_t total = count * LOG_RECORD_SIZE;
+        if (n == -1) {
+            ret = 1;
+        } else if ((size_t)n < total) {
+            // Only on a full disk or a broken file, write the rest in order
+            size_t done = n;
+            if (done < iov[0].iov_len) {
+                ret = write_all((char *)iov[0].iov_base + done,
+                                iov[0].iov_len - done);
+                done = iov[0].iov_len;
+            }
+            if (ret == 0) {
+                ret = write_all((char *)iov[1].iov_base +
+                                    (done - iov[0].iov_len),
+                                total - done);
+            }
+        }
+        atomic_store_explicit(&ring->tail, head, memory_order_release);
+    }
+
+    atomic_store_explicit(&ring->notified, 0, memory_order_relaxed);
+    atomic_flag_clear_explicit(&ring->draining, memory_order_release);
+    return ret;
+}
+
+static int drain_rings(int wait) {
+    int ret = 0;
+    for (log_ring_t *ring = atomic_load(&rings); ring != NULL;
+         ring = ring->next) {
+        ret |= drain_ring(ring, wait);
+    }
+    return ret;
+}
+
+static void *log_writer(void *arg) {
+    (void)arg;
+    struct pollfd wake = {writer_fd, POLLIN, 0};
+    uint64_t events;
+
+    while (atomic_load(&writer_state) == WRITER_RUNNING) {
+        if (poll(&wake, 1, WRITER_WAIT_MS) == 1) {
+            while (read(writer_fd, &events, sizeof(events)) == -1 &&
+                   errno == EINTR) {
+            }
         }
-        char file_path[256];
-        sprintf(file_path, "./log/%s", getenv("LOG_FILENAME"));
-        file_log = open(file_path, O_WRONLY | O_CREAT | O_TRUNC, DEFAULT_MODE);
-    } else {  // Write log to a pre defined file
+        drain_rings(0);
+    }
+    return NULL;
+}
+
+/**
+ * @brief Wakes the writer, started the first time a buffer is half full so
+ *        processes with few records never have it
+ */
+static void wake_writer(void) {
+    if (atomic_load(&writer_state) == WRITER_NONE) {
+        pthread_mutex_lock(&rings_lock);
+        if (atomic_load(&writer_state) == WRITER_NONE && !log_direct &&
+            (writer_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) != -1) {
+            // Signals are handled by the other threads
+            sigset_t all, old;
+            sigfillset(&all);
+            pthread_sigmask(SIG_SETMASK, &all, &old);
+            atomic_store(&writer_state, WRITER_RUNNING);
+            if (pthread_create(&writer, NULL, log_writer, NULL)) {
+                atomic_store(&writer_state, WRITER_NONE);
+                close(writer_fd);
+                writer_fd = -1;
+            }
+            pthread_sigmask(SIG_SETMASK, &old, NULL);
+        }
+        pthread_mutex_unlock(&rings_lock);
+        return;
+    }
+    uint64_t one = 1;
+    write(writer_fd, &one, sizeof(one));
+}
+
+static log_ring_t *ring_create(void) {
+    log_ring_t *ring = (log_ring_t *)calloc(1, sizeof(log_ring_t));
+    if (ring == NULL) return NULL;
+    ring->records =
+        (log_record_t *)calloc(RING_RECORDS, sizeof(log_record_t));
+    if (ring->records == NULL) {
+        free(ring);
+        return NULL;
+    }
+    atomic_init(&ring->head, 0);
+    atomic_init(&ring->tail, 0);
+    atomic_flag_clear(&ring->draining);
+    atomic_init(&ring->notified, 0);
+
+    pthread_mutex_lock(&rings_lock);
+    ring->next = atomic_load(&rings);
+    atomic_store(&rings, ring);
+    pthread_mutex_unlock(&rings_lock);
+    return ring;
+}
+
+/**
+ * @brief Copies the text of the record at index, going on in the next records
+ */
+static void ring_copy_text(log_ring_t *ring, size_t index, const char *text,
+                           size_t len) {
+    char *dest = ring->records[index % RING_RECORDS].text;
+    size_t room = LOG_RECORD_TEXT;
+
+    while (len > 0) {
+        size_t n = len < room ? len : room;
+        memcpy(dest, text, n);
+        text += n;
+        len -= n;
+        dest = (char *)&ring->records[++index % RING_RECORDS];
+        room = LOG_RECORD_SIZE;
+    }
+}
+
+/**
+ * @brief Writes a record and its text at once, async signal safe when the
+ *        text fits in DIRECT_RECORDS records
+ */
+static int record_direct(const log_record_t *record, const void *text) {
+    size_t count = log_record_count(record->length);
+    log_record_t small[DIRECT_RECORDS];
+    log_record_t *group = small;
+
+    if (count > DIRECT_RECORDS &&
+        (group = (log_record_t *)malloc(count * LOG_RECORD_SIZE)) == NULL) {
+        return 1;
+    }
+    memset(group, 0, count * LOG_RECORD_SIZE);
+    memcpy(group, record, offsetof(log_record_t, text));
+    if (record->length > 0) memcpy(group[0].text, text, record->length);
+
+    int ret = write_all((const char *)group, count * LOG_RECORD_SIZE);
+    if (group != small) free(group);
+    return ret;
+}
+
+/**
+ * @brief Adds a record to the buffer of the thread
+ */
+static int record_push(const log_record_t *record, const void *text) {
+    size_t count = log_record_count(record->length);
+    log_ring_t *ring = thread_ring;
+
+    if (atomic_load_explicit(&log_direct, memory_order_relaxed) ||
+        count > RING_RECORDS / 2) {
+        return record_direct(record, text);
+    }
+    if (ring == NULL && (ring = thread_ring = ring_create()) == NULL) {
+        return record_direct(record, text);
+    }
+
+    size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    int ret = 0;
+    while (head + count -
+               atomic_load_explicit(&ring->tail, memory_order_acquire) >
+           RING_RECORDS) {
+        ret |= drain_ring(ring, 1);
+    }
+
+    // The text of record isn't set
+    memcpy(&ring->records[head % RING_RECORDS], record,
+           offsetof(log_record_t, text));
+    ring_copy_text(ring, head, (const char *)text, record->length);
+    atomic_store_explicit(&ring->head, head + count, memory_order_release);
+
+    if (head + count - atomic_load_explicit(&ring->tail,
+                                            memory_order_relaxed) >=
+            RING_RECORDS / 2 &&
+        !atomic_exchange_explicit(&ring->notified, 1, memory_order_relaxed)) {
+        wake_writer();
+    }
+    return ret;
+}
+
+static int log_record(log_action_t action, log_kind_t kind, int64_t value,
+                      const void *text, size_t len, int direct) {
+    log_record_t record;
+    record.instant = instant_usec();
+    record.value = value;
+    record.pid = log_ppid;
+    record.length = len;
+    record.action = action;
+    record.kind = kind;
+    return direct ? record_direct(&record, text) : record_push(&record, text);
+}
+
+static int action_of(const char *name) {
+    for (int action = 0; action < LOG_ACTIONS; action++) {
+        if (strcmp(log_action_names[action], name) == 0) return action;
+    }
+    return -1;
+}
+
+/**
+ * @brief Nothing buffered is copied to a child of fork, which only writes
+ *        at once until execv
+ */
+static void log_atfork_child(void) {
+    pthread_mutex_init(&rings_lock, NULL);
+    atomic_store(&writer_state, WRITER_NONE);
+    writer_fd = -1;
+    atomic_store(&log_direct, 1);
+    log_ppid = getppid();
+    for (log_ring_t *ring = atomic_load(&rings); ring != NULL;
+         ring = ring->next) {
+        atomic_store(&ring->tail, atomic_load(&ring->head));
+        atomic_flag_clear(&ring->draining);
+    }
+}
+
+static void log_shutdown(void) {
+    if (atomic_load(&writer_state) == WRITER_RUNNING) {
+        uint64_t one = 1;
+        atomic_store(&writer_state, WRITER_STOPPING);
+        write(writer_fd, &one, sizeof(one));
+        pthread_join(writer, NULL);
+        close(writer_fd);
+        writer_fd = -1;
+        atomic_store(&writer_state, WRITER_NONE);
+    }
+    // Records logged from now on (EXIT) are written at once
+    atomic_store(&log_direct, 1);
+    if (drain_rings(1)) {
+        write(STDERR_FILENO, "error upon writing log\n", 23);
+    }
+}
+
+/**
+ * @brief Chooses the format of the log of this process
+ */
+static int log_start(void) {
+    const char *format = getenv("LOG_FORMAT");
+    log_binary = (format == NULL || strcmp(format, "text") != 0);
+    if (!log_binary) return 0;
+
+    log_ppid = getppid();
+    if (pthread_atfork(NULL, NULL, log_atfork_child) || atexit(log_shutdown)) {
+        atomic_store(&log_direct, 1);
+        return 1;
+    }
+    return 0;
+}
+
+int log_path(char *path, size_t size, int binary, int create) {
+    const char *name = getenv("LOG_FILENAME");
+    if (name != NULL && strchr(name, '/') != NULL) {
+        int n = snprintf(path, size, "%s", name);
+        if (n < 0 || (size_t)n >= size) {
+            errno = ENAMETOOLONG;
+            return -1;
+        }
+        return 0;
+    }
+    if (name == NULL) name = binary ? "log.bin" : "log.txt";
+
+    // Never the working directory, which may be the tree being measured
+    const char *state = getenv("XDG_STATE_HOME");
+    int n;
+    if (state != NULL && state[0] == '/') {
+        if (create) mkdir(state, 0700);
+        n = snprintf(path, size, "%s/simpledu", state);
+    } else {
+        n = snprintf(path, size, "/tmp/simpledu-%u", (unsigned)getuid());
+    }
+    if (n < 0 || (size_t)n >= size) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+
+    if (create) {
+        // Anyone may create it first in /tmp
         struct stat st;
-        if (stat("./log", &st) == -1) {
-            mkdir("./log", 0700);
+        if (mkdir(path, 0700) == -1 && errno != EEXIST) return -1;
+        if (lstat(path, &st) == -1) return -1;
+        if (!S_ISDIR(st.st_mode) || st.st_uid != getuid()) {
+            errno = EACCES;
+            return -1;
         }
-        file_log =
-            open("./log/log.txt", O_WRONLY | O_CREAT | O_TRUNC, DEFAULT_MODE);
+    }
+
+    int len = snprintf(path + n, size - n, "/%s", name);
+    if (len < 0 || (size_t)len >= size - n) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    return 0;
+}
+
+int init_log() {
+    log_start();
+
+    char file_path[LOG_PATH_SIZE];
+    if (log_path(file_path, sizeof(file_path), log_binary, 1) == 0) {
+        // Processes of a binary log append whole batches of records
+        int append = log_binary ? O_APPEND : 0;
+        file_log = open(file_path, O_WRONLY | O_CREAT | O_TRUNC | append,
+                        DEFAULT_MODE);
+    } else {
+        file_log = -1;
     }
 
     if (file_log == -1) {  // Test if file is open
@@ -41,6 +426,18 @@ int init_log() {
         return 1;
     }
 
+    if (log_binary) {
+        log_header_t header;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, LOG_MAGIC, sizeof(header.magic));
+        header.version = LOG_VERSION;
+        header.record_size = LOG_RECORD_SIZE;
+        header.init_sec = init_time.tv_sec;
+        header.init_usec = init_time.tv_usec;
+        write(file_log, &header, sizeof(header));
+        return file_log;
+    }
+
     // Write the first line of log
     char buffer[256];
     sprintf(buffer, "%12s\t%15s\t%15s\t%s\n", "Instant", "PID", "Action",
@@ -50,7 +447,10 @@ int init_log() {
     return file_log;
 }
 
-void set_log_descriptor(int descriptor) { file_log = descriptor; }
+void set_log_descriptor(int descriptor) {
+    file_log = descriptor;
+    log_start();
+}
 
 void set_time(struct timeval* it) { init_time = *it; }
 
@@ -62,17 +462,63 @@ long double elapsed_time() {
 }
 
 int write_log(char* log_action, char* log_info) {
-    char buffer[256];
-    sprintf(buffer, "%10.2Lf\t%15d\t%15s\t%s", elapsed_time(), getppid(),
-            log_action, log_info);
+    if (log_binary) {
+        int action = action_of(log_action);
+        return action == -1 || log_record(action, LOG_INFO_TEXT, 0, log_info,
+                                          strlen(log_info), 1);
+    }
 
-    if (write(file_log, buffer, strlen(buffer)) == -1) {
-        return 1;
+    char small[256];
+    char* buffer = small;
+    long double instant = elapsed_time();
+    int ppid = getppid();
+    int len = snprintf(small, sizeof(small), "%10.2Lf\t%15d\t%15s\t%s",
+                       instant, ppid, log_action, log_info);
+
+    // Info may hold a path of any length
+    if (len >= (int)sizeof(small)) {
+        if ((buffer = malloc(len + 1)) == NULL) return 1;
+        snprintf(buffer, len + 1, "%10.2Lf\t%15d\t%15s\t%s", instant, ppid,
+                 log_action, log_info);
     }
-    return 0;
+
+    int ret = (write(file_log, buffer, len) == -1);
+    if (buffer != small) free(buffer);
+    return ret;
+}
+
+int write_log_entry(long size, const char* path) {
+    if (log_binary) {
+        return log_record(LOG_ENTRY, LOG_INFO_ENTRY, size, path, strlen(path),
+                          0);
+    }
+
+    char small[256];
+    char* buffer = small;
+    long double instant = elapsed_time();
+    int ppid = getppid();
+    int len = snprintf(small, sizeof(small), "%10.2Lf\t%15d\t%15s\t%ld\x9%s\n",
+                       instant, ppid, "ENTRY", size, path);
+
+    if (len >= (int)sizeof(small)) {
+        if ((buffer = malloc(len + 1)) == NULL) return 1;
+        snprintf(buffer, len + 1, "%10.2Lf\t%15d\t%15s\t%ld\x9%s\n", instant,
+                 ppid, "ENTRY", size, path);
+    }
+
+    int ret = (write(file_log, buffer, len) == -1);
+    if (buffer != small) free(buffer);
+    return ret;
 }
 
 int write_log_timeval(char* log_action, struct timeval log_info) {
+    if (log_binary) {
+        int action = action_of(log_action);
+        int64_t tv[2] = {log_info.tv_sec, log_info.tv_usec};
+        return action == -1 || log_record(action, LOG_INFO_TIMEVAL, 0, tv,
+                                          sizeof(tv), 0);
+    }
+
     char buffer[256];
     sprintf(buffer, "%10.2Lf\t%15d\t%15s\t%ld%ld\n", elapsed_time(), getppid(),
             log_action, log_info.tv_sec, log_info.tv_usec);
@@ -84,25 +530,36 @@ int write_log_timeval(char* log_action, struct timeval log_info) {
 }
 
 int write_log_array(char* log_action, int* info, int size) {
-    char to_char[256];
-    char* log_info = malloc(256);
-    for (int i = 0; i < size; i++) {
-        sprintf(to_char, "%d", info[i]);
-        strncat(log_info, to_char, 256 - 1);
+    if (log_binary) {
+        int action = action_of(log_action);
+        return action == -1 || log_record(action, LOG_INFO_ARRAY, 0, info,
+                                          sizeof(int) * size, 0);
     }
 
-    char buffer[256];
-    sprintf(buffer, "%10.2Lf\t%15d\t%15s\t%s\n", elapsed_time(), getppid(),
-            log_action, log_info);
+    char log_info[256];
+    size_t len = 0;
+    log_info[0] = 0;
+    for (int i = 0; i < size && len < sizeof(log_info) - 1; i++) {
+        len += snprintf(log_info + len, sizeof(log_info) - len, "%d",
+                        info[i]);
+    }
+
+    char buffer[sizeof(log_info) + 64];
+    snprintf(buffer, sizeof(buffer), "%10.2Lf\t%15d\t%15s\t%s\n",
+             elapsed_time(), getppid(), log_action, log_info);
     if (write(file_log, buffer, strlen(buffer)) == -1) {
-        free(log_info);
         return 1;
     }
-    free(log_info);
     return 0;
 }
 
 int write_log_long(char* log_action, long log_info) {
+    if (log_binary) {
+        int action = action_of(log_action);
+        return action == -1 ||
+               log_record(action, LOG_INFO_LONG, log_info, NULL, 0, 0);
+    }
+
     char buffer[256];
     sprintf(buffer, "%10.2Lf\t%15d\t%15s\t%ld\n", elapsed_time(), getppid(),
             log_action, log_info);
@@ -114,6 +571,14 @@ int write_log_long(char* log_action, long log_info) {
 }
 
 int write_log_double(char* log_action, double log_info) {
+    if (log_binary) {
+        int action = action_of(log_action);
+        int64_t bits;
+        memcpy(&bits, &log_info, sizeof(bits));
+        return action == -1 ||
+               log_record(action, LOG_INFO_DOUBLE, bits, NULL, 0, 0);
+    }
+
     char buffer[256];
     sprintf(buffer, "%10.2Lf\t%15d\t%15s\t%f\n", elapsed_time(), getppid(),
             log_action, log_info);
@@ -125,6 +590,12 @@ int write_log_double(char* log_action, double log_info) {
 }
 
 int write_log_sign(char* log_action, char* log_info, int pid) {
+    if (log_binary) {
+        int action = action_of(log_action);
+        return action == -1 || log_record(action, LOG_INFO_SIGNAL, pid,
+                                          log_info, strlen(log_info), 1);
+    }
+
     char buffer[256];
     sprintf(buffer, "%10.2Lf\t%15d\t%15s\t%s %d\n", elapsed_time(), getppid(),
             log_action, log_info, pid);
@@ -135,6 +606,11 @@ int write_log_sign(char* log_action, char* log_info, int pid) {
     return 0;
 }
 
+int flush_log(void) {
+    if (!log_binary) return 0;
+    return drain_rings(0);
+}
+
 int close_log() {
     if (close(file_log) != 0) {
         return 1;
@@ -0,0 +1,173 @@
+/* MAIN HEADER */
+
+/* INCLUDE HEADERS */
+#include "log.h"
+
+/* SYSTEM CALLS HEADERS */
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/* C LIBRARY HEADERS */
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * @brief First record of a group (record and its text)
+ */
+typedef struct group {
+    int64_t     instant;
+    size_t      index;
+} group_t;
+
+/**
+ * @brief Processes and threads write their records in batches, sorting by
+ *        instant (then by position) gives back the order they were logged
+ */
+static int compare_groups(const void *a, const void *b) {
+    const group_t *ga = (const group_t *)a, *gb = (const group_t *)b;
+    if (ga->instant != gb->instant) return ga->instant < gb->instant ? -1 : 1;
+    return ga->index < gb->index ? -1 : (ga->index > gb->index);
+}
+
+/**
+ * @brief Prints a record the same way the text log does
+ */
+static void print_record(const log_record_t *record) {
+    const char *text = record->text;
+    long double instant = record->instant / 1000.0L;
+
+    printf("%10.2Lf\t%15d\t%15s\t", instant, record->pid,
+           log_action_names[record->action]);
+
+    switch (record->kind) {
+        case LOG_INFO_TEXT:
+            fwrite(text, 1, record->length, stdout);
+            break;
+        case LOG_INFO_LONG:
+            printf("%ld\n", (long)record->value);
+            break;
+        case LOG_INFO_DOUBLE: {
+            double value;
+            memcpy(&value, &record->value, sizeof(value));
+            printf("%f\n", value);
+        } break;
+        case LOG_INFO_ARRAY:
+            for (size_t i = 0; i + sizeof(int) <= record->length;
+                 i += sizeof(int)) {
+                int value;
+                memcpy(&value, text + i, sizeof(value));
+                printf("%d", value);
+            }
+            putchar('\n');
+            break;
+        case LOG_INFO_TIMEVAL: {
+            int64_t tv[2];
+            memcpy(tv, text, sizeof(tv));
+            printf("%ld%ld\n", (long)tv[0], (long)tv[1]);
+        } break;
+        case LOG_INFO_SIGNAL:
+            printf("%.*s %d\n", (int)record->length, text, (int)record->value);
+            break;
+        case LOG_INFO_ENTRY:
+            printf("%ld\t%.*s\n", (long)record->value, (int)record->length,
+                   text);
+            break;
+        default:
+            putchar('\n');
+            break;
+    }
+}
+
+static char *read_file(const char *path, size_t *size) {
+    int fd = open(path, O_RDONLY);
+    if (fd == -1) return NULL;
+
+    struct stat status;
+    char *data = NULL;
+    if (fstat(fd, &status) == 0 &&
+        (data = (char *)malloc(status.st_size + 1)) != NULL) {
+        size_t done = 0;
+        while (done < (size_t)status.st_size) {
+            ssize_t n = read(fd, data + done, status.st_size - done);
+            if (n == -1 && errno == EINTR) continue;
+            if (n <= 0) break;
+            done += n;
+        }
+        *size = done;
+    }
+    close(fd);
+    return data;
+}
+
+int main(int argc, char *argv[]) {
+    char path[LOG_PATH_SIZE];
+
+    if (argc > 2) {
+        fprintf(stderr, "usage: %s [log file]\n", argv[0]);
+        return 1;
+    }
+    if (argc == 2) {
+        snprintf(path, sizeof(path), "%s", argv[1]);
+    } else if (log_path(path, sizeof(path), 1, 0)) {
+        fprintf(stderr, "simpledu-logdump: %s\n", strerror(errno));
+        return 1;
+    }
+
+    size_t size = 0;
+    char *data = read_file(path, &size);
+    if (data == NULL) {
+        fprintf(stderr, "simpledu-logdump: %s: %s\n", path, strerror(errno));
+        return 1;
+    }
+
+    const log_header_t *header = (const log_header_t *)data;
+    if (size < sizeof(log_header_t) ||
+        memcmp(header->magic, LOG_MAGIC, sizeof(header->magic)) != 0 ||
+        header->version != LOG_VERSION ||
+        header->record_size != LOG_RECORD_SIZE) {
+        fprintf(stderr,
+                "simpledu-logdump: %s: not a binary log (LOG_FORMAT=text "
+                "logs are already text)\n",
+                path);
+        free(data);
+        return 1;
+    }
+
+    const log_record_t *records = (const log_record_t *)(header + 1);
+    size_t nrecords = (size - sizeof(log_header_t)) / LOG_RECORD_SIZE;
+    group_t *groups = (group_t *)malloc(sizeof(group_t) * (nrecords + 1));
+    if (groups == NULL) {
+        fprintf(stderr, "simpledu-logdump: malloc error\n");
+        free(data);
+        return 1;
+    }
+
+    size_t ngroups = 0;
+    int damaged = 0;
+    for (size_t i = 0; i < nrecords;) {
+        size_t count = log_record_count(records[i].length);
+        if (records[i].action >= LOG_ACTIONS || i + count > nrecords) {
+            damaged = 1;
+            break;
+        }
+        groups[ngroups].instant = records[i].instant;
+        groups[ngroups].index = i;
+        ngroups++;
+        i += count;
+    }
+    qsort(groups, ngroups, sizeof(group_t), compare_groups);
+
+    printf("%12s\t%15s\t%15s\t%s\n", "Instant", "PID", "Action", "Info");
+    for (size_t g = 0; g < ngroups; g++) print_record(&records[groups[g].index]);
+
+    if (damaged) {
+        fprintf(stderr, "simpledu-logdump: %s: damaged record, stopped\n",
+                path);
+    }
+    free(groups);
+    free(data);
+    return damaged;
+}
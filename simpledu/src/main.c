@@ -1,12 +1,31 @@
 /* MAIN HEADER */
 
 /* INCLUDE HEADERS */
+#include "arena.h"
+#include "cache.h"
+#include "checkpoint.h"
+#include "dirscan.h"
+#include "estimate.h"
+#include "exclude.h"
+#include "index.h"
+#include "inoset.h"
 #include "log.h"
+#include "mounts.h"
+#include "outbuf.h"
 #include "parse.h"
+#include "progress.h"
 #include "sig_handler.h"
+#include "sink.h"
+#include "stats.h"
+#include "topn.h"
+#include "traverse.h"
 #include "utils.h"
+#include "watch.h"
 
 /* SYSTEM CALLS  HEADERS */
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/pidfd.h>
 #include <sys/stat.h>
 #include <sys/time.h>
 #include <sys/types.h>
@@ -16,22 +35,1221 @@
 /* C LIBRARY HEADERS */
 #include <dirent.h>
 #include <errno.h>
+#include <limits.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
 #define BUFFER_SIZE 256
 #define READ_PIPE 0
 #define WRITE_PIPE 1
 #define LOG_FILE 2
+#define INODE_SET 3
+#define TOKENS_READ 4
+#define TOKENS_WRITE 5
+#define PROGRESS_FILE 6
+#define STD_FDS 7           // descriptors sent to a subprocess
+#define SUBPROCESS_ENV "SIMPLEDU_PARENT"    // pid of the parent, set for a subprocess
+#define DIFF_TOP 20         // changes printed by simpledu diff without --top
 
 int exit_status = 0;
+// Pipe of --jobs shared by every process, one byte for each subprocess that
+// may run besides the first one of each directory, -1 if none
+int job_tokens[2] = {-1, -1};
 
 int error_sys(char *error_msg) {
     char error[BUFFER_SIZE];
     sprintf(error, "simpledu: %s", error_msg);
     perror(error);
-    return errno;
+    int error_num = errno;
+    stats_count(STATS_ERRORS, 1);
+    return error_num;
+}
+
+void log_entry(long size, const char *path) {
+    uint64_t begin = stats_clock();
+    if (write_log_entry(size, path)) {
+        write(STDERR_FILENO, "error upon writing log\n", 23);
+    }
+    stats_time(STATS_LOG, begin);
+}
+
+// The process mode only writes text, other formats use the thread mode
+void print_entry(long size, const char *path) {
+    log_entry(size, path);
+    if (outbuf_entry(outbuf_stdout(), size, path)) {
+        error_sys("write error");
+    }
+}
+
+/**
+ * @brief Reads exactly size bytes from a pipe
+ * @return 0 upon success, -1 otherwise
+ */
+int read_full(int fd, void *data, size_t size) {
+    size_t done = 0;
+    while (done < size) {
+        ssize_t n = read(fd, (char *)data + done, size - done);
+        if (n == -1 && errno == EINTR) continue;
+        if (n <= 0) return -1;
+        done += n;
+    }
+    return 0;
+}
+
+/**
+ * @brief Counts an entry read for --stats, directories count themselves in
+ *        their own process
+ */
+void stats_status(const struct stat *status) {
+    stats_entry(S_ISDIR(status->st_mode)   ? STATS_DIRS
+                : S_ISLNK(status->st_mode) ? STATS_SYMLINKS
+                                           : STATS_FILES,
+                status->st_size);
+}
+
+/**
+ * @brief Counts the entry unless it is a hard link to an inode already counted,
+ *        or any entry already counted if the set keeps every one
+ */
+int count_entry(inoset_t *inodes, const struct stat *status) {
+    if (inodes == NULL) return 1;
+    int seen = inoset_seen(inodes, status);
+    if (seen == -1) error_sys("inode set error");
+    return seen != 1;
+}
+
+void print_inode_stats(inoset_t *inodes) {
+    long count, bytes;
+    inoset_usage(inodes, &count, &bytes);
+    fprintf(stderr,
+            "simpledu: %ld inodes with several links tracked, %ld bytes, "
+            "%.1f bytes per inode\n",
+            count, bytes, count ? (double)bytes / count : 0.0);
+}
+
+/**
+ * @brief Runs this program again, the subprocess reads its descriptors from
+ *        the pipe given as its stdin and gives back its size through the one
+ *        given as its stdout. It knows it is one by SUBPROCESS_ENV, pipes
+ *        alone may be the ones of a shell
+ * @param out_fd    Descriptor where the subprocess writes its lines
+ * @param pgid      Process group of the subprocess, 0 for a new one and -1
+ *                  keeps this one
+ * @param result_fd Filled with the pipe where the subprocess writes its size
+ * @return Pid of the subprocess, -1 upon error
+ */
+pid_t spawn_subprocess(char *argv0, char **new_argv, int out_fd,
+                       int log_file_fd, inoset_t *inodes,
+                       struct timeval *init_time, pid_t pgid, int *result_fd) {
+    int pipe_ctosp[2];  // Pipe child to subprocess
+    int pipe_ctop[2];   // Pipe child to parent
+
+    uint64_t begin = stats_clock();
+    if (pipe(pipe_ctosp) || pipe(pipe_ctop)) {
+        exit_status = error_sys("pipe error");
+        return -1;
+    }
+
+    pid_t pid = fork();
+    if (pid == -1) {
+        exit_status = error_sys("fork error");
+        return -1;
+    }
+    if (pid > 0) {  // Pai
+        stats_time(STATS_FORK, begin);
+        if (close(pipe_ctop[WRITE_PIPE]) || close(pipe_ctosp[WRITE_PIPE]) ||
+            close(pipe_ctosp[READ_PIPE])) {
+            exit_status = error_sys("close error upon closing pipe");
+            return -1;
+        }
+        // Not inherited by the next subprocesses, which may run while this
+        // one does
+        fcntl(pipe_ctop[READ_PIPE], F_SETFD, FD_CLOEXEC);
+        *result_fd = pipe_ctop[READ_PIPE];
+        return pid;
+    }
+
+    // Filho
+    int std[STD_FDS];
+    if (pgid != -1) setpgid(0, pgid);
+    if ((std[READ_PIPE] = dup(STDIN_FILENO)) == -1 ||
+        (std[WRITE_PIPE] = dup(out_fd)) == -1) {
+        exit_status =
+            error_sys("dup error upon copying stdin and stdout descriptors");
+        exit(exit_status);
+    }
+    if ((std[LOG_FILE] = dup(log_file_fd)) == -1) {
+        exit_status = error_sys("dup error upon copying log_file_fd");
+        exit(exit_status);
+    }
+    std[INODE_SET] = inodes ? inoset_fd(inodes) : -1;
+    std[TOKENS_READ] = job_tokens[READ_PIPE];
+    std[TOKENS_WRITE] = job_tokens[WRITE_PIPE];
+    std[PROGRESS_FILE] = progress_fd();
+    if (write(pipe_ctosp[WRITE_PIPE], std, sizeof(int) * STD_FDS) == -1 ||
+        write(pipe_ctosp[WRITE_PIPE], init_time, sizeof(*init_time)) == -1) {
+        exit_status = error_sys("write error to subprocess connection pipe");
+        exit(exit_status);
+    }
+    // write log  of std
+    if (write_log_array("SEND_PIPE", std, STD_FDS) ||
+        write_log_timeval("SEND_PIPE", *init_time)) {
+        write(STDERR_FILENO, "error upon writing log\n", 23);
+    }
+    if (close(pipe_ctop[READ_PIPE]) || close(pipe_ctosp[WRITE_PIPE])) {
+        exit_status = error_sys("close error upon closing pipe");
+        exit(exit_status);
+    }
+    if (dup2(pipe_ctop[WRITE_PIPE], STDOUT_FILENO) == -1 ||
+        dup2(pipe_ctosp[READ_PIPE], STDIN_FILENO) == -1) {
+        exit_status = error_sys(
+            "dup2 error upon redefining descriptors pointed by stdin and "
+            "stdout");
+        exit(exit_status);
+    }
+    if (close(pipe_ctop[WRITE_PIPE]) || close(pipe_ctosp[READ_PIPE])) {
+        exit_status = error_sys("close error upon closing pipe");
+        exit(exit_status);
+    }
+
+    char parent[32];
+    snprintf(parent, sizeof(parent), "%ld", (long)getppid());
+    if (setenv(SUBPROCESS_ENV, parent, 1)) {
+        exit_status = error_sys("setenv error");
+        exit(exit_status);
+    }
+
+    execv(argv0, new_argv);
+    exit_status = error_sys("execv error");
+    exit(exit_status);
+}
+
+/**
+ * @brief Reads the size, and the counters with --stats, of a subprocess
+ *        already waited, from result_fd, which is closed
+ * @param succeeded Subprocess exited with status 0, nothing is read otherwise
+ * @return 0 upon success, 1 if the subprocess failed, -1 upon error
+ */
+int read_result(int succeeded, int result_fd, int flags, size_sum_t *size) {
+    int ret = 1;
+    if (succeeded) {
+        uint64_t begin = stats_clock();
+        if (read_full(result_fd, size, sizeof(*size))) {
+            exit_status =
+                error_sys("read error upon reading from child connection pipe");
+            return -1;
+        }
+        // Counters of the whole subtree follow the size
+        if (flags & FLAG_STATS) {
+            stats_t sub;
+            if (read_full(result_fd, &sub, sizeof(sub)) == 0) {
+                stats_merge(&sub);
+            }
+        }
+        stats_time(STATS_PIPE, begin);
+        if (write_log_long("RECV_PIPE", (long)size->blocks) ||
+            write_log_long("RECV_PIPE", (long)size->bytes)) {
+            write(STDERR_FILENO, "error upon writing log\n", 23);
+        }
+        ret = 0;
+    }
+
+    if (close(result_fd)) {
+        exit_status = error_sys("close error upon closing pipe");
+        return -1;
+    }
+    return ret;
+}
+
+/**
+ * @brief Waits for a subprocess and reads its result, see read_result
+ * @return 0 upon success, 1 if the subprocess failed, -1 upon error
+ */
+int wait_subprocess(pid_t pid, int result_fd, int flags, size_sum_t *size) {
+    int return_status;
+
+    while (waitpid(pid, &return_status, 0) == -1) {
+        if (errno == EINTR) {
+            sig_poll();
+            continue;
+        }
+        exit_status = error_sys("waitpid error");
+        return -1;
+    }
+    return read_result(
+        WIFEXITED(return_status) && WEXITSTATUS(return_status) == 0,
+        result_fd, flags, size);
+}
+
+/**
+ * @brief Appends to a buffer of lines, growing it
+ * @return 0 upon success, -1 if out of memory
+ */
+static int buf_append(char **buf, size_t *len, size_t *cap, const char *data,
+                      size_t n) {
+    if (*len + n > *cap) {
+        size_t new_cap = *cap ? *cap * 2 : BUFFER_SIZE * 16;
+        while (new_cap < *len + n) new_cap *= 2;
+        char *new_buf = (char *)realloc(*buf, new_cap);
+        if (new_buf == NULL) return -1;
+        *buf = new_buf;
+        *cap = new_cap;
+    }
+    memcpy(*buf + *len, data, n);
+    *len += n;
+    return 0;
+}
+
+/**
+ * @brief Reads from the pipe of a subprocess, its lines are written right
+ *        away if it is its turn and kept in its buffer otherwise
+ * @param is_head   Whether the lines of the subprocess are the next ones
+ * @return 1 once the pipe is at its end, 0 if more may come, -1 upon error
+ */
+static int pipe_read(int fd, char **buf, size_t *len, size_t *cap,
+                     int is_head) {
+    char data[BUFFER_SIZE * 64];
+
+    ssize_t n = read(fd, data, sizeof(data));
+    if (n == -1 && errno == EINTR) {
+        sig_poll();
+        return 0;
+    }
+    if (n <= 0) return 1;
+    if (!is_head) {
+        if (buf_append(buf, len, cap, data, n)) {
+            exit_status = error_sys("malloc error");
+            return -1;
+        }
+        return 0;
+    }
+    if (outbuf_write(outbuf_stdout(), data, n)) error_sys("write error");
+    return 0;
+}
+
+/**
+ * @brief Puts a subprocess of the main process in the group of the ones
+ *        before it, so SIGINT stops all of them. A new group is made if every
+ *        one of them already exited
+ * @param pgid  Group of the subprocesses, 0 if none, updated
+ */
+static void join_group(pid_t pid, pid_t *pgid) {
+    if (setpgid(pid, *pgid) && *pgid != 0) setpgid(pid, 0);
+    if (*pgid == 0 || getpgid(pid) == pid) *pgid = pid;
+    setGlobalProcess(*pgid);
+}
+
+/**
+ * @brief Path given in the command line, directories are traversed by a
+ *        subprocess writing to a pipe of its own
+ */
+typedef struct root_slot {
+    char       *path;
+    struct stat status;
+    int         device;     /**< @brief Index of its device */
+    int         next;       /**< @brief Next root on the same device, -1 if none */
+    int         started;
+    int         done;       /**< @brief Every line was read and the subprocess waited */
+    pid_t       pid;
+    int         out_fd;     /**< @brief Lines of the subprocess, -1 once closed */
+    int         result_fd;
+    char       *buf;        /**< @brief Lines read before its turn to be written */
+    size_t      buf_len;
+    size_t      buf_cap;
+} root_slot_t;
+
+/**
+ * @brief Roots of a device waiting for their turn
+ */
+typedef struct root_device {
+    dev_t       dev;
+    int         waiting;    /**< @brief First root not started, -1 if none */
+    int         last;
+    int         running;
+} root_device_t;
+
+typedef struct root_sched {
+    char           *argv0;
+    int             flags;
+    parse_info_t   *info;
+    inoset_t       *inodes;
+    const mounts_t *excluded;
+    int             log_file_fd;
+    struct timeval *init_time;
+    int             block_size;
+    root_slot_t    *slots;
+    int             nslots;
+    int             head;       /**< @brief First root whose lines aren't all written */
+    root_device_t  *devices;
+    int             ndevices;
+    pid_t           pgid;       /**< @brief Group of the subprocesses, 0 if none */
+    int             failed;
+    arena_t         arena;      /**< @brief Argument vector of the next subprocess */
+} root_sched_t;
+
+static int root_spawn(root_sched_t *s, root_slot_t *slot) {
+    // The subprocess is one level below this process, as its root is a path
+    // given here
+    arena_mark_t mark = arena_mark(&s->arena);
+    char **new_argv = build_argv(&s->arena, s->argv0, s->flags, s->info,
+                                 slot->path, s->info->max_depth + 1);
+    if (new_argv == NULL) {
+        exit_status = error_sys("malloc error");
+        return -1;
+    }
+
+    int out[2];
+    if (pipe2(out, O_CLOEXEC)) {
+        arena_reset(&s->arena, mark);
+        exit_status = error_sys("pipe error");
+        return -1;
+    }
+
+    // Counted before the subprocess may read it
+    progress_found(1);
+    pid_t pid = spawn_subprocess(s->argv0, new_argv, out[WRITE_PIPE],
+                                 s->log_file_fd, s->inodes, s->init_time,
+                                 s->pgid, &slot->result_fd);
+    arena_reset(&s->arena, mark);
+    close(out[WRITE_PIPE]);
+    if (pid == -1) {
+        close(out[READ_PIPE]);
+        return -1;
+    }
+
+    join_group(pid, &s->pgid);
+
+    slot->pid = pid;
+    slot->out_fd = out[READ_PIPE];
+    return 0;
+}
+
+/**
+ * @brief Starts the roots of the device while under its budget, in the order
+ *        they were given
+ */
+static int roots_start(root_sched_t *s, int device) {
+    root_device_t *dev = &s->devices[device];
+
+    while (dev->waiting != -1 && dev->running < s->info->device_jobs) {
+        root_slot_t *slot = &s->slots[dev->waiting];
+        dev->waiting = slot->next;
+        slot->started = 1;
+
+        // Read in its turn, hard links (and, with several paths, every
+        // entry) are counted by the first path
+        if (!S_ISDIR(slot->status.st_mode)) stats_status(&slot->status);
+        if (!count_entry(s->inodes, &slot->status)) {
+            slot->path = NULL;
+            slot->done = 1;
+            continue;
+        }
+        if (!S_ISDIR(slot->status.st_mode)) {
+            slot->done = 1;
+            continue;
+        }
+        if (root_spawn(s, slot)) return -1;
+        dev->running++;
+    }
+    return 0;
+}
+
+/**
+ * @brief Writes the roots whose turn came, in the order they were given
+ */
+static void roots_emit(root_sched_t *s) {
+    while (s->head < s->nslots && s->slots[s->head].started) {
+        root_slot_t *slot = &s->slots[s->head];
+
+        if (!S_ISDIR(slot->status.st_mode)) {
+            if (slot->path != NULL) {
+                size_sum_t size = {0, 0};
+                size_add(&size, &slot->status);
+                print_entry(
+                    size_print(&size, s->flags & FLAG_BYTES, s->block_size),
+                    slot->path);
+            }
+        } else if (slot->buf_len > 0) {
+            if (outbuf_write(outbuf_stdout(), slot->buf, slot->buf_len)) {
+                error_sys("write error");
+            }
+            slot->buf_len = 0;
+        }
+        if (!slot->done) break;
+        free(slot->buf);
+        slot->buf = NULL;
+        s->head++;
+    }
+}
+
+/**
+ * @brief Reads from the pipe of the subprocess of a path, starting the next
+ *        path of its device once it is done
+ */
+static int root_read(root_sched_t *s, int index) {
+    root_slot_t *slot = &s->slots[index];
+
+    int ret = pipe_read(slot->out_fd, &slot->buf, &slot->buf_len,
+                        &slot->buf_cap, index == s->head);
+    if (ret != 1) return ret;
+
+    close(slot->out_fd);
+    slot->out_fd = -1;
+    size_sum_t size;
+    int waited = wait_subprocess(slot->pid, slot->result_fd, s->flags, &size);
+    if (waited == -1) return -1;
+    if (waited == 1) s->failed = 1;
+    slot->done = 1;
+    s->devices[slot->device].running--;
+    return roots_start(s, slot->device);
+}
+
+/**
+ * @brief Traverses several paths at the same time, each directory by a
+ *        subprocess. Up to --device-jobs paths of the same device are
+ *        traversed at once and the lines are written in the order of the
+ *        paths, the ones of a later path are kept until its turn
+ * @return 0 upon success, exit status otherwise
+ */
+int traverse_roots(char *argv0, int flags, parse_info_t *info,
+                   inoset_t *inodes, const mounts_t *excluded,
+                   int log_file_fd, struct timeval *init_time,
+                   int block_size) {
+    root_sched_t s;
+    s.argv0 = argv0;
+    s.flags = flags;
+    s.info = info;
+    s.inodes = inodes;
+    s.excluded = excluded;
+    s.log_file_fd = log_file_fd;
+    s.init_time = init_time;
+    s.block_size = block_size;
+    s.nslots = 0;
+    s.head = 0;
+    s.ndevices = 0;
+    s.pgid = 0;
+    s.failed = 0;
+    arena_init(&s.arena);
+    s.slots = (root_slot_t *)calloc(info->paths_size, sizeof(root_slot_t));
+    s.devices =
+        (root_device_t *)calloc(info->paths_size, sizeof(root_device_t));
+    struct pollfd *fds =
+        (struct pollfd *)malloc(sizeof(struct pollfd) * info->paths_size);
+    int *polled = (int *)malloc(sizeof(int) * info->paths_size);
+    if (s.slots == NULL || s.devices == NULL || fds == NULL ||
+        polled == NULL) {
+        free(s.slots);
+        free(s.devices);
+        free(fds);
+        free(polled);
+        return error_sys("malloc error");
+    }
+
+    // Every path is read before any is traversed, the ones after a path that
+    // can't be read aren't traversed
+    int unread = 0;
+    for (int i = 0; i < info->paths_size; i++) {
+        root_slot_t *slot = &s.slots[s.nslots];
+        if (fget_status(info->paths[i], &slot->status, flags & FLAG_DEREF)) {
+            unread = 1;
+            break;
+        }
+        file_type_t ftype = sget_type(&slot->status);
+        if ((ftype != FTYPE_REG && ftype != FTYPE_LINK && ftype != FTYPE_DIR) ||
+            (ftype == FTYPE_DIR &&
+             mounts_prune(excluded, 0, slot->status.st_dev,
+                          slot->status.st_dev))) {
+            continue;
+        }
+        slot->path = info->paths[i];
+        slot->next = -1;
+        slot->out_fd = -1;
+
+        int d = 0;
+        while (d < s.ndevices && s.devices[d].dev != slot->status.st_dev) d++;
+        if (d == s.ndevices) {
+            s.devices[d].dev = slot->status.st_dev;
+            s.devices[d].waiting = s.nslots;
+            s.ndevices++;
+        } else {
+            s.slots[s.devices[d].last].next = s.nslots;
+        }
+        s.devices[d].last = s.nslots;
+        slot->device = d;
+        s.nslots++;
+    }
+
+    int status = 0;
+    for (int d = 0; d < s.ndevices && status == 0; d++) {
+        if (roots_start(&s, d)) status = -1;
+    }
+
+    while (status == 0) {
+        roots_emit(&s);
+
+        int nfds = 0;
+        for (int i = s.head; i < s.nslots; i++) {
+            if (s.slots[i].out_fd == -1) continue;
+            fds[nfds].fd = s.slots[i].out_fd;
+            fds[nfds].events = POLLIN;
+            polled[nfds++] = i;
+        }
+        if (nfds == 0) break;
+
+        if (poll(fds, nfds, -1) == -1) {
+            if (errno == EINTR) {
+                sig_poll();
+                continue;
+            }
+            status = error_sys("poll error");
+            break;
+        }
+        for (int i = 0; i < nfds && status == 0; i++) {
+            if (fds[i].revents == 0) continue;
+            if (root_read(&s, polled[i])) status = -1;
+        }
+    }
+    resetGlobalProcess();
+
+    for (int i = 0; i < s.nslots; i++) {
+        if (s.slots[i].out_fd != -1) close(s.slots[i].out_fd);
+        free(s.slots[i].buf);
+    }
+    free(s.slots);
+    free(s.devices);
+    free(fds);
+    free(polled);
+    arena_free(&s.arena);
+
+    if (status == 0 && unread) status = -1;
+    if (status == 0 && s.failed) status = 1;
+    return status;
+}
+
+/**
+ * @brief Subdirectory traversed by a subprocess, or lines of this process
+ *        that come after the subdirectory before them. Jobs are written in
+ *        readdir order, each one once every job before it is done
+ */
+typedef struct job {
+    pid_t       pid;        /**< @brief -1 for lines of this process */
+    int         token;      /**< @brief Took a token from the --jobs pipe */
+    int         out_fd;     /**< @brief Lines of the subprocess, -1 if it writes to stdout or once closed */
+    int         result_fd;  /**< @brief -1 once the subprocess is reaped */
+    int         exit_fd;    /**< @brief pidfd, readable once the subprocess exited, -1 if not supported */
+    char       *buf;        /**< @brief Lines read before its turn */
+    size_t      buf_len;
+    size_t      buf_cap;
+} job_t;
+
+/**
+ * @brief Subprocesses of the directory being read, up to --jobs of them run
+ *        while the next entries are read
+ */
+typedef struct job_queue {
+    job_t          *jobs;       /**< @brief Ring, in readdir order */
+    int             memsize;
+    int             head;
+    int             size;
+    int             running;    /**< @brief Subprocesses not reaped */
+    int             untokened;  /**< @brief Subprocesses running without a token, at most 1 */
+    int             limit;
+    int             flags;
+    pid_t           pgid;       /**< @brief Group of the subprocesses of the main process, 0 if none */
+    size_sum_t     *total;      /**< @brief Size of the directory, each subdirectory is added once reaped */
+    struct pollfd  *fds;
+    job_t         **polled;
+} job_queue_t;
+
+static int job_token_take(void) {
+    char token;
+    return job_tokens[READ_PIPE] != -1 &&
+           read(job_tokens[READ_PIPE], &token, 1) == 1;
+}
+
+static void job_token_give(void) {
+    if (write(job_tokens[WRITE_PIPE], "+", 1) == -1) {
+        error_sys("write error to the pipe of --jobs");
+    }
+}
+
+static int jobs_init(job_queue_t *q, int limit, int flags,
+                     size_sum_t *total) {
+    // A subprocess and the lines after it, grown while subprocesses done wait
+    // for the turn of a longer one
+    q->memsize = 2 * limit;
+    q->head = 0;
+    q->size = 0;
+    q->running = 0;
+    q->untokened = 0;
+    q->limit = limit;
+    q->flags = flags;
+    q->pgid = 0;
+    q->total = total;
+    q->jobs = (job_t *)calloc(q->memsize, sizeof(job_t));
+    q->fds = (struct pollfd *)malloc(sizeof(struct pollfd) * q->memsize * 2);
+    q->polled = (job_t **)malloc(sizeof(job_t *) * q->memsize * 2);
+    if (q->jobs == NULL || q->fds == NULL || q->polled == NULL) {
+        free(q->jobs);
+        free(q->fds);
+        free(q->polled);
+        return -1;
+    }
+    return 0;
+}
+
+static void jobs_free(job_queue_t *q) {
+    for (int i = 0; i < q->memsize; i++) free(q->jobs[i].buf);
+    free(q->jobs);
+    free(q->fds);
+    free(q->polled);
+}
+
+/**
+ * @brief Adds a job at the end of the queue
+ * @return Pointer to job upon success, NULL if out of memory
+ */
+static job_t* jobs_push(job_queue_t *q) {
+    if (q->size == q->memsize) {
+        int memsize = q->memsize * 2;
+        job_t *jobs = (job_t *)calloc(memsize, sizeof(job_t));
+        struct pollfd *fds = (struct pollfd *)realloc(
+            q->fds, sizeof(struct pollfd) * memsize * 2);
+        if (fds != NULL) q->fds = fds;
+        job_t **polled =
+            (job_t **)realloc(q->polled, sizeof(job_t *) * memsize * 2);
+        if (polled != NULL) q->polled = polled;
+        if (jobs == NULL || fds == NULL || polled == NULL) {
+            free(jobs);
+            return NULL;
+        }
+        for (int i = 0; i < q->memsize; i++) {
+            jobs[i] = q->jobs[(q->head + i) % q->memsize];
+        }
+        free(q->jobs);
+        q->jobs = jobs;
+        q->memsize = memsize;
+        q->head = 0;
+    }
+
+    job_t *job = &q->jobs[(q->head + q->size) % q->memsize];
+    job->pid = -1;
+    job->token = 0;
+    job->out_fd = -1;
+    job->result_fd = -1;
+    job->exit_fd = -1;
+    job->buf_len = 0;
+    q->size++;
+    return job;
+}
+
+static int job_done(const job_t *job) {
+    return job->pid == -1 || (job->out_fd == -1 && job->result_fd == -1);
+}
+
+/**
+ * @brief Writes the jobs whose turn came
+ */
+static void jobs_emit(job_queue_t *q) {
+    while (q->size > 0) {
+        job_t *job = &q->jobs[q->head];
+        if (job->buf_len > 0) {
+            if (outbuf_write(outbuf_stdout(), job->buf, job->buf_len)) {
+                error_sys("write error");
+            }
+            job->buf_len = 0;
+        }
+        if (!job_done(job)) break;
+        q->head = (q->head + 1) % q->memsize;
+        q->size--;
+    }
+}
+
+/**
+ * @brief Reads from the pipe of the subprocess of a job
+ */
+static int job_read(job_queue_t *q, job_t *job) {
+    int ret = pipe_read(job->out_fd, &job->buf, &job->buf_len, &job->buf_cap,
+                        job == &q->jobs[q->head]);
+    if (ret != 1) return ret;
+
+    close(job->out_fd);
+    job->out_fd = -1;
+    return 0;
+}
+
+/**
+ * @brief Reaps a subprocess whose pidfd is readable, or that closed its
+ *        result pipe and is exiting
+ * @param options   WNOHANG with a pidfd, 0 otherwise
+ */
+static int job_reap(job_queue_t *q, job_t *job, int options) {
+    siginfo_t info;
+    info.si_pid = 0;
+    while (waitid(P_PID, job->pid, &info, WEXITED | options) == -1) {
+        if (errno == EINTR) {
+            sig_poll();
+            continue;
+        }
+        exit_status = error_sys("waitid error");
+        return -1;
+    }
+    if (info.si_pid == 0) return 0;
+    if (job->exit_fd != -1) {
+        close(job->exit_fd);
+        job->exit_fd = -1;
+    }
+
+    size_sum_t size;
+    int ret = read_result(info.si_code == CLD_EXITED && info.si_status == 0,
+                          job->result_fd, q->flags, &size);
+    job->result_fd = -1;
+    if (ret == -1) return -1;
+    if (ret == 0 && (q->flags & FLAG_SEPDIR) == 0) {
+        q->total->blocks += size.blocks;
+        q->total->bytes += size.bytes;
+    }
+
+    q->running--;
+    if (job->token) {
+        job_token_give();
+    } else {
+        q->untokened--;
+    }
+    // The next subprocess makes a new group
+    if (q->running == 0) {
+        q->pgid = 0;
+        resetGlobalProcess();
+    }
+    return 0;
+}
+
+/**
+ * @brief Waits until a subprocess writes lines or exits, once
+ */
+static int jobs_step(job_queue_t *q) {
+    int nfds = 0;
+
+    for (int i = 0; i < q->size; i++) {
+        job_t *job = &q->jobs[(q->head + i) % q->memsize];
+        if (job->pid == -1) continue;
+        if (job->out_fd != -1) {
+            q->fds[nfds].fd = job->out_fd;
+            q->fds[nfds].events = POLLIN;
+            q->polled[nfds++] = job;
+        }
+        if (job->result_fd == -1) continue;
+        // The result is read once reaped, without a pidfd the hangup of the
+        // result pipe means the subprocess is exiting
+        if (job->exit_fd != -1) {
+            q->fds[nfds].fd = job->exit_fd;
+            q->fds[nfds].events = POLLIN;
+        } else {
+            q->fds[nfds].fd = job->result_fd;
+            q->fds[nfds].events = 0;
+        }
+        q->polled[nfds++] = job;
+    }
+    if (nfds == 0) return 0;
+
+    if (poll(q->fds, nfds, -1) == -1) {
+        if (errno == EINTR) {
+            sig_poll();
+            return 0;
+        }
+        exit_status = error_sys("poll error");
+        return -1;
+    }
+    for (int i = 0; i < nfds; i++) {
+        job_t *job = q->polled[i];
+        int ret = 0;
+        if (q->fds[i].revents == 0) continue;
+        if (q->fds[i].fd == job->out_fd) {
+            ret = job_read(q, job);
+        } else {
+            ret = job_reap(q, job, job->exit_fd != -1 ? WNOHANG : 0);
+        }
+        if (ret) return -1;
+    }
+    jobs_emit(q);
+    return 0;
+}
+
+/**
+ * @brief Traverses a subdirectory by a subprocess, once there is room for
+ *        it. The first subprocess of the queue writes to stdout, the others
+ *        to a pipe read until their turn. With --jobs=1 the subprocess is
+ *        waited before the next entry is read
+ * @return 0 upon success, -1 upon error
+ */
+static int jobs_spawn(job_queue_t *q, char *argv0, char **new_argv,
+                      int log_file_fd, inoset_t *inodes,
+                      struct timeval *init_time, int subprocess) {
+    // One subprocess always runs without a token, so every directory keeps
+    // going, the others take one from the pipe shared by the whole tree
+    int token = 0;
+    while (1) {
+        if (q->running < q->limit) {
+            if (q->untokened == 0) break;
+            if ((token = job_token_take())) break;
+        }
+        if (jobs_step(q)) return -1;
+    }
+
+    int out[2] = {-1, -1};
+    if (q->size > 0) {
+        if (pipe2(out, O_CLOEXEC)) {
+            if (token) job_token_give();
+            exit_status = error_sys("pipe error");
+            return -1;
+        }
+    } else {
+        // Lines of this process come before the ones of the subprocess
+        outbuf_flush(outbuf_stdout());
+    }
+
+    job_t *job = jobs_push(q);
+    if (job == NULL) {
+        if (out[READ_PIPE] != -1) close(out[READ_PIPE]);
+        if (out[WRITE_PIPE] != -1) close(out[WRITE_PIPE]);
+        if (token) job_token_give();
+        exit_status = error_sys("malloc error");
+        return -1;
+    }
+    pid_t pid = spawn_subprocess(
+        argv0, new_argv, out[WRITE_PIPE] != -1 ? out[WRITE_PIPE] : STDOUT_FILENO,
+        log_file_fd, inodes, init_time, subprocess ? -1 : q->pgid,
+        &job->result_fd);
+    if (out[WRITE_PIPE] != -1) close(out[WRITE_PIPE]);
+    if (pid == -1) {
+        if (out[READ_PIPE] != -1) close(out[READ_PIPE]);
+        if (token) job_token_give();
+        q->size--;
+        return -1;
+    }
+    if (!subprocess) join_group(pid, &q->pgid);
+
+    job->pid = pid;
+    job->token = token;
+    job->out_fd = out[READ_PIPE];
+    job->exit_fd = pidfd_open(pid, 0);
+    q->running++;
+    if (!token) q->untokened++;
+
+    while (q->running >= q->limit) {
+        if (jobs_step(q)) return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Prints an entry of this process, after the lines of the
+ *        subprocesses before it
+ */
+static int jobs_print(job_queue_t *q, long size, const char *path) {
+    if (q->size == 0) {
+        print_entry(size, path);
+        return 0;
+    }
+
+    job_t *last = &q->jobs[(q->head + q->size - 1) % q->memsize];
+    if (last->pid != -1 && (last = jobs_push(q)) == NULL) {
+        exit_status = error_sys("malloc error");
+        return -1;
+    }
+
+    log_entry(size, path);
+    char field[LONG_DECIMAL_SIZE + 1];
+    size_t n = format_long(field, size);
+    field[n++] = '\t';
+    if (buf_append(&last->buf, &last->buf_len, &last->buf_cap, field, n) ||
+        buf_append(&last->buf, &last->buf_len, &last->buf_cap, path,
+                   strlen(path)) ||
+        buf_append(&last->buf, &last->buf_len, &last->buf_cap, "\n", 1)) {
+        exit_status = error_sys("malloc error");
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Waits for every subprocess and writes every job
+ */
+static int jobs_finish(job_queue_t *q) {
+    jobs_emit(q);
+    while (q->size > 0) {
+        if (jobs_step(q)) return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Compiles the patterns of --exclude and --exclude-from, in the order
+ *        given, errors are printed
+ * @return Pointer to set upon success, NULL otherwise
+ */
+exclude_t* load_excludes(const parse_info_t *info) {
+    exclude_t *exclude = exclude_create();
+    if (exclude == NULL) {
+        error_sys("malloc error");
+        return NULL;
+    }
+
+    for (int i = 0; i < info->excludes_size; i++) {
+        const char *arg = info->excludes[i];
+        if (strncmp(arg, "--exclude-from=", 15) == 0) {
+            if (exclude_add_file(exclude, arg + 15)) {
+                fprintf(stderr, "simpledu: '%s': %s\n", arg + 15,
+                        strerror(errno));
+                exclude_destroy(exclude);
+                return NULL;
+            }
+        } else if (exclude_add(exclude, arg + 10)) {  // skip "--exclude="
+            error_sys("malloc error");
+            exclude_destroy(exclude);
+            return NULL;
+        }
+    }
+    if (exclude_compile(exclude)) {
+        error_sys("malloc error");
+        exclude_destroy(exclude);
+        return NULL;
+    }
+    return exclude;
+}
+
+/**
+ * @brief Hashes the options that change the sizes kept by --cache: -L, -x,
+ *        the devices of the excluded filesystem types and the patterns
+ * @return Key of the cache
+ */
+static uint64_t cache_key(int flags, const exclude_t *exclude,
+                          const mounts_t *excluded) {
+    uint64_t key = hash_pair((flags & FLAG_DEREF) != 0,
+                             (flags & FLAG_ONEFS) != 0);
+    key = hash_pair(key, exclude ? exclude_key(exclude) : 0);
+    if (excluded != NULL) {
+        for (int i = 0; i < excluded->size; i++) {
+            key = hash_pair(key, (uint64_t)excluded->devs[i]);
+        }
+    }
+    return key;
+}
+
+/**
+ * @brief Prints the entries of paths from an index written by --save-index,
+ *        as the scan printed them, without reading the filesystem
+ * @param argc  Number of arguments after "query"
+ * @param argv  Index file, then the paths and --format=FORMAT
+ * @return      0 upon success, 1 if a path isn't in the index, -1 upon error
+ */
+int query_index(int argc, char *argv[]) {
+    int format = SINK_TEXT;
+    int npaths = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (strncmp(argv[i], "--format=", 9) == 0) {
+            if ((format = sink_find(argv[i] + 9)) == -1) {
+                write(STDERR_FILENO,
+                      "Flag --format must be text, ndjson, csv or bin\n", 47);
+                return -1;
+            }
+        } else {
+            npaths++;
+        }
+    }
+    if (argc < 1 || npaths == 0) {
+        write(STDERR_FILENO, "Usage: simpledu query FILE PATH...\n", 35);
+        return -1;
+    }
+
+    index_t idx;
+    if (index_open(&idx, argv[0])) return error_sys("index error");
+    if (outbuf_init_stdout(OUTBUF_DEFAULT_SIZE) || sink_begin(format)) {
+        index_close(&idx);
+        return error_sys("output buffer error");
+    }
+
+    int status = 0;
+    for (int i = 1; i < argc; i++) {
+        if (strncmp(argv[i], "--format=", 9) == 0) continue;
+
+        const index_node_t *node = index_lookup(&idx, argv[i]);
+        if (node == NULL) {
+            fprintf(stderr, "simpledu: '%s' is not in the index\n", argv[i]);
+            status = 1;
+            continue;
+        }
+        sink_rec_t rec;
+        rec.path = argv[i];
+        rec.size = node->size;
+        rec.blocks = node->blocks;
+        rec.apparent = node->apparent;
+        rec.inode = node->inode;
+        rec.count = node->count;
+        rec.depth = 0;
+        rec.type = node->type;
+        rec.partial = (node->flags & INDEX_PARTIAL) != 0;
+        rec.hist = NULL;
+        if (sink_entry(&rec)) {
+            status = error_sys("write error");
+            break;
+        }
+    }
+    index_close(&idx);
+    return status;
+}
+
+/**
+ * @brief State of simpledu diff
+ */
+typedef struct diff_state {
+    long    threshold;  /**< @brief Changes of at most this size aren't printed */
+    int     ranked;     /**< @brief Changes are kept in top, otherwise printed */
+    topn_t  top;        /**< @brief Largest changes, ranked by their absolute size */
+} diff_state_t;
+
+static long diff_size(const index_node_t *node) {
+    return node != NULL ? node->size : 0;
+}
+
+/**
+ * @brief Prints "DELTA\tOLD\tNEW\tPATH", a size is "-" if the entry isn't
+ *        in that index
+ */
+static int diff_print(const char *path, const index_node_t *before,
+                      const index_node_t *after) {
+    char buf[3 * (LONG_DECIMAL_SIZE + 2)];
+    size_t n = 0;
+    long delta = diff_size(after) - diff_size(before);
+
+    if (delta >= 0) buf[n++] = '+';
+    n += format_long(buf + n, delta);
+    buf[n++] = '\t';
+    if (before != NULL) n += format_long(buf + n, before->size);
+    else buf[n++] = '-';
+    buf[n++] = '\t';
+    if (after != NULL) n += format_long(buf + n, after->size);
+    else buf[n++] = '-';
+    buf[n++] = '\t';
+
+    outbuf_t *out = outbuf_stdout();
+    if (outbuf_write(out, buf, n) || outbuf_write(out, path, strlen(path)) ||
+        outbuf_write(out, "\n", 1)) {
+        return -1;
+    }
+    return 0;
+}
+
+static int diff_visit(void *arg, const char *path,
+                      const index_node_t *before, const index_node_t *after) {
+    diff_state_t *state = (diff_state_t *)arg;
+
+    // A directory that couldn't be read has no sizes to compare, nor has one
+    // cut by --deadline
+    if ((before != NULL && (before->flags & (INDEX_FAILED | INDEX_PARTIAL))) ||
+        (after != NULL && (after->flags & (INDEX_FAILED | INDEX_PARTIAL)))) {
+        return 0;
+    }
+    long delta = diff_size(after) - diff_size(before);
+    long change = delta < 0 ? -delta : delta;
+    if (change <= state->threshold) return 0;
+
+    if (!state->ranked) return diff_print(path, before, after);
+    if (!topn_wants(&state->top, change)) return 0;
+
+    sink_rec_t rec;
+    memset(&rec, 0, sizeof(rec));
+    rec.path = path;
+    rec.size = change;
+    return topn_add(&state->top, &rec);
+}
+
+/**
+ * @brief Prints the entries whose size changed between two indexes written
+ *        by --save-index, walking both at once in the order of the paths
+ * @param argc  Number of arguments after "diff"
+ * @param argv  Old and new index files, --threshold=SIZE and --top=N
+ * @return      0 upon success, -1 upon error
+ */
+int diff_index(int argc, char *argv[]) {
+    diff_state_t state;
+    char *files[2];
+    int nfiles = 0;
+    long top = DIFF_TOP;
+
+    state.threshold = 0;
+    for (int i = 0; i < argc; i++) {
+        char *end;
+        if (strncmp(argv[i], "--threshold=", 12) == 0) {
+            errno = 0;
+            state.threshold = strtol(argv[i] + 12, &end, 10);
+            if (errno || end == argv[i] + 12 || *end || state.threshold < 0) {
+                write(STDERR_FILENO,
+                      "Flag --threshold must be a non negative integer\n", 48);
+                return -1;
+            }
+        } else if (strncmp(argv[i], "--top=", 6) == 0) {
+            errno = 0;
+            top = strtol(argv[i] + 6, &end, 10);
+            if (errno || end == argv[i] + 6 || *end || top < 0 ||
+                top > INT_MAX) {
+                write(STDERR_FILENO,
+                      "Flag --top must be a non negative integer\n", 42);
+                return -1;
+            }
+        } else if (nfiles < 2) {
+            files[nfiles++] = argv[i];
+        } else {
+            nfiles = 3;
+        }
+    }
+    if (nfiles != 2) {
+        write(STDERR_FILENO, "Usage: simpledu diff OLD NEW\n", 29);
+        return -1;
+    }
+
+    index_t before, after;
+    if (index_open(&before, files[0])) return error_sys("index error");
+    if (index_open(&after, files[1])) {
+        index_close(&before);
+        return error_sys("index error");
+    }
+    if (before.header->block_size != after.header->block_size) {
+        write(STDERR_FILENO,
+              "simpledu: indexes were written with different block sizes\n",
+              58);
+        index_close(&before);
+        index_close(&after);
+        return -1;
+    }
+
+    // Ranking only keeps the largest changes, --top=0 prints every change
+    // as it is found so the memory never depends on the number of changes
+    state.ranked = top > 0;
+    int status = 0;
+    if ((state.ranked && topn_init(&state.top, top)) ||
+        outbuf_init_stdout(OUTBUF_DEFAULT_SIZE)) {
+        status = error_sys("malloc error");
+    } else if (index_diff(&before, &after, diff_visit, &state)) {
+        status = error_sys("diff error");
+    } else if (state.ranked) {
+        // Only the paths are kept, their sizes are found again
+        topn_sort(&state.top);
+        for (int i = 0; i < state.top.size && status == 0; i++) {
+            const char *path = state.top.items[i].path;
+            if (diff_print(path, index_lookup(&before, path),
+                           index_lookup(&after, path))) {
+                status = error_sys("write error");
+            }
+        }
+    }
+    if (state.ranked) topn_free(&state.top);
+    index_close(&before);
+    index_close(&after);
+    return status;
 }
 
 void write_log_exit_status(void) {
@@ -41,17 +1259,20 @@ void write_log_exit_status(void) {
 }
 
 int main(int argc, char *argv[] /*, char * envp[]*/) {
-    if (argc < 2) {
-        errno = EINVAL;
-        return error_sys(
-            "Program usage: simpledu -l [path] [-a] [-b] [-B size] [-L] [-S] "
-            "[--max-depth=N]");
-    }
     int subprocess = 0; // indicates if this is a subprocess or the main process
-    int ppipe_write;  // pipe to write to parent in case of subprocess
+    int ppipe_write = -1;  // pipe to write to parent, -1 if not a subprocess
     int log_file_fd;
+    int inode_set_fd = -1;  // set of hard links shared by every process
     struct timeval init_time;
 
+    // Answered from the index alone, nothing is traversed nor logged
+    if (argc >= 2 && strcmp(argv[1], "query") == 0) {
+        return query_index(argc - 2, &argv[2]);
+    }
+    if (argc >= 2 && strcmp(argv[1], "diff") == 0) {
+        return diff_index(argc - 2, &argv[2]);
+    }
+
     if (atexit(write_log_exit_status)) {
         return error_sys("error on atexit");
     }
@@ -59,20 +1280,18 @@ int main(int argc, char *argv[] /*, char * envp[]*/) {
     gettimeofday(&init_time, 0);  // Init time
 
     {
-        struct stat stdout_status, stdin_status;
-
-        if (fstat(STDOUT_FILENO, &stdout_status) ||
-            fstat(STDIN_FILENO, &stdin_status)) {
-            exit_status =
-                error_sys("fstat error on reading stdin and stdout status");
-            return exit_status;
-        }
+        // Only a subprocess spawned by its parent reads the handshake, stdin
+        // and stdout may be pipes of a shell (--watch reads stdin). The mark
+        // isn't passed on to anything else this process runs
+        const char *parent = getenv(SUBPROCESS_ENV);
+        int spawned = parent != NULL && atol(parent) == (long)getppid();
+        unsetenv(SUBPROCESS_ENV);
 
-        if (sget_type(&stdout_status) == FTYPE_FIFO &&
-            sget_type(&stdin_status) == FTYPE_FIFO) {
-            int std[3];
+        if (spawned) {
+            int std[STD_FDS];
 
-            if (read(STDIN_FILENO, std, sizeof(int) * 3) != sizeof(int) * 3) {
+            if (read(STDIN_FILENO, std, sizeof(int) * STD_FDS) !=
+                sizeof(int) * STD_FDS) {
                 exit_status = error_sys(
                     "read error upon reading pipe to obtain stdout and stdin");
                 return exit_status;
@@ -97,36 +1316,40 @@ int main(int argc, char *argv[] /*, char * envp[]*/) {
 
             /* set log file */
             log_file_fd = std[LOG_FILE];
+            inode_set_fd = std[INODE_SET];
+            job_tokens[READ_PIPE] = std[TOKENS_READ];
+            job_tokens[WRITE_PIPE] = std[TOKENS_WRITE];
+            progress_attach(std[PROGRESS_FILE]);
             set_log_descriptor(log_file_fd);
             set_time(&init_time);
 
             // Write to log after restoring the file descriptor the information
             // received
-            if (write_log_array("RECV_PIPE", std, 3) ||
+            if (write_log_array("RECV_PIPE", std, STD_FDS) ||
                 write_log_timeval("RECV_PIPE", init_time)) {
                 write(STDERR_FILENO, "error upon writing log\n", 23);
             }
 
             subprocess = 1;
         } else {
-            log_file_fd = init_log();
             set_time(&init_time);
+            log_file_fd = init_log();
         }
 
         // Write commands passed as arguments
-        char buffer[BUFFER_SIZE];
+        char buffer[BUFFER_SIZE] = "";
         for (int i = 0; i < argc; i++) {
-            strncat(buffer, argv[i], sizeof(char) * strlen(argv[i]));
-            strncat(buffer, " ", 1);
+            strncat(buffer, argv[i], sizeof(buffer) - strlen(buffer) - 2);
+            strncat(buffer, " ", sizeof(buffer) - strlen(buffer) - 2);
         }
-        strncat(buffer, "\n", 1);
+        strcat(buffer, "\n");
         if (write_log("CREATE", buffer)) {
             write(STDERR_FILENO, "error upon writing log\n", 23);
         }
     }
 
     // Structs para dar handle aos sinais
-    struct sigaction action, actionLog;
+    struct sigaction action, actionLog, actionProgress;
 
     // Struct para dar handle a SIGIN
     action.sa_handler = subprocess ? SIG_IGN : sigint_handler;
@@ -138,6 +1361,11 @@ int main(int argc, char *argv[] /*, char * envp[]*/) {
     sigemptyset(&actionLog.sa_mask);
     actionLog.sa_flags = 0;
 
+    // Progress is only written by the main process, the scan goes on
+    actionProgress.sa_handler = subprocess ? SIG_IGN : progress_handler;
+    sigemptyset(&actionProgress.sa_mask);
+    actionProgress.sa_flags = SA_RESTART;
+
     // Instalação dos sigint_handler
 
     if (sigaction(SIGINT, &action, NULL) < 0) {
@@ -152,6 +1380,10 @@ int main(int argc, char *argv[] /*, char * envp[]*/) {
         fprintf(stderr, "Unable to install SIGCONT handler\n");
         exit(1);
     }
+    if (sigaction(SIGUSR1, &actionProgress, NULL) < 0) {
+        fprintf(stderr, "Unable to install SIGUSR1 handler\n");
+        exit(1);
+    }
     // resetHandler(actionLog);
 
     // error | path | max-depth | S | L | B | b | a | l
@@ -166,6 +1398,126 @@ int main(int argc, char *argv[] /*, char * envp[]*/) {
         return exit_status;
     }
 
+    if (flags & FLAG_STATS) stats_start(&init_time);
+
+    // A resumed output already has what comes before the first entry
+    sink_set_columns(&info.columns);
+    if (outbuf_init_stdout(info.flush_size) ||
+        (!subprocess && info.resume_path != NULL &&
+         sink_select(info.format)) ||
+        (!subprocess && info.resume_path == NULL &&
+         sink_begin(info.format))) {
+        free_parse_info(&info);
+        exit_status = error_sys("output buffer error");
+        return exit_status;
+    }
+
+    // The watch keeps its tree inside this process and counts every link, a
+    // link may be removed from the directory that counted it
+    if (flags & FLAG_WATCH) flags |= FLAG_LINKS;
+    // Walks of the estimate only see part of the tree, a link seen once may
+    // have been counted elsewhere
+    if (flags & FLAG_ESTIMATE) flags |= FLAG_LINKS;
+
+    // Each thread of the traversal sends its directories to a worker process
+    if (flags & FLAG_WORKERS) {
+        flags |= FLAG_THREADS;
+        info.threads = info.workers;
+    }
+
+    // Without -l every inode with several links is counted only once, across
+    // every path, thread and subprocess. Like du, paths given more than once,
+    // or inside another one, and directories reached again through -L are
+    // counted once too, every entry is then kept
+    inoset_t *inodes = NULL;
+    if ((flags & FLAG_LINKS) == 0) {
+        inodes = subprocess
+                     ? inoset_attach(inode_set_fd)
+                     : inoset_create(flags & FLAG_THREADS,
+                                     info.paths_size > 1 ||
+                                         (flags & FLAG_DEREF));
+        if (inodes == NULL) {
+            free_parse_info(&info);
+            exit_status = error_sys("inode set error");
+            return exit_status;
+        }
+    }
+
+    // The cache, the watch, the tops, the deadline, the checkpoint and the
+    // sizes of other formats and columns only live inside a process
+    if (((flags & (FLAG_CACHE | FLAG_WATCH | FLAG_TOP | FLAG_TOPFILES |
+                   FLAG_INDEX | FLAG_ESTIMATE | FLAG_DEADLINE |
+                   FLAG_CHECKPOINT)) ||
+         info.format != SINK_TEXT || info.columns.size > 0) &&
+        (flags & FLAG_THREADS) == 0) {
+        flags |= FLAG_THREADS;
+        info.threads = 1;
+    }
+
+    // Counters of SIGUSR1, mapped by every subprocess of the process mode
+    if (!subprocess && progress_create((flags & FLAG_THREADS) == 0)) {
+        error_sys("progress error");
+    }
+
+    // Subdirectories read at the same time would count a hard link by
+    // whichever reads it first, not by the first one in output order as the
+    // thread mode and du do, so the sizes would change between runs
+    if (!subprocess && (flags & FLAG_JOBS) && (flags & FLAG_THREADS) == 0 &&
+        info.jobs > 1 && inodes != NULL) {
+        write(STDERR_FILENO,
+              "Flag --jobs above 1 needs -l in the process mode\n", 49);
+        inoset_destroy(inodes);
+        free_parse_info(&info);
+        exit_status = -1;
+        return exit_status;
+    }
+
+    // Paths of the same device read at the same time would do the same
+    if (!subprocess && (flags & FLAG_DEVJOBS) && (flags & FLAG_THREADS) == 0 &&
+        info.device_jobs > 1 && inodes != NULL) {
+        write(STDERR_FILENO,
+              "Flag --device-jobs above 1 needs -l in the process mode\n", 56);
+        inoset_destroy(inodes);
+        free_parse_info(&info);
+        exit_status = -1;
+        return exit_status;
+    }
+
+    // Subprocesses besides the first one of each directory take a token, so
+    // --jobs bounds the subprocesses of every level together
+    if (!subprocess && (flags & FLAG_JOBS) && (flags & FLAG_THREADS) == 0 &&
+        info.jobs > 1) {
+        if (pipe(job_tokens) ||
+            fcntl(job_tokens[READ_PIPE], F_SETFL, O_NONBLOCK)) {
+            free_parse_info(&info);
+            exit_status = error_sys("pipe error");
+            return exit_status;
+        }
+        for (int i = 1; i < info.jobs; i++) job_token_give();
+    }
+
+    // Devices of the excluded types, read once before anything is traversed
+    mounts_t excluded = {NULL, 0};
+    if ((flags & FLAG_EXCLFS) &&
+        mounts_load(&excluded, info.exclude_fstype)) {
+        error_sys("error upon reading " MOUNTINFO_PATH);
+    }
+
+    // Compiled once, every thread of this process reads the same set
+    exclude_t *exclude = NULL;
+    if ((flags & FLAG_EXCLUDE) && (exclude = load_excludes(&info)) == NULL) {
+        free_parse_info(&info);
+        exit_status = -1;
+        return exit_status;
+    }
+
+    unsigned int extra_mask = 0;
+    if (inodes != NULL) extra_mask |= STATX_INO | STATX_NLINK;
+    if (flags & FLAG_CACHE) {
+        extra_mask |= STATX_INO | STATX_NLINK | STATX_MTIME | STATX_CTIME;
+    }
+    fset_stat_mode(info.stat_mode, extra_mask);
+
     char *path;
     int block_size;
     int max_depth;
@@ -173,6 +1525,121 @@ int main(int argc, char *argv[] /*, char * envp[]*/) {
     block_size = (flags & FLAG_BSIZE) ? info.block_size : 1024;
     max_depth = (flags & FLAG_MAXDEPTH) ? info.max_depth - subprocess : -1;
 
+    if (flags & FLAG_THREADS) {
+        du_opts_t opts;
+        opts.flags = flags;
+        opts.block_size = block_size;
+        opts.max_depth = info.max_depth;
+        opts.threads = info.threads;
+        opts.uring_depth = (flags & FLAG_URING) ? info.uring_depth : 0;
+        opts.inodes = inodes;
+        opts.cache = NULL;
+        opts.visit = NULL;
+        opts.visit_ctx = NULL;
+        opts.top = (flags & FLAG_TOP) ? info.top : 0;
+        opts.top_files = (flags & FLAG_TOPFILES) ? info.top_files : 0;
+        opts.device_jobs = info.device_jobs;
+        opts.excluded = (flags & FLAG_EXCLFS) ? &excluded : NULL;
+        opts.exclude = exclude;
+        opts.workers = (flags & FLAG_WORKERS) != 0;
+        opts.worker_timeout = info.worker_timeout * 1000;
+        opts.deadline = 0;
+        if (flags & FLAG_DEADLINE) {
+            struct timespec now;
+            clock_gettime(CLOCK_MONOTONIC, &now);
+            opts.deadline = now.tv_sec * 1000000000ULL + now.tv_nsec +
+                            (uint64_t)(info.deadline * 1e9);
+        }
+
+        if (flags & FLAG_CACHE) {
+            opts.cache = cache_open(info.cache_path, info.threads,
+                                    cache_key(flags, exclude, opts.excluded));
+            if (opts.cache == NULL) {
+                exit_status = error_sys("cache error");
+                return exit_status;
+            }
+        }
+
+        checkpoint_t resume;
+        opts.checkpoint = info.checkpoint_path;
+        opts.checkpoint_interval = info.checkpoint_interval;
+        opts.resume = NULL;
+        opts.histogram = sink_has_column(&info.columns, SINK_COL_HIST);
+        if (info.resume_path != NULL) {
+            if (checkpoint_open(&resume, info.resume_path)) {
+                exit_status = error_sys("checkpoint error");
+                return exit_status;
+            }
+            opts.resume = &resume;
+        }
+
+        opts.index = NULL;
+        if ((flags & FLAG_INDEX) &&
+            (opts.index = index_create(
+                 info.index_path, (flags & FLAG_BYTES) ? 0 : block_size)) ==
+                NULL) {
+            exit_status = error_sys("index error");
+            return exit_status;
+        }
+
+        if (flags & FLAG_WATCH) {
+            exit_status = watch_paths(&opts, info.paths, info.paths_size);
+        } else if (flags & FLAG_ESTIMATE) {
+            exit_status = estimate_paths(&opts, info.paths, info.paths_size,
+                                         info.estimate_error, info.refine);
+        } else {
+            exit_status = traverse_paths(&opts, info.paths, info.paths_size);
+        }
+        if (opts.resume != NULL) checkpoint_close(opts.resume);
+        if (opts.index != NULL &&
+            index_finish(opts.index, exit_status != -1) &&
+            exit_status != -1) {
+            exit_status = error_sys("index error upon saving");
+        }
+        if (opts.cache != NULL) {
+            if (exit_status != -1 && cache_save(opts.cache)) {
+                error_sys("cache error upon saving");
+            }
+            cache_close(opts.cache);
+        }
+        if (inodes != NULL && (flags & FLAG_INODESTATS)) {
+            print_inode_stats(inodes);
+        }
+        if (flags & FLAG_STATS) stats_print(info.stats_format);
+        inoset_destroy(inodes);
+        mounts_free(&excluded);
+        exclude_destroy(exclude);
+        free_parse_info(&info);
+        return exit_status;
+    }
+
+    if (!subprocess && info.paths_size > 1) {
+        exit_status = traverse_roots(
+            argv[0], flags, &info, inodes,
+            (flags & FLAG_EXCLFS) ? &excluded : NULL, log_file_fd, &init_time,
+            block_size);
+        if (inodes != NULL && (flags & FLAG_INODESTATS)) {
+            print_inode_stats(inodes);
+        }
+        if (flags & FLAG_STATS) stats_print(info.stats_format);
+        inoset_destroy(inodes);
+        mounts_free(&excluded);
+        exclude_destroy(exclude);
+        free_parse_info(&info);
+        return exit_status;
+    }
+
+    // Status of the entries read in batches if io_uring is available
+    uring_t *ring = NULL;
+    if (flags & FLAG_URING) ring = uring_create(info.uring_depth);
+
+    dir_scan_t scan;
+    if (dirscan_init(&scan, ring, flags & FLAG_DEREF)) {
+        exit_status = error_sys("malloc error");
+        return exit_status;
+    }
+    scan.exclude = exclude;
+
     struct stat status;
 
     for (int path_index = 0; path_index < info.paths_size; path_index++) {
@@ -185,295 +1652,190 @@ int main(int argc, char *argv[] /*, char * envp[]*/) {
         }
 
         file_type_t ftype = sget_type(&status);
-        double fsize = fget_size(flags & FLAG_BYTES, &status, block_size);
+        if (ftype == FTYPE_DIR &&
+            mounts_prune(&excluded, 0, status.st_dev, status.st_dev)) {
+            continue;
+        }
+        stats_status(&status);
+        // The directory of a subprocess was counted by its parent
+        if ((ftype != FTYPE_DIR || !subprocess) &&
+            !count_entry(inodes, &status)) {
+            continue;
+        }
+        // Summed exactly and rounded once, like the thread mode
+        size_sum_t fsize = {0, 0};
+        size_add(&fsize, &status);
+        int bytes_only = (flags & FLAG_BYTES) != 0;
 
         switch (ftype) {
-            case FTYPE_REG: {
-                char buffer[BUFFER_SIZE];
-                sprintf(buffer,
-                        "%ld"
-                        "\x9"
-                        "%s\n",
-                        dceill(fsize), path);
-                write_log("ENTRY", buffer);
-                write(STDOUT_FILENO, buffer, strlen(buffer));
-            } break;
+            case FTYPE_REG:
+                print_entry(size_print(&fsize, bytes_only, block_size), path);
+                break;
             case FTYPE_DIR: {
                 DIR *dir;
 
+                uint64_t begin = stats_clock();
                 if ((dir = opendir(path)) == NULL) {
                     exit_status = error_sys("opendir error");
                     return exit_status;
                 }
+                stats_time(STATS_OPEN, begin);
 
-                struct dirent *direntp;
-
-                while ((direntp = readdir(dir)) != NULL) {
-                    // Skip . and .. directories
-                    if (strcmp(direntp->d_name, ".") == 0 ||
-                        strcmp(direntp->d_name, "..") == 0)
-                        continue;
-
-                    // Build new path
-                    char new_path[BUFFER_SIZE];
-                    sprintf(new_path, "%s%s%s", path,
-                            ((path[strlen(path) - 1] == '/') ? "" : "/"),
-                            direntp->d_name);
+                // Paths of the entries are only built when printed or passed
+                // to a subprocess, the entries are read relative to dir
+                path_buf_t new_path;
+                pathbuf_init(&new_path);
+                if (pathbuf_set(&new_path, path)) {
+                    exit_status = error_sys("malloc error");
+                    return exit_status;
+                }
+                // Argument vectors of the subprocesses, taken again from the
+                // start for each subdirectory
+                arena_t scratch;
+                arena_init(&scratch);
+                // Subprocesses of the subdirectories, up to --jobs of them
+                // run while the next entries are read
+                job_queue_t jobs;
+                if (jobs_init(&jobs, info.jobs, flags, &fsize)) {
+                    exit_status = error_sys("malloc error");
+                    return exit_status;
+                }
 
-                    struct stat new_status;
+                dir_entry_t *entry;
+                long entries = 0;
+                uint64_t bytes = 0;
+                if (!subprocess) progress_found(1);
+                dirscan_start(&scan, dir);
 
-                    if (fget_status(new_path, &new_status,
-                                    flags & FLAG_DEREF)) {
+                while ((entry = dirscan_next(&scan)) != NULL) {
+                    // Signals are handled between entries, when no output
+                    // is being written
+                    sig_poll();
+                    if (entry->error) {
+                        errno = entry->error;
                         exit_status = error_sys(
                             "fget_status error on reading directory's file "
                             "status");
                         return exit_status;
                     }
 
+                    struct stat new_status = entry->status;
                     file_type_t new_type = sget_type(&new_status);
-                    double new_fsize;
+                    if (new_type != FTYPE_DIR) stats_status(&new_status);
+                    if (!count_entry(inodes, &new_status)) continue;
+                    entries++;
+                    if (new_type != FTYPE_DIR) {
+                        bytes += (uint64_t)new_status.st_blocks * 512;
+                    }
                     switch (new_type) {
                         case FTYPE_REG:
-                            new_fsize = fget_size(flags & FLAG_BYTES,
-                                                  &new_status, block_size);
-                            fsize += new_fsize;
+                            size_add(&fsize, &new_status);
                             if ((flags & FLAG_ALL) &&
                                 ((flags & FLAG_MAXDEPTH) == 0 ||
                                  max_depth > 0)) {
-                                char buffer[BUFFER_SIZE];
-                                sprintf(buffer,
-                                        "%ld"
-                                        "\x9"
-                                        "%s\n",
-                                        dceill(new_fsize), new_path);
-                                if (write_log("ENTRY", buffer)) {
-                                    write(STDERR_FILENO,
-                                          "error upon writing log\n", 23);
+                                size_sum_t new_fsize = {0, 0};
+                                size_add(&new_fsize, &new_status);
+                                size_t len =
+                                    pathbuf_push(&new_path, entry->name);
+                                if (jobs_print(&jobs,
+                                               size_print(&new_fsize,
+                                                          bytes_only,
+                                                          block_size),
+                                               new_path.str)) {
+                                    return exit_status;
                                 }
-                                write(STDOUT_FILENO, buffer, strlen(buffer));
+                                pathbuf_pop(&new_path, len);
                             }
                             break;
                         case FTYPE_DIR: {
+                            // Pruned before the subprocess opens it
+                            if (mounts_prune(&excluded, flags & FLAG_ONEFS,
+                                             status.st_dev,
+                                             new_status.st_dev)) {
+                                break;
+                            }
                             // Build command line arguments
-                            parse_info_t new_info;
-                            init_parse_info(&new_info);
-                            parse_info_addpath(&new_info, new_path);
-                            new_info.block_size = block_size;
-                            new_info.max_depth =
-                                (max_depth > 0) ? max_depth : 0;
-
+                            arena_mark_t mark = arena_mark(&scratch);
+                            size_t len =
+                                pathbuf_push(&new_path, entry->name);
                             char **new_argv =
-                                build_argv(argv[0], flags, &new_info);
-
-                            free_parse_info(&new_info);
-
-                            int pipe_ctosp[2];  // Pipe child to subprocess
-                            int pipe_ctop[2];   // Pipe child to parent
-
-                            int return_status;
-
-                            if (pipe(pipe_ctosp) || pipe(pipe_ctop)) {
-                                exit_status = error_sys("pipe error");
+                                len == (size_t)-1
+                                    ? NULL
+                                    : build_argv(&scratch, argv[0], flags,
+                                                 &info, new_path.str,
+                                                 (max_depth > 0) ? max_depth
+                                                                 : 0);
+                            if (new_argv == NULL) {
+                                exit_status = error_sys("malloc error");
                                 return exit_status;
                             }
 
-                            pid_t pid = fork();
-
-                            // sleep(2);
-
-                            switch (pid) {
-                                case -1:
-                                    exit_status = error_sys("fork error");
-                                    return exit_status;
-                                case 0:  // Filho
-                                {
-                                    int std[3];
-                                    if (!subprocess) {
-                                        setpgid(0, 0);
-                                    }
-                                    if ((std[READ_PIPE] = dup(STDIN_FILENO)) ==
-                                            -1 ||
-                                        (std[WRITE_PIPE] =
-                                             dup(STDOUT_FILENO)) == -1) {
-                                        exit_status = error_sys(
-                                            "dup error upon copying stdin and "
-                                            "stdout descriptors");
-                                        return exit_status;
-                                    }
-                                    if ((std[LOG_FILE] = dup(log_file_fd)) ==
-                                        -1) {
-                                        exit_status = error_sys(
-                                            "dup error upon copying "
-                                            "log_file_fd");
-                                        return exit_status;
-                                    }
-                                    if (write(pipe_ctosp[WRITE_PIPE], std,
-                                              sizeof(int) * 3) == -1) {
-                                        exit_status = error_sys(
-                                            "write error to subprocess "
-                                            "connection pipe");
-                                        return exit_status;
-                                    }
-                                    // write timeval to pipe
-                                    if (write(pipe_ctosp[WRITE_PIPE],
-                                              &init_time,
-                                              sizeof(init_time)) == -1) {
-                                        exit_status = error_sys(
-                                            "write error to subprocess "
-                                            "connection pipe");
-                                        return exit_status;
-                                    }
-                                    // write log  of std
-                                    if (write_log_array("SEND_PIPE", std, 3) ||
-                                        write_log_timeval("SEND_PIPE",
-                                                          init_time)) {
-                                        write(STDERR_FILENO,
-                                              "error upon writing log\n", 23);
-                                    }
-                                    if (close(pipe_ctop[READ_PIPE]) ||
-                                        close(pipe_ctosp[WRITE_PIPE])) {
-                                        exit_status = error_sys(
-                                            "close error upon closing pipe");
-                                        return exit_status;
-                                    }
-
-                                    if (dup2(pipe_ctop[WRITE_PIPE],
-                                             STDOUT_FILENO) == -1 ||
-                                        dup2(pipe_ctosp[READ_PIPE],
-                                             STDIN_FILENO) == -1) {
-                                        exit_status = error_sys(
-                                            "dup2 error upon redefining "
-                                            "descriptors pointed by "
-                                            "stdin and stdout");
-                                        return exit_status;
-                                    }
-
-                                    if (close(pipe_ctop[WRITE_PIPE]) ||
-                                        close(pipe_ctosp[READ_PIPE])) {
-                                        exit_status = error_sys(
-                                            "close error upon closing pipe");
-                                        return exit_status;
-                                    }
-
-                                    if (execv(argv[0], new_argv) == -1) {
-                                        exit_status = error_sys("execv error");
-                                        return exit_status;
-                                    }
-                                } break;
-                                default:  // Pai
-                                {
-                                    setGlobalProcess(pid);
-
-                                    if (close(pipe_ctop[WRITE_PIPE]) ||
-                                        close(pipe_ctosp[WRITE_PIPE]) ||
-                                        close(pipe_ctosp[READ_PIPE])) {
-                                        exit_status = error_sys(
-                                            "close error upon closing pipe");
-                                        return exit_status;
-                                    }
-
-                                    do {
-                                        if (waitpid(pid, &return_status, 0) ==
-                                            -1) {
-                                            if (errno == EINTR) continue;
-                                            exit_status =
-                                                error_sys("waitpid error");
-                                            return exit_status;
-                                        }
-                                        break;
-                                    } while (1);
-                                    resetGlobalProcess();
-
-                                    int i = 0;
-                                    while (new_argv[i] != NULL) {
-                                        free(new_argv[i]);
-                                        i++;
-                                    }
-                                    free(new_argv);
-
-                                    if (WIFEXITED(return_status) &&
-                                        WEXITSTATUS(return_status) == 0) {
-                                        double subdir_size = 0;
-                                        if (read(pipe_ctop[READ_PIPE],
-                                                 &subdir_size,
-                                                 sizeof(double)) == -1) {
-                                            exit_status = error_sys(
-                                                "write error upon reading from "
-                                                "child connection "
-                                                "pipe");
-                                            return exit_status;
-                                        }
-                                        if (write_log_double("RECV_PIPE",
-                                                             subdir_size)) {
-                                            write(STDERR_FILENO,
-                                                  "error upon writing log\n",
-                                                  23);
-                                        }
-
-                                        fsize += (flags & FLAG_SEPDIR)
-                                                     ? 0
-                                                     : subdir_size;
-
-                                        if (close(pipe_ctop[READ_PIPE])) {
-                                            exit_status = error_sys(
-                                                "close error upon closing "
-                                                "pipe");
-                                            return exit_status;
-                                        }
-                                    }
-
-                                } break;
-                            }
+                            progress_found(1);
+                            int spawned =
+                                jobs_spawn(&jobs, argv[0], new_argv,
+                                           log_file_fd, inodes, &init_time,
+                                           subprocess);
+                            pathbuf_pop(&new_path, len);
+                            arena_reset(&scratch, mark);
+                            if (spawned) return exit_status;
                         } break;
                         case FTYPE_LINK: {
-                            new_fsize = fget_size(flags & FLAG_BYTES,
-                                                  &new_status, block_size);
-                            fsize += new_fsize;
+                            size_add(&fsize, &new_status);
                             if ((flags & FLAG_ALL) &&
                                 ((flags & FLAG_MAXDEPTH) == 0 ||
                                  max_depth > 0)) {
-                                char buffer[BUFFER_SIZE];
-                                sprintf(buffer,
-                                        "%ld"
-                                        "\x9"
-                                        "%s\n",
-                                        dceill(new_fsize), new_path);
-                                if (write_log("ENTRY", buffer)) {
-                                    write(STDERR_FILENO,
-                                          "error upon writing log\n", 23);
+                                size_sum_t new_fsize = {0, 0};
+                                size_add(&new_fsize, &new_status);
+                                size_t len =
+                                    pathbuf_push(&new_path, entry->name);
+                                if (jobs_print(&jobs,
+                                               size_print(&new_fsize,
+                                                          bytes_only,
+                                                          block_size),
+                                               new_path.str)) {
+                                    return exit_status;
                                 }
-                                write(STDOUT_FILENO, buffer, strlen(buffer));
+                                pathbuf_pop(&new_path, len);
                             }
                         } break;
                         default:
                             break;
                     }
                 }
+                progress_dir(entries, bytes, 0);
+                // Sizes of the subdirectories are added as they finish
+                if (jobs_finish(&jobs)) return exit_status;
+                jobs_free(&jobs);
+                pathbuf_free(&new_path);
+                arena_free(&scratch);
+
                 if (!subprocess || (flags & FLAG_MAXDEPTH) == 0 ||
                     max_depth >= 0) {
-                    char buffer[BUFFER_SIZE];
-                    sprintf(buffer,
-                            "%ld"
-                            "\x9"
-                            "%s\n",
-                            dceill(fsize), path);
-                    if (write_log("ENTRY", buffer)) {
-                        write(STDERR_FILENO, "error upon writing log\n", 23);
-                    }
-                    write(STDOUT_FILENO, buffer, strlen(buffer));
+                    print_entry(size_print(&fsize, bytes_only, block_size),
+                                path);
                 }
 
-                if (subprocess) {
-                    if (write(ppipe_write, &fsize, sizeof(double)) == -1) {
+                if (ppipe_write != -1) {
+                    uint64_t begin = stats_clock();
+                    if (write(ppipe_write, &fsize, sizeof(fsize)) == -1) {
                         exit_status = error_sys(
                             "write error upong writing to parent connection "
                             "pipe and/or "
                             "write information received by pipe to log");
                         return exit_status;
                     }
+                    if (flags & FLAG_STATS) {
+                        stats_time(STATS_PIPE, begin);
+                        stats_t total;
+                        stats_collect(&total);
+                        if (write(ppipe_write, &total, sizeof(total)) == -1) {
+                            error_sys("write error upon sending stats");
+                        }
+                    }
                 }
 
-                if (write_log_double("SEND_PIPE", fsize)) {
+                if (write_log_long("SEND_PIPE", (long)fsize.blocks) ||
+                    write_log_long("SEND_PIPE", (long)fsize.bytes)) {
                     write(STDERR_FILENO, "error upon writing log\n", 23);
                 }
 
@@ -482,33 +1844,34 @@ int main(int argc, char *argv[] /*, char * envp[]*/) {
                     return exit_status;
                 }
             } break;
-            case FTYPE_LINK: {
+            case FTYPE_LINK:
                 // Dereference symbolic link if flag is set
-                char buffer[BUFFER_SIZE];
-                sprintf(buffer,
-                        "%ld"
-                        "\x9"
-                        "%s\n",
-                        dceill(fsize), path);
-                if (write_log("ENTRY", buffer)) {
-                    write(STDOUT_FILENO, "error upon writing log", 22);
-                }
-                write(STDOUT_FILENO, buffer, strlen(buffer));
-            } break;
+                print_entry(size_print(&fsize, bytes_only, block_size), path);
+                break;
             default:
                 break;
         }
     }
 
-    if (subprocess) {
+    if (ppipe_write != -1) {
         if (close(ppipe_write)) {
             exit_status = error_sys("close error upon closing pipe");
             return exit_status;
         }
     }
 
+    if (!subprocess && inodes != NULL && (flags & FLAG_INODESTATS)) {
+        print_inode_stats(inodes);
+    }
+    if (!subprocess && (flags & FLAG_STATS)) stats_print(info.stats_format);
+
     // free memory
+    inoset_destroy(inodes);
+    mounts_free(&excluded);
+    exclude_destroy(exclude);
     free_parse_info(&info);
+    dirscan_free(&scan);
+    uring_destroy(ring);
 
     // Close log file
     /*if(subprocess == 0) {
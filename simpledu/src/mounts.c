@@ -0,0 +1,96 @@
+/* MAIN HEADER */
+#include "mounts.h"
+
+/* INCLUDE HEADERS */
+
+/* SYSTEM CALLS HEADERS */
+#include <sys/sysmacros.h>
+
+/* C LIBRARY HEADERS */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MOUNTS_INIT_SIZE 16
+
+/**
+ * @brief Checks if the type is in the list, a name without a dot also
+ *        matches its subtypes ("fuse" matches "fuse.sshfs")
+ */
+static int fstype_listed(const char *fstypes, const char *fstype) {
+    size_t type_len = strlen(fstype);
+
+    for (const char *p = fstypes; *p != 0;) {
+        size_t len = strcspn(p, ",");
+        if (len > 0 && len <= type_len && strncmp(p, fstype, len) == 0 &&
+            (len == type_len || fstype[len] == '.')) {
+            return 1;
+        }
+        p += len;
+        if (*p == ',') p++;
+    }
+    return 0;
+}
+
+static int dev_compare(const void *a, const void *b) {
+    dev_t x = *(const dev_t *)a, y = *(const dev_t *)b;
+    return (x > y) - (x < y);
+}
+
+int mounts_load(mounts_t *mounts, const char *fstypes) {
+    mounts->devs = NULL;
+    mounts->size = 0;
+
+    FILE *file = fopen(MOUNTINFO_PATH, "r");
+    if (file == NULL) return -1;
+
+    int memsize = 0;
+    char *line = NULL;
+    size_t line_size = 0;
+    while (getline(&line, &line_size, file) != -1) {
+        // id parent major:minor root point options [optional...] - type ...
+        unsigned int major, minor;
+        char *sep = strstr(line, " - ");
+        if (sscanf(line, "%*d %*d %u:%u", &major, &minor) != 2 ||
+            sep == NULL) {
+            continue;
+        }
+        char *type = sep + 3;
+        type[strcspn(type, " \n")] = 0;
+        if (!fstype_listed(fstypes, type)) continue;
+
+        if (mounts->size == memsize) {
+            memsize = memsize ? memsize * 2 : MOUNTS_INIT_SIZE;
+            dev_t *devs =
+                (dev_t *)realloc(mounts->devs, sizeof(dev_t) * memsize);
+            if (devs == NULL) {
+                free(line);
+                fclose(file);
+                mounts_free(mounts);
+                return -1;
+            }
+            mounts->devs = devs;
+        }
+        mounts->devs[mounts->size++] = makedev(major, minor);
+    }
+    free(line);
+    fclose(file);
+
+    if (mounts->size > 1) {
+        qsort(mounts->devs, mounts->size, sizeof(dev_t), dev_compare);
+    }
+    return 0;
+}
+
+int mounts_prune(const mounts_t *mounts, int one_fs, dev_t parent, dev_t dev) {
+    if (one_fs && dev != parent) return 1;
+    if (mounts == NULL || mounts->size == 0) return 0;
+    return bsearch(&dev, mounts->devs, mounts->size, sizeof(dev_t),
+                   dev_compare) != NULL;
+}
+
+void mounts_free(mounts_t *mounts) {
+    free(mounts->devs);
+    mounts->devs = NULL;
+    mounts->size = 0;
+}
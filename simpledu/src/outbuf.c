@@ -0,0 +1,123 @@
+/* MAIN HEADER */
+#include "outbuf.h"
+
+/* INCLUDE HEADERS */
+#include "stats.h"
+#include "utils.h"
+
+/* SYSTEM CALLS HEADERS */
+#include <sys/stat.h>
+#include <unistd.h>
+
+/* C LIBRARY HEADERS */
+#include <errno.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+
+outbuf_t out_stdout = {STDOUT_FILENO, NULL, 0, 0, 0};
+
+int outbuf_init(outbuf_t *ob, int fd, size_t size) {
+    struct stat status;
+
+    ob->fd = fd;
+    ob->len = 0;
+    ob->size = size;
+    ob->atomic = (fstat(fd, &status) == 0 && S_ISFIFO(status.st_mode));
+    ob->buf = NULL;
+    if (size > 0 && (ob->buf = (char *)malloc(size)) == NULL) return -1;
+    return 0;
+}
+
+static int write_all(int fd, const char *data, size_t len) {
+    while (len > 0) {
+        uint64_t begin = stats_clock();
+        ssize_t n = write(fd, data, len);
+        stats_time(STATS_OUTPUT, begin);
+        if (n == -1) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        data += n;
+        len -= n;
+    }
+    return 0;
+}
+
+int outbuf_flush(outbuf_t *ob) {
+    size_t len = ob->len;
+    size_t pos = 0;
+    int ret = 0;
+
+    while (pos < len && ret == 0) {
+        size_t chunk = len - pos;
+        if (ob->atomic && chunk > PIPE_BUF) {
+            // Whole lines up to PIPE_BUF bytes, or a longer line alone
+            const char *end = memrchr(ob->buf + pos, '\n', PIPE_BUF);
+            if (end == NULL) {
+                end = memchr(ob->buf + pos + PIPE_BUF, '\n', chunk - PIPE_BUF);
+            }
+            if (end != NULL) chunk = end - (ob->buf + pos) + 1;
+        }
+        ret = write_all(ob->fd, ob->buf + pos, chunk);
+        pos += chunk;
+    }
+
+    ob->len = 0;
+    return ret;
+}
+
+int outbuf_entry(outbuf_t *ob, long size, const char *path) {
+    size_t path_len = strlen(path);
+    size_t line_len = LONG_DECIMAL_SIZE + 1 + path_len + 1;
+
+    if (ob->len + line_len > ob->size && outbuf_flush(ob)) return -1;
+
+    // Doesn't fit even in an empty buffer
+    if (line_len > ob->size) return write_entry(ob->fd, size, path);
+
+    char *line = ob->buf + ob->len;
+    size_t n = format_long(line, size);
+    line[n++] = '\t';
+    memcpy(line + n, path, path_len);
+    n += path_len;
+    line[n++] = '\n';
+
+    ob->len += n;
+    return 0;
+}
+
+char* outbuf_reserve(outbuf_t *ob, size_t len) {
+    if (ob->len + len > ob->size && outbuf_flush(ob)) return NULL;
+    if (len > ob->size) return NULL;
+    return ob->buf + ob->len;
+}
+
+void outbuf_commit(outbuf_t *ob, size_t len) { ob->len += len; }
+
+int outbuf_write(outbuf_t *ob, const void *data, size_t len) {
+    char *room = outbuf_reserve(ob, len);
+    if (room == NULL) {
+        if (ob->len > 0 && outbuf_flush(ob)) return -1;
+        return write_all(ob->fd, (const char *)data, len);
+    }
+    memcpy(room, data, len);
+    outbuf_commit(ob, len);
+    return 0;
+}
+
+void outbuf_free(outbuf_t *ob) {
+    outbuf_flush(ob);
+    free(ob->buf);
+    ob->buf = NULL;
+    ob->size = 0;
+}
+
+static void outbuf_flush_stdout(void) { outbuf_flush(&out_stdout); }
+
+int outbuf_init_stdout(size_t size) {
+    if (outbuf_init(&out_stdout, STDOUT_FILENO, size)) return -1;
+    return atexit(outbuf_flush_stdout) ? -1 : 0;
+}
+
+outbuf_t* outbuf_stdout(void) { return &out_stdout; }
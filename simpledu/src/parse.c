@@ -2,6 +2,12 @@
 #include "parse.h"
 
 /* INCLUDE HEADERS */
+#include "checkpoint.h"
+#include "estimate.h"
+#include "outbuf.h"
+#include "procpool.h"
+#include "sink.h"
+#include "stats.h"
 #include "utils.h"
 
 /* SYSTEM CALLS  HEADERS */
@@ -18,6 +24,30 @@ void init_parse_info(parse_info_t *info) {
     info->paths_memsize = 0;
     info->block_size = 0;
     info->max_depth = 0;
+    info->threads = 0;
+    info->stat_mode = STAT_MODE_STAT;
+    info->uring_depth = 0;
+    info->cache_path = NULL;
+    info->index_path = NULL;
+    info->flush_size = OUTBUF_DEFAULT_SIZE;
+    info->top = 0;
+    info->top_files = 0;
+    info->format = SINK_TEXT;
+    info->stats_format = STATS_TEXT;
+    info->device_jobs = 1;
+    info->jobs = 1;
+    info->workers = 0;
+    info->worker_timeout = PROCPOOL_TIMEOUT;
+    info->estimate_error = ESTIMATE_ERROR;
+    info->refine = 0;
+    info->deadline = 0;
+    info->checkpoint_path = NULL;
+    info->checkpoint_interval = CHECKPOINT_INTERVAL;
+    info->resume_path = NULL;
+    info->columns.size = 0;
+    info->exclude_fstype = NULL;
+    info->excludes = NULL;
+    info->excludes_size = 0;
 }
 
 void free_parse_info(parse_info_t *info) {
@@ -25,6 +55,20 @@ void free_parse_info(parse_info_t *info) {
     for (int i = 0; i < info->paths_size; i++) {
         if (info->paths[i] != NULL) free(info->paths[i]);
     }
+    free(info->cache_path);
+    info->cache_path = NULL;
+    free(info->index_path);
+    info->index_path = NULL;
+    free(info->checkpoint_path);
+    info->checkpoint_path = NULL;
+    free(info->resume_path);
+    info->resume_path = NULL;
+    free(info->exclude_fstype);
+    info->exclude_fstype = NULL;
+    for (int i = 0; i < info->excludes_size; i++) free(info->excludes[i]);
+    free(info->excludes);
+    info->excludes = NULL;
+    info->excludes_size = 0;
 }
 
 void parse_info_addpath(parse_info_t *info, char *path) {
@@ -37,47 +81,83 @@ void parse_info_addpath(parse_info_t *info, char *path) {
     info->paths[info->paths_size++] = strdup(path);
 }
 
-char **build_argv(char *argv0, int flags, parse_info_t *info) {
+char **build_argv(arena_t *arena, char *argv0, int flags,
+                  const parse_info_t *info, char *path, int max_depth) {
     int n = 1;  // argv size initialized with 1 for argv0
     for (int i = 0, k = 1; i < 7; i++, k <<= 1) {  // ignore path flag
         n += ((flags & k) != 0);  // add space for each flag activated
     }
-    n = n + info->paths_size;  // add space for paths
-    n = n + 1;                 // add space for null pointer
-    char **cmd = (char **)malloc(sizeof(char *) * n);
-
-    cmd[0] = strdup(argv0);
+    n += ((flags & FLAG_STATMODE) != 0);
+    n += ((flags & FLAG_URING) != 0);
+    n += ((flags & FLAG_FLUSHSIZE) != 0);
+    n += ((flags & FLAG_STATS) != 0);
+    n += ((flags & FLAG_ONEFS) != 0);
+    n += ((flags & FLAG_EXCLFS) != 0);
+    n += ((flags & FLAG_JOBS) != 0);
+    n += info->excludes_size;
+    n = n + 1;  // add space for path
+    n = n + 1;  // add space for null pointer
+    char **cmd = (char **)arena_alloc(arena, sizeof(char *) * n);
+    if (cmd == NULL) return NULL;
+
+    // Options without a value aren't copied, nothing in the vector is freed
+    cmd[0] = argv0;
     int i = 1;
     if (flags & FLAG_LINKS) {
-        cmd[i++] = strdup("--count-links");
+        cmd[i++] = "--count-links";
     }
     if (flags & FLAG_ALL) {
-        cmd[i++] = strdup("--all");
+        cmd[i++] = "--all";
     }
     if (flags & FLAG_BYTES) {
-        cmd[i++] = strdup("--bytes");
+        cmd[i++] = "--bytes";
     }
     if (flags & FLAG_BSIZE) {
-        char num[50];
-        sprintf(num, "%d", info->block_size);
-        cmd[i++] = str_cat("--block-size=", num, strlen(num));
+        cmd[i++] = arena_printf(arena, "--block-size=%d", info->block_size);
     }
     if (flags & FLAG_DEREF) {
-        cmd[i++] = strdup("--dereference");
+        cmd[i++] = "--dereference";
     }
     if (flags & FLAG_SEPDIR) {
-        cmd[i++] = strdup("--separate-dirs");
+        cmd[i++] = "--separate-dirs";
     }
     if (flags & FLAG_MAXDEPTH) {
-        char num[50];
-        sprintf(num, "%d", info->max_depth);
-        cmd[i++] = str_cat("--max-depth=", num, strlen(num));
+        cmd[i++] = arena_printf(arena, "--max-depth=%d", max_depth);
+    }
+    if (flags & FLAG_STATMODE) {
+        char *modes[] = {"stat", "statx", "nosync"};
+        cmd[i++] = arena_printf(arena, "--stat-mode=%s", modes[info->stat_mode]);
+    }
+    if (flags & FLAG_URING) {
+        cmd[i++] = arena_printf(arena, "--uring=%d", info->uring_depth);
+    }
+    if (flags & FLAG_FLUSHSIZE) {
+        cmd[i++] = arena_printf(arena, "--flush-size=%d", info->flush_size);
+    }
+    if (flags & FLAG_STATS) {
+        // Subprocesses only send their counters, the format doesn't matter
+        cmd[i++] = "--stats";
+    }
+    if (flags & FLAG_ONEFS) {
+        cmd[i++] = "--one-file-system";
+    }
+    if (flags & FLAG_EXCLFS) {
+        cmd[i++] = arena_printf(arena, "--exclude-fstype=%s",
+                                info->exclude_fstype);
     }
-    for (int j = 0; j < info->paths_size; j++) {
-        cmd[i++] = strdup(info->paths[j]);
+    if (flags & FLAG_JOBS) {
+        cmd[i++] = arena_printf(arena, "--jobs=%d", info->jobs);
     }
+    // Each subprocess compiles the patterns again
+    for (int j = 0; j < info->excludes_size; j++) {
+        cmd[i++] = info->excludes[j];
+    }
+    cmd[i++] = path;
     cmd[i] = NULL;
 
+    for (int j = 1; j < i; j++) {
+        if (cmd[j] == NULL) return NULL;
+    }
     return cmd;
 }
 
@@ -102,6 +182,46 @@ int parse_cmd(int argc, char *argv[], parse_info_t *info) {
             flags |= FLAG_BYTES;   // update flag
         } else if (strcmp(argv[i], "--count-links") == 0) {
             flags |= FLAG_LINKS;
+        } else if (strcmp(argv[i], "--one-file-system") == 0) {
+            flags |= FLAG_ONEFS;  // update flag
+        } else if (strncmp(argv[i], "--exclude=", 10) == 0 ||
+                   strncmp(argv[i], "--exclude-from=", 15) == 0) {
+            char *tmp = argv[i] + (argv[i][9] == '=' ? 10 : 15);
+
+            if (strlen(tmp) == 0) {
+                write(STDERR_FILENO,
+                      "Flag --exclude or --exclude-from must have a pattern "
+                      "or a path\n",
+                      63);
+                flags |= FLAG_ERR;
+                return flags;
+            }
+
+            char **excludes = (char **)realloc(
+                info->excludes, sizeof(char *) * (info->excludes_size + 1));
+            if (excludes == NULL) {
+                write(STDERR_FILENO, "Out of memory\n", 14);
+                flags |= FLAG_ERR;
+                return flags;
+            }
+            info->excludes = excludes;
+            info->excludes[info->excludes_size++] = strdup(argv[i]);
+
+            flags |= FLAG_EXCLUDE;  // update flag
+        } else if (strncmp(argv[i], "--exclude-fstype=", 17) == 0) {
+            char *tmp = argv[i] + 17;  // skip "--exclude-fstype="
+
+            if (strlen(tmp) == 0) {
+                write(STDERR_FILENO,
+                      "Flag --exclude-fstype must have a list of types\n", 48);
+                flags |= FLAG_ERR;
+                return flags;
+            }
+
+            free(info->exclude_fstype);
+            info->exclude_fstype = strdup(tmp);
+
+            flags |= FLAG_EXCLFS;  // update flag
         } else if (strncmp(argv[i], "--block-size=", 13) == 0) {
             char *tmp = argv[i] + 13;  // skip "--block-size="
 
@@ -133,6 +253,315 @@ int parse_cmd(int argc, char *argv[], parse_info_t *info) {
             sscanf(tmp, "%d", &(info->max_depth));
 
             flags |= FLAG_MAXDEPTH;  // update flag
+        } else if (strncmp(argv[i], "--threads=", 10) == 0) {
+            char *tmp = argv[i] + 10;  // skip "--threads="
+
+            if (strlen(tmp) == 0 || str_isDigit(tmp) < 1) {
+                write(STDERR_FILENO, "Flag --threads must have an integer\n",
+                      36);
+                flags |= FLAG_ERR;
+                return flags;
+            }
+
+            // Every steal looks at the deque of each thread, more threads
+            // than that only add contention
+            if (strlen(tmp) > 4 || atoi(tmp) < 1 || atoi(tmp) > 1024) {
+                write(STDERR_FILENO,
+                      "Flag --threads must be between 1 and 1024\n", 42);
+                flags |= FLAG_ERR;
+                return flags;
+            }
+
+            info->threads = atoi(tmp);
+
+            flags |= FLAG_THREADS;  // update flag
+        } else if (strncmp(argv[i], "--stat-mode=", 12) == 0) {
+            char *tmp = argv[i] + 12;  // skip "--stat-mode="
+
+            if (strcmp(tmp, "stat") == 0) {
+                info->stat_mode = STAT_MODE_STAT;
+            } else if (strcmp(tmp, "statx") == 0) {
+                info->stat_mode = STAT_MODE_STATX;
+            } else if (strcmp(tmp, "nosync") == 0) {
+                info->stat_mode = STAT_MODE_NOSYNC;
+            } else {
+                write(STDERR_FILENO,
+                      "Flag --stat-mode must be stat, statx or nosync\n", 47);
+                flags |= FLAG_ERR;
+                return flags;
+            }
+
+            flags |= FLAG_STATMODE;  // update flag
+        } else if (strncmp(argv[i], "--uring=", 8) == 0) {
+            char *tmp = argv[i] + 8;  // skip "--uring="
+
+            if (strlen(tmp) == 0 || str_isDigit(tmp) < 1) {
+                write(STDERR_FILENO, "Flag --uring must have an integer\n",
+                      34);
+                flags |= FLAG_ERR;
+                return flags;
+            }
+
+            sscanf(tmp, "%d", &(info->uring_depth));
+
+            if (info->uring_depth < 1 || info->uring_depth > 4096) {
+                write(STDERR_FILENO, "Flag --uring must be between 1 and 4096\n",
+                      40);
+                flags |= FLAG_ERR;
+                return flags;
+            }
+
+            flags |= FLAG_URING;  // update flag
+        } else if (strncmp(argv[i], "--cache=", 8) == 0) {
+            char *tmp = argv[i] + 8;  // skip "--cache="
+
+            if (strlen(tmp) == 0) {
+                write(STDERR_FILENO, "Flag --cache must have a path\n", 30);
+                flags |= FLAG_ERR;
+                return flags;
+            }
+
+            free(info->cache_path);
+            info->cache_path = strdup(tmp);
+
+            flags |= FLAG_CACHE;  // update flag
+        } else if (strncmp(argv[i], "--save-index=", 13) == 0) {
+            char *tmp = argv[i] + 13;  // skip "--save-index="
+
+            if (strlen(tmp) == 0) {
+                write(STDERR_FILENO, "Flag --save-index must have a path\n",
+                      35);
+                flags |= FLAG_ERR;
+                return flags;
+            }
+
+            free(info->index_path);
+            info->index_path = strdup(tmp);
+
+            flags |= FLAG_INDEX;  // update flag
+        } else if (strncmp(argv[i], "--flush-size=", 13) == 0) {
+            char *tmp = argv[i] + 13;  // skip "--flush-size="
+
+            if (strlen(tmp) == 0 || str_isDigit(tmp) < 1 || strlen(tmp) > 9) {
+                write(STDERR_FILENO, "Flag --flush-size must have an integer\n",
+                      39);
+                flags |= FLAG_ERR;
+                return flags;
+            }
+
+            sscanf(tmp, "%d", &(info->flush_size));
+
+            if (info->flush_size > OUTBUF_MAX_SIZE) {
+                write(STDERR_FILENO,
+                      "Flag --flush-size must be at most 16777216\n", 43);
+                flags |= FLAG_ERR;
+                return flags;
+            }
+
+            flags |= FLAG_FLUSHSIZE;  // update flag
+        } else if (strncmp(argv[i], "--top=", 6) == 0 ||
+                   strncmp(argv[i], "--top-files=", 12) == 0) {
+            int files = argv[i][5] == '-';
+            char *tmp = argv[i] + (files ? 12 : 6);  // skip "--top[-files]="
+
+            if (strlen(tmp) == 0 || str_isDigit(tmp) < 1 || strlen(tmp) > 9 ||
+                atoi(tmp) < 1) {
+                write(STDERR_FILENO,
+                      "Flag --top or --top-files must have a positive integer\n",
+                      55);
+                flags |= FLAG_ERR;
+                return flags;
+            }
+
+            if (files) {
+                info->top_files = atoi(tmp);
+                flags |= FLAG_TOPFILES;  // update flag
+            } else {
+                info->top = atoi(tmp);
+                flags |= FLAG_TOP;  // update flag
+            }
+        } else if (strncmp(argv[i], "--device-jobs=", 14) == 0) {
+            char *tmp = argv[i] + 14;  // skip "--device-jobs="
+
+            if (strlen(tmp) == 0 || str_isDigit(tmp) < 1 || strlen(tmp) > 4 ||
+                atoi(tmp) < 1) {
+                write(STDERR_FILENO,
+                      "Flag --device-jobs must have a positive integer\n", 48);
+                flags |= FLAG_ERR;
+                return flags;
+            }
+
+            info->device_jobs = atoi(tmp);
+            flags |= FLAG_DEVJOBS;  // update flag
+        } else if (strncmp(argv[i], "--jobs=", 7) == 0) {
+            char *tmp = argv[i] + 7;  // skip "--jobs="
+
+            if (strlen(tmp) == 0 || str_isDigit(tmp) < 1 || strlen(tmp) > 4 ||
+                atoi(tmp) < 1) {
+                write(STDERR_FILENO,
+                      "Flag --jobs must have a positive integer\n", 41);
+                flags |= FLAG_ERR;
+                return flags;
+            }
+
+            info->jobs = atoi(tmp);
+            flags |= FLAG_JOBS;  // update flag
+        } else if (strncmp(argv[i], "--workers=", 10) == 0) {
+            char *tmp = argv[i] + 10;  // skip "--workers="
+
+            if (strlen(tmp) == 0 || str_isDigit(tmp) < 1 || strlen(tmp) > 4 ||
+                atoi(tmp) < 1) {
+                write(STDERR_FILENO,
+                      "Flag --workers must have a positive integer\n", 44);
+                flags |= FLAG_ERR;
+                return flags;
+            }
+
+            info->workers = atoi(tmp);
+            flags |= FLAG_WORKERS;  // update flag
+        } else if (strncmp(argv[i], "--worker-timeout=", 17) == 0) {
+            char *tmp = argv[i] + 17;  // skip "--worker-timeout="
+
+            if (strlen(tmp) == 0 || str_isDigit(tmp) < 1 || strlen(tmp) > 6 ||
+                atoi(tmp) < 1) {
+                write(STDERR_FILENO,
+                      "Flag --worker-timeout must have a positive integer\n",
+                      51);
+                flags |= FLAG_ERR;
+                return flags;
+            }
+
+            info->worker_timeout = atoi(tmp);
+        } else if (strncmp(argv[i], "--format=", 9) == 0) {
+            char *tmp = argv[i] + 9;  // skip "--format="
+
+            if ((info->format = sink_find(tmp)) == -1) {
+                write(STDERR_FILENO,
+                      "Flag --format must be text, ndjson, csv or bin\n", 47);
+                flags |= FLAG_ERR;
+                return flags;
+            }
+
+            flags |= FLAG_FORMAT;  // update flag
+        } else if (strncmp(argv[i], "--columns=", 10) == 0) {
+            char *tmp = argv[i] + 10;  // skip "--columns="
+
+            if (sink_parse_columns(tmp, &info->columns)) {
+                write(STDERR_FILENO,
+                      "Flag --columns must be a list of size, blocks, "
+                      "apparent, count or hist\n",
+                      71);
+                flags |= FLAG_ERR;
+                return flags;
+            }
+        } else if (strcmp(argv[i], "--stats") == 0 ||
+                   strncmp(argv[i], "--stats=", 8) == 0) {
+            char *tmp = argv[i] + 7;  // skip "--stats"
+
+            if (strcmp(tmp, "") == 0 || strcmp(tmp, "=text") == 0) {
+                info->stats_format = STATS_TEXT;
+            } else if (strcmp(tmp, "=json") == 0) {
+                info->stats_format = STATS_JSON;
+            } else {
+                write(STDERR_FILENO, "Flag --stats must be text or json\n",
+                      34);
+                flags |= FLAG_ERR;
+                return flags;
+            }
+
+            flags |= FLAG_STATS;  // update flag
+        } else if (strcmp(argv[i], "--estimate") == 0 ||
+                   strncmp(argv[i], "--estimate=", 11) == 0) {
+            char *tmp = argv[i] + 10;  // skip "--estimate"
+
+            if (*tmp == '=') {
+                char *end;
+                info->estimate_error = strtod(tmp + 1, &end);
+                if (end == tmp + 1 || *end != '\0' ||
+                    !(info->estimate_error > 0 && info->estimate_error < 1)) {
+                    write(STDERR_FILENO,
+                          "Flag --estimate must be between 0 and 1\n", 40);
+                    flags |= FLAG_ERR;
+                    return flags;
+                }
+            }
+
+            flags |= FLAG_ESTIMATE;  // update flag
+        } else if (strncmp(argv[i], "--refine=", 9) == 0) {
+            char *tmp = argv[i] + 9;  // skip "--refine="
+
+            if (strlen(tmp) == 0 || str_isDigit(tmp) < 1 || strlen(tmp) > 6 ||
+                atoi(tmp) < 1) {
+                write(STDERR_FILENO,
+                      "Flag --refine must have a positive integer\n", 43);
+                flags |= FLAG_ERR;
+                return flags;
+            }
+
+            info->refine = atoi(tmp);
+        } else if (strncmp(argv[i], "--deadline=", 11) == 0) {
+            char *tmp = argv[i] + 11;  // skip "--deadline="
+            char *end;
+
+            info->deadline = strtod(tmp, &end);
+            if (end == tmp || *end != '\0' ||
+                !(info->deadline > 0 && info->deadline < 1e6)) {
+                write(STDERR_FILENO,
+                      "Flag --deadline must have a positive number of "
+                      "seconds\n",
+                      55);
+                flags |= FLAG_ERR;
+                return flags;
+            }
+
+            flags |= FLAG_DEADLINE;  // update flag
+        } else if (strncmp(argv[i], "--checkpoint=", 13) == 0) {
+            char *tmp = argv[i] + 13;  // skip "--checkpoint="
+
+            if (strlen(tmp) == 0) {
+                write(STDERR_FILENO, "Flag --checkpoint must have a path\n",
+                      35);
+                flags |= FLAG_ERR;
+                return flags;
+            }
+
+            free(info->checkpoint_path);
+            info->checkpoint_path = strdup(tmp);
+
+            flags |= FLAG_CHECKPOINT;  // update flag
+        } else if (strncmp(argv[i], "--checkpoint-interval=", 22) == 0) {
+            char *tmp = argv[i] + 22;  // skip "--checkpoint-interval="
+
+            if (strlen(tmp) == 0 || str_isDigit(tmp) < 1 || strlen(tmp) > 6 ||
+                atoi(tmp) < 1) {
+                write(STDERR_FILENO,
+                      "Flag --checkpoint-interval must have a positive "
+                      "integer\n",
+                      56);
+                flags |= FLAG_ERR;
+                return flags;
+            }
+
+            info->checkpoint_interval = atoi(tmp);
+        } else if (strncmp(argv[i], "--resume=", 9) == 0) {
+            char *tmp = argv[i] + 9;  // skip "--resume="
+
+            if (strlen(tmp) == 0) {
+                write(STDERR_FILENO, "Flag --resume must have a path\n", 31);
+                flags |= FLAG_ERR;
+                return flags;
+            }
+
+            free(info->resume_path);
+            info->resume_path = strdup(tmp);
+
+            flags |= FLAG_CHECKPOINT;  // update flag
+        } else if (strcmp(argv[i], "--watch") == 0) {
+            flags |= FLAG_WATCH;  // update flag
+        } else if (strcmp(argv[i], "--verify") == 0) {
+            flags |= FLAG_VERIFY;  // update flag
+        } else if (strcmp(argv[i], "--inode-stats") == 0) {
+            flags |= FLAG_INODESTATS;  // update flag
         } else if (strncmp(argv[i], "-", 1) == 0) {
             char *tmp = argv[i] + 1;  // skip "-"
 
@@ -176,6 +605,9 @@ int parse_cmd(int argc, char *argv[], parse_info_t *info) {
             if (str_find(tmp, "S", 0) >= 0) {
                 flags |= FLAG_SEPDIR;  // update flag
             }
+            if (str_find(tmp, "x", 0) >= 0) {
+                flags |= FLAG_ONEFS;  // update flag
+            }
             if (str_find(tmp, "B", 0) >= 0) {
                 if (i + 1 >= argc || strlen(argv[i + 1]) == 0 ||
                     str_isDigit(argv[i + 1]) < 1) {
@@ -209,14 +641,102 @@ int parse_cmd(int argc, char *argv[], parse_info_t *info) {
         }
     }
 
-    // Obligatory flag -l
-    if ((flags & FLAG_LINKS) == 0) {
-        write(STDERR_FILENO, "Missing obligatory flag: -l or --count-links\n",
+    if ((flags & FLAG_VERIFY) && (flags & FLAG_CACHE) == 0) {
+        write(STDERR_FILENO, "Flag --verify needs --cache\n", 28);
+        flags |= FLAG_ERR;
+        return flags;
+    }
+
+    if ((flags & FLAG_WATCH) && (flags & FLAG_CACHE)) {
+        write(STDERR_FILENO, "Flag --watch can't be used with --cache\n", 40);
+        flags |= FLAG_ERR;
+        return flags;
+    }
+
+    if ((flags & FLAG_WATCH) && (flags & FLAG_INDEX)) {
+        write(STDERR_FILENO, "Flag --watch can't be used with --save-index\n",
               45);
         flags |= FLAG_ERR;
         return flags;
     }
 
+    if ((flags & FLAG_ESTIMATE) &&
+        ((flags & (FLAG_WATCH | FLAG_CACHE | FLAG_INDEX | FLAG_TOP |
+                   FLAG_TOPFILES)) ||
+         info->format != SINK_TEXT)) {
+        write(STDERR_FILENO,
+              "Flag --estimate can't be used with --watch, --cache, "
+              "--save-index, --top or --format\n",
+              85);
+        flags |= FLAG_ERR;
+        return flags;
+    }
+
+    if ((flags & FLAG_DEADLINE) && (flags & (FLAG_WATCH | FLAG_ESTIMATE))) {
+        write(STDERR_FILENO,
+              "Flag --deadline can't be used with --watch or --estimate\n",
+              57);
+        flags |= FLAG_ERR;
+        return flags;
+    }
+
+    if ((flags & FLAG_CHECKPOINT) &&
+        (flags & (FLAG_WATCH | FLAG_ESTIMATE | FLAG_INDEX | FLAG_DEADLINE |
+                  FLAG_TOP | FLAG_TOPFILES))) {
+        write(STDERR_FILENO,
+              "Flag --checkpoint can't be used with --watch, --estimate, "
+              "--save-index, --deadline or --top\n",
+              92);
+        flags |= FLAG_ERR;
+        return flags;
+    }
+
+    // A resumed traversal goes on saving to the checkpoint it was read from
+    if (info->resume_path != NULL && info->checkpoint_path == NULL) {
+        info->checkpoint_path = strdup(info->resume_path);
+    }
+
+    // Other formats write every field, ndjson adds hist if it is a column
+    if (info->columns.size > 0 && (flags & (FLAG_WATCH | FLAG_ESTIMATE))) {
+        write(STDERR_FILENO,
+              "Flag --columns can't be used with --watch or --estimate\n",
+              56);
+        flags |= FLAG_ERR;
+        return flags;
+    }
+
+    // The tops keep their entries after the directories are freed
+    if (sink_has_column(&info->columns, SINK_COL_HIST) &&
+        (flags & (FLAG_TOP | FLAG_TOPFILES))) {
+        write(STDERR_FILENO, "Column hist can't be used with --top\n", 37);
+        flags |= FLAG_ERR;
+        return flags;
+    }
+
+    if (info->refine > 0 && (flags & FLAG_ESTIMATE) == 0) {
+        write(STDERR_FILENO, "Flag --refine needs --estimate\n", 31);
+        flags |= FLAG_ERR;
+        return flags;
+    }
+
+    if ((flags & FLAG_TOPFILES) && (flags & FLAG_ALL) == 0) {
+        write(STDERR_FILENO, "Flag --top-files needs -a\n", 26);
+        flags |= FLAG_ERR;
+        return flags;
+    }
+
+    if ((flags & FLAG_WATCH) && (flags & (FLAG_TOP | FLAG_TOPFILES))) {
+        write(STDERR_FILENO, "Flag --watch can't be used with --top\n", 38);
+        flags |= FLAG_ERR;
+        return flags;
+    }
+
+    if ((flags & FLAG_WATCH) && info->format != SINK_TEXT) {
+        write(STDERR_FILENO, "Flag --watch only writes text\n", 30);
+        flags |= FLAG_ERR;
+        return flags;
+    }
+
     if (info->paths_size == 0) {
         parse_info_addpath(info, ".");
     }
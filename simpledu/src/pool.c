@@ -0,0 +1,252 @@
+/* MAIN HEADER */
+#include "pool.h"
+
+/* INCLUDE HEADERS */
+
+/* SYSTEM CALLS HEADERS */
+#include <pthread.h>
+
+/* C LIBRARY HEADERS */
+#include <stdatomic.h>
+#include <stdlib.h>
+
+#define DEQUE_INIT_SIZE 64
+
+/**
+ * @brief Circular deque owned by one worker
+ *        top is where thieves steal, bottom is where the owner pushes and pops
+ */
+typedef struct deque {
+    pthread_mutex_t   lock;
+    void            **tasks;
+    long              top;
+    long              bottom;
+    long              memsize;
+} deque_t;
+
+struct pool {
+    deque_t        *deques;
+    int             workers;
+    pool_task_fn    fn;
+    void           *ctx;
+
+    atomic_long     queued;     // tasks inside the deques
+    atomic_long     pending;    // tasks queued or running
+    atomic_int      idle;       // workers sleeping on wake
+    atomic_int      held;       // workers only take from their own deque
+
+    pthread_mutex_t idle_lock;
+    pthread_cond_t  wake;
+};
+
+typedef struct worker_arg {
+    pool_t *pool;
+    int     index;
+} worker_arg_t;
+
+static int deque_init(deque_t *deque) {
+    deque->tasks = (void **)malloc(sizeof(void *) * DEQUE_INIT_SIZE);
+    if (deque->tasks == NULL) return -1;
+    deque->top = 0;
+    deque->bottom = 0;
+    deque->memsize = DEQUE_INIT_SIZE;
+    return pthread_mutex_init(&deque->lock, NULL) ? -1 : 0;
+}
+
+static void deque_free(deque_t *deque) {
+    pthread_mutex_destroy(&deque->lock);
+    free(deque->tasks);
+}
+
+static int deque_push(deque_t *deque, void *task) {
+    pthread_mutex_lock(&deque->lock);
+    if (deque->bottom - deque->top == deque->memsize) {
+        void **tasks = (void **)malloc(sizeof(void *) * deque->memsize * 2);
+        if (tasks == NULL) {
+            pthread_mutex_unlock(&deque->lock);
+            return -1;
+        }
+        for (long i = deque->top; i < deque->bottom; i++) {
+            tasks[i % (deque->memsize * 2)] = deque->tasks[i % deque->memsize];
+        }
+        free(deque->tasks);
+        deque->tasks = tasks;
+        deque->memsize *= 2;
+    }
+    deque->tasks[deque->bottom % deque->memsize] = task;
+    deque->bottom++;
+    pthread_mutex_unlock(&deque->lock);
+    return 0;
+}
+
+static void* deque_pop(deque_t *deque) {
+    void *task = NULL;
+    pthread_mutex_lock(&deque->lock);
+    if (deque->bottom > deque->top) {
+        deque->bottom--;
+        task = deque->tasks[deque->bottom % deque->memsize];
+    }
+    pthread_mutex_unlock(&deque->lock);
+    return task;
+}
+
+static void* deque_steal(deque_t *deque) {
+    void *task = NULL;
+    if (pthread_mutex_trylock(&deque->lock)) return NULL;
+    if (deque->bottom > deque->top) {
+        task = deque->tasks[deque->top % deque->memsize];
+        deque->top++;
+    }
+    pthread_mutex_unlock(&deque->lock);
+    return task;
+}
+
+pool_t* pool_create(int workers, pool_task_fn fn, void *ctx) {
+    if (workers < 1 || fn == NULL) return NULL;
+
+    pool_t *pool = (pool_t *)malloc(sizeof(pool_t));
+    if (pool == NULL) return NULL;
+
+    pool->deques = (deque_t *)malloc(sizeof(deque_t) * workers);
+    if (pool->deques == NULL) {
+        free(pool);
+        return NULL;
+    }
+    for (int i = 0; i < workers; i++) {
+        if (deque_init(&pool->deques[i])) {
+            for (int j = 0; j < i; j++) deque_free(&pool->deques[j]);
+            free(pool->deques);
+            free(pool);
+            return NULL;
+        }
+    }
+
+    pool->workers = workers;
+    pool->fn = fn;
+    pool->ctx = ctx;
+    atomic_init(&pool->queued, 0);
+    atomic_init(&pool->pending, 0);
+    atomic_init(&pool->idle, 0);
+    atomic_init(&pool->held, 0);
+    pthread_mutex_init(&pool->idle_lock, NULL);
+    pthread_cond_init(&pool->wake, NULL);
+
+    return pool;
+}
+
+int pool_push(pool_t *pool, int worker, void *task) {
+    atomic_fetch_add(&pool->pending, 1);
+    if (deque_push(&pool->deques[worker % pool->workers], task)) {
+        atomic_fetch_sub(&pool->pending, 1);
+        return -1;
+    }
+    atomic_fetch_add(&pool->queued, 1);
+
+    // queued is written before idle is read, a worker going to sleep does the
+    // opposite, so at least one of both sees the other
+    if (atomic_load(&pool->idle) > 0) {
+        pthread_mutex_lock(&pool->idle_lock);
+        pthread_cond_signal(&pool->wake);
+        pthread_mutex_unlock(&pool->idle_lock);
+    }
+    return 0;
+}
+
+long pool_queued(pool_t *pool) { return atomic_load(&pool->queued); }
+
+void pool_hold(pool_t *pool, int hold) {
+    if (atomic_exchange(&pool->held, hold) == hold || hold) return;
+    pthread_mutex_lock(&pool->idle_lock);
+    pthread_cond_broadcast(&pool->wake);
+    pthread_mutex_unlock(&pool->idle_lock);
+}
+
+static void* pool_take(pool_t *pool, int worker) {
+    void *task = deque_pop(&pool->deques[worker]);
+    int held = atomic_load_explicit(&pool->held, memory_order_relaxed);
+    for (int i = 1; task == NULL && !held && i < pool->workers; i++) {
+        task = deque_steal(&pool->deques[(worker + i) % pool->workers]);
+    }
+    if (task != NULL) atomic_fetch_sub(&pool->queued, 1);
+    return task;
+}
+
+static void pool_work(pool_t *pool, int worker) {
+    while (1) {
+        void *task = pool_take(pool, worker);
+
+        if (task != NULL) {
+            pool->fn(pool->ctx, task, worker);
+            if (atomic_fetch_sub(&pool->pending, 1) == 1) {
+                // Last task finished, wake everyone so they can leave
+                pthread_mutex_lock(&pool->idle_lock);
+                pthread_cond_broadcast(&pool->wake);
+                pthread_mutex_unlock(&pool->idle_lock);
+            }
+            continue;
+        }
+
+        pthread_mutex_lock(&pool->idle_lock);
+        atomic_fetch_add(&pool->idle, 1);
+        // A held worker waits for the release or the end, nothing is pushed
+        // to its deque while it doesn't run
+        while ((atomic_load(&pool->queued) == 0 ||
+                atomic_load(&pool->held)) &&
+               atomic_load(&pool->pending) > 0) {
+            pthread_cond_wait(&pool->wake, &pool->idle_lock);
+        }
+        atomic_fetch_sub(&pool->idle, 1);
+        pthread_mutex_unlock(&pool->idle_lock);
+
+        if (atomic_load(&pool->pending) == 0) break;
+    }
+}
+
+static void* pool_thread(void *arg) {
+    worker_arg_t *warg = (worker_arg_t *)arg;
+    pool_work(warg->pool, warg->index);
+    return NULL;
+}
+
+int pool_run(pool_t *pool) {
+    pthread_t *threads = NULL;
+    worker_arg_t *args = NULL;
+    int created = 0;  // workers that couldn't be created leave their deque to thieves
+
+    if (pool->workers > 1) {
+        threads = (pthread_t *)malloc(sizeof(pthread_t) * pool->workers);
+        args = (worker_arg_t *)malloc(sizeof(worker_arg_t) * pool->workers);
+        if (threads == NULL || args == NULL) {
+            free(threads);
+            free(args);
+            return -1;
+        }
+        for (int i = 1; i < pool->workers; i++) {
+            args[i].pool = pool;
+            args[i].index = i;
+            if (pthread_create(&threads[i], NULL, pool_thread, &args[i])) {
+                break;
+            }
+            created++;
+        }
+    }
+
+    pool_work(pool, 0);
+
+    for (int i = 1; i <= created; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    free(threads);
+    free(args);
+
+    return 0;
+}
+
+void pool_destroy(pool_t *pool) {
+    if (pool == NULL) return;
+    for (int i = 0; i < pool->workers; i++) deque_free(&pool->deques[i]);
+    free(pool->deques);
+    pthread_mutex_destroy(&pool->idle_lock);
+    pthread_cond_destroy(&pool->wake);
+    free(pool);
+}
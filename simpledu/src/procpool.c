@@ -0,0 +1,349 @@
+/* MAIN HEADER */
+#include "procpool.h"
+
+/* INCLUDE HEADERS */
+#include "sig_handler.h"
+#include "uring.h"
+
+/* SYSTEM CALLS HEADERS */
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+/* C LIBRARY HEADERS */
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * @brief Start of every message of a worker
+ */
+typedef struct worker_head {
+    int32_t     last;       /**< @brief Last message of the job */
+    int32_t     error;      /**< @brief errno of opening the directory, in the last message */
+} worker_head_t;
+
+/**
+ * @brief Entry of a message, followed by its name and a null byte
+ */
+typedef struct worker_rec {
+    struct stat status;
+    int32_t     error;
+    uint32_t    d_type;
+    uint32_t    name_len;
+} worker_rec_t;
+
+static int worker_send(int sock, char *msg, size_t len, int last, int error) {
+    worker_head_t head = {last, error};
+    memcpy(msg, &head, sizeof(head));
+    while (send(sock, msg, len, MSG_NOSIGNAL) == -1) {
+        if (errno != EINTR) return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Receives a whole message, growing the buffer to its size
+ * @return Size of the message, 0 if the other end is closed, -1 upon error
+ */
+static ssize_t worker_recv(int sock, char **buf, size_t *memsize) {
+    ssize_t n;
+    while ((n = recv(sock, NULL, 0, MSG_PEEK | MSG_TRUNC)) == -1) {
+        if (errno != EINTR) return -1;
+    }
+    if ((size_t)n + 1 > *memsize) {
+        char *new_buf = (char *)realloc(*buf, n + 1);
+        if (new_buf == NULL) return -1;
+        *buf = new_buf;
+        *memsize = n + 1;
+    }
+    while ((n = recv(sock, *buf, *memsize, 0)) == -1) {
+        if (errno != EINTR) return -1;
+    }
+    return n;
+}
+
+/**
+ * @brief Body of a worker: reads the directories received until the socket
+ *        is closed, never returns
+ */
+static void worker_run(procpool_t *pp, int sock) {
+    char *job = NULL;
+    size_t job_memsize = 0;
+    char *msg = (char *)malloc(PROCPOOL_MSG_SIZE);
+    uring_t *ring = pp->uring_depth > 0 ? uring_create(pp->uring_depth) : NULL;
+    dir_scan_t scan;
+
+    if (msg == NULL) _exit(1);
+    if (dirscan_init(&scan, ring, pp->deref_sym)) {
+        dirscan_init(&scan, NULL, pp->deref_sym);
+    }
+    scan.exclude = pp->exclude;
+
+    ssize_t n;
+    while ((n = worker_recv(sock, &job, &job_memsize)) > 0) {
+        job[n] = '\0';
+        int only_dirs = job[0] == 'd';
+        size_t len = sizeof(worker_head_t);
+        int error = 0;
+
+        int fd = open(job + 1, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        DIR *dir = fd != -1 ? fdopendir(fd) : NULL;
+        if (dir == NULL) {
+            error = errno;
+            if (fd != -1) close(fd);
+        } else {
+            dir_entry_t *entry;
+            dirscan_start(&scan, dir);
+            while ((entry = only_dirs ? dirscan_next_dir(&scan)
+                                      : dirscan_next(&scan)) != NULL) {
+                worker_rec_t rec;
+                rec.name_len = strlen(entry->name);
+                size_t size = sizeof(rec) + rec.name_len + 1;
+                if (len + size > PROCPOOL_MSG_SIZE) {
+                    if (worker_send(sock, msg, len, 0, 0)) _exit(1);
+                    len = sizeof(worker_head_t);
+                }
+                rec.status = entry->status;
+                rec.error = entry->error;
+                rec.d_type = entry->d_type;
+                memcpy(msg + len, &rec, sizeof(rec));
+                memcpy(msg + len + sizeof(rec), entry->name, rec.name_len + 1);
+                len += size;
+            }
+            closedir(dir);
+        }
+        if (worker_send(sock, msg, len, 1, error)) _exit(1);
+    }
+    _exit(n == 0 ? 0 : 1);
+}
+
+/**
+ * @brief Forks the worker, it joins the group of the others
+ * @return 0 upon success, -1 otherwise
+ */
+static int worker_spawn(procpool_t *pp, int index) {
+    proc_worker_t *w = &pp->workers[index];
+    int sv[2];
+
+    w->pid = -1;
+    w->busy = 0;
+    if (socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, sv)) return -1;
+
+    pid_t pid = fork();
+    if (pid == -1) {
+        close(sv[0]);
+        close(sv[1]);
+        return -1;
+    }
+    if (pid == 0) {
+        // Only the main process asks about SIGINT and writes to the log
+        signal(SIGINT, SIG_IGN);
+        signal(SIGUSR1, SIG_IGN);
+        signal(SIGTERM, SIG_DFL);
+        signal(SIGCONT, SIG_DFL);
+        setpgid(0, pp->pgid);
+        // Ends of the other workers are closed so they see the main process
+        // closing them
+        for (int i = 0; i < pp->size; i++) {
+            if (pp->workers[i].sock != -1) close(pp->workers[i].sock);
+        }
+        close(sv[0]);
+        worker_run(pp, sv[1]);
+    }
+
+    close(sv[1]);
+    if (setpgid(pid, pp->pgid) && pp->pgid != 0) setpgid(pid, 0);
+    if (pp->pgid == 0 || getpgid(pid) == pid) pp->pgid = pid;
+    setGlobalProcess(pp->pgid);
+    w->pid = pid;
+    w->sock = sv[0];
+    return 0;
+}
+
+/**
+ * @brief Kills a worker that doesn't answer, or closed its end, and forks
+ *        it again
+ */
+static void worker_restart(procpool_t *pp, int index) {
+    proc_worker_t *w = &pp->workers[index];
+
+    pthread_mutex_lock(&pp->lock);
+    if (w->pid != -1) {
+        kill(w->pid, SIGKILL);
+        while (waitpid(w->pid, NULL, 0) == -1 && errno == EINTR) {}
+    }
+    if (w->sock != -1) close(w->sock);
+    w->sock = -1;
+    worker_spawn(pp, index);
+    pthread_mutex_unlock(&pp->lock);
+}
+
+/**
+ * @brief Waits for a message of the worker, the time the workers spent
+ *        stopped by SIGINT doesn't count
+ * @return 0 upon success, -1 otherwise
+ */
+static int worker_wait(procpool_t *pp, proc_worker_t *w) {
+    struct pollfd pfd = {w->sock, POLLIN, 0};
+    while (1) {
+        int pauses = sig_pauses();
+        int ret = poll(&pfd, 1, pp->timeout);
+        if (ret > 0) return 0;
+        if (ret == -1 && errno != EINTR) return -1;
+        if (ret == 0 && pauses == sig_pauses() && pauses % 2 == 0) {
+            errno = ETIMEDOUT;
+            return -1;
+        }
+    }
+}
+
+/**
+ * @brief Receives the next message of the job
+ * @return 0 upon success, -1 if the worker failed, it was forked again
+ */
+static int worker_next_msg(procpool_t *pp, int index) {
+    proc_worker_t *w = &pp->workers[index];
+    size_t memsize = PROCPOOL_MSG_SIZE;
+
+    ssize_t n = -1;
+    if (worker_wait(pp, w) == 0 &&
+        (n = worker_recv(w->sock, &w->msg, &memsize)) == 0) {
+        errno = ECONNRESET;
+    }
+    if (n < (ssize_t)sizeof(worker_head_t)) {
+        int error = errno;
+        worker_restart(pp, index);
+        errno = error;
+        return -1;
+    }
+
+    worker_head_t head;
+    memcpy(&head, w->msg, sizeof(head));
+    w->msg_len = n;
+    w->msg_pos = sizeof(head);
+    w->last = head.last;
+    w->error = head.error;
+    if (w->last) w->busy = 0;
+    return 0;
+}
+
+procpool_t* procpool_create(int workers, int timeout, int deref_sym,
+                            int uring_depth, const exclude_t *exclude) {
+    procpool_t *pp = (procpool_t *)malloc(sizeof(procpool_t));
+    if (pp == NULL) return NULL;
+    pp->workers = (proc_worker_t *)calloc(workers, sizeof(proc_worker_t));
+    if (pp->workers == NULL) {
+        free(pp);
+        return NULL;
+    }
+    pp->size = workers;
+    pp->timeout = timeout;
+    pp->deref_sym = deref_sym;
+    pp->uring_depth = uring_depth;
+    pp->exclude = exclude;
+    pp->pgid = 0;
+    pthread_mutex_init(&pp->lock, NULL);
+
+    for (int i = 0; i < workers; i++) {
+        pp->workers[i].pid = -1;
+        pp->workers[i].sock = -1;
+    }
+    for (int i = 0; i < workers; i++) {
+        // Messages of the worker are received in place, the name of the
+        // entry given points inside them
+        if ((pp->workers[i].msg = (char *)malloc(PROCPOOL_MSG_SIZE)) == NULL ||
+            worker_spawn(pp, i)) {
+            procpool_destroy(pp);
+            return NULL;
+        }
+    }
+    return pp;
+}
+
+int procpool_start(procpool_t *pp, int worker, const char *path,
+                   int only_dirs) {
+    proc_worker_t *w = &pp->workers[worker];
+
+    // Entries of a directory that failed half way
+    while (w->busy) {
+        if (worker_next_msg(pp, worker)) break;
+    }
+    if (w->pid == -1) {
+        errno = ECHILD;
+        return -1;
+    }
+
+    size_t len = strlen(path);
+    char *job = (char *)malloc(len + 1);
+    if (job == NULL) return -1;
+    job[0] = only_dirs ? 'd' : 'a';
+    memcpy(job + 1, path, len);
+
+    int ret;
+    while ((ret = send(w->sock, job, len + 1, MSG_NOSIGNAL)) == -1 &&
+           errno == EINTR) {}
+    free(job);
+    if (ret == -1) {
+        int error = errno;
+        worker_restart(pp, worker);
+        errno = error;
+        return -1;
+    }
+
+    w->busy = 1;
+    w->last = 0;
+    w->msg_len = 0;
+    w->msg_pos = 0;
+    return 0;
+}
+
+int procpool_next(procpool_t *pp, int worker, dir_entry_t **entry) {
+    proc_worker_t *w = &pp->workers[worker];
+
+    *entry = NULL;
+    while (w->msg_pos >= w->msg_len) {
+        if (w->last) {
+            if (w->error == 0) return 0;
+            errno = w->error;
+            return PROCPOOL_EOPEN;
+        }
+        if (worker_next_msg(pp, worker)) return -1;
+    }
+
+    worker_rec_t rec;
+    memcpy(&rec, w->msg + w->msg_pos, sizeof(rec));
+    w->entry.status = rec.status;
+    w->entry.error = rec.error;
+    w->entry.d_type = rec.d_type;
+    w->entry.name = w->msg + w->msg_pos + sizeof(rec);
+    w->msg_pos += sizeof(rec) + rec.name_len + 1;
+    *entry = &w->entry;
+    return 0;
+}
+
+void procpool_destroy(procpool_t *pp) {
+    if (pp == NULL) return;
+
+    // Idle workers end once their socket is closed, a busy one may hang
+    for (int i = 0; i < pp->size; i++) {
+        proc_worker_t *w = &pp->workers[i];
+        if (w->busy && w->pid != -1) kill(w->pid, SIGKILL);
+        if (w->sock != -1) close(w->sock);
+    }
+    for (int i = 0; i < pp->size; i++) {
+        proc_worker_t *w = &pp->workers[i];
+        if (w->pid != -1) {
+            while (waitpid(w->pid, NULL, 0) == -1 && errno == EINTR) {}
+        }
+        free(w->msg);
+    }
+    resetGlobalProcess();
+    pthread_mutex_destroy(&pp->lock);
+    free(pp->workers);
+    free(pp);
+}
@@ -0,0 +1,145 @@
+/* MAIN HEADER */
+#include "progress.h"
+
+/* INCLUDE HEADERS */
+#include "utils.h"
+
+/* SYSTEM CALLS HEADERS */
+#include <sys/mman.h>
+#include <unistd.h>
+
+/* C LIBRARY HEADERS */
+#include <errno.h>
+#include <stdatomic.h>
+#include <string.h>
+#include <time.h>
+
+/**
+ * @brief Counters of the whole traversal, in a file mapped by every process
+ *        of the process mode. Signed, a directory may be read by a
+ *        subprocess before its parent counts it as found
+ */
+typedef struct progress {
+    uint64_t                start_ns;   /**< @brief Monotonic clock of progress_create */
+    atomic_int_least64_t    entries;
+    atomic_int_least64_t    dirs;       /**< @brief Directories read */
+    atomic_int_least64_t    queued;     /**< @brief Directories found and not read yet */
+    atomic_int_least64_t    bytes;
+} progress_t;
+
+static progress_t local;
+static progress_t *progress = NULL;
+static int progress_file = -1;
+
+// Last report of the handler, the rate is the one since then
+static uint64_t last_ns = 0;
+static int64_t last_entries = 0;
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static progress_t* progress_map(int fd) {
+    void *map = mmap(NULL, sizeof(progress_t), PROT_READ | PROT_WRITE,
+                     MAP_SHARED, fd, 0);
+    return map == MAP_FAILED ? NULL : (progress_t *)map;
+}
+
+int progress_create(int shared) {
+    progress_t *p = &local;
+    if (shared) {
+        // Inherited through exec by every subprocess, like the inode set
+        int fd = memfd_create("simpledu-progress", 0);
+        if (fd == -1) return -1;
+        if (ftruncate(fd, sizeof(progress_t)) ||
+            (p = progress_map(fd)) == NULL) {
+            close(fd);
+            return -1;
+        }
+        progress_file = fd;
+    }
+
+    p->start_ns = now_ns();
+    atomic_init(&p->entries, 0);
+    atomic_init(&p->dirs, 0);
+    atomic_init(&p->queued, 0);
+    atomic_init(&p->bytes, 0);
+    last_ns = p->start_ns;
+    progress = p;
+    return 0;
+}
+
+int progress_attach(int fd) {
+    if (fd == -1 || (progress = progress_map(fd)) == NULL) return -1;
+    progress_file = fd;
+    return 0;
+}
+
+int progress_fd(void) { return progress_file; }
+
+void progress_found(long dirs) {
+    if (progress == NULL) return;
+    atomic_fetch_add_explicit(&progress->queued, dirs, memory_order_relaxed);
+}
+
+void progress_dir(long entries, uint64_t bytes, long found) {
+    if (progress == NULL) return;
+    atomic_fetch_add_explicit(&progress->entries, entries,
+                              memory_order_relaxed);
+    atomic_fetch_add_explicit(&progress->dirs, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&progress->queued, found - 1,
+                              memory_order_relaxed);
+    atomic_fetch_add_explicit(&progress->bytes, bytes, memory_order_relaxed);
+}
+
+static size_t append(char *buf, const char *str) {
+    size_t len = strlen(str);
+    memcpy(buf, str, len);
+    return len;
+}
+
+/**
+ * @brief Writes milliseconds as seconds with 3 decimals
+ */
+static size_t format_seconds(char *buf, uint64_t ms) {
+    size_t n = format_long(buf, (long)(ms / 1000));
+    buf[n++] = '.';
+    buf[n++] = '0' + ms / 100 % 10;
+    buf[n++] = '0' + ms / 10 % 10;
+    buf[n++] = '0' + ms % 10;
+    return n;
+}
+
+void progress_handler(int signo) {
+    (void)signo;
+    if (progress == NULL) return;
+
+    int error = errno;
+    uint64_t now = now_ns();
+    int64_t entries = atomic_load(&progress->entries);
+    int64_t queued = atomic_load(&progress->queued);
+    uint64_t elapsed = now - last_ns;
+    long rate = elapsed > 0 ? (long)((entries - last_entries) * 1e9 / elapsed)
+                            : 0;
+    last_ns = now;
+    last_entries = entries;
+
+    char buf[6 * (LONG_DECIMAL_SIZE + 16) + 64];
+    size_t n = append(buf, "simpledu: progress: ");
+    n += format_long(buf + n, (long)entries);
+    n += append(buf + n, " entries (");
+    n += format_long(buf + n, rate);
+    n += append(buf + n, "/s), ");
+    n += format_long(buf + n, (long)atomic_load(&progress->dirs));
+    n += append(buf + n, " directories read, ");
+    n += format_long(buf + n, queued > 0 ? (long)queued : 0);
+    n += append(buf + n, " queued, ");
+    n += format_long(buf + n, (long)atomic_load(&progress->bytes));
+    n += append(buf + n, " bytes, ");
+    n += format_seconds(buf + n, (now - progress->start_ns) / 1000000);
+    n += append(buf + n, " s\n");
+    write(STDERR_FILENO, buf, n);
+    errno = error;
+}
@@ -3,17 +3,30 @@
 
 /* INCLUDE HEADERS */
 #include "log.h"
+#include "outbuf.h"
 
 /* SYSTEM CALLS HEADERS */
+#include <pthread.h>
 #include <signal.h>
 #include <unistd.h>
 
 /* C LIBRARY HEADERS */
+#include <stdatomic.h>
 #include <stdio.h>
 #include <stdlib.h>
 
 int globalProcess = 0;
 int check_process = 0;
+// Odd while the subprocesses are stopped by SIGINT
+atomic_int pauses = 0;
+// Written by the handlers of SIGINT and SIGTERM, -1 if none
+atomic_int wake_fd = -1;
+
+// Set by the handlers, which do nothing else, and handled by sig_poll from a
+// point where no output is being written
+static volatile sig_atomic_t interrupted = 0;
+static volatile sig_atomic_t terminated = 0;
+static volatile sig_atomic_t continued = 0;
 
 void setGlobalProcess(int pgid) {
     globalProcess = pgid;
@@ -25,31 +38,56 @@ void resetGlobalProcess(void) {
     check_process = 0;
 }
 
-// Handler for SIGINT
-void sigint_handler(int signo) {
-    (void)signo;
+int sig_pauses(void) {
+    return atomic_load(&pauses);
+}
+
+void sig_setwake_fd(int fd) {
+    atomic_store(&wake_fd, fd);
+}
+
+int sig_pending(void) {
+    return interrupted || terminated;
+}
+
+int sig_interrupted(void) {
+    if (!interrupted) return 0;
+    interrupted = 0;
+    return 1;
+}
+
+int sig_terminated(void) {
+    return terminated;
+}
 
+int sig_prompt(void) {
     write_log("RECV_SIGNAL", "SIGINT\n");
 
     char ch[256];
 
+    atomic_fetch_add(&pauses, 1);
     if (check_process) {
         write_log_sign("SEND_SIGNAL", "SIGSTOP", globalProcess);
         // Send sigstops for every subprocess
         killpg(globalProcess, SIGSTOP);
     }
 
+    // Lines already printed come before the question
+    outbuf_flush(outbuf_stdout());
     write(STDOUT_FILENO, "\nAre you sure you want to exit the program?\n", 44);
     write(STDOUT_FILENO, "Press 'y' to confirm, anything else otherwise\n", 46);
 
+    int quit = 0;
     int n = read(STDIN_FILENO, ch, 256);
     if ((n == 2) && (ch[0] == 'y')) {
         if (check_process) {
             write_log_sign("SEND_SIGNAL", "SIGTERM", globalProcess);
             // Shutdown previous process
             killpg(globalProcess, SIGTERM);
+            // Stopped processes only receive it once continued
+            killpg(globalProcess, SIGCONT);
         }
-        raise(SIGTERM);
+        quit = 1;
     } else {
         if (check_process) {
             write_log_sign("SEND_SIGNAL", "SIGCONT", globalProcess);
@@ -57,20 +95,53 @@ void sigint_handler(int signo) {
             killpg(globalProcess, SIGCONT);
         }
     }
+    atomic_fetch_add(&pauses, 1);
+    return quit;
 }
 
-void siglog_handler(int signo) {
-    if (signo == SIGTERM) {
-        write_log("RECV_SIGNAL", "SIGTERM\n");
+void sig_terminate(void) {
+    write_log("RECV_SIGNAL", "SIGTERM\n");
+    outbuf_flush(outbuf_stdout());
+    flush_log();
 
-        struct sigaction newHandler;
+    struct sigaction newHandler;
 
-        newHandler.sa_handler = SIG_DFL;
-        sigemptyset(&newHandler.sa_mask);
-        newHandler.sa_flags = 0;
-        sigaction(SIGTERM, &newHandler, NULL);
-        raise(SIGTERM);
-    } else if (signo == SIGCONT) {
+    newHandler.sa_handler = SIG_DFL;
+    sigemptyset(&newHandler.sa_mask);
+    newHandler.sa_flags = 0;
+    sigaction(SIGTERM, &newHandler, NULL);
+
+    // Only the thread calling it may have the signal unblocked
+    sigset_t term;
+    sigemptyset(&term);
+    sigaddset(&term, SIGTERM);
+    pthread_sigmask(SIG_UNBLOCK, &term, NULL);
+    raise(SIGTERM);
+}
+
+void sig_poll(void) {
+    if (continued) {
+        continued = 0;
         write_log("RECV_SIGNAL", "SIGCONT\n");
     }
+    if (terminated) sig_terminate();
+    if (sig_interrupted() && sig_prompt()) sig_terminate();
+}
+
+// Handler for SIGINT
+void sigint_handler(int signo) {
+    (void)signo;
+    interrupted = 1;
+    int fd = atomic_load(&wake_fd);
+    if (fd != -1) write(fd, "i", 1);
+}
+
+void siglog_handler(int signo) {
+    if (signo == SIGTERM) {
+        terminated = 1;
+        int fd = atomic_load(&wake_fd);
+        if (fd != -1) write(fd, "t", 1);
+    } else if (signo == SIGCONT) {
+        continued = 1;
+    }
 }
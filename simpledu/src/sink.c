@@ -0,0 +1,309 @@
+/* MAIN HEADER */
+#include "sink.h"
+
+/* INCLUDE HEADERS */
+#include "utils.h"
+
+/* SYSTEM CALLS HEADERS */
+
+/* C LIBRARY HEADERS */
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define NUMBERS_SIZE 256    /** @brief Bytes of a record besides the path and the histogram */
+#define HIST_SIZE (SINK_HIST_BUCKETS * (LONG_DECIMAL_SIZE + 1))   /** @brief Bytes of a histogram at most */
+
+static const char *type_names[] = {"file", "dir", "link"};
+static const char *column_names[] = {"size", "blocks", "apparent", "count",
+                                     "hist"};
+
+// Columns of the text format, none writes the size alone
+static sink_columns_t text_columns = {{0}, 0};
+
+/**
+ * @brief Gets room for a record of at most max bytes, inside the buffer if it
+ *        fits there, otherwise in heap which is written by room_put
+ */
+static char* room_get(outbuf_t *out, size_t max, char **heap) {
+    char *room = NULL;
+    *heap = NULL;
+    if (max <= out->size) room = outbuf_reserve(out, max);
+    if (room == NULL) room = *heap = (char *)malloc(max);
+    return room;
+}
+
+static int room_put(outbuf_t *out, size_t len, char *heap) {
+    if (heap == NULL) {
+        outbuf_commit(out, len);
+        return 0;
+    }
+    int ret = outbuf_write(out, heap, len);
+    free(heap);
+    return ret;
+}
+
+static size_t format_uint64(char *buf, uint64_t value) {
+    char tmp[LONG_DECIMAL_SIZE];
+    size_t n = 0;
+    do {
+        tmp[n++] = '0' + value % 10;
+        value /= 10;
+    } while (value > 0);
+    for (size_t i = 0; i < n; i++) buf[i] = tmp[n - 1 - i];
+    return n;
+}
+
+static size_t append(char *buf, const char *str) {
+    size_t len = strlen(str);
+    memcpy(buf, str, len);
+    return len;
+}
+
+/**
+ * @brief Writes the files of each bucket separated by commas, up to the last
+ *        bucket that isn't empty, "-" if there's no histogram
+ */
+static size_t format_hist(char *buf, const uint64_t *hist) {
+    if (hist == NULL) return append(buf, "-");
+    int last = SINK_HIST_BUCKETS - 1;
+    while (last > 0 && hist[last] == 0) last--;
+    size_t n = 0;
+    for (int i = 0; i <= last; i++) {
+        if (i > 0) buf[n++] = ',';
+        n += format_uint64(buf + n, hist[i]);
+    }
+    return n;
+}
+
+/**
+ * @brief Writes the columns of --columns, each one followed by a tab, then
+ *        the path. Sizes of a lower bound are written ">=size"
+ */
+static int text_columns_entry(outbuf_t *out, const sink_rec_t *rec) {
+    size_t max = strlen(rec->path) + 1;
+    for (int i = 0; i < text_columns.size; i++) {
+        max += text_columns.ids[i] == SINK_COL_HIST ? HIST_SIZE
+                                                    : LONG_DECIMAL_SIZE + 3;
+    }
+    char *heap;
+    char *buf = room_get(out, max, &heap);
+    if (buf == NULL) return -1;
+
+    size_t n = 0;
+    for (int i = 0; i < text_columns.size; i++) {
+        int id = text_columns.ids[i];
+        if (rec->partial && id != SINK_COL_HIST) n += append(buf + n, ">=");
+        switch (id) {
+            case SINK_COL_SIZE:
+                n += format_long(buf + n, rec->size);
+                break;
+            case SINK_COL_BLOCKS:
+                n += format_long(buf + n, rec->blocks);
+                break;
+            case SINK_COL_APPARENT:
+                n += format_uint64(buf + n, rec->apparent);
+                break;
+            case SINK_COL_COUNT:
+                n += format_uint64(buf + n, rec->count);
+                break;
+            default:
+                n += format_hist(buf + n, rec->hist);
+                break;
+        }
+        buf[n++] = '\t';
+    }
+    n += append(buf + n, rec->path);
+    buf[n++] = '\n';
+    return room_put(out, n, heap);
+}
+
+// A lower bound is written ">=size"
+static int text_entry(outbuf_t *out, const sink_rec_t *rec) {
+    if (text_columns.size > 0) return text_columns_entry(out, rec);
+    if (rec->partial && outbuf_write(out, ">=", 2)) return -1;
+    return outbuf_entry(out, rec->size, rec->path);
+}
+
+/**
+ * @brief Copies the path as a JSON string without quotes, bytes over 0x7f
+ *        are copied as they are
+ */
+static size_t json_path(char *buf, const char *path) {
+    static const char hex[] = "0123456789abcdef";
+    size_t n = 0;
+    for (const unsigned char *c = (const unsigned char *)path; *c; c++) {
+        if (*c == '"' || *c == '\\') {
+            buf[n++] = '\\';
+            buf[n++] = *c;
+        } else if (*c < 0x20) {
+            n += append(buf + n, "\\u00");
+            buf[n++] = hex[*c >> 4];
+            buf[n++] = hex[*c & 0xf];
+        } else {
+            buf[n++] = *c;
+        }
+    }
+    return n;
+}
+
+static int ndjson_entry(outbuf_t *out, const sink_rec_t *rec) {
+    char *heap;
+    size_t max = NUMBERS_SIZE + 6 * strlen(rec->path) +
+                 (rec->hist != NULL ? HIST_SIZE : 0);
+    char *buf = room_get(out, max, &heap);
+    if (buf == NULL) return -1;
+
+    size_t n = append(buf, "{\"path\":\"");
+    n += json_path(buf + n, rec->path);
+    n += append(buf + n, "\",\"size\":");
+    n += format_long(buf + n, rec->size);
+    n += append(buf + n, ",\"blocks\":");
+    n += format_long(buf + n, rec->blocks);
+    n += append(buf + n, ",\"apparent\":");
+    n += format_uint64(buf + n, rec->apparent);
+    n += append(buf + n, ",\"inode\":");
+    n += format_uint64(buf + n, rec->inode);
+    n += append(buf + n, ",\"count\":");
+    n += format_uint64(buf + n, rec->count);
+    n += append(buf + n, ",\"depth\":");
+    n += format_long(buf + n, rec->depth);
+    n += append(buf + n, ",\"type\":\"");
+    n += append(buf + n, type_names[rec->type]);
+    n += append(buf + n, rec->partial ? "\",\"partial\":true" : "\"");
+    if (rec->hist != NULL) {
+        n += append(buf + n, ",\"hist\":[");
+        n += format_hist(buf + n, rec->hist);
+        buf[n++] = ']';
+    }
+    n += append(buf + n, "}\n");
+    return room_put(out, n, heap);
+}
+
+static int csv_begin(outbuf_t *out) {
+    static const char header[] = "size,apparent,inode,count,depth,type,path\n";
+    return outbuf_write(out, header, sizeof(header) - 1);
+}
+
+static int csv_entry(outbuf_t *out, const sink_rec_t *rec) {
+    char *heap;
+    char *buf = room_get(out, NUMBERS_SIZE + 2 * strlen(rec->path), &heap);
+    if (buf == NULL) return -1;
+
+    size_t n = rec->partial ? append(buf, ">=") : 0;
+    n += format_long(buf + n, rec->size);
+    buf[n++] = ',';
+    n += format_uint64(buf + n, rec->apparent);
+    buf[n++] = ',';
+    n += format_uint64(buf + n, rec->inode);
+    buf[n++] = ',';
+    n += format_uint64(buf + n, rec->count);
+    buf[n++] = ',';
+    n += format_long(buf + n, rec->depth);
+    buf[n++] = ',';
+    n += append(buf + n, type_names[rec->type]);
+    buf[n++] = ',';
+
+    // Quoted (RFC 4180) only when needed
+    if (strpbrk(rec->path, ",\"\r\n") == NULL) {
+        n += append(buf + n, rec->path);
+    } else {
+        buf[n++] = '"';
+        for (const char *c = rec->path; *c; c++) {
+            if (*c == '"') buf[n++] = '"';
+            buf[n++] = *c;
+        }
+        buf[n++] = '"';
+    }
+    buf[n++] = '\n';
+    return room_put(out, n, heap);
+}
+
+static int bin_begin(outbuf_t *out) {
+    sink_bin_header_t header;
+    memcpy(header.magic, SINK_BIN_MAGIC, sizeof(header.magic));
+    header.version = SINK_BIN_VERSION;
+    header.header_size = offsetof(sink_bin_rec_t, path);
+    return outbuf_write(out, &header, sizeof(header));
+}
+
+static int bin_entry(outbuf_t *out, const sink_rec_t *rec) {
+    size_t path_len = strlen(rec->path);
+    size_t length = (offsetof(sink_bin_rec_t, path) + path_len + 1 + 7) & ~7UL;
+    char *heap;
+    char *buf = room_get(out, length, &heap);
+    if (buf == NULL) return -1;
+
+    sink_bin_rec_t *bin = (sink_bin_rec_t *)buf;
+    memset(buf + length - 8, 0, 8);     // padding
+    bin->length = length;
+    bin->path_len = path_len;
+    bin->size = rec->size;
+    bin->apparent = rec->apparent;
+    bin->inode = rec->inode;
+    bin->count = rec->count;
+    bin->depth = rec->depth;
+    bin->type = rec->type | (rec->partial ? SINK_BIN_PARTIAL : 0);
+    memcpy(bin->path, rec->path, path_len + 1);
+    return room_put(out, length, heap);
+}
+
+static const sink_t sinks[] = {
+    {"text", NULL, text_entry},
+    {"ndjson", NULL, ndjson_entry},
+    {"csv", csv_begin, csv_entry},
+    {"bin", bin_begin, bin_entry}};
+
+static const sink_t *current = &sinks[SINK_TEXT];
+
+int sink_find(const char *name) {
+    for (size_t i = 0; i < sizeof(sinks) / sizeof(sinks[0]); i++) {
+        if (strcmp(sinks[i].name, name) == 0) return i;
+    }
+    return -1;
+}
+
+int sink_begin(int index) {
+    current = &sinks[index];
+    return current->begin != NULL ? current->begin(outbuf_stdout()) : 0;
+}
+
+int sink_select(int index) {
+    current = &sinks[index];
+    return 0;
+}
+
+int sink_parse_columns(const char *list, sink_columns_t *columns) {
+    columns->size = 0;
+    while (1) {
+        size_t len = strcspn(list, ",");
+        size_t id = 0;
+        while (id < sizeof(column_names) / sizeof(column_names[0]) &&
+               (strlen(column_names[id]) != len ||
+                strncmp(column_names[id], list, len) != 0)) {
+            id++;
+        }
+        if (id == sizeof(column_names) / sizeof(column_names[0]) ||
+            columns->size == SINK_COLUMNS_MAX) {
+            return -1;
+        }
+        columns->ids[columns->size++] = id;
+        if (list[len] == '\0') return 0;
+        list += len + 1;
+    }
+}
+
+int sink_has_column(const sink_columns_t *columns, sink_column_t id) {
+    for (int i = 0; i < columns->size; i++) {
+        if (columns->ids[i] == (int)id) return 1;
+    }
+    return 0;
+}
+
+void sink_set_columns(const sink_columns_t *columns) {
+    text_columns = *columns;
+}
+
+int sink_entry(const sink_rec_t *rec) {
+    return current->entry(outbuf_stdout(), rec);
+}
@@ -0,0 +1,285 @@
+/* MAIN HEADER */
+#include "stats.h"
+
+/* INCLUDE HEADERS */
+
+/* SYSTEM CALLS HEADERS */
+#include <time.h>
+
+/* C LIBRARY HEADERS */
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * @brief Counters of a thread, only written by it. Every thread that counts
+ *        pushes its own to a list once, without locks
+ */
+typedef struct stats_local stats_local_t;
+struct stats_local {
+    stats_t         data;
+    uint64_t        last_ns;    /**< @brief Last instant measured by the thread */
+    stats_local_t  *next;
+};
+
+static const char *class_names[STATS_CLASSES] = {
+    "open", "readdir", "stat", "output", "log", "fork", "pipe"};
+
+int stats_enabled = 0;
+static uint64_t origin_ns;
+static _Atomic(stats_local_t *) locals = NULL;
+static _Thread_local stats_local_t *local = NULL;
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static stats_local_t* stats_local(void) {
+    if (local != NULL) return local;
+
+    stats_local_t *l = (stats_local_t *)calloc(1, sizeof(stats_local_t));
+    if (l == NULL) return NULL;
+    l->data.slot_ns = STATS_SLOT_NS;
+    l->last_ns = now_ns();
+    l->next = atomic_load(&locals);
+    while (!atomic_compare_exchange_weak(&locals, &l->next, l)) continue;
+    local = l;
+    return l;
+}
+
+/**
+ * @brief Halves the number of intervals by doubling their width
+ */
+static void slots_fold(stats_t *s) {
+    for (int i = 0; i < STATS_SLOTS / 2; i++) {
+        s->slots[i] = s->slots[2 * i] + s->slots[2 * i + 1];
+    }
+    memset(&s->slots[STATS_SLOTS / 2], 0,
+           sizeof(uint64_t) * (STATS_SLOTS / 2));
+    s->slot_ns *= 2;
+}
+
+static void slots_add(stats_t *s, uint64_t instant, uint64_t n) {
+    uint64_t elapsed = instant > origin_ns ? instant - origin_ns : 0;
+    while (elapsed / s->slot_ns >= STATS_SLOTS) slots_fold(s);
+    s->slots[elapsed / s->slot_ns] += n;
+}
+
+static void stats_add(stats_t *dst, const stats_t *src) {
+    stats_t folded;
+    if (src->slot_ns < dst->slot_ns) {
+        folded = *src;
+        while (folded.slot_ns < dst->slot_ns) slots_fold(&folded);
+        src = &folded;
+    }
+    while (dst->slot_ns < src->slot_ns) slots_fold(dst);
+
+    for (int i = 0; i < STATS_COUNTERS; i++) dst->counters[i] += src->counters[i];
+    for (int c = 0; c < STATS_CLASSES; c++) {
+        stats_hist_t *h = &dst->hists[c];
+        const stats_hist_t *o = &src->hists[c];
+        h->count += o->count;
+        h->total_ns += o->total_ns;
+        if (o->max_ns > h->max_ns) h->max_ns = o->max_ns;
+        for (int i = 0; i < STATS_BUCKETS; i++) h->buckets[i] += o->buckets[i];
+    }
+    for (int i = 0; i < STATS_SLOTS; i++) dst->slots[i] += src->slots[i];
+}
+
+void stats_start(const struct timeval *origin) {
+    struct timespec real;
+    clock_gettime(CLOCK_REALTIME, &real);
+    int64_t ago = (real.tv_sec - origin->tv_sec) * 1000000000LL +
+                  real.tv_nsec - origin->tv_usec * 1000LL;
+    uint64_t now = now_ns();
+
+    // Monotonic instant of the origin, the same in every subprocess
+    origin_ns = (ago > 0 && (uint64_t)ago < now) ? now - ago : now;
+    stats_enabled = 1;
+}
+
+uint64_t stats_clock(void) { return stats_enabled ? now_ns() : 0; }
+
+void stats_time(stats_class_t class, uint64_t begin) {
+    stats_local_t *l;
+    if (begin == 0 || (l = stats_local()) == NULL) return;
+
+    uint64_t end = now_ns();
+    uint64_t ns = end > begin ? end - begin : 0;
+    int bucket = ns < 2 ? 0 : 63 - __builtin_clzll(ns);
+    if (bucket >= STATS_BUCKETS) bucket = STATS_BUCKETS - 1;
+
+    stats_hist_t *h = &l->data.hists[class];
+    h->count++;
+    h->total_ns += ns;
+    if (ns > h->max_ns) h->max_ns = ns;
+    h->buckets[bucket]++;
+    l->last_ns = end;
+}
+
+void stats_count(stats_counter_t counter, uint64_t value) {
+    stats_local_t *l;
+    if (!stats_enabled || (l = stats_local()) == NULL) return;
+    l->data.counters[counter] += value;
+}
+
+void stats_entry(stats_counter_t counter, uint64_t bytes) {
+    stats_local_t *l;
+    if (!stats_enabled || (l = stats_local()) == NULL) return;
+    l->data.counters[counter]++;
+    l->data.counters[STATS_BYTES] += bytes;
+    slots_add(&l->data, l->last_ns, 1);
+}
+
+void stats_collect(stats_t *total) {
+    memset(total, 0, sizeof(stats_t));
+    total->slot_ns = STATS_SLOT_NS;
+    for (stats_local_t *l = atomic_load(&locals); l != NULL; l = l->next) {
+        stats_add(total, &l->data);
+    }
+}
+
+void stats_merge(const stats_t *other) {
+    stats_local_t *l;
+    if (!stats_enabled || (l = stats_local()) == NULL) return;
+    stats_add(&l->data, other);
+}
+
+/**
+ * @brief Upper bound of the bucket holding the quantile q
+ */
+static uint64_t hist_quantile(const stats_hist_t *h, double q) {
+    uint64_t rank = (uint64_t)(h->count * q + 0.5), seen = 0;
+    if (rank == 0) rank = 1;
+    for (int i = 0; i < STATS_BUCKETS; i++) {
+        if ((seen += h->buckets[i]) >= rank) return 2ULL << i;
+    }
+    return h->max_ns;
+}
+
+static void print_duration(char *buf, size_t size, uint64_t ns) {
+    if (ns < 1000) {
+        snprintf(buf, size, "%lluns", (unsigned long long)ns);
+    } else if (ns < 1000000) {
+        snprintf(buf, size, "%lluus", (unsigned long long)ns / 1000);
+    } else if (ns < 1000000000) {
+        snprintf(buf, size, "%llums", (unsigned long long)ns / 1000000);
+    } else {
+        snprintf(buf, size, "%llus", (unsigned long long)ns / 1000000000);
+    }
+}
+
+/**
+ * @brief Number of intervals up to the last one with entries
+ */
+static int slots_used(const stats_t *s) {
+    int used = STATS_SLOTS;
+    while (used > 0 && s->slots[used - 1] == 0) used--;
+    return used;
+}
+
+static void print_text(const stats_t *s, uint64_t elapsed) {
+    const uint64_t *c = s->counters;
+    double seconds = elapsed / 1e9;
+    uint64_t entries = c[STATS_DIRS] + c[STATS_FILES] + c[STATS_SYMLINKS];
+
+    fprintf(stderr,
+            "simpledu: stats: %llu directories, %llu files, %llu symbolic "
+            "links, %llu errors, %llu bytes in %.3f s (%.0f entries/s)\n",
+            (unsigned long long)c[STATS_DIRS],
+            (unsigned long long)c[STATS_FILES],
+            (unsigned long long)c[STATS_SYMLINKS],
+            (unsigned long long)c[STATS_ERRORS],
+            (unsigned long long)c[STATS_BYTES], seconds,
+            seconds > 0 ? entries / seconds : 0.0);
+
+    fprintf(stderr, "simpledu: stats: %-8s %10s %10s %9s %9s %9s %9s\n",
+            "class", "calls", "total ms", "mean us", "p50 <", "p99 <", "max");
+    for (int i = 0; i < STATS_CLASSES; i++) {
+        const stats_hist_t *h = &s->hists[i];
+        if (h->count == 0) continue;
+        char p50[16], p99[16], max[16];
+        print_duration(p50, sizeof(p50), hist_quantile(h, 0.5));
+        print_duration(p99, sizeof(p99), hist_quantile(h, 0.99));
+        print_duration(max, sizeof(max), h->max_ns);
+        fprintf(stderr,
+                "simpledu: stats: %-8s %10llu %10.1f %9.2f %9s %9s %9s\n",
+                class_names[i], (unsigned long long)h->count,
+                h->total_ns / 1e6, h->total_ns / 1e3 / h->count, p50, p99, max);
+    }
+
+    for (int i = 0; i < STATS_CLASSES; i++) {
+        const stats_hist_t *h = &s->hists[i];
+        if (h->count == 0) continue;
+        fprintf(stderr, "simpledu: stats: %s latency:", class_names[i]);
+        for (int b = 0; b < STATS_BUCKETS; b++) {
+            if (h->buckets[b] == 0) continue;
+            char bound[16];
+            print_duration(bound, sizeof(bound), 2ULL << b);
+            fprintf(stderr, " <%s %llu", bound,
+                    (unsigned long long)h->buckets[b]);
+        }
+        fprintf(stderr, "\n");
+    }
+
+    char width[16];
+    print_duration(width, sizeof(width), s->slot_ns);
+    fprintf(stderr, "simpledu: stats: entries/s every %s:", width);
+    for (int i = 0, used = slots_used(s); i < used; i++) {
+        fprintf(stderr, " %.0f", s->slots[i] * 1e9 / s->slot_ns);
+    }
+    fprintf(stderr, "\n");
+}
+
+static void print_json(const stats_t *s, uint64_t elapsed) {
+    const uint64_t *c = s->counters;
+
+    fprintf(stderr,
+            "{\"elapsed_ns\":%llu,\"dirs\":%llu,\"files\":%llu,"
+            "\"symlinks\":%llu,\"errors\":%llu,\"bytes\":%llu,\"latency\":{",
+            (unsigned long long)elapsed, (unsigned long long)c[STATS_DIRS],
+            (unsigned long long)c[STATS_FILES],
+            (unsigned long long)c[STATS_SYMLINKS],
+            (unsigned long long)c[STATS_ERRORS],
+            (unsigned long long)c[STATS_BYTES]);
+    for (int i = 0; i < STATS_CLASSES; i++) {
+        const stats_hist_t *h = &s->hists[i];
+        int used = STATS_BUCKETS;
+        while (used > 0 && h->buckets[used - 1] == 0) used--;
+
+        fprintf(stderr,
+                "%s\"%s\":{\"count\":%llu,\"total_ns\":%llu,\"max_ns\":%llu,"
+                "\"buckets\":[",
+                i ? "," : "", class_names[i], (unsigned long long)h->count,
+                (unsigned long long)h->total_ns,
+                (unsigned long long)h->max_ns);
+        for (int b = 0; b < used; b++) {
+            fprintf(stderr, "%s%llu", b ? "," : "",
+                    (unsigned long long)h->buckets[b]);
+        }
+        fprintf(stderr, "]}");
+    }
+    fprintf(stderr, "},\"throughput\":{\"slot_ns\":%llu,\"entries\":[",
+            (unsigned long long)s->slot_ns);
+    for (int i = 0, used = slots_used(s); i < used; i++) {
+        fprintf(stderr, "%s%llu", i ? "," : "",
+                (unsigned long long)s->slots[i]);
+    }
+    fprintf(stderr, "]}}\n");
+}
+
+void stats_print(stats_format_t format) {
+    stats_t total;
+    stats_collect(&total);
+    uint64_t now = now_ns();
+    uint64_t elapsed = now > origin_ns ? now - origin_ns : 0;
+
+    if (format == STATS_JSON) {
+        print_json(&total, elapsed);
+    } else {
+        print_text(&total, elapsed);
+    }
+}
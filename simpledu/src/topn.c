@@ -0,0 +1,103 @@
+/* MAIN HEADER */
+#include "topn.h"
+
+/* INCLUDE HEADERS */
+
+/* SYSTEM CALLS HEADERS */
+
+/* C LIBRARY HEADERS */
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * @brief Compares the rank of two entries
+ * @return Positive if a ranks above b, negative if below, 0 if equal
+ */
+static int rank(const sink_rec_t *a, const sink_rec_t *b) {
+    if (a->size != b->size) return a->size > b->size ? 1 : -1;
+    return strcmp(b->path, a->path);
+}
+
+static void sift_up(sink_rec_t *items, int i) {
+    sink_rec_t item = items[i];
+    while (i > 0) {
+        int parent = (i - 1) / 2;
+        if (rank(&items[parent], &item) <= 0) break;
+        items[i] = items[parent];
+        i = parent;
+    }
+    items[i] = item;
+}
+
+static void sift_down(sink_rec_t *items, int size, int i) {
+    sink_rec_t item = items[i];
+    while (2 * i + 1 < size) {
+        int child = 2 * i + 1;
+        if (child + 1 < size && rank(&items[child + 1], &items[child]) < 0) {
+            child++;
+        }
+        if (rank(&items[child], &item) >= 0) break;
+        items[i] = items[child];
+        i = child;
+    }
+    items[i] = item;
+}
+
+/**
+ * @brief Keeps the entry, taking its path, or frees the path if it isn't kept
+ */
+static void topn_take(topn_t *top, const sink_rec_t *rec) {
+    if (top->size < top->capacity) {
+        top->items[top->size] = *rec;
+        sift_up(top->items, top->size++);
+        return;
+    }
+    if (rank(rec, &top->items[0]) <= 0) {
+        free((char *)rec->path);
+        return;
+    }
+    free((char *)top->items[0].path);
+    top->items[0] = *rec;
+    sift_down(top->items, top->size, 0);
+}
+
+int topn_init(topn_t *top, int capacity) {
+    top->size = 0;
+    top->capacity = capacity;
+    top->items = (sink_rec_t *)malloc(sizeof(sink_rec_t) * capacity);
+    return top->items == NULL ? -1 : 0;
+}
+
+int topn_wants(const topn_t *top, long size) {
+    return top->size < top->capacity || size >= top->items[0].size;
+}
+
+int topn_add(topn_t *top, const sink_rec_t *rec) {
+    if (top->size == top->capacity && rank(rec, &top->items[0]) <= 0) {
+        return 0;
+    }
+    sink_rec_t copy = *rec;
+    if ((copy.path = strdup(rec->path)) == NULL) return -1;
+    topn_take(top, &copy);
+    return 0;
+}
+
+void topn_merge(topn_t *top, topn_t *from) {
+    for (int i = 0; i < from->size; i++) topn_take(top, &from->items[i]);
+    from->size = 0;
+}
+
+static int compare_items(const void *a, const void *b) {
+    return rank((const sink_rec_t *)b, (const sink_rec_t *)a);
+}
+
+void topn_sort(topn_t *top) {
+    qsort(top->items, top->size, sizeof(sink_rec_t), compare_items);
+}
+
+void topn_free(topn_t *top) {
+    for (int i = 0; i < top->size; i++) free((char *)top->items[i].path);
+    free(top->items);
+    top->items = NULL;
+    top->size = 0;
+}
@@ -0,0 +1,2040 @@
+/* MAIN HEADER */
+#include "traverse.h"
+
+/* INCLUDE HEADERS */
+#include "arena.h"
+#include "checkpoint.h"
+#include "dirscan.h"
+#include "index.h"
+#include "log.h"
+#include "mounts.h"
+#include "outbuf.h"
+#include "parse.h"
+#include "pool.h"
+#include "procpool.h"
+#include "progress.h"
+#include "sig_handler.h"
+#include "sink.h"
+#include "stats.h"
+#include "topn.h"
+#include "utils.h"
+
+/* SYSTEM CALLS HEADERS */
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+/* C LIBRARY HEADERS */
+#include <dirent.h>
+#include <errno.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define NODE_SCANNING   0   /** @brief Entries of the directory are being read */
+#define NODE_SCANNED    1   /** @brief Every entry was read, subdirectories may be pending */
+#define NODE_DONE       2   /** @brief Size of the whole subtree is known */
+
+#define ITEMS_INIT_SIZE 8
+#define NODE_NAME_HINT  16  /** @brief Bytes expected for the name of a subdirectory */
+#define FD_RESERVED     64  /** @brief Descriptors left for everything except kept directories */
+#define DEADLINE_CHECK  1024    /** @brief Entries read between checks of the deadline */
+#define HOLD_NODES      4096    /** @brief Subdirectories in memory past which workers stop stealing */
+
+// Options that change the output, a checkpoint is only resumed with them
+#define CHECKPOINT_OPTS (FLAG_LINKS | FLAG_ALL | FLAG_BYTES | FLAG_BSIZE | \
+                         FLAG_DEREF | FLAG_SEPDIR | FLAG_MAXDEPTH | \
+                         FLAG_ONEFS | FLAG_EXCLFS | FLAG_EXCLUDE)
+
+typedef struct du_node du_node_t;
+
+/**
+ * @brief Entry of a directory, in the order given by readdir
+ */
+typedef struct du_item {
+    du_node_t  *child;      /**< @brief Subdirectory, NULL for other entries */
+    uint64_t    blocks;     /**< @brief 512-byte blocks of the entry, or of the subdirectory once done */
+    char       *name;       /**< @brief Name to print or index, NULL if neither */
+    uint64_t    apparent;   /**< @brief Bytes, like blocks */
+    uint64_t    count;      /**< @brief Entries counted in blocks */
+    uint64_t    ino;        /**< @brief Inode of a printed entry or of a link */
+    dev_t       dev;        /**< @brief Device of a link */
+    int64_t     mtime;      /**< @brief Modification of an indexed entry */
+    int         type;       /**< @brief Sink type of a printed entry */
+    int         print;      /**< @brief Entry is printed, not only indexed */
+    int         link;       /**< @brief Entry with several links, counted by the first one written */
+} du_item_t;
+
+/**
+ * @brief Hard links of a subtree that were already counted by a link written
+ *        before them, taken off its sizes when it is written
+ */
+typedef struct du_linked {
+    uint64_t    blocks;
+    uint64_t    apparent;
+    uint64_t    count;
+    uint64_t    own;        /**< @brief Blocks of the entries of the directory itself */
+    uint64_t    own_apparent;
+    uint64_t    hist[];     /**< @brief Files of each size bucket, only with a histogram */
+} du_linked_t;
+
+/**
+ * @brief Directory being traversed
+ */
+struct du_node {
+    du_node_t  *parent;
+    long        index;      /**< @brief Index of this directory in parent items */
+    char       *name;       /**< @brief Name of the entry, the whole path for a root */
+    size_t      emit_len;   /**< @brief Length of the emitted path before this name */
+    int         depth;
+    int         failed;     /**< @brief Directory couldn't be fully read */
+    atomic_int  partial;    /**< @brief It or a subdirectory was cut by the deadline */
+    // Sizes are summed exactly and only turned into the printed unit once
+    // they are written
+    uint64_t    blocks;     /**< @brief 512-byte blocks of itself and its entries, plus subdirectories once done */
+    uint64_t    own;        /**< @brief Blocks of itself and its entries, set once done */
+    uint64_t    apparent;   /**< @brief Bytes, like blocks */
+    uint64_t    own_apparent;   /**< @brief Bytes, like own */
+    uint64_t    count;      /**< @brief Entries counted in blocks, itself included */
+    atomic_uint_least64_t  *hist;   /**< @brief Files of each size bucket, like blocks, NULL without a histogram */
+    du_linked_t            *linked; /**< @brief Links counted elsewhere, NULL if none, only used by the output */
+
+    // Kept open until every subdirectory opened itself relative to it
+    DIR        *dir;
+    atomic_int  unopened;
+
+    du_item_t  *items;
+    long        items_size;
+    long        items_memsize;
+
+    // Names of the entries and the nodes of the subdirectories, which are
+    // always freed before this node, so the whole region goes at once
+    arena_t     arena;
+
+    atomic_int  pending;    /**< @brief Subdirectories not done yet */
+    atomic_int  state;
+
+    // Status of the directory and raw sizes, recorded in the cache
+    dev_t                   dev;
+    ino_t                   ino;
+    struct timespec         mtim;
+    struct timespec         ctim;
+    uint64_t                own_blocks;     /**< @brief Entries that aren't directories */
+    uint64_t                own_bytes;
+    uint32_t                cache_flags;
+    atomic_uint_least64_t   tree_blocks;    /**< @brief Complete once the node is done */
+    atomic_uint_least64_t   tree_bytes;
+};
+
+/**
+ * @brief Path given to traverse_paths, started once its device has room
+ */
+typedef struct du_root {
+    char       *path;
+    int         device;     /**< @brief Index of its device */
+    long        next;       /**< @brief Next root on the same device, -1 if none */
+    struct stat status;
+    du_node_t  *node;       /**< @brief Directory, NULL for other entries */
+    sink_rec_t  rec;        /**< @brief Entry that isn't a directory */
+    int         counted;    /**< @brief Entry isn't a hard link already counted */
+    atomic_int  ready;      /**< @brief Entry that isn't a directory was read */
+    int         resumed;    /**< @brief Directory started before the checkpoint of --resume */
+} du_root_t;
+
+/**
+ * @brief Roots of a device waiting for their turn, at most device_jobs of
+ *        them are traversed at the same time
+ */
+typedef struct du_device {
+    dev_t       dev;
+    long        waiting;    /**< @brief First root not started, -1 if none */
+    long        last;       /**< @brief Last root added */
+    int         running;
+} du_device_t;
+
+typedef struct traverse {
+    const du_opts_t    *opts;
+    pool_t             *pool;
+    atomic_int          error;
+    atomic_int          index_failed;   /**< @brief An entry couldn't be indexed, reported once */
+    atomic_int          expired;    /**< @brief The deadline passed, no directory is read anymore */
+    path_buf_t         *paths;      /**< @brief Scratch path of each worker */
+    dir_scan_t         *scans;      /**< @brief Scanner of each worker */
+    uring_t           **rings;      /**< @brief io_uring of each worker, NULL if none */
+    procpool_t         *procs;      /**< @brief Process reading the directories of each worker, NULL if none */
+
+    // With --top or --top-files nothing is printed while traversing, each
+    // worker keeps its largest entries and they are merged at the end.
+    // Directories and hard links are only known once written, they are kept
+    // by the output in the top after the ones of the workers
+    int                 ranked;
+    topn_t             *top_dirs;   /**< @brief Largest directories of the output, NULL if none */
+    topn_t             *top_files;  /**< @brief Largest files of each worker and of the output, NULL if none */
+
+    // Directories kept open for their subdirectories, over the budget the
+    // subdirectories are opened by their whole path
+    atomic_int          kept;
+
+    // Thieves take the oldest directories, far ahead of the output, and a
+    // subtree stays in memory until it is written. Past HOLD_NODES nodes
+    // workers only go on with their own directories, depth first, until the
+    // output frees half of them
+    atomic_long         live;       /**< @brief Nodes that aren't roots, not written yet */
+    int                 kept_budget;
+
+    // Output is written in the same order as the process mode: entries of a
+    // directory in readdir order, each subdirectory fully before the next
+    // entry and the directory itself last. The cursor walks the tree in that
+    // order and stops at the first node that isn't ready
+    pthread_mutex_t     emit_lock;
+    uint64_t            emit_hist[SINK_HIST_BUCKETS];   /**< @brief Histogram of the entry being written */
+    du_node_t          *cursor;
+    long                cursor_pos;
+    path_buf_t          emit_path;  /**< @brief Path of the cursor */
+
+    // With several paths or -L every entry is counted once, like du: each
+    // one is kept and claimed in output order, a directory already counted
+    // is walked by the cursor without writing anything under it
+    int                 unique;
+    du_node_t          *skipped;    /**< @brief Directory counted before, NULL if the cursor isn't under one */
+
+    // Paths on different devices are traversed at the same time, their
+    // output is still written in the order they were given
+    du_root_t          *roots;
+    long                nroots;
+    long                root_pos;   /**< @brief Next root of the cursor */
+    du_device_t        *devices;
+    int                 ndevices;
+    pthread_mutex_t     devices_lock;
+
+    // Directories changed after this instant aren't trusted in the next run
+    time_t              start;
+    // Accuracy of the cache, with --verify
+    atomic_long         verify_dirs;
+    atomic_long         verify_unchanged;
+    atomic_long         verify_stale;
+    atomic_long         verify_blocks_off;
+    atomic_long         verify_bytes_off;
+
+    // Signals are only taken by the control thread. While it handles one the
+    // workers wait before their next task and the output waits for it
+    sigset_t            signals;    /**< @brief Signals blocked in every other thread */
+    int                 wake[2];    /**< @brief Pipe of the control thread, 'i' upon SIGINT, 't' upon SIGTERM and 'q' at the end */
+    atomic_int          paused;
+    pthread_mutex_t     pause_lock;
+    pthread_cond_t      resume;
+
+    // With --checkpoint every task holds quiet for reading and a checkpoint
+    // takes it for writing, so the tree it saves is the one between tasks
+    pthread_rwlock_t    quiet;
+    uint64_t            entries;    /**< @brief Entries written, the ones before --resume too */
+    char              **given;      /**< @brief Paths given, checked by --resume */
+    int                 ngiven;
+} traverse_t;
+
+static int printable(const du_opts_t *opts, int depth) {
+    return (opts->flags & FLAG_MAXDEPTH) == 0 || depth <= opts->max_depth;
+}
+
+/**
+ * @brief Checks the deadline of the options, once it passed it stays so
+ */
+static int deadline_passed(traverse_t *t) {
+    if (t->opts->deadline == 0) return 0;
+    if (atomic_load_explicit(&t->expired, memory_order_relaxed)) return 1;
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    if (now.tv_sec * 1000000000ULL + now.tv_nsec < t->opts->deadline) {
+        return 0;
+    }
+    atomic_store(&t->expired, 1);
+    return 1;
+}
+
+static void print_error(const char *error_msg, const char *path) {
+    char *error = strerror(errno);
+    stats_count(STATS_ERRORS, 1);
+    char buffer[512];
+    snprintf(buffer, sizeof(buffer), "simpledu: %s '%s': %s\n", error_msg,
+             path, error);
+    write(STDERR_FILENO, buffer, strlen(buffer));
+}
+
+static void print_entry(const sink_rec_t *rec) {
+    uint64_t begin = stats_clock();
+    if (write_log_entry(rec->size, rec->path)) {
+        write(STDERR_FILENO, "error upon writing log\n", 23);
+    }
+    stats_time(STATS_LOG, begin);
+    sink_entry(rec);
+}
+
+/**
+ * @brief Converts 512-byte blocks to blocks of -B, rounded up
+ */
+static long print_blocks(const du_opts_t *opts, uint64_t blocks) {
+    uint64_t block_size = opts->block_size;
+    return (long)((blocks * 512 + block_size - 1) / block_size);
+}
+
+/**
+ * @brief Size as printed, bytes with -b and blocks of -B otherwise
+ */
+static long print_size(const du_opts_t *opts, uint64_t blocks,
+                       uint64_t bytes) {
+    if (opts->flags & FLAG_BYTES) return (long)bytes;
+    return print_blocks(opts, blocks);
+}
+
+/**
+ * @brief Size in the unit of fget_size, for the callers of visit that add
+ *        sizes of their own
+ */
+static double visit_size(const du_opts_t *opts, uint64_t blocks,
+                         uint64_t bytes) {
+    if (opts->flags & FLAG_BYTES) return (double)bytes;
+    return blocks * (512.0 / (double)opts->block_size);
+}
+
+/**
+ * @brief Bucket of a file in the histogram, see SINK_HIST_BUCKETS
+ */
+static int hist_bucket(uint64_t bytes) {
+    if (bytes == 0) return 0;
+    int bucket = 64 - __builtin_clzll(bytes);
+    return bucket < SINK_HIST_BUCKETS ? bucket : SINK_HIST_BUCKETS - 1;
+}
+
+static atomic_uint_least64_t* hist_create(arena_t *arena) {
+    atomic_uint_least64_t *hist = (atomic_uint_least64_t *)arena_alloc(
+        arena, sizeof(atomic_uint_least64_t) * SINK_HIST_BUCKETS);
+    if (hist == NULL) return NULL;
+    for (int i = 0; i < SINK_HIST_BUCKETS; i++) atomic_init(&hist[i], 0);
+    return hist;
+}
+
+/**
+ * @brief Adds the histogram of a subdirectory to the one of its parent,
+ *        subdirectories of the same parent may be done at the same time
+ */
+static void hist_add(atomic_uint_least64_t *to,
+                     atomic_uint_least64_t *from) {
+    for (int i = 0; i < SINK_HIST_BUCKETS; i++) {
+        uint64_t files = atomic_load_explicit(&from[i], memory_order_relaxed);
+        if (files > 0) {
+            atomic_fetch_add_explicit(&to[i], files, memory_order_relaxed);
+        }
+    }
+}
+
+static const uint64_t* hist_load(uint64_t *to, atomic_uint_least64_t *from) {
+    for (int i = 0; i < SINK_HIST_BUCKETS; i++) to[i] = atomic_load(&from[i]);
+    return to;
+}
+
+/**
+ * @brief Histogram of the node as written, without its links counted
+ *        elsewhere, in the scratch buffer of the output
+ */
+static const uint64_t* node_hist(traverse_t *t, const du_node_t *node) {
+    hist_load(t->emit_hist, node->hist);
+    if (node->linked != NULL) {
+        for (int i = 0; i < SINK_HIST_BUCKETS; i++) {
+            t->emit_hist[i] -= node->linked->hist[i];
+        }
+    }
+    return t->emit_hist;
+}
+
+static void node_rec(traverse_t *t, sink_rec_t *rec, const du_node_t *node,
+                     const char *path) {
+    const du_linked_t *linked = node->linked;
+    uint64_t blocks = node->blocks - (linked != NULL ? linked->blocks : 0);
+    uint64_t apparent =
+        node->apparent - (linked != NULL ? linked->apparent : 0);
+    rec->path = path;
+    rec->size = print_size(t->opts, blocks, apparent);
+    rec->blocks = print_blocks(t->opts, blocks);
+    rec->apparent = apparent;
+    rec->inode = node->ino;
+    rec->count = node->count - (linked != NULL ? linked->count : 0);
+    rec->depth = node->depth;
+    rec->type = SINK_DIR;
+    rec->partial = atomic_load(&node->partial);
+    rec->hist = NULL;
+}
+
+static void item_rec(traverse_t *t, sink_rec_t *rec, const du_item_t *item,
+                     int depth, const char *path) {
+    rec->path = path;
+    rec->size = print_size(t->opts, item->blocks, item->apparent);
+    rec->blocks = print_blocks(t->opts, item->blocks);
+    rec->apparent = item->apparent;
+    rec->inode = item->ino;
+    rec->count = item->count;
+    rec->depth = depth;
+    rec->type = item->type;
+    rec->partial = 0;
+    rec->hist = NULL;
+}
+
+/**
+ * @brief Builds the whole path of the node, only used when it is needed
+ *        outside the output (error messages, too many open directories,
+ *        entries kept by a top)
+ */
+static int node_path(du_node_t *node, path_buf_t *pb) {
+    if (node->parent == NULL) return pathbuf_set(pb, node->name);
+    if (node_path(node->parent, pb)) return -1;
+    return (pathbuf_push(pb, node->name) == (size_t)-1) ? -1 : 0;
+}
+
+static void print_node_error(const char *error_msg, du_node_t *node,
+                             const char *name, path_buf_t *pb) {
+    int error = errno;
+    if (node_path(node, pb) ||
+        (name != NULL && pathbuf_push(pb, name) == (size_t)-1)) {
+        pathbuf_set(pb, name != NULL ? name : node->name);
+    }
+    errno = error;
+    print_error(error_msg, pb->str);
+}
+
+/**
+ * @brief Creates a node in the arena of its parent, a root is allocated on
+ *        its own
+ * @param name  Name of the entry, copied
+ */
+static du_node_t* node_create(du_node_t *parent, const char *name, int depth) {
+    du_node_t *node =
+        parent != NULL
+            ? (du_node_t *)arena_alloc(&parent->arena, sizeof(du_node_t))
+            : (du_node_t *)malloc(sizeof(du_node_t));
+    if (node == NULL) return NULL;
+
+    arena_init(&node->arena);
+    node->name = arena_strdup(parent != NULL ? &parent->arena : &node->arena,
+                              name);
+    if (node->name == NULL) {
+        if (parent == NULL) free(node);
+        return NULL;
+    }
+
+    node->parent = parent;
+    node->index = 0;
+    node->emit_len = 0;
+    node->depth = depth;
+    node->failed = 0;
+    atomic_init(&node->partial, 0);
+    node->blocks = 0;
+    node->own = 0;
+    node->apparent = 0;
+    node->own_apparent = 0;
+    node->count = 1;
+    node->hist = NULL;
+    node->linked = NULL;
+    node->dir = NULL;
+    atomic_init(&node->unopened, 0);
+    node->items = NULL;
+    node->items_size = 0;
+    node->items_memsize = 0;
+    atomic_init(&node->pending, 0);
+    atomic_init(&node->state, NODE_SCANNING);
+    node->own_blocks = 0;
+    node->own_bytes = 0;
+    node->cache_flags = 0;
+    atomic_init(&node->tree_blocks, 0);
+    atomic_init(&node->tree_bytes, 0);
+    return node;
+}
+
+static void node_setstatus(du_node_t *node, const struct stat *status) {
+    node->dev = status->st_dev;
+    node->ino = status->st_ino;
+    node->mtim = status->st_mtim;
+    node->ctim = status->st_ctim;
+    node->apparent = status->st_size;
+    atomic_store(&node->tree_blocks, status->st_blocks);
+    atomic_store(&node->tree_bytes, status->st_size);
+    // Links of a directory are its entry, "." and ".." of each subdirectory
+    // on most filesystems, so their nodes fit in the first chunk
+    if (status->st_nlink > 2) {
+        arena_hint(&node->arena,
+                   (status->st_nlink - 2) * (sizeof(du_node_t) + NODE_NAME_HINT));
+    }
+}
+
+/**
+ * @brief Checks if the directory is the node or one of its ancestors, which
+ *        -L reaches through a symbolic link to it. Each level is opened
+ *        relative to its parent, so the kernel never sees the loop
+ */
+static int node_cycle(const du_node_t *node, const struct stat *status) {
+    for (; node != NULL; node = node->parent) {
+        if (node->ino == status->st_ino && node->dev == status->st_dev) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static void node_free(du_node_t *node) {
+    free(node->items);
+    free(node->linked);
+    arena_free(&node->arena);
+    if (node->parent == NULL) free(node);
+}
+
+static du_item_t* node_additem(du_node_t *node) {
+    if (node->items_size == node->items_memsize) {
+        long memsize = node->items_memsize ? node->items_memsize * 2 : ITEMS_INIT_SIZE;
+        du_item_t *items =
+            (du_item_t *)realloc(node->items, sizeof(du_item_t) * memsize);
+        if (items == NULL) return NULL;
+        node->items = items;
+        node->items_memsize = memsize;
+    }
+
+    du_item_t *item = &node->items[node->items_size++];
+    item->child = NULL;
+    item->blocks = 0;
+    item->name = NULL;
+    item->apparent = 0;
+    item->count = 0;
+    item->ino = 0;
+    item->dev = 0;
+    item->mtime = 0;
+    item->type = SINK_FILE;
+    item->print = 0;
+    item->link = 0;
+    return item;
+}
+
+/**
+ * @brief Called once a subdirectory doesn't need the directory of its parent,
+ *        the last one closes it
+ */
+static void node_release(traverse_t *t, du_node_t *node) {
+    if (node->dir == NULL) return;
+    if (atomic_fetch_sub(&node->unopened, 1) == 1) {
+        closedir(node->dir);
+        node->dir = NULL;
+        atomic_fetch_sub(&t->kept, 1);
+    }
+}
+
+/**
+ * @brief Gets the links of the node counted elsewhere, created the first time
+ * @return Pointer to them, NULL if out of memory
+ */
+static du_linked_t* node_linked(traverse_t *t, du_node_t *node) {
+    if (node->linked == NULL) {
+        size_t size = sizeof(du_linked_t);
+        if (t->opts->histogram) size += sizeof(uint64_t) * SINK_HIST_BUCKETS;
+        node->linked = (du_linked_t *)calloc(1, size);
+    }
+    return node->linked;
+}
+
+/**
+ * @brief Takes an entry counted elsewhere off the sizes of its directory and
+ *        of every ancestor they were added to
+ * @param child Subdirectory of the entry, NULL if it isn't one
+ */
+static void linked_take(traverse_t *t, du_node_t *node, const du_item_t *item,
+                        const du_node_t *child) {
+    for (du_node_t *n = node; n != NULL; n = n->parent) {
+        du_linked_t *linked = node_linked(t, n);
+        if (linked == NULL) {
+            errno = ENOMEM;
+            print_error("malloc error", t->emit_path.str);
+            atomic_store(&t->error, 1);
+            break;
+        }
+        linked->blocks += item->blocks;
+        linked->apparent += item->apparent;
+        linked->count += item->count;
+        if (n == node && child == NULL) {
+            linked->own += item->blocks;
+            linked->own_apparent += item->apparent;
+        }
+        if (t->opts->histogram && child == NULL) {
+            linked->hist[hist_bucket(item->apparent)]++;
+        } else if (t->opts->histogram && child->hist != NULL &&
+                   !child->failed) {
+            for (int i = 0; i < SINK_HIST_BUCKETS; i++) {
+                linked->hist[i] += atomic_load(&child->hist[i]);
+            }
+        }
+        // Sizes of a failed directory aren't added to its parent, neither are
+        // the ones of subdirectories with -S
+        if (n->failed || (t->opts->flags & FLAG_SEPDIR)) break;
+    }
+}
+
+/**
+ * @brief Counts an entry with several links by the first of them written,
+ *        as du does. A later one is taken off the sizes of its directory
+ *        and of every ancestor they were added to. Called by the output in
+ *        its order, so the result doesn't depend on the scheduling
+ * @return 1 if the link is counted, 0 if one was written before it
+ */
+static int link_claim(traverse_t *t, du_node_t *node, const du_item_t *item) {
+    int seen = inoset_insert(t->opts->inodes, item->dev, item->ino);
+    if (seen == -1) print_error("inode set error", t->emit_path.str);
+    if (seen != 0) return 1;
+
+    linked_take(t, node, item, NULL);
+    return 0;
+}
+
+/**
+ * @brief Counts a directory by the first path it is written under when every
+ *        entry is counted once, see link_claim
+ * @return 1 if the directory is counted, 0 if it was written before
+ */
+static int dir_claim(traverse_t *t, const du_node_t *node) {
+    if (!t->unique) return 1;
+    int seen = inoset_insert(t->opts->inodes, node->dev, node->ino);
+    if (seen == -1) print_error("inode set error", t->emit_path.str);
+    return seen != 0;
+}
+
+/**
+ * @brief Gets the record of the previous traversal if the directory wasn't
+ *        changed since (no entry was added, removed or renamed)
+ */
+static const cache_rec_t* node_cached(traverse_t *t, du_node_t *node) {
+    if (t->opts->cache == NULL) return NULL;
+
+    const cache_rec_t *rec = cache_lookup(t->opts->cache, node->dev, node->ino);
+    if (rec == NULL || (rec->flags & CACHE_RACY) ||
+        rec->mtime_sec != node->mtim.tv_sec ||
+        rec->mtime_nsec != node->mtim.tv_nsec ||
+        rec->ctime_sec != node->ctim.tv_sec ||
+        rec->ctime_nsec != node->ctim.tv_nsec) {
+        return NULL;
+    }
+    return rec;
+}
+
+static void node_record(traverse_t *t, du_node_t *node, int worker) {
+    cache_rec_t rec;
+    memset(&rec, 0, sizeof(rec));
+    rec.dev = node->dev;
+    rec.ino = node->ino;
+    rec.mtime_sec = node->mtim.tv_sec;
+    rec.mtime_nsec = node->mtim.tv_nsec;
+    rec.ctime_sec = node->ctim.tv_sec;
+    rec.ctime_nsec = node->ctim.tv_nsec;
+    rec.own_blocks = node->own_blocks;
+    rec.own_bytes = node->own_bytes;
+    rec.own_count = node->count - 1;    // subdirectories aren't added yet
+    rec.tree_blocks = atomic_load(&node->tree_blocks);
+    rec.tree_bytes = atomic_load(&node->tree_bytes);
+    rec.flags = node->cache_flags;
+
+    // An entry added in the same tick as the status was read wouldn't change
+    // the stamps
+    if (node->mtim.tv_sec >= t->start - 1 || node->ctim.tv_sec >= t->start - 1) {
+        rec.flags |= CACHE_RACY;
+    }
+
+    if (cache_add(t->opts->cache, worker, &rec)) {
+        print_node_error("cache error", node, NULL, &t->paths[worker]);
+    }
+}
+
+/**
+ * @brief Keeps the entry in the top of the worker if it is among the largest,
+ *        its path is only built in that case
+ */
+static void top_offer(traverse_t *t, topn_t *top, du_node_t *node,
+                      const char *name, sink_rec_t *rec, int worker) {
+    path_buf_t *pb = &t->paths[worker];
+    if (!topn_wants(top, rec->size)) return;
+    if (node_path(node, pb) ||
+        (name != NULL && pathbuf_push(pb, name) == (size_t)-1) ||
+        (rec->path = pb->str, topn_add(top, rec))) {
+        print_node_error("malloc error", node, name, pb);
+        atomic_store(&t->error, 1);
+    }
+}
+
+/**
+ * @brief Keeps an entry being written in the top of the output if it is
+ *        among the largest
+ */
+static void top_keep(traverse_t *t, topn_t *tops, const sink_rec_t *rec) {
+    topn_t *top = &tops[t->opts->threads];
+    if (topn_wants(top, rec->size) && topn_add(top, rec)) {
+        errno = ENOMEM;
+        print_error("malloc error", rec->path);
+        atomic_store(&t->error, 1);
+    }
+}
+
+/**
+ * @brief Prints the largest entries of every worker and of the output
+ */
+static void top_print(traverse_t *t, topn_t *tops) {
+    if (tops == NULL) return;
+    for (int i = 1; i <= t->opts->threads; i++) topn_merge(&tops[0], &tops[i]);
+    topn_sort(&tops[0]);
+    for (int i = 0; i < tops[0].size; i++) print_entry(&tops[0].items[i]);
+}
+
+static void top_free(traverse_t *t, topn_t *tops) {
+    if (tops == NULL) return;
+    for (int i = 0; i <= t->opts->threads; i++) topn_free(&tops[i]);
+    free(tops);
+}
+
+/**
+ * @brief Creates a top for each worker and one for the output, after them
+ */
+static topn_t* top_create(traverse_t *t, int capacity) {
+    topn_t *tops = (topn_t *)calloc(t->opts->threads + 1, sizeof(topn_t));
+    if (tops == NULL) return NULL;
+    for (int i = 0; i <= t->opts->threads; i++) {
+        if (topn_init(&tops[i], capacity)) {
+            top_free(t, tops);
+            return NULL;
+        }
+    }
+    return tops;
+}
+
+static DIR* node_opendir(traverse_t *t, du_node_t *node, path_buf_t *pb) {
+    du_node_t *parent = node->parent;
+    uint64_t begin = stats_clock();
+    int fd;
+
+    if (parent == NULL) {
+        fd = open(node->name, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    } else if (parent->dir != NULL) {
+        fd = openat(dirfd(parent->dir), node->name,
+                    O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        node_release(t, parent);
+    } else if (node_path(node, pb) == 0) {
+        fd = open(pb->str, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    } else {
+        return NULL;
+    }
+
+    if (fd == -1) return NULL;
+
+    DIR *dir = fdopendir(fd);
+    if (dir == NULL) close(fd);
+    stats_time(STATS_OPEN, begin);
+    return dir;
+}
+
+/**
+ * @brief Adds an entry to the index of --save-index, in output order
+ */
+static void index_entry(traverse_t *t, const char *name, int depth,
+                        const sink_rec_t *rec, int64_t mtime, int failed) {
+    index_node_t node;
+    node.size = rec->size;
+    node.apparent = rec->apparent;
+    node.blocks = rec->blocks;
+    node.inode = rec->inode;
+    node.count = rec->count;
+    node.mtime = mtime;
+    node.type = rec->type;
+    node.flags = (failed ? INDEX_FAILED : 0) |
+                 (rec->partial ? INDEX_PARTIAL : 0);
+    if (index_add(t->opts->index, name, depth, &node) &&
+        !atomic_exchange(&t->index_failed, 1)) {
+        print_error("index error", name);
+        atomic_store(&t->error, 1);
+    }
+}
+
+/**
+ * @brief Moves the cursor to the next root that is a directory, writing the
+ *        roots before it that aren't
+ * @return 1 if the cursor moved, 0 if a root isn't ready or none is left
+ */
+static int emit_next_root(traverse_t *t) {
+    while (t->root_pos < t->nroots) {
+        du_root_t *root = &t->roots[t->root_pos];
+        if (root->node != NULL) {
+            if (pathbuf_set(&t->emit_path, root->path)) return 0;
+            if (!dir_claim(t, root->node)) t->skipped = root->node;
+            t->cursor = root->node;
+            t->cursor_pos = 0;
+            t->root_pos++;
+            return 1;
+        }
+        if (!atomic_load(&root->ready)) return 0;
+        root->counted = t->opts->inodes == NULL ||
+                        inoset_seen(t->opts->inodes, &root->status) != 1;
+        if (root->counted && t->top_files != NULL) {
+            top_keep(t, t->top_files, &root->rec);
+        }
+        if (root->counted && !t->ranked) {
+            print_entry(&root->rec);
+            t->entries++;
+        }
+        if (root->counted && t->opts->index != NULL) {
+            index_entry(t, root->path, 0, &root->rec,
+                        root->status.st_mtim.tv_sec, 0);
+        }
+        t->root_pos++;
+    }
+    return 0;
+}
+
+/**
+ * @brief Writes a directory once the cursor is done with its entries
+ */
+static void node_write(traverse_t *t, du_node_t *node) {
+    if (t->opts->index != NULL) {
+        sink_rec_t rec;
+        node_rec(t, &rec, node, NULL);
+        if (node->failed) rec.size = rec.apparent = rec.count = 0;
+        index_entry(t, node->name, node->depth, &rec, node->mtim.tv_sec,
+                    node->failed);
+    }
+    if (t->top_dirs != NULL && !node->failed &&
+        printable(t->opts, node->depth)) {
+        sink_rec_t rec;
+        node_rec(t, &rec, node, t->emit_path.str);
+        top_keep(t, t->top_dirs, &rec);
+    }
+    if (t->opts->visit != NULL) {
+        const du_opts_t *opts = t->opts;
+        const du_linked_t *linked = node->linked;
+        uint64_t own = node->own, own_apparent = node->own_apparent;
+        uint64_t blocks = node->blocks, apparent = node->apparent;
+        if (linked != NULL) {
+            own -= linked->own;
+            own_apparent -= linked->own_apparent;
+            blocks -= linked->blocks;
+            apparent -= linked->apparent;
+        }
+        opts->visit(
+            opts->visit_ctx, t->emit_path.str, node->depth,
+            node->failed ? 0 : visit_size(opts, own, own_apparent),
+            node->failed ? 0 : visit_size(opts, blocks, apparent),
+            node->failed);
+    } else if (!node->failed && !t->ranked &&
+               printable(t->opts, node->depth)) {
+        sink_rec_t rec;
+        node_rec(t, &rec, node, t->emit_path.str);
+        if (node->hist != NULL) rec.hist = node_hist(t, node);
+        print_entry(&rec);
+        t->entries++;
+    }
+}
+
+/**
+ * @brief Writes every entry that is ready, following the output order
+ */
+static void emit_ready(traverse_t *t) {
+    pthread_mutex_lock(&t->emit_lock);
+
+    while (t->cursor != NULL || emit_next_root(t)) {
+        du_node_t *node = t->cursor;
+        int state = atomic_load(&node->state);
+
+        if (state == NODE_SCANNING) break;
+
+        if (t->cursor_pos < node->items_size) {
+            du_item_t *item = &node->items[t->cursor_pos];
+            if (item->child != NULL) {
+                if (t->skipped == NULL && !dir_claim(t, item->child)) {
+                    t->skipped = item->child;
+                }
+                t->cursor = item->child;
+                t->cursor_pos = 0;
+                item->child->emit_len =
+                    pathbuf_push(&t->emit_path, item->child->name);
+                continue;
+            }
+            if (t->skipped != NULL) {
+                t->cursor_pos++;
+                continue;
+            }
+            if (item->link && !link_claim(t, node, item)) {
+                t->cursor_pos++;
+                continue;
+            }
+            if (item->name != NULL) {
+                sink_rec_t rec;
+                item_rec(t, &rec, item, node->depth + 1, NULL);
+                // Links are only ranked once they are known to be counted
+                int keep = item->link && t->top_files != NULL &&
+                           (t->opts->flags & FLAG_ALL) &&
+                           printable(t->opts, node->depth + 1);
+                if (item->print || keep) {
+                    size_t len = pathbuf_push(&t->emit_path, item->name);
+                    if (len != (size_t)-1) {
+                        rec.path = t->emit_path.str;
+                        if (item->print) {
+                            print_entry(&rec);
+                            t->entries++;
+                        } else {
+                            top_keep(t, t->top_files, &rec);
+                        }
+                        pathbuf_pop(&t->emit_path, len);
+                    }
+                }
+                if (t->opts->index != NULL) {
+                    index_entry(t, item->name, node->depth + 1, &rec,
+                                item->mtime, 0);
+                }
+                item->name = NULL;
+            }
+            t->cursor_pos++;
+            continue;
+        }
+
+        if (state != NODE_DONE) break;
+
+        if (t->skipped == node) {
+            // Counted under an earlier path, nothing of it is written
+            if (node->parent != NULL &&
+                (t->opts->flags & FLAG_SEPDIR) == 0) {
+                linked_take(t, node->parent,
+                            &node->parent->items[node->index], node);
+            }
+            t->skipped = NULL;
+        } else if (t->skipped == NULL) {
+            node_write(t, node);
+        }
+
+        pathbuf_pop(&t->emit_path, node->emit_len);
+        t->cursor = node->parent;
+        t->cursor_pos = node->index + 1;
+        if (node->parent != NULL &&
+            atomic_fetch_sub(&t->live, 1) == HOLD_NODES / 2) {
+            pool_hold(t->pool, 0);
+        }
+        node_free(node);
+    }
+
+    pthread_mutex_unlock(&t->emit_lock);
+}
+
+static void node_complete(traverse_t *t, du_node_t *node, int worker);
+
+/**
+ * @brief Adds a path to the roots of its device
+ * @return 0 upon success, -1 if out of memory
+ */
+static int root_add(traverse_t *t, char *path, const struct stat *status) {
+    const du_opts_t *opts = t->opts;
+    du_root_t *root = &t->roots[t->nroots];
+    file_type_t type = sget_type(status);
+
+    if (type != FTYPE_REG && type != FTYPE_LINK && type != FTYPE_DIR) return 0;
+    if (type == FTYPE_DIR &&
+        mounts_prune(opts->excluded, 0, status->st_dev, status->st_dev)) {
+        return 0;
+    }
+
+    root->path = path;
+    root->status = *status;
+    root->next = -1;
+    root->node = NULL;
+    root->counted = 0;
+    atomic_init(&root->ready, 0);
+    root->resumed = 0;
+
+    if (type == FTYPE_DIR) {
+        if ((root->node = node_create(NULL, path, 0)) == NULL) return -1;
+        root->node->index = t->nroots;  // roots have no parent items
+        root->node->blocks = status->st_blocks;
+        node_setstatus(root->node, status);
+        progress_found(1);
+    } else {
+        root->rec.path = path;
+        root->rec.size =
+            print_size(opts, status->st_blocks, status->st_size);
+        root->rec.blocks = print_blocks(opts, status->st_blocks);
+        root->rec.apparent = status->st_size;
+        root->rec.inode = status->st_ino;
+        root->rec.count = 1;
+        root->rec.depth = 0;
+        root->rec.type = type == FTYPE_LINK ? SINK_LINK : SINK_FILE;
+        root->rec.partial = 0;
+        root->rec.hist = NULL;
+    }
+
+    int device = 0;
+    while (device < t->ndevices && t->devices[device].dev != status->st_dev) {
+        device++;
+    }
+    du_device_t *dev = &t->devices[device];
+    if (device == t->ndevices) {
+        dev->dev = status->st_dev;
+        dev->waiting = t->nroots;
+        dev->running = 0;
+        t->ndevices++;
+    } else {
+        t->roots[dev->last].next = t->nroots;
+    }
+    dev->last = t->nroots;
+    root->device = device;
+    t->nroots++;
+    return 0;
+}
+
+/**
+ * @brief Reads a root that isn't a directory in its turn on the device, it is
+ *        counted once written like the links of the directories
+ */
+static void root_read(du_root_t *root) {
+    stats_entry(S_ISLNK(root->status.st_mode) ? STATS_SYMLINKS : STATS_FILES,
+                root->status.st_size);
+    atomic_store(&root->ready, 1);
+}
+
+/**
+ * @brief Starts the roots of the device while under its budget, in the order
+ *        they were given
+ */
+static void device_start(traverse_t *t, int device, int worker) {
+    du_device_t *dev = &t->devices[device];
+    int read = 0;
+
+    while (1) {
+        pthread_mutex_lock(&t->devices_lock);
+        long index = dev->waiting;
+        if (index != -1 && dev->running < t->opts->device_jobs) {
+            dev->waiting = t->roots[index].next;
+            // A root done before the checkpoint only waits to be written
+            du_node_t *node = t->roots[index].node;
+            if (node != NULL && atomic_load(&node->state) != NODE_DONE) {
+                dev->running++;
+            }
+        } else {
+            index = -1;
+        }
+        pthread_mutex_unlock(&t->devices_lock);
+        if (index == -1) break;
+
+        du_root_t *root = &t->roots[index];
+        if (root->node == NULL) {
+            root_read(root);
+            read = 1;
+        } else if (root->resumed) {
+            // Its directories left were pushed when the tree was rebuilt
+            read = 1;
+        } else if (pool_push(t->pool, worker, root->node)) {
+            print_error("pool push error", root->path);
+            atomic_store(&t->error, 1);
+            root->node->failed = 1;
+            atomic_store(&root->node->state, NODE_SCANNED);
+            node_complete(t, root->node, worker);
+        }
+    }
+
+    // Nothing else would write the roots that were just read or resumed
+    if (read) emit_ready(t);
+}
+
+/**
+ * @brief Called once every entry of the root is known, gives its turn to
+ *        the next root of the device
+ */
+static void root_done(traverse_t *t, long index, int worker) {
+    int device = t->roots[index].device;
+    pthread_mutex_lock(&t->devices_lock);
+    t->devices[device].running--;
+    pthread_mutex_unlock(&t->devices_lock);
+    device_start(t, device, worker);
+}
+
+/**
+ * @brief Adds the subdirectories to the size of the node and propagates to
+ *        every ancestor whose last pending subdirectory was this one
+ */
+static void node_complete(traverse_t *t, du_node_t *node, int worker) {
+    while (node != NULL) {
+        du_node_t *parent = node->parent;
+        long index = node->index;
+
+        node->own = node->blocks;
+        node->own_apparent = node->apparent;
+        // A directory cut by the deadline isn't known to be unchanged
+        int partial = atomic_load(&node->partial);
+        if (t->opts->cache != NULL && !node->failed && !partial) {
+            node_record(t, node, worker);
+            if (parent != NULL) {
+                atomic_fetch_add(&parent->tree_blocks,
+                                 atomic_load(&node->tree_blocks));
+                atomic_fetch_add(&parent->tree_bytes,
+                                 atomic_load(&node->tree_bytes));
+            }
+        }
+
+        if (!node->failed && (t->opts->flags & FLAG_SEPDIR) == 0) {
+            for (long i = 0; i < node->items_size; i++) {
+                if (node->items[i].child != NULL) {
+                    node->blocks += node->items[i].blocks;
+                    node->apparent += node->items[i].apparent;
+                    node->count += node->items[i].count;
+                }
+            }
+        }
+        if (parent != NULL) {
+            du_item_t *item = &parent->items[index];
+            item->blocks = node->failed ? 0 : node->blocks;
+            item->apparent = node->failed ? 0 : node->apparent;
+            item->count = node->failed ? 0 : node->count;
+            // Sizes of the parent only hold its own entries with -S
+            if (partial && (t->opts->flags & FLAG_SEPDIR) == 0) {
+                atomic_store(&parent->partial, 1);
+            }
+            if (node->hist != NULL && parent->hist != NULL &&
+                !node->failed && (t->opts->flags & FLAG_SEPDIR) == 0) {
+                hist_add(parent->hist, node->hist);
+            }
+        }
+
+        // After this point the node may be written and freed by emit_ready
+        atomic_store(&node->state, NODE_DONE);
+        emit_ready(t);
+
+        if (parent == NULL) {
+            root_done(t, index, worker);
+            break;
+        }
+        if (atomic_fetch_sub(&parent->pending, 1) != 1) break;
+        node = parent;
+    }
+}
+
+/**
+ * @brief Gets the next entry of the directory from the scanner of the worker,
+ *        or from its process
+ * @return Pointer to entry, NULL at the end or if the directory failed
+ */
+static dir_entry_t* node_next(traverse_t *t, du_node_t *node, int worker,
+                              int reuse) {
+    if (t->procs == NULL) {
+        dir_scan_t *scan = &t->scans[worker];
+        return reuse ? dirscan_next_dir(scan) : dirscan_next(scan);
+    }
+
+    dir_entry_t *entry;
+    int ret = procpool_next(t->procs, worker, &entry);
+    if (ret != 0) {
+        print_node_error(ret == PROCPOOL_EOPEN ? "opendir error" : "worker error",
+                         node, NULL, &t->paths[worker]);
+        node->failed = 1;
+    }
+    return entry;
+}
+
+static void node_scan(traverse_t *t, du_node_t *node, int worker) {
+    const du_opts_t *opts = t->opts;
+    path_buf_t *pb = &t->paths[worker];
+    dir_scan_t *scan = &t->scans[worker];
+    DIR *dir = NULL;
+
+    // Unchanged directories keep the size of their entries, only the
+    // subdirectories are read again. Sizes of the entries are read when they
+    // are printed, verified or may be counted elsewhere
+    const cache_rec_t *cached = node_cached(t, node);
+    int reuse = cached != NULL &&
+                (opts->flags & (FLAG_ALL | FLAG_VERIFY)) == 0 &&
+                !opts->histogram &&
+                (opts->inodes == NULL ||
+                 (!t->unique && (cached->flags & CACHE_MULTILINK) == 0));
+
+    if (opts->histogram && node->hist == NULL &&
+        (node->hist = hist_create(&node->arena)) == NULL) {
+        print_node_error("malloc error", node, NULL, pb);
+        node->failed = 1;
+        return;
+    }
+
+    // Past the deadline the directory is left as it was found, with its own
+    // size only
+    if (deadline_passed(t)) {
+        if (node->parent != NULL) node_release(t, node->parent);
+        atomic_store(&node->partial, 1);
+        return;
+    }
+
+    stats_entry(STATS_DIRS, node->apparent);
+    if (t->procs != NULL) {
+        // The worker opens it by its whole path, errors come with the entries
+        if (node_path(node, pb) ||
+            procpool_start(t->procs, worker, pb->str, reuse)) {
+            print_node_error("worker error", node, NULL, pb);
+            node->failed = 1;
+            return;
+        }
+    } else if ((dir = node_opendir(t, node, pb)) == NULL) {
+        print_node_error("opendir error", node, NULL, pb);
+        node->failed = 1;
+        return;
+    }
+
+    if (reuse) {
+        node->own_blocks = cached->own_blocks;
+        node->own_bytes = cached->own_bytes;
+        node->apparent += cached->own_bytes;
+        node->count += cached->own_count;
+        node->cache_flags = cached->flags & CACHE_MULTILINK;
+        node->blocks += cached->own_blocks;
+    }
+
+    dir_entry_t *entry;
+    long read = 0;
+    if (dir != NULL) dirscan_start(scan, dir);
+    while ((entry = node_next(t, node, worker, reuse)) != NULL) {
+        if (++read % DEADLINE_CHECK == 0 && deadline_passed(t)) {
+            atomic_store(&node->partial, 1);
+            break;
+        }
+        if (entry->error) {
+            errno = entry->error;
+            print_node_error("fget_status error on reading", node,
+                             entry->name, pb);
+            node->failed = 1;
+            break;
+        }
+
+        struct stat *new_status = &entry->status;
+        switch (sget_type(new_status)) {
+            case FTYPE_REG:
+            case FTYPE_LINK: {
+                stats_entry(S_ISLNK(new_status->st_mode) ? STATS_SYMLINKS
+                                                         : STATS_FILES,
+                            new_status->st_size);
+                if (new_status->st_nlink > 1) {
+                    node->cache_flags |= CACHE_MULTILINK;
+                }
+
+                node->blocks += new_status->st_blocks;
+                node->own_blocks += new_status->st_blocks;
+                node->own_bytes += new_status->st_size;
+                node->apparent += new_status->st_size;
+                node->count++;
+                if (node->hist != NULL) {
+                    atomic_fetch_add_explicit(
+                        &node->hist[hist_bucket(new_status->st_size)], 1,
+                        memory_order_relaxed);
+                }
+
+                // Files are kept until their directory is written when they
+                // are printed or indexed, and hard links to be counted (or
+                // taken off) once they are written, in output order
+                int print = (opts->flags & FLAG_ALL) &&
+                            printable(opts, node->depth + 1);
+                int link = opts->inodes != NULL &&
+                           (t->unique || new_status->st_nlink > 1);
+                if (print || opts->index != NULL || link) {
+                    du_item_t file;
+                    file.blocks = new_status->st_blocks;
+                    file.apparent = new_status->st_size;
+                    file.count = 1;
+                    file.ino = new_status->st_ino;
+                    file.dev = new_status->st_dev;
+                    file.mtime = new_status->st_mtim.tv_sec;
+                    file.type = S_ISLNK(new_status->st_mode) ? SINK_LINK
+                                                              : SINK_FILE;
+                    file.print = print && !t->ranked;
+                    file.link = link;
+                    if (print && t->ranked && !link) {
+                        if (t->top_files != NULL) {
+                            sink_rec_t rec;
+                            item_rec(t, &rec, &file, node->depth + 1, NULL);
+                            top_offer(t, &t->top_files[worker], node,
+                                      entry->name, &rec, worker);
+                        }
+                        if (opts->index == NULL) break;
+                    }
+                    du_item_t *item = node_additem(node);
+                    file.name = NULL;
+                    if (item == NULL ||
+                        ((print || opts->index != NULL) &&
+                         (file.name = arena_strdup(&node->arena,
+                                                   entry->name)) == NULL)) {
+                        if (item != NULL) node->items_size--;
+                        print_node_error("malloc error", node,
+                                         entry->name, pb);
+                        node->failed = 1;
+                        break;
+                    }
+                    file.child = NULL;
+                    *item = file;
+                }
+            } break;
+            case FTYPE_DIR: {
+                // Pruned before being opened, as if it wasn't there
+                if (mounts_prune(opts->excluded, opts->flags & FLAG_ONEFS,
+                                 node->dev, new_status->st_dev)) {
+                    break;
+                }
+                // Reported and skipped like du, whose -L doesn't fail on it
+                if (node_cycle(node, new_status)) {
+                    errno = ELOOP;
+                    print_node_error("directory cycle", node, entry->name,
+                                     pb);
+                    break;
+                }
+                du_item_t *item = node_additem(node);
+                du_node_t *child;
+                if (item == NULL ||
+                    (child = node_create(node, entry->name,
+                                         node->depth + 1)) == NULL) {
+                    if (item != NULL) node->items_size--;
+                    print_node_error("malloc error", node, entry->name,
+                                     pb);
+                    node->failed = 1;
+                    break;
+                }
+                child->index = node->items_size - 1;
+                child->blocks = new_status->st_blocks;
+                node_setstatus(child, new_status);
+                item->child = child;
+            } break;
+            default:
+                break;
+        }
+        if (node->failed) break;
+    }
+
+    node->dir = dir;
+    atomic_fetch_add(&node->tree_blocks, node->own_blocks);
+    atomic_fetch_add(&node->tree_bytes, node->own_bytes);
+
+    if ((opts->flags & FLAG_VERIFY) && !node->failed) {
+        atomic_fetch_add(&t->verify_dirs, 1);
+        if (cached != NULL) {
+            long blocks_off = labs((long)(node->own_blocks - cached->own_blocks));
+            long bytes_off = labs((long)(node->own_bytes - cached->own_bytes));
+            atomic_fetch_add(&t->verify_unchanged, 1);
+            if (blocks_off != 0 || bytes_off != 0) {
+                atomic_fetch_add(&t->verify_stale, 1);
+                atomic_fetch_add(&t->verify_blocks_off, blocks_off);
+                atomic_fetch_add(&t->verify_bytes_off, bytes_off);
+            }
+        }
+    }
+}
+
+static void scan_node(traverse_t *t, du_node_t *node, int worker) {
+    node_scan(t, node, worker);
+    if (node->failed) atomic_store(&t->error, 1);
+
+    int children = 0;
+    for (long i = 0; i < node->items_size; i++) {
+        children += (node->items[i].child != NULL);
+    }
+    progress_dir(node->count - 1 + children, node->own_blocks * 512,
+                 children);
+
+    // Subdirectories are opened relative to this one while under budget
+    if (node->dir != NULL) {
+        if (children > 0 &&
+            atomic_fetch_add(&t->kept, 1) < t->kept_budget) {
+            atomic_store(&node->unopened, children);
+        } else {
+            if (children > 0) atomic_fetch_sub(&t->kept, 1);
+            if (closedir(node->dir)) {
+                print_node_error("closedir error", node, NULL,
+                                 &t->paths[worker]);
+            }
+            node->dir = NULL;
+        }
+    }
+
+    if (children > 0 &&
+        atomic_fetch_add(&t->live, children) + children >= HOLD_NODES) {
+        pool_hold(t->pool, 1);
+    }
+    atomic_store(&node->pending, children);
+    atomic_store(&node->state, NODE_SCANNED);
+    emit_ready(t);
+
+    if (children == 0) {
+        node_complete(t, node, worker);
+        return;
+    }
+
+    // Pushed backwards so the owner pops them in readdir order, which lets
+    // the output advance while thieves take the last subdirectories
+    // Once the last one is pushed the node may already be done and freed
+    for (long i = node->items_size - 1; children > 0; i--) {
+        du_node_t *child = node->items[i].child;
+        if (child == NULL) continue;
+        children--;
+        if (pool_push(t->pool, worker, child)) {
+            print_node_error("pool push error", child, NULL,
+                             &t->paths[worker]);
+            child->failed = 1;
+            atomic_store(&child->state, NODE_SCANNED);
+            node_release(t, node);
+            node_complete(t, child, worker);
+        }
+    }
+}
+
+static void scan_task(void *ctx, void *task, int worker) {
+    traverse_t *t = (traverse_t *)ctx;
+    if (atomic_load_explicit(&t->paused, memory_order_relaxed)) {
+        pthread_mutex_lock(&t->pause_lock);
+        while (atomic_load(&t->paused)) {
+            pthread_cond_wait(&t->resume, &t->pause_lock);
+        }
+        pthread_mutex_unlock(&t->pause_lock);
+    }
+    if (t->opts->checkpoint == NULL) {
+        scan_node(t, (du_node_t *)task, worker);
+        return;
+    }
+    pthread_rwlock_rdlock(&t->quiet);
+    scan_node(t, (du_node_t *)task, worker);
+    pthread_rwlock_unlock(&t->quiet);
+}
+
+/**
+ * @brief Saves a node and its items not written yet, each subdirectory
+ *        right after its item
+ * @param chain     Nodes from the root of the cursor down to it
+ * @param level     Position of the node in the chain, -1 if it isn't there
+ */
+static void checkpoint_node(traverse_t *t, checkpoint_writer_t *w,
+                            du_node_t *node, du_node_t **chain, int nchain,
+                            int level) {
+    int state = atomic_load(&node->state);
+    long first = 0;
+    if (level >= 0) {
+        first = level + 1 < nchain ? chain[level + 1]->index : t->cursor_pos;
+    }
+
+    checkpoint_node_t rec;
+    memset(&rec, 0, sizeof(rec));
+    rec.blocks = node->blocks;
+    rec.own = node->own;
+    rec.apparent = node->apparent;
+    rec.own_apparent = node->own_apparent;
+    rec.count = node->count;
+    // Subdirectories already written only live on in the size of a node
+    // that isn't done, like node_complete would have added them
+    if (state == NODE_SCANNED && !node->failed &&
+        (t->opts->flags & FLAG_SEPDIR) == 0) {
+        for (long i = 0; i < first; i++) {
+            if (node->items[i].child == NULL) continue;
+            rec.blocks += node->items[i].blocks;
+            rec.apparent += node->items[i].apparent;
+            rec.count += node->items[i].count;
+        }
+    }
+    rec.dev = node->dev;
+    rec.ino = node->ino;
+    rec.mtime_sec = node->mtim.tv_sec;
+    rec.mtime_nsec = node->mtim.tv_nsec;
+    rec.ctime_sec = node->ctim.tv_sec;
+    rec.ctime_nsec = node->ctim.tv_nsec;
+    rec.own_blocks = node->own_blocks;
+    rec.own_bytes = node->own_bytes;
+    rec.tree_blocks = atomic_load(&node->tree_blocks);
+    rec.tree_bytes = atomic_load(&node->tree_bytes);
+    if (node->linked != NULL) {
+        rec.linked_blocks = node->linked->blocks;
+        rec.linked_apparent = node->linked->apparent;
+        rec.linked_count = node->linked->count;
+        rec.linked_own = node->linked->own;
+        rec.linked_own_apparent = node->linked->own_apparent;
+    }
+    rec.cache_flags = node->cache_flags;
+    // Between tasks a node still scanning hasn't been started
+    rec.state = state == NODE_SCANNING  ? CHECKPOINT_UNREAD
+                : state == NODE_SCANNED ? CHECKPOINT_SCANNED
+                                        : CHECKPOINT_DONE;
+    rec.flags = (node->failed ? CHECKPOINT_FAILED : 0) |
+                (atomic_load(&node->partial) ? CHECKPOINT_PARTIAL : 0) |
+                (node->hist != NULL ? CHECKPOINT_HIST : 0) |
+                (node->linked != NULL ? CHECKPOINT_LINKED : 0);
+    rec.items = rec.state == CHECKPOINT_UNREAD ? 0 : node->items_size - first;
+    rec.name_len = strlen(node->name);
+    checkpoint_write(w, &rec, sizeof(rec), node->name, rec.name_len);
+    if (node->hist != NULL) {
+        uint64_t hist[SINK_HIST_BUCKETS];
+        checkpoint_write(w, hist_load(hist, node->hist), sizeof(hist), NULL,
+                         0);
+        if (node->linked != NULL) {
+            checkpoint_write(w, node->linked->hist, sizeof(hist), NULL, 0);
+        }
+    }
+    if (rec.state == CHECKPOINT_UNREAD) return;
+
+    for (long i = first; i < node->items_size; i++) {
+        const du_item_t *item = &node->items[i];
+        checkpoint_item_t irec;
+        memset(&irec, 0, sizeof(irec));
+        irec.blocks = item->blocks;
+        irec.apparent = item->apparent;
+        irec.count = item->count;
+        irec.ino = item->ino;
+        irec.dev = item->dev;
+        irec.mtime = item->mtime;
+        irec.type = item->type;
+        irec.print = item->print;
+        irec.dir = item->child != NULL;
+        irec.link = item->link;
+        irec.name_len = item->child == NULL && item->name != NULL
+                            ? strlen(item->name)
+                            : 0;
+        checkpoint_write(w, &irec, sizeof(irec),
+                         irec.name_len > 0 ? item->name : NULL,
+                         irec.name_len);
+        if (item->child != NULL) {
+            int next = level >= 0 && i == first && level + 1 < nchain
+                           ? level + 1
+                           : -1;
+            checkpoint_node(t, w, item->child, chain, nchain, next);
+        }
+    }
+}
+
+/**
+ * @brief Saves every root not fully written to the checkpoint file, the
+ *        output written so far is flushed first. Called between tasks
+ */
+static void checkpoint_save(traverse_t *t) {
+    const du_opts_t *opts = t->opts;
+    outbuf_flush(outbuf_stdout());
+
+    // The root of the cursor is the first one not fully written
+    long first = t->cursor != NULL ? t->root_pos - 1 : t->root_pos;
+    int nchain = 0;
+    du_node_t **chain = NULL;
+    if (t->cursor != NULL) {
+        nchain = t->cursor->depth + 1;
+        if ((chain = (du_node_t **)malloc(sizeof(du_node_t *) * nchain)) ==
+            NULL) {
+            print_error("checkpoint error", opts->checkpoint);
+            return;
+        }
+        for (du_node_t *node = t->cursor; node != NULL; node = node->parent) {
+            chain[node->depth] = node;
+        }
+    }
+
+    checkpoint_header_t header;
+    memset(&header, 0, sizeof(header));
+    header.magic = CHECKPOINT_MAGIC;
+    header.version = CHECKPOINT_VERSION;
+    header.flags = opts->flags & CHECKPOINT_OPTS;
+    header.block_size = opts->block_size;
+    header.max_depth = opts->max_depth;
+    header.entries = t->entries;
+    header.paths = t->ngiven;
+    header.roots = t->nroots - first;
+    header.histogram = opts->histogram != 0;
+
+    checkpoint_writer_t *w = checkpoint_create(opts->checkpoint, &header);
+    if (w == NULL) {
+        print_error("checkpoint error", opts->checkpoint);
+        free(chain);
+        return;
+    }
+    for (int i = 0; i < t->ngiven; i++) {
+        uint32_t len = strlen(t->given[i]);
+        checkpoint_write(w, &len, sizeof(len), t->given[i], len);
+    }
+    for (long i = first; i < t->nroots; i++) {
+        du_root_t *root = &t->roots[i];
+        uint32_t len = strlen(root->path);
+        checkpoint_write(w, &len, sizeof(len), root->path, len);
+        if (root->node != NULL) {
+            checkpoint_node(t, w, root->node, chain, nchain,
+                            i == first && chain != NULL ? 0 : -1);
+            continue;
+        }
+        // Status of the other entries is read again on resume
+        checkpoint_node_t rec;
+        memset(&rec, 0, sizeof(rec));
+        rec.state = CHECKPOINT_UNREAD;
+        rec.name_len = len;
+        checkpoint_write(w, &rec, sizeof(rec), root->path, len);
+    }
+    if (checkpoint_finish(w, 1)) {
+        print_error("checkpoint error", opts->checkpoint);
+    }
+    free(chain);
+}
+
+/**
+ * @brief Handles SIGINT or SIGTERM with the workers stopped and the output
+ *        locked, so nothing is being written while the output is flushed.
+ *        The program ends upon SIGTERM or if the question of SIGINT is
+ *        confirmed, after a checkpoint with --checkpoint
+ */
+static void control_signal(traverse_t *t) {
+    atomic_store(&t->paused, 1);
+    if (t->opts->checkpoint != NULL) pthread_rwlock_wrlock(&t->quiet);
+    pthread_mutex_lock(&t->emit_lock);
+
+    if (sig_terminated() || (sig_interrupted() && sig_prompt())) {
+        if (t->opts->checkpoint != NULL) checkpoint_save(t);
+        sig_terminate();
+    }
+
+    pthread_mutex_unlock(&t->emit_lock);
+    if (t->opts->checkpoint != NULL) pthread_rwlock_unlock(&t->quiet);
+    pthread_mutex_lock(&t->pause_lock);
+    atomic_store(&t->paused, 0);
+    pthread_cond_broadcast(&t->resume);
+    pthread_mutex_unlock(&t->pause_lock);
+}
+
+/**
+ * @brief Thread taking the signals of the traversal, the only one where they
+ *        aren't blocked, and writing a checkpoint every interval with
+ *        --checkpoint
+ */
+static void* control_run(void *arg) {
+    traverse_t *t = (traverse_t *)arg;
+    struct pollfd wake = {.fd = t->wake[0], .events = POLLIN};
+    int timeout = t->opts->checkpoint != NULL
+                      ? t->opts->checkpoint_interval * 1000
+                      : -1;
+    pthread_sigmask(SIG_UNBLOCK, &t->signals, NULL);
+
+    while (1) {
+        // Signals received before the pipe was set are only flagged
+        if (sig_pending()) control_signal(t);
+
+        char reason = 0;
+        int ret = poll(&wake, 1, timeout);
+        if (ret == -1 && errno != EINTR) break;
+        if (ret == -1) continue;
+        if (ret > 0 && read(t->wake[0], &reason, 1) != 1) continue;
+        if (reason == 'q') break;
+        if (reason != 0) continue;
+
+        pthread_rwlock_wrlock(&t->quiet);
+        checkpoint_save(t);
+        pthread_rwlock_unlock(&t->quiet);
+    }
+    return NULL;
+}
+
+/**
+ * @brief Rebuilds a node saved by checkpoint_node, the subdirectories left
+ *        unread are pushed to the first worker
+ * @param parent    Parent node, NULL for a root, which isn't pushed
+ * @return          Pointer to node upon success, NULL if the checkpoint is
+ *                  cut short or out of memory
+ */
+static du_node_t* resume_node(traverse_t *t, checkpoint_t *ck,
+                              du_node_t *parent, int depth) {
+    checkpoint_node_t rec;
+    const char *name;
+    if (checkpoint_read(ck, &rec, sizeof(rec), 0) == NULL ||
+        (name = checkpoint_read(ck, NULL, 0, rec.name_len)) == NULL) {
+        return NULL;
+    }
+
+    du_node_t *node = node_create(parent, name, depth);
+    if (node == NULL) return NULL;
+    if (parent != NULL) atomic_fetch_add(&t->live, 1);
+    node->failed = (rec.flags & CHECKPOINT_FAILED) != 0;
+    atomic_store(&node->partial, (rec.flags & CHECKPOINT_PARTIAL) != 0);
+    node->blocks = rec.blocks;
+    node->own = rec.own;
+    node->apparent = rec.apparent;
+    node->own_apparent = rec.own_apparent;
+    node->count = rec.count;
+    node->dev = rec.dev;
+    node->ino = rec.ino;
+    node->mtim.tv_sec = rec.mtime_sec;
+    node->mtim.tv_nsec = rec.mtime_nsec;
+    node->ctim.tv_sec = rec.ctime_sec;
+    node->ctim.tv_nsec = rec.ctime_nsec;
+    node->own_blocks = rec.own_blocks;
+    node->own_bytes = rec.own_bytes;
+    node->cache_flags = rec.cache_flags;
+    atomic_store(&node->tree_blocks, rec.tree_blocks);
+    atomic_store(&node->tree_bytes, rec.tree_bytes);
+    if (rec.flags & CHECKPOINT_HIST) {
+        uint64_t hist[SINK_HIST_BUCKETS];
+        if (checkpoint_read(ck, hist, sizeof(hist), 0) == NULL ||
+            (node->hist = hist_create(&node->arena)) == NULL) {
+            return NULL;
+        }
+        for (int i = 0; i < SINK_HIST_BUCKETS; i++) {
+            atomic_store(&node->hist[i], hist[i]);
+        }
+    }
+    if (rec.flags & CHECKPOINT_LINKED) {
+        du_linked_t *linked = node_linked(t, node);
+        if (linked == NULL ||
+            ((rec.flags & CHECKPOINT_HIST) &&
+             checkpoint_read(ck, linked->hist,
+                             sizeof(uint64_t) * SINK_HIST_BUCKETS,
+                             0) == NULL)) {
+            return NULL;
+        }
+        linked->blocks = rec.linked_blocks;
+        linked->apparent = rec.linked_apparent;
+        linked->count = rec.linked_count;
+        linked->own = rec.linked_own;
+        linked->own_apparent = rec.linked_own_apparent;
+    }
+
+    if (rec.state == CHECKPOINT_UNREAD) {
+        if (parent != NULL) {
+            progress_found(1);
+            if (pool_push(t->pool, 0, node)) return NULL;
+        }
+        return node;
+    }
+
+    int pending = 0;
+    for (uint32_t i = 0; i < rec.items; i++) {
+        checkpoint_item_t irec;
+        du_item_t *item;
+        if (checkpoint_read(ck, &irec, sizeof(irec), 0) == NULL ||
+            (name = checkpoint_read(ck, NULL, 0, irec.name_len)) == NULL ||
+            (item = node_additem(node)) == NULL) {
+            return NULL;
+        }
+        item->blocks = irec.blocks;
+        item->apparent = irec.apparent;
+        item->count = irec.count;
+        item->ino = irec.ino;
+        item->dev = irec.dev;
+        item->mtime = irec.mtime;
+        item->type = irec.type;
+        item->print = irec.print;
+        item->link = irec.link;
+        if (irec.name_len > 0 &&
+            (item->name = arena_strdup(&node->arena, name)) == NULL) {
+            return NULL;
+        }
+        if (irec.dir) {
+            du_node_t *child = resume_node(t, ck, node, depth + 1);
+            if (child == NULL) return NULL;
+            child->index = node->items_size - 1;
+            node->items[child->index].child = child;
+            pending += atomic_load(&child->state) != NODE_DONE;
+        }
+    }
+    atomic_store(&node->pending, pending);
+    atomic_store(&node->state,
+                 rec.state == CHECKPOINT_DONE ? NODE_DONE : NODE_SCANNED);
+    return node;
+}
+
+/**
+ * @brief Adds the roots saved in the checkpoint of --resume, rebuilding the
+ *        directories started before it
+ * @return 0 upon success, -1 otherwise
+ */
+static int resume_roots(traverse_t *t, char **paths, int npaths) {
+    const du_opts_t *opts = t->opts;
+    checkpoint_t *ck = opts->resume;
+    const checkpoint_header_t *header = ck->header;
+
+    if (header->flags != (opts->flags & CHECKPOINT_OPTS) ||
+        header->block_size != opts->block_size ||
+        header->max_depth != opts->max_depth ||
+        header->histogram != (opts->histogram != 0) ||
+        header->paths != (uint64_t)npaths) {
+        write(STDERR_FILENO,
+              "simpledu: checkpoint was written with other options or "
+              "paths\n", 61);
+        return -1;
+    }
+    for (int i = 0; i < npaths; i++) {
+        uint32_t len;
+        const char *path;
+        if (checkpoint_read(ck, &len, sizeof(len), 0) == NULL ||
+            (path = checkpoint_read(ck, NULL, 0, len)) == NULL) {
+            write(STDERR_FILENO, "simpledu: checkpoint is damaged\n", 32);
+            return -1;
+        }
+        if (strcmp(path, paths[i]) != 0) {
+            write(STDERR_FILENO,
+                  "simpledu: checkpoint was written with other options or "
+                  "paths\n", 61);
+            return -1;
+        }
+    }
+
+    t->entries = header->entries;
+    fprintf(stderr,
+            "simpledu: resuming from '%s', %lu entries were written before "
+            "it\n",
+            opts->checkpoint != NULL ? opts->checkpoint : "checkpoint",
+            (unsigned long)header->entries);
+
+    for (uint64_t i = 0; i < header->roots; i++) {
+        uint32_t len;
+        const char *path;
+        struct stat status;
+        if (checkpoint_read(ck, &len, sizeof(len), 0) == NULL ||
+            (path = checkpoint_read(ck, NULL, 0, len)) == NULL) {
+            write(STDERR_FILENO, "simpledu: checkpoint is damaged\n", 32);
+            return -1;
+        }
+        if (fget_status(path, &status, opts->flags & FLAG_DEREF)) return -1;
+
+        long nroots = t->nroots;
+        if (root_add(t, (char *)path, &status)) {
+            errno = ENOMEM;
+            perror("simpledu: malloc error");
+            return -1;
+        }
+        du_node_t *node = resume_node(t, ck, NULL, 0);
+        if (node == NULL) {
+            write(STDERR_FILENO, "simpledu: checkpoint is damaged\n", 32);
+            return -1;
+        }
+
+        // Roots not started are read again like the paths given
+        du_root_t *root = &t->roots[nroots];
+        if (t->nroots == nroots || root->node == NULL ||
+            atomic_load(&node->state) == NODE_SCANNING) {
+            node_free(node);
+            continue;
+        }
+        node->index = nroots;
+        node_free(root->node);
+        root->node = node;
+        root->resumed = 1;
+    }
+    return 0;
+}
+
+int traverse_paths(const du_opts_t *opts, char **paths, int npaths) {
+    traverse_t t;
+    t.opts = opts;
+    atomic_init(&t.error, 0);
+    atomic_init(&t.index_failed, 0);
+    atomic_init(&t.expired, 0);
+    atomic_init(&t.kept, 0);
+    atomic_init(&t.live, 0);
+    pthread_mutex_init(&t.emit_lock, NULL);
+    pthread_mutex_init(&t.devices_lock, NULL);
+    pathbuf_init(&t.emit_path);
+    t.start = time(NULL);
+    atomic_init(&t.verify_dirs, 0);
+    atomic_init(&t.verify_unchanged, 0);
+    atomic_init(&t.verify_stale, 0);
+    atomic_init(&t.verify_blocks_off, 0);
+    atomic_init(&t.verify_bytes_off, 0);
+    t.wake[0] = t.wake[1] = -1;
+    atomic_init(&t.paused, 0);
+    pthread_mutex_init(&t.pause_lock, NULL);
+    pthread_cond_init(&t.resume, NULL);
+    t.entries = 0;
+    t.given = paths;
+    t.ngiven = npaths;
+
+    struct rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0 &&
+        limit.rlim_cur != RLIM_INFINITY && limit.rlim_cur > FD_RESERVED) {
+        t.kept_budget = (int)(limit.rlim_cur - FD_RESERVED);
+    } else {
+        t.kept_budget = FD_RESERVED;
+    }
+
+    t.ranked = opts->top > 0 || opts->top_files > 0;
+    t.top_dirs = NULL;
+    t.top_files = NULL;
+    t.procs = NULL;
+
+    t.paths = (path_buf_t *)malloc(sizeof(path_buf_t) * opts->threads);
+    t.scans = (dir_scan_t *)malloc(sizeof(dir_scan_t) * opts->threads);
+    t.rings = (uring_t **)calloc(opts->threads, sizeof(uring_t *));
+    t.roots = (du_root_t *)calloc(npaths, sizeof(du_root_t));
+    t.devices = (du_device_t *)calloc(npaths, sizeof(du_device_t));
+    t.nroots = 0;
+    t.root_pos = 0;
+    t.ndevices = 0;
+    t.cursor = NULL;
+    t.unique = opts->inodes != NULL && inoset_all(opts->inodes);
+    t.skipped = NULL;
+    if (opts->top > 0) t.top_dirs = top_create(&t, opts->top);
+    if (opts->top_files > 0) t.top_files = top_create(&t, opts->top_files);
+    if (t.paths == NULL || t.scans == NULL || t.rings == NULL ||
+        t.roots == NULL || t.devices == NULL || (opts->top > 0 && t.top_dirs == NULL) ||
+        (opts->top_files > 0 && t.top_files == NULL) ||
+        (t.pool = pool_create(opts->threads, scan_task, &t)) == NULL) {
+        free(t.paths);
+        free(t.scans);
+        free(t.rings);
+        free(t.roots);
+        free(t.devices);
+        top_free(&t, t.top_dirs);
+        top_free(&t, t.top_files);
+        pthread_mutex_destroy(&t.emit_lock);
+        pthread_mutex_destroy(&t.devices_lock);
+        pthread_mutex_destroy(&t.pause_lock);
+        pthread_cond_destroy(&t.resume);
+        errno = ENOMEM;
+        perror("simpledu: pool_create error");
+        return -1;
+    }
+
+    int status = 0;
+    for (int i = 0; i < opts->threads; i++) {
+        pathbuf_init(&t.paths[i]);
+        // Without io_uring the scanner reads the status synchronously
+        if (opts->uring_depth > 0) t.rings[i] = uring_create(opts->uring_depth);
+        if (dirscan_init(&t.scans[i], t.rings[i], opts->flags & FLAG_DEREF)) {
+            dirscan_init(&t.scans[i], NULL, opts->flags & FLAG_DEREF);
+        }
+        t.scans[i].exclude = opts->exclude;
+    }
+
+    // Forked before the threads of the pool exist
+    if (opts->workers &&
+        (t.procs = procpool_create(opts->threads, opts->worker_timeout,
+                                   opts->flags & FLAG_DEREF, opts->uring_depth,
+                                   opts->exclude)) == NULL) {
+        perror("simpledu: worker error");
+        status = -1;
+    }
+
+    if (status == 0 && opts->resume != NULL &&
+        resume_roots(&t, paths, npaths)) {
+        status = -1;
+    }
+
+    // Every path is read before any is traversed, the ones after a path that
+    // can't be read aren't traversed
+    for (int path_index = 0;
+         status == 0 && opts->resume == NULL && path_index < npaths;
+         path_index++) {
+        struct stat status_root;
+
+        if (fget_status(paths[path_index], &status_root,
+                        opts->flags & FLAG_DEREF)) {
+            status = -1;
+            break;
+        }
+        if (root_add(&t, paths[path_index], &status_root)) {
+            errno = ENOMEM;
+            perror("simpledu: malloc error");
+            status = -1;
+            break;
+        }
+    }
+
+    // The pool is idle, the first roots of each device go to the first worker
+    for (int device = 0; device < t.ndevices; device++) {
+        device_start(&t, device, 0);
+    }
+
+    // Writers go first, a checkpoint doesn't wait for the queue to drain
+    if (opts->checkpoint != NULL) {
+        pthread_rwlockattr_t attr;
+        pthread_rwlockattr_init(&attr);
+        pthread_rwlockattr_setkind_np(
+            &attr, PTHREAD_RWLOCK_PREFER_WRITER_NONRECURSIVE_NP);
+        pthread_rwlock_init(&t.quiet, &attr);
+        pthread_rwlockattr_destroy(&attr);
+    }
+
+    // Blocked before the threads of the pool exist, which inherit the mask,
+    // and after the workers of --workers were forked
+    sigset_t previous;
+    sigemptyset(&t.signals);
+    sigaddset(&t.signals, SIGINT);
+    sigaddset(&t.signals, SIGTERM);
+    sigaddset(&t.signals, SIGCONT);
+    sigaddset(&t.signals, SIGUSR1);
+    pthread_sigmask(SIG_BLOCK, &t.signals, &previous);
+    pthread_t control;
+    int controlling = 0;
+    if (pipe2(t.wake, O_CLOEXEC | O_NONBLOCK) ||
+        pthread_create(&control, NULL, control_run, &t)) {
+        perror("simpledu: control thread error");
+        status = -1;
+    } else {
+        controlling = 1;
+        sig_setwake_fd(t.wake[1]);
+    }
+
+    if (pool_run(t.pool)) {
+        perror("simpledu: pool error");
+        status = -1;
+    }
+
+    sig_setwake_fd(-1);
+    if (controlling) {
+        write(t.wake[1], "q", 1);
+        pthread_join(control, NULL);
+    }
+    if (t.wake[0] != -1) close(t.wake[0]);
+    if (t.wake[1] != -1) close(t.wake[1]);
+    if (opts->checkpoint != NULL) pthread_rwlock_destroy(&t.quiet);
+    pthread_sigmask(SIG_SETMASK, &previous, NULL);
+    emit_ready(&t);
+    // Signals received after the control thread left
+    sig_poll();
+
+    pool_destroy(t.pool);
+    procpool_destroy(t.procs);
+    pthread_mutex_destroy(&t.emit_lock);
+    pthread_mutex_destroy(&t.devices_lock);
+    pthread_mutex_destroy(&t.pause_lock);
+    pthread_cond_destroy(&t.resume);
+    free(t.roots);
+    free(t.devices);
+
+    if (status == 0) {
+        top_print(&t, t.top_dirs);
+        top_print(&t, t.top_files);
+    }
+    top_free(&t, t.top_dirs);
+    top_free(&t, t.top_files);
+
+    for (int i = 0; i < opts->threads; i++) {
+        pathbuf_free(&t.paths[i]);
+        dirscan_free(&t.scans[i]);
+        uring_destroy(t.rings[i]);
+    }
+    free(t.paths);
+    free(t.scans);
+    free(t.rings);
+    pathbuf_free(&t.emit_path);
+
+    if (opts->flags & FLAG_VERIFY) {
+        fprintf(stderr,
+                "simpledu: cache verify: %ld directories, %ld unchanged since "
+                "the cache, %ld of them with stale sizes (%ld blocks, %ld "
+                "bytes off)\n",
+                atomic_load(&t.verify_dirs), atomic_load(&t.verify_unchanged),
+                atomic_load(&t.verify_stale), atomic_load(&t.verify_blocks_off),
+                atomic_load(&t.verify_bytes_off));
+    }
+
+    if (atomic_load(&t.expired)) {
+        write(STDERR_FILENO,
+              "simpledu: deadline reached, sizes of the directories not "
+              "fully read are lower bounds\n",
+              85);
+        if (status == 0) status = 1;
+    }
+    // A traversal that got to the end has nothing left to resume
+    if (status == 0 && opts->checkpoint != NULL && controlling &&
+        unlink(opts->checkpoint) && errno != ENOENT) {
+        print_error("checkpoint error", opts->checkpoint);
+    }
+    if (status == 0 && atomic_load(&t.error)) status = 1;
+    return status;
+}
@@ -0,0 +1,180 @@
+/* MAIN HEADER */
+#include "uring.h"
+
+/* INCLUDE HEADERS */
+
+/* SYSTEM CALLS HEADERS */
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+/* C LIBRARY HEADERS */
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct uring {
+    int                   fd;
+    unsigned              depth;
+
+    void                 *sq_ptr;
+    size_t                sq_size;
+    void                 *cq_ptr;
+    size_t                cq_size;
+    struct io_uring_sqe  *sqes;
+    size_t                sqes_size;
+
+    unsigned             *sq_head;
+    unsigned             *sq_tail;
+    unsigned             *sq_mask;
+    unsigned             *sq_array;
+    unsigned             *cq_head;
+    unsigned             *cq_tail;
+    unsigned             *cq_mask;
+    struct io_uring_cqe  *cqes;
+};
+
+static int sys_io_uring_setup(unsigned entries, struct io_uring_params *p) {
+    return (int)syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int sys_io_uring_enter(int fd, unsigned to_submit,
+                              unsigned min_complete, unsigned flags) {
+    return (int)syscall(__NR_io_uring_enter, fd, to_submit, min_complete,
+                        flags, NULL, 0);
+}
+
+uring_t* uring_create(unsigned depth) {
+    if (depth == 0) return NULL;
+
+    uring_t *ring = (uring_t *)calloc(1, sizeof(uring_t));
+    if (ring == NULL) return NULL;
+
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    if ((ring->fd = sys_io_uring_setup(depth, &params)) < 0) {
+        free(ring);
+        return NULL;
+    }
+    ring->depth = params.sq_entries;
+
+    ring->sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    ring->cq_size =
+        params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        if (ring->cq_size > ring->sq_size) ring->sq_size = ring->cq_size;
+        ring->cq_size = ring->sq_size;
+    }
+
+    ring->sq_ptr = mmap(NULL, ring->sq_size, PROT_READ | PROT_WRITE,
+                        MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQ_RING);
+    if (ring->sq_ptr == MAP_FAILED) goto error_sq;
+
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        ring->cq_ptr = ring->sq_ptr;
+    } else {
+        ring->cq_ptr = mmap(NULL, ring->cq_size, PROT_READ | PROT_WRITE,
+                            MAP_SHARED | MAP_POPULATE, ring->fd,
+                            IORING_OFF_CQ_RING);
+        if (ring->cq_ptr == MAP_FAILED) goto error_cq;
+    }
+
+    ring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    ring->sqes = mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES);
+    if (ring->sqes == MAP_FAILED) goto error_sqes;
+
+    char *sq = (char *)ring->sq_ptr;
+    ring->sq_head = (unsigned *)(sq + params.sq_off.head);
+    ring->sq_tail = (unsigned *)(sq + params.sq_off.tail);
+    ring->sq_mask = (unsigned *)(sq + params.sq_off.ring_mask);
+    ring->sq_array = (unsigned *)(sq + params.sq_off.array);
+
+    char *cq = (char *)ring->cq_ptr;
+    ring->cq_head = (unsigned *)(cq + params.cq_off.head);
+    ring->cq_tail = (unsigned *)(cq + params.cq_off.tail);
+    ring->cq_mask = (unsigned *)(cq + params.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe *)(cq + params.cq_off.cqes);
+
+    return ring;
+
+error_sqes:
+    if (ring->cq_ptr != ring->sq_ptr) munmap(ring->cq_ptr, ring->cq_size);
+error_cq:
+    munmap(ring->sq_ptr, ring->sq_size);
+error_sq:
+    close(ring->fd);
+    free(ring);
+    return NULL;
+}
+
+unsigned uring_depth(uring_t *ring) { return ring->depth; }
+
+int uring_statx_batch(uring_t *ring, int dirfd, char **names, unsigned n,
+                      int flags, unsigned mask, struct statx *out,
+                      int *errors) {
+    if (n > ring->depth) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    unsigned tail = *ring->sq_tail;
+    for (unsigned i = 0; i < n; i++) {
+        unsigned index = tail & *ring->sq_mask;
+        struct io_uring_sqe *sqe = &ring->sqes[index];
+
+        memset(sqe, 0, sizeof(*sqe));
+        sqe->opcode = IORING_OP_STATX;
+        sqe->fd = dirfd;
+        sqe->addr = (unsigned long)names[i];
+        sqe->len = mask;
+        sqe->off = (unsigned long)&out[i];
+        sqe->statx_flags = flags;
+        sqe->user_data = i;
+
+        ring->sq_array[index] = index;
+        tail++;
+    }
+    // Entries must be visible to the kernel before the new tail
+    __atomic_store_n(ring->sq_tail, tail, __ATOMIC_RELEASE);
+
+    unsigned submitted = 0, completed = 0;
+    int unsupported = 0;
+    while (completed < n) {
+        int ret = sys_io_uring_enter(ring->fd, n - submitted, 1,
+                                     IORING_ENTER_GETEVENTS);
+        if (ret < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        submitted += ret;
+
+        unsigned head = *ring->cq_head;
+        while (head != __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE)) {
+            struct io_uring_cqe *cqe = &ring->cqes[head & *ring->cq_mask];
+            int res = cqe->res;
+            errors[cqe->user_data] = (res < 0) ? -res : 0;
+            // Old kernels refuse the opcode itself
+            if (res == -EINVAL || res == -EOPNOTSUPP) unsupported = 1;
+            head++;
+            completed++;
+        }
+        __atomic_store_n(ring->cq_head, head, __ATOMIC_RELEASE);
+    }
+
+    if (unsupported) {
+        errno = EOPNOTSUPP;
+        return -1;
+    }
+    return 0;
+}
+
+void uring_destroy(uring_t *ring) {
+    if (ring == NULL) return;
+    munmap(ring->sqes, ring->sqes_size);
+    if (ring->cq_ptr != ring->sq_ptr) munmap(ring->cq_ptr, ring->cq_size);
+    munmap(ring->sq_ptr, ring->sq_size);
+    close(ring->fd);
+    free(ring);
+}
@@ -4,6 +4,10 @@
 /* INCLUDE HEADERS */
 
 /* SYSTEM CALLS  HEADERS */
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/sysmacros.h>
+#include <sys/uio.h>
 
 /* C LIBRARY HEADERS */
 #include <assert.h>
@@ -130,7 +134,63 @@ char *str_cat(char *s1, char *s2, int n) {
         return NULL;
     }
 
-    return strncat(res, s2, len2);
+    memcpy(res + len1, s2, len2);
+    res[len1 + len2] = 0;
+    return res;
+}
+
+/*----------------------------------------------------------------------------*/
+/*                              PATH FUNCTIONS                                */
+/*----------------------------------------------------------------------------*/
+
+void pathbuf_init(path_buf_t *pb) {
+    pb->str = NULL;
+    pb->len = 0;
+    pb->memsize = 0;
+}
+
+static int pathbuf_reserve(path_buf_t *pb, size_t len) {
+    if (len + 1 <= pb->memsize) return 0;
+
+    size_t memsize = pb->memsize ? pb->memsize : 256;
+    while (memsize < len + 1) memsize *= 2;
+
+    char *str = (char *)realloc(pb->str, memsize);
+    if (str == NULL) return -1;
+    pb->str = str;
+    pb->memsize = memsize;
+    return 0;
+}
+
+int pathbuf_set(path_buf_t *pb, const char *path) {
+    size_t len = strlen(path);
+    if (pathbuf_reserve(pb, len)) return -1;
+    memcpy(pb->str, path, len + 1);
+    pb->len = len;
+    return 0;
+}
+
+size_t pathbuf_push(path_buf_t *pb, const char *name) {
+    size_t old_len = pb->len;
+    size_t name_len = strlen(name);
+    int slash = (old_len > 0 && pb->str[old_len - 1] != '/');
+
+    if (pathbuf_reserve(pb, old_len + slash + name_len)) return (size_t)-1;
+    if (slash) pb->str[pb->len++] = '/';
+    memcpy(pb->str + pb->len, name, name_len + 1);
+    pb->len += name_len;
+    return old_len;
+}
+
+void pathbuf_pop(path_buf_t *pb, size_t len) {
+    if (pb->str == NULL || len > pb->len) return;
+    pb->len = len;
+    pb->str[len] = 0;
+}
+
+void pathbuf_free(path_buf_t *pb) {
+    free(pb->str);
+    pathbuf_init(pb);
 }
 
 /*----------------------------------------------------------------------------*/
@@ -140,7 +200,6 @@ char *str_cat(char *s1, char *s2, int n) {
 int fget_status(const char *path, struct stat *pstat, int deref_sym) {
     if (deref_sym) {  // If -L is set, then dereference the symbolic link
         if (stat(path, pstat) == -1) {
-            printf("here");
             char *error = strerror(errno);
             write(STDERR_FILENO, error, strlen(error));
             write(STDERR_FILENO, "\n", 1);
@@ -157,6 +216,80 @@ int fget_status(const char *path, struct stat *pstat, int deref_sym) {
     return 0;
 }
 
+static int stat_mode = STAT_MODE_STAT;
+static unsigned int stat_mask = STATX_TYPE | STATX_BLOCKS | STATX_SIZE;
+
+void fset_stat_mode(int mode, unsigned int extra_mask) {
+    stat_mode = mode;
+    stat_mask = STATX_TYPE | STATX_BLOCKS | STATX_SIZE | extra_mask;
+}
+
+int fget_stat_mode(void) { return stat_mode; }
+
+int dtype_ignored(unsigned char d_type) {
+    switch (d_type) {
+        case DT_FIFO:
+        case DT_CHR:
+        case DT_BLK:
+        case DT_SOCK:
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+unsigned int fget_statx_mask(void) { return stat_mask; }
+
+int fget_statx_flags(int deref_sym) {
+    int flags = deref_sym ? 0 : AT_SYMLINK_NOFOLLOW;
+    if (stat_mode == STAT_MODE_NOSYNC) flags |= AT_STATX_DONT_SYNC;
+    return flags;
+}
+
+void statx_to_stat(const struct statx *stx, struct stat *pstat) {
+    pstat->st_mode = stx->stx_mode;
+    pstat->st_size = stx->stx_size;
+    pstat->st_blocks = stx->stx_blocks;
+    pstat->st_nlink = stx->stx_nlink;
+    pstat->st_ino = stx->stx_ino;
+    pstat->st_dev = makedev(stx->stx_dev_major, stx->stx_dev_minor);
+    pstat->st_mtim.tv_sec = stx->stx_mtime.tv_sec;
+    pstat->st_mtim.tv_nsec = stx->stx_mtime.tv_nsec;
+    pstat->st_ctim.tv_sec = stx->stx_ctime.tv_sec;
+    pstat->st_ctim.tv_nsec = stx->stx_ctime.tv_nsec;
+}
+
+static int fget_statx_at(int dirfd, const char *name, struct stat *pstat,
+                         int deref_sym) {
+    struct statx stx;
+
+    if (statx(dirfd, name, fget_statx_flags(deref_sym), stat_mask, &stx) ==
+        -1)
+        return -1;
+
+    statx_to_stat(&stx, pstat);
+    return 0;
+}
+
+int fget_status_at(int dirfd, const char *name, struct stat *pstat,
+                   int deref_sym) {
+    int ret;
+    if (stat_mode == STAT_MODE_STAT) {
+        // If -L is set, then dereference the symbolic link
+        ret = fstatat(dirfd, name, pstat, deref_sym ? 0 : AT_SYMLINK_NOFOLLOW);
+    } else {
+        ret = fget_statx_at(dirfd, name, pstat, deref_sym);
+    }
+
+    if (ret == -1) {
+        char *error = strerror(errno);
+        write(STDERR_FILENO, error, strlen(error));
+        write(STDERR_FILENO, "\n", 1);
+        return -1;
+    }
+    return 0;
+}
+
 file_type_t fget_type(const char *path, int deref_sym) {
     struct stat status;
 
@@ -198,8 +331,82 @@ double fget_size(int bytes, struct stat *status, int block_size) {
     return fsize;
 }
 
+void size_add(size_sum_t *sum, const struct stat *status) {
+    sum->blocks += (uint64_t)status->st_blocks;
+    sum->bytes += (uint64_t)status->st_size;
+}
+
+long size_print(const size_sum_t *sum, int bytes, int block_size) {
+    if (bytes) return (long)sum->bytes;
+    return (long)((sum->blocks * 512 + block_size - 1) / block_size);
+}
+
 /*----------------------------------------------------------------------------*/
 /*                              MATH FUNCTIONS                                */
 /*----------------------------------------------------------------------------*/
 
 long dceill(double x) { return ((x - (long)x) > 0) ? (long)(x + 1) : (long)x; }
+
+uint64_t hash_pair(uint64_t a, uint64_t b) {
+    uint64_t x = b ^ (a * 0x9e3779b97f4a7c15ULL);
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+/*----------------------------------------------------------------------------*/
+/*                              OUTPUT FUNCTIONS                              */
+/*----------------------------------------------------------------------------*/
+
+static const char digit_pairs[201] =
+    "00010203040506070809"
+    "10111213141516171819"
+    "20212223242526272829"
+    "30313233343536373839"
+    "40414243444546474849"
+    "50515253545556575859"
+    "60616263646566676869"
+    "70717273747576777879"
+    "80818283848586878889"
+    "90919293949596979899";
+
+size_t format_long(char *buf, long value) {
+    char tmp[LONG_DECIMAL_SIZE];
+    char *end = tmp + sizeof(tmp), *p = end;
+    // Negated as unsigned so LONG_MIN doesn't overflow
+    unsigned long n = (value < 0) ? 0UL - (unsigned long)value : (unsigned long)value;
+
+    // Two digits at a time
+    while (n >= 100) {
+        unsigned long pair = (n % 100) * 2;
+        n /= 100;
+        *--p = digit_pairs[pair + 1];
+        *--p = digit_pairs[pair];
+    }
+    if (n >= 10) {
+        *--p = digit_pairs[n * 2 + 1];
+        *--p = digit_pairs[n * 2];
+    } else {
+        *--p = (char)('0' + n);
+    }
+    if (value < 0) *--p = '-';
+
+    memcpy(buf, p, end - p);
+    return end - p;
+}
+
+int write_entry(int fd, long size, const char *path) {
+    char num[LONG_DECIMAL_SIZE + 1];
+    size_t num_len = format_long(num, size);
+    num[num_len++] = '\t';
+
+    struct iovec iov[3];
+    iov[0].iov_base = num;
+    iov[0].iov_len = num_len;
+    iov[1].iov_base = (void *)path;
+    iov[1].iov_len = strlen(path);
+    iov[2].iov_base = "\n";
+    iov[2].iov_len = 1;
+
+    return (writev(fd, iov, 3) == -1) ? -1 : 0;
+}
@@ -0,0 +1,639 @@
+/* MAIN HEADER */
+#include "watch.h"
+
+/* INCLUDE HEADERS */
+#include "dirscan.h"
+#include "mounts.h"
+#include "outbuf.h"
+#include "parse.h"
+#include "sig_handler.h"
+#include "utils.h"
+
+/* SYSTEM CALLS HEADERS */
+#include <poll.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/* C LIBRARY HEADERS */
+#include <dirent.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define WATCH_MASK      (IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | \
+                         IN_MODIFY | IN_CLOSE_WRITE | IN_ONLYDIR)
+#define QUIET_MS        50      /** @brief Events are applied once none came for this long */
+#define MAX_DELAY_MS    1000    /** @brief ... or once the oldest one waited this long */
+#define EVENTS_SIZE     65536
+#define CMD_SIZE        4096
+
+typedef struct wnode wnode_t;
+
+/**
+ * @brief Directory kept in memory
+ */
+struct wnode {
+    wnode_t    *parent;
+    char       *name;       /**< @brief Name of the entry, the whole path for a root */
+    int         wd;         /**< @brief Inotify watch, -1 if none */
+    double      own;        /**< @brief Directory itself and entries that aren't directories */
+    double      total;      /**< @brief Own size plus every subdirectory */
+
+    wnode_t   **children;
+    long        children_size;
+    long        children_memsize;
+};
+
+/**
+ * @brief Directories visited by a traversal whose parent wasn't visited yet,
+ *        the traversal gives every subdirectory before its parent
+ */
+typedef struct wlevel {
+    wnode_t   **nodes;
+    long        size;
+    long        memsize;
+} wlevel_t;
+
+typedef struct watch {
+    const du_opts_t    *opts;
+    du_opts_t           scan_opts;  /**< @brief Options of the traversals, visiting instead of printing */
+    int                 fd;
+
+    wnode_t           **roots;
+    int                 nroots;
+
+    wnode_t           **by_wd;      /**< @brief Node of each watch descriptor */
+    int                 by_wd_size;
+
+    int                *dirty;      /**< @brief Watch descriptors with events not applied yet */
+    long                dirty_size;
+    long                dirty_memsize;
+    int                 overflow;   /**< @brief Events were lost, every path is traversed again */
+
+    wlevel_t           *levels;
+    int                 levels_size;
+
+    path_buf_t          path;
+    dir_scan_t          scan;
+    int                 watch_error;    /**< @brief Limit of watches reached, reported once */
+} watch_t;
+
+static long elapsed_ms(const struct timespec *since) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - since->tv_sec) * 1000 +
+           (now.tv_nsec - since->tv_nsec) / 1000000;
+}
+
+static int sizes_add(void **array, long size, long *memsize, size_t elem) {
+    if (size < *memsize) return 0;
+    long new_memsize = *memsize ? *memsize * 2 : 8;
+    void *new_array = realloc(*array, elem * new_memsize);
+    if (new_array == NULL) return -1;
+    *array = new_array;
+    *memsize = new_memsize;
+    return 0;
+}
+
+static int wnode_addchild(wnode_t *node, wnode_t *child) {
+    if (sizes_add((void **)&node->children, node->children_size,
+                  &node->children_memsize, sizeof(wnode_t *))) {
+        return -1;
+    }
+    node->children[node->children_size++] = child;
+    child->parent = node;
+    return 0;
+}
+
+/**
+ * @brief Builds the whole path of the node
+ */
+static int wnode_path(wnode_t *node, path_buf_t *pb) {
+    if (node->parent == NULL) return pathbuf_set(pb, node->name);
+    if (wnode_path(node->parent, pb)) return -1;
+    return (pathbuf_push(pb, node->name) == (size_t)-1) ? -1 : 0;
+}
+
+static void wnode_propagate(wnode_t *node, double delta) {
+    for (; node != NULL; node = node->parent) node->total += delta;
+}
+
+static void watch_register(watch_t *w, wnode_t *node, const char *path) {
+    node->wd = inotify_add_watch(w->fd, path, WATCH_MASK);
+    if (node->wd == -1) {
+        if (!w->watch_error) {
+            char buffer[512];
+            snprintf(buffer, sizeof(buffer),
+                     "simpledu: inotify_add_watch error '%s': %s, "
+                     "directories without a watch aren't updated\n",
+                     path, strerror(errno));
+            write(STDERR_FILENO, buffer, strlen(buffer));
+            w->watch_error = 1;
+        }
+        return;
+    }
+
+    if (node->wd >= w->by_wd_size) {
+        int size = w->by_wd_size ? w->by_wd_size : 64;
+        while (size <= node->wd) size *= 2;
+        wnode_t **by_wd =
+            (wnode_t **)realloc(w->by_wd, sizeof(wnode_t *) * size);
+        if (by_wd == NULL) {
+            inotify_rm_watch(w->fd, node->wd);
+            node->wd = -1;
+            return;
+        }
+        memset(by_wd + w->by_wd_size, 0,
+               sizeof(wnode_t *) * (size - w->by_wd_size));
+        w->by_wd = by_wd;
+        w->by_wd_size = size;
+    }
+
+    // The same directory reached again (moved before its old name was
+    // removed) shares the watch, the new node owns it
+    wnode_t *old = w->by_wd[node->wd];
+    if (old != NULL && old != node) old->wd = -1;
+    w->by_wd[node->wd] = node;
+}
+
+static void wnode_free(watch_t *w, wnode_t *node) {
+    for (long i = 0; i < node->children_size; i++) {
+        wnode_free(w, node->children[i]);
+    }
+    if (node->wd != -1 && node->wd < w->by_wd_size &&
+        w->by_wd[node->wd] == node) {
+        inotify_rm_watch(w->fd, node->wd);
+        w->by_wd[node->wd] = NULL;
+    }
+    free(node->children);
+    free(node->name);
+    free(node);
+}
+
+/**
+ * @brief Receives the directories of a traversal, subdirectories come first
+ *        and wait in the level below theirs for their parent
+ */
+static void watch_visit(void *ctx, const char *path, int depth, double own,
+                        double size, int failed) {
+    watch_t *w = (watch_t *)ctx;
+    (void)size;
+
+    if (depth + 2 > w->levels_size) {
+        wlevel_t *levels = (wlevel_t *)realloc(
+            w->levels, sizeof(wlevel_t) * (depth + 2));
+        if (levels == NULL) return;
+        memset(levels + w->levels_size, 0,
+               sizeof(wlevel_t) * (depth + 2 - w->levels_size));
+        w->levels = levels;
+        w->levels_size = depth + 2;
+    }
+
+    const char *name = path;
+    if (depth > 0 && strrchr(path, '/') != NULL) name = strrchr(path, '/') + 1;
+
+    wnode_t *node = (wnode_t *)calloc(1, sizeof(wnode_t));
+    if (node == NULL || (node->name = strdup(name)) == NULL) {
+        free(node);
+        return;
+    }
+    node->wd = -1;
+    node->own = failed ? 0 : own;
+    node->total = node->own;
+
+    wlevel_t *below = &w->levels[depth + 1];
+    for (long i = 0; i < below->size; i++) {
+        if (wnode_addchild(node, below->nodes[i]) == 0) {
+            node->total += below->nodes[i]->total;
+        } else {
+            wnode_free(w, below->nodes[i]);
+        }
+    }
+    below->size = 0;
+
+    wlevel_t *level = &w->levels[depth];
+    if (sizes_add((void **)&level->nodes, level->size, &level->memsize,
+                  sizeof(wnode_t *))) {
+        wnode_free(w, node);
+        return;
+    }
+    level->nodes[level->size++] = node;
+
+    if (!failed) watch_register(w, node, path);
+}
+
+/**
+ * @brief Traverses a directory and builds its tree
+ * @return Root of the tree, NULL if the directory couldn't be traversed
+ */
+static wnode_t* watch_scan(watch_t *w, const char *path) {
+    char *paths[1] = {(char *)path};
+    for (int i = 0; i < w->levels_size; i++) w->levels[i].size = 0;
+
+    if (traverse_paths(&w->scan_opts, paths, 1) == -1 || w->levels_size == 0 ||
+        w->levels[0].size != 1) {
+        for (int i = 0; i < w->levels_size; i++) {
+            for (long j = 0; j < w->levels[i].size; j++) {
+                wnode_free(w, w->levels[i].nodes[j]);
+            }
+            w->levels[i].size = 0;
+        }
+        return NULL;
+    }
+
+    w->levels[0].size = 0;
+    return w->levels[0].nodes[0];
+}
+
+static int compare_wnode(const void *a, const void *b) {
+    return strcmp((*(wnode_t *const *)a)->name, (*(wnode_t *const *)b)->name);
+}
+
+/**
+ * @brief Reads the entries of the directory again, subdirectories that
+ *        appeared are traversed and the ones that are gone are removed
+ */
+static void watch_reconcile(watch_t *w, wnode_t *node) {
+    const du_opts_t *opts = w->opts;
+    int bytes = opts->flags & FLAG_BYTES;
+    struct stat status;
+
+    if (wnode_path(node, &w->path)) return;
+    if (((opts->flags & FLAG_DEREF) ? stat(w->path.str, &status)
+                                    : lstat(w->path.str, &status)) == -1) {
+        return;  // Gone, the event of its parent removes it
+    }
+
+    DIR *dir = opendir(w->path.str);
+    if (dir == NULL) return;
+
+    qsort(node->children, node->children_size, sizeof(wnode_t *),
+          compare_wnode);
+    char *seen = (char *)calloc(node->children_size + 1, 1);
+    if (seen == NULL) {
+        closedir(dir);
+        return;
+    }
+
+    double own = fget_size(bytes, &status, opts->block_size);
+    double delta = 0;
+    wnode_t **added = NULL;
+    long added_size = 0, added_memsize = 0;
+
+    dir_entry_t *entry;
+    dirscan_start(&w->scan, dir);
+    while ((entry = dirscan_next(&w->scan)) != NULL) {
+        if (entry->error) continue;
+        switch (sget_type(&entry->status)) {
+            case FTYPE_REG:
+            case FTYPE_LINK:
+                own += fget_size(bytes, &entry->status, opts->block_size);
+                break;
+            case FTYPE_DIR: {
+                if (mounts_prune(opts->excluded, opts->flags & FLAG_ONEFS,
+                                 status.st_dev, entry->status.st_dev)) {
+                    break;
+                }
+                wnode_t key_node;
+                wnode_t *key = &key_node;
+                key_node.name = entry->name;
+                wnode_t **found = (wnode_t **)bsearch(
+                    &key, node->children, node->children_size,
+                    sizeof(wnode_t *), compare_wnode);
+                if (found != NULL) {
+                    seen[found - node->children] = 1;
+                    break;
+                }
+                // Traversed once every entry was read, the scanner is reused
+                if (sizes_add((void **)&added, added_size, &added_memsize,
+                              sizeof(wnode_t *)) == 0) {
+                    wnode_t *name_node = (wnode_t *)calloc(1, sizeof(wnode_t));
+                    if (name_node != NULL &&
+                        (name_node->name = strdup(entry->name)) != NULL) {
+                        added[added_size++] = name_node;
+                    } else {
+                        free(name_node);
+                    }
+                }
+            } break;
+            default:
+                break;
+        }
+    }
+    closedir(dir);
+
+    // Removed first, a directory moved inside the tree keeps its watch
+    long kept = 0;
+    for (long i = 0; i < node->children_size; i++) {
+        wnode_t *child = node->children[i];
+        if (seen[i]) {
+            node->children[kept++] = child;
+        } else {
+            delta -= child->total;
+            wnode_free(w, child);
+        }
+    }
+    node->children_size = kept;
+    free(seen);
+
+    for (long i = 0; i < added_size; i++) {
+        wnode_t *child = NULL;
+        if (wnode_path(node, &w->path) == 0 &&
+            pathbuf_push(&w->path, added[i]->name) != (size_t)-1) {
+            child = watch_scan(w, w->path.str);
+        }
+        if (child != NULL) {
+            free(child->name);
+            child->name = added[i]->name;
+            added[i]->name = NULL;
+            if (wnode_addchild(node, child)) {
+                wnode_free(w, child);
+            } else {
+                delta += child->total;
+            }
+        }
+        free(added[i]->name);
+        free(added[i]);
+    }
+    free(added);
+
+    delta += own - node->own;
+    node->own = own;
+    wnode_propagate(node, delta);
+}
+
+static void watch_rebuild(watch_t *w) {
+    for (int i = 0; i < w->nroots; i++) {
+        if (w->roots[i] != NULL) {
+            char *path = strdup(w->roots[i]->name);
+            wnode_free(w, w->roots[i]);
+            w->roots[i] = (path != NULL) ? watch_scan(w, path) : NULL;
+            free(path);
+        }
+    }
+}
+
+static void watch_apply(watch_t *w) {
+    if (w->overflow) {
+        w->overflow = 0;
+        w->dirty_size = 0;
+        watch_rebuild(w);
+        return;
+    }
+
+    // A node may be freed by the reconciliation of its parent, so watch
+    // descriptors are looked up again
+    for (long i = 0; i < w->dirty_size; i++) {
+        int wd = w->dirty[i];
+        if (wd >= 0 && wd < w->by_wd_size && w->by_wd[wd] != NULL) {
+            wnode_t *node = w->by_wd[wd];
+            watch_reconcile(w, node);
+        }
+    }
+    w->dirty_size = 0;
+}
+
+static void watch_mark(watch_t *w, int wd) {
+    // Consecutive events of the same directory are common
+    if (w->dirty_size > 0 && w->dirty[w->dirty_size - 1] == wd) return;
+    for (long i = 0; i < w->dirty_size; i++) {
+        if (w->dirty[i] == wd) return;
+    }
+    if (sizes_add((void **)&w->dirty, w->dirty_size, &w->dirty_memsize,
+                  sizeof(int))) {
+        w->overflow = 1;
+        return;
+    }
+    w->dirty[w->dirty_size++] = wd;
+}
+
+static int watch_read_events(watch_t *w) {
+    _Alignas(struct inotify_event) char buffer[EVENTS_SIZE];
+    ssize_t n = read(w->fd, buffer, sizeof(buffer));
+    if (n <= 0) return (n == -1 && errno != EAGAIN && errno != EINTR) ? -1 : 0;
+
+    for (char *p = buffer; p < buffer + n;) {
+        struct inotify_event *event = (struct inotify_event *)p;
+        p += sizeof(struct inotify_event) + event->len;
+
+        if (event->mask & IN_Q_OVERFLOW) {
+            w->overflow = 1;
+        } else if (event->mask & IN_IGNORED) {
+            // Directory removed, its parent has an event for it
+            if (event->wd < w->by_wd_size && w->by_wd[event->wd] != NULL) {
+                w->by_wd[event->wd]->wd = -1;
+                w->by_wd[event->wd] = NULL;
+            }
+        } else if (event->wd >= 0 && event->wd < w->by_wd_size &&
+                   w->by_wd[event->wd] != NULL) {
+            watch_mark(w, event->wd);
+        }
+    }
+    return 0;
+}
+
+static void wnode_dump(watch_t *w, wnode_t *node, int depth) {
+    for (long i = 0; i < node->children_size; i++) {
+        size_t len = pathbuf_push(&w->path, node->children[i]->name);
+        if (len == (size_t)-1) continue;
+        wnode_dump(w, node->children[i], depth + 1);
+        pathbuf_pop(&w->path, len);
+    }
+
+    if ((w->opts->flags & FLAG_MAXDEPTH) == 0 || depth <= w->opts->max_depth) {
+        double size = (w->opts->flags & FLAG_SEPDIR) ? node->own : node->total;
+        outbuf_entry(outbuf_stdout(), dceill(size), w->path.str);
+    }
+}
+
+/**
+ * @brief Finds the node of a path, which must start with one of the paths
+ *        being watched
+ */
+static wnode_t* watch_find(watch_t *w, const char *path) {
+    for (int i = 0; i < w->nroots; i++) {
+        wnode_t *node = w->roots[i];
+        if (node == NULL) continue;
+        size_t len = strlen(node->name);
+        if (len > 1 && node->name[len - 1] == '/') len--;
+        if (strncmp(path, node->name, len) != 0 ||
+            (path[len] != 0 && path[len] != '/')) {
+            continue;
+        }
+
+        char *rest = strdup(path + len), *save = NULL;
+        if (rest == NULL) return NULL;
+        for (char *name = strtok_r(rest, "/", &save); node != NULL && name;
+             name = strtok_r(NULL, "/", &save)) {
+            wnode_t *child = NULL;
+            for (long j = 0; j < node->children_size; j++) {
+                if (strcmp(node->children[j]->name, name) == 0) {
+                    child = node->children[j];
+                    break;
+                }
+            }
+            node = child;
+        }
+        free(rest);
+        if (node != NULL) return node;
+    }
+    return NULL;
+}
+
+/**
+ * @brief Runs a command read from stdin
+ * @return 1 if the watch must end, 0 otherwise
+ */
+static int watch_command(watch_t *w, char *cmd) {
+    if (strcmp(cmd, "quit") == 0) return 1;
+
+    if (strcmp(cmd, "dump") == 0) {
+        for (int i = 0; i < w->nroots; i++) {
+            if (w->roots[i] == NULL) continue;
+            if (pathbuf_set(&w->path, w->roots[i]->name) == 0) {
+                wnode_dump(w, w->roots[i], 0);
+            }
+        }
+    } else if (strncmp(cmd, "dump ", 5) == 0) {
+        wnode_t *node = watch_find(w, cmd + 5);
+        if (node == NULL || wnode_path(node, &w->path)) {
+            write(STDERR_FILENO, "simpledu: path isn't watched\n", 29);
+        } else {
+            int depth = 0;
+            for (wnode_t *n = node; n->parent != NULL; n = n->parent) depth++;
+            wnode_dump(w, node, depth);
+        }
+    } else if (strlen(cmd) > 0) {
+        write(STDERR_FILENO, "simpledu: unknown command, use dump [path] or quit\n",
+              51);
+    }
+    return 0;
+}
+
+int watch_paths(const du_opts_t *opts, char **paths, int npaths) {
+    watch_t w;
+    memset(&w, 0, sizeof(w));
+    w.opts = opts;
+    w.scan_opts = *opts;
+    w.scan_opts.flags &= ~FLAG_ALL;
+    w.scan_opts.inodes = NULL;
+    w.scan_opts.cache = NULL;
+    w.scan_opts.visit = watch_visit;
+    w.scan_opts.visit_ctx = &w;
+    pathbuf_init(&w.path);
+    dirscan_init(&w.scan, NULL, opts->flags & FLAG_DEREF);
+    w.scan.exclude = opts->exclude;
+
+    if ((w.fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC)) == -1) {
+        perror("simpledu: inotify_init1 error");
+        return -1;
+    }
+
+    int status = 0;
+    w.roots = (wnode_t **)calloc(npaths, sizeof(wnode_t *));
+    w.nroots = npaths;
+    for (int i = 0; w.roots != NULL && i < npaths; i++) {
+        struct stat root_status;
+        if (fget_status(paths[i], &root_status, opts->flags & FLAG_DEREF) ||
+            sget_type(&root_status) != FTYPE_DIR) {
+            write(STDERR_FILENO, "simpledu: --watch needs directories\n", 36);
+            status = -1;
+            break;
+        }
+        if ((w.roots[i] = watch_scan(&w, paths[i])) == NULL) {
+            status = 1;
+            continue;
+        }
+        pathbuf_set(&w.path, w.roots[i]->name);
+        wnode_dump(&w, w.roots[i], 0);
+    }
+    outbuf_flush(outbuf_stdout());
+    if (w.roots == NULL) status = -1;
+
+    char cmd[CMD_SIZE];
+    size_t cmd_len = 0;
+    int stdin_open = 1;
+    struct timespec dirty_since;
+
+    while (status != -1 && stdin_open) {
+        // Signals interrupt the poll, they are handled once back here
+        sig_poll();
+
+        struct pollfd fds[2];
+        fds[0].fd = w.fd;
+        fds[0].events = POLLIN;
+        fds[1].fd = STDIN_FILENO;
+        fds[1].events = POLLIN;
+
+        int pending = w.dirty_size > 0 || w.overflow;
+        int timeout = -1;
+        if (pending) {
+            long waited = elapsed_ms(&dirty_since);
+            timeout = (waited >= MAX_DELAY_MS) ? 0 : QUIET_MS;
+        }
+
+        int ret = poll(fds, 2, timeout);
+        if (ret == -1) {
+            if (errno == EINTR) continue;
+            perror("simpledu: poll error");
+            status = -1;
+            break;
+        }
+
+        if (ret == 0 || (pending && elapsed_ms(&dirty_since) >= MAX_DELAY_MS)) {
+            watch_apply(&w);
+        }
+
+        if (fds[0].revents & POLLIN) {
+            if (watch_read_events(&w)) {
+                perror("simpledu: inotify read error");
+                status = -1;
+                break;
+            }
+            if (!pending && (w.dirty_size > 0 || w.overflow)) {
+                clock_gettime(CLOCK_MONOTONIC, &dirty_since);
+            }
+        }
+
+        if (fds[1].revents & (POLLIN | POLLHUP)) {
+            ssize_t n = read(STDIN_FILENO, cmd + cmd_len,
+                             sizeof(cmd) - 1 - cmd_len);
+            if (n <= 0) {
+                if (n == -1 && errno == EINTR) continue;
+                stdin_open = 0;
+                n = 0;
+            }
+            cmd_len += n;
+
+            char *line = cmd, *end;
+            while ((end = memchr(line, '\n', cmd + cmd_len - line)) != NULL) {
+                *end = 0;
+                // Changes made before the command are seen by it
+                if (w.dirty_size > 0 || w.overflow) watch_apply(&w);
+                if (watch_command(&w, line)) stdin_open = 0;
+                outbuf_flush(outbuf_stdout());
+                line = end + 1;
+            }
+            cmd_len -= line - cmd;
+            memmove(cmd, line, cmd_len);
+            if (cmd_len == sizeof(cmd) - 1) cmd_len = 0;  // Line too long
+        }
+    }
+
+    for (int i = 0; w.roots != NULL && i < w.nroots; i++) {
+        if (w.roots[i] != NULL) wnode_free(&w, w.roots[i]);
+    }
+    free(w.roots);
+    for (int i = 0; i < w.levels_size; i++) free(w.levels[i].nodes);
+    free(w.levels);
+    free(w.by_wd);
+    free(w.dirty);
+    dirscan_free(&w.scan);
+    pathbuf_free(&w.path);
+    close(w.fd);
+
+    return status;
+}
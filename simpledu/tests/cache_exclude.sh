@@ -0,0 +1,36 @@
+#!/bin/sh
+# A cache written with other --exclude patterns isn't reused, the sizes are
+# the ones of a run without --cache
+SIMPLEDU=$(realpath "${1:-./bin/simpledu}")
+dir=$(mktemp -d)
+trap 'rm -rf "$dir"' EXIT
+cd "$dir" || exit 1
+
+mkdir tree
+for i in 1 2 3 4 5 6; do
+    mkdir -p tree/d$i/s$i
+    head -c $((i * 3000)) /dev/zero > tree/d$i/f$i.dat
+    head -c $((i * 7000)) /dev/zero > tree/d$i/s$i/f$i.log
+done
+# Directories changed in the last second aren't taken from the cache
+sleep 2
+
+status=0
+for args in "--exclude=*.log" "--exclude=*.dat" "--exclude=s3"; do
+    "$SIMPLEDU" -b $args tree > plain.out 2>&1
+    "$SIMPLEDU" -b --cache=du.cache tree > /dev/null 2>&1
+    "$SIMPLEDU" -b --cache=du.cache $args tree > cached.out 2>&1
+    if ! cmp -s plain.out cached.out; then
+        echo "FAIL: --cache reused sizes written without $args"
+        diff plain.out cached.out | head -n 10
+        status=1
+    fi
+    # Written with the patterns, the cache is reused by the same patterns
+    "$SIMPLEDU" -b --cache=du.cache $args tree > cached.out 2>&1
+    if ! cmp -s plain.out cached.out; then
+        echo "FAIL: --cache written with $args gives other sizes"
+        diff plain.out cached.out | head -n 10
+        status=1
+    fi
+done
+exit $status
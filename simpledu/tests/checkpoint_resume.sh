@@ -0,0 +1,74 @@
+#!/bin/sh
+# A scan stopped by SIGTERM with --checkpoint and finished by --resume prints
+# the same lines as du, the output of the first run followed by the second
+SIMPLEDU=$(realpath "${1:-./bin/simpledu}")
+dir=$(mktemp -d)
+trap 'rm -rf "$dir"' EXIT
+cd "$dir" || exit 1
+
+# Long names, so the output doesn't fit in the pipe and the scan is still
+# writing when it is stopped
+n=directory_with_a_rather_long_name
+for a in 1 2 3 4 5 6; do
+    for b in 1 2 3 4 5 6; do
+        for c in 1 2 3 4 5 6; do
+            for d in 1 2 3 4 5 6; do
+                mkdir -p tree/$n$a/$n$b/$n$c/$n$d/$n
+                : > tree/$n$a/$n$b/$n$c/$n$d/file
+            done
+        done
+    done
+done
+mkfifo out.fifo
+
+status=0
+for args in "" "-a"; do
+    du $args tree > du.out
+    for mode in "--threads=1" "--threads=4"; do
+        rm -f scan.ckpt
+        "$SIMPLEDU" $args $mode --checkpoint=scan.ckpt tree > out.fifo &
+        pid=$!
+        # read only reads up to the end of the line from a pipe, the lines
+        # past the first 100 are still in it when the signal comes
+        {
+            i=0
+            while [ $i -lt 100 ] && IFS= read -r line; do
+                printf '%s\n' "$line"
+                i=$((i + 1))
+            done
+            kill -TERM $pid
+            cat
+        } < out.fifo > simpledu.out
+        wait $pid 2> /dev/null
+        ret=$?
+        if [ $ret -ne 143 ] || [ ! -f scan.ckpt ]; then
+            echo "FAIL: simpledu $args $mode --checkpoint didn't stop on SIGTERM with a checkpoint ($ret)"
+            status=1
+            continue
+        fi
+
+        "$SIMPLEDU" $args $mode --resume=scan.ckpt tree >> simpledu.out \
+            2> resume.err
+        ret=$?
+        if [ $ret -ne 0 ] || ! cmp -s du.out simpledu.out; then
+            echo "FAIL: simpledu $args $mode --checkpoint then --resume differs from du ($ret)"
+            diff du.out simpledu.out | head -n 10
+            status=1
+        fi
+        if [ -f scan.ckpt ]; then
+            echo "FAIL: simpledu $args $mode --resume left the checkpoint"
+            status=1
+        fi
+    done
+done
+
+# The options that change the output are checked
+"$SIMPLEDU" --checkpoint=scan.ckpt tree > out.fifo &
+pid=$!
+{ IFS= read -r line; kill -TERM $pid; cat > /dev/null; } < out.fifo
+wait $pid 2> /dev/null
+if "$SIMPLEDU" -a --resume=scan.ckpt tree > /dev/null 2>&1; then
+    echo "FAIL: simpledu -a --resume of a scan without -a accepted"
+    status=1
+fi
+exit $status
@@ -0,0 +1,75 @@
+#!/bin/sh
+# Wherever --deadline cuts the scan, the lines printed come in the order of
+# du, the complete ones with its sizes and the others marked as lower bounds,
+# and the exit status is 1 once a size is a lower bound
+SIMPLEDU=$(realpath "${1:-./bin/simpledu}")
+dir=$(mktemp -d)
+trap 'rm -rf "$dir"' EXIT
+cd "$dir" || exit 1
+
+for t in 1 2 3 4; do
+    for i in 1 2 3 4 5 6; do
+        for j in 1 2 3 4 5 6; do
+            mkdir -p tree/t$t/$i/$j
+            head -c $(((t * i * j) % 13 * 3000)) /dev/zero > tree/t$t/$i/$j/f
+        done
+    done
+done
+
+status=0
+for args in "" "-a" "-ab"; do
+    du $args tree > du.out
+    for deadline in 0.000001 0.001 0.003 0.01 60; do
+        for mode in "--threads=1" "--threads=4"; do
+            "$SIMPLEDU" $args $mode --deadline=$deadline tree \
+                > simpledu.out 2> stderr.out
+            ret=$?
+            # Each line printed is the next one of du with that path, its size
+            # the same or a lower bound
+            awk -F '\t' '
+                FNR == NR { size[NR] = $1; path[NR] = $2; n = NR; next }
+                {
+                    while (i < n && path[++i] != $2) {}
+                    if (path[i] != $2) { print "unknown or out of order: " $0; next }
+                    if ($1 ~ /^>=/) {
+                        if (substr($1, 3) + 0 > size[i] + 0) print "above du: " $0
+                    } else if ($1 != size[i]) print "differs: " $0
+                }' du.out simpledu.out > bad.out
+            if [ -s bad.out ]; then
+                echo "FAIL: simpledu $args $mode --deadline=$deadline differs from du"
+                head -n 10 bad.out
+                status=1
+            fi
+            if grep -q "^>=" simpledu.out; then
+                if [ $ret -ne 1 ] || ! grep -q "deadline reached" stderr.out ||
+                   [ "$(tail -n 1 simpledu.out | cut -c 1-2)" != ">=" ]; then
+                    echo "FAIL: simpledu $args $mode --deadline=$deadline cut the scan without saying so ($ret)"
+                    status=1
+                fi
+            elif [ $ret -ne 0 ] || ! cmp -s du.out simpledu.out; then
+                echo "FAIL: simpledu $args $mode --deadline=$deadline isn't complete ($ret)"
+                status=1
+            fi
+        done
+    done
+done
+
+# Before any directory is read the path itself is a lower bound, in every
+# format
+"$SIMPLEDU" --deadline=0.000001 tree > simpledu.out 2> /dev/null
+ret=$?
+if [ $ret -ne 1 ] || ! grep -q "^>=" simpledu.out; then
+    echo "FAIL: simpledu --deadline=0.000001 has no lower bound ($ret)"
+    status=1
+fi
+"$SIMPLEDU" --deadline=0.000001 --format=ndjson tree > simpledu.out 2> /dev/null
+if ! grep -q '"partial":true' simpledu.out; then
+    echo "FAIL: simpledu --deadline=0.000001 --format=ndjson has no partial entry"
+    status=1
+fi
+"$SIMPLEDU" --deadline=0.000001 --format=csv tree > simpledu.out 2> /dev/null
+if ! grep -q '>=' simpledu.out; then
+    echo "FAIL: simpledu --deadline=0.000001 --format=csv has no lower bound"
+    status=1
+fi
+exit $status
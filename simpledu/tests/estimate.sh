@@ -0,0 +1,69 @@
+#!/bin/sh
+# --estimate reads part of the tree, gives the same intervals every run and
+# is close to du, and --refine makes the largest subdirectories exact
+SIMPLEDU=$(realpath "${1:-./bin/simpledu}")
+dir=$(mktemp -d)
+trap 'rm -rf "$dir"' EXIT
+cd "$dir" || exit 1
+
+# 4 subdirectories of 259 directories, the leaves with files of uneven sizes
+for t in 1 2 3 4; do
+    for i in 1 2 3 4 5 6; do
+        for j in 1 2 3 4 5 6; do
+            for k in 1 2 3 4 5 6; do
+                mkdir -p tree/t$t/$i/$j/$k
+                head -c $(((t * i * j * k) % 17 * 3000)) /dev/zero \
+                    > tree/t$t/$i/$j/$k/f
+            done
+        done
+    done
+done
+du -l --max-depth=1 tree | sort -k 2 > du.out
+
+status=0
+"$SIMPLEDU" --estimate --stats tree > estimate.out 2> stats.out
+"$SIMPLEDU" --estimate tree > again.out
+if ! cmp -s estimate.out again.out; then
+    echo "FAIL: simpledu --estimate differs between two runs"
+    diff estimate.out again.out | head -n 10
+    status=1
+fi
+
+read_dirs=$(sed -n 's/^simpledu: stats: \([0-9]*\) directories.*/\1/p' stats.out)
+all_dirs=$(find tree -type d | wc -l)
+if [ -z "$read_dirs" ] || [ "$read_dirs" -ge "$all_dirs" ]; then
+    echo "FAIL: simpledu --estimate read $read_dirs of $all_dirs directories"
+    status=1
+fi
+
+# Intervals around the estimate, within a fifth of the size du prints
+sort -k 4 estimate.out | join -1 4 -2 2 -t "$(printf '\t')" - du.out \
+    > joined.out
+awk -F '\t' '$3 > $2 || $2 > $4 || $2 < $5 * 0.8 || $2 > $5 * 1.2' \
+    joined.out > off.out
+if [ -s off.out ] || [ "$(wc -l < joined.out)" -ne "$(wc -l < du.out)" ]; then
+    echo "FAIL: simpledu --estimate is off (PATH SIZE LOW HIGH DU)"
+    head -n 10 off.out
+    status=1
+fi
+
+# Every subdirectory refined, the path adds their exact sizes
+"$SIMPLEDU" --estimate --refine=4 tree | awk -F '\t' '
+    $1 != $2 || $1 != $3 { print "inexact"; next }
+    { print $1 "\t" $4 }' | sort -k 2 > refined.out
+if ! cmp -s du.out refined.out; then
+    echo "FAIL: simpledu --estimate --refine=4 differs from du"
+    diff du.out refined.out | head -n 10
+    status=1
+fi
+
+# One subdirectory refined, the largest estimate
+largest=$(awk -F '\t' '$4 != "tree"' estimate.out | sort -n | tail -n 1 |
+    cut -f 4)
+"$SIMPLEDU" --estimate --refine=1 tree |
+    awk -F '\t' -v p="$largest" '$4 == p { print $1 "\t" $4 }' > one.out
+if ! grep -qx "$(cat one.out)" du.out || [ ! -s one.out ]; then
+    echo "FAIL: simpledu --estimate --refine=1 doesn't make $largest exact"
+    status=1
+fi
+exit $status
@@ -0,0 +1,41 @@
+#!/bin/sh
+# Hard links shared by several directories are counted by the first link in
+# output order, like du, in both modes and whatever the number of threads
+SIMPLEDU=$(realpath "${1:-./bin/simpledu}")
+dir=$(mktemp -d)
+trap 'rm -rf "$dir"' EXIT
+cd "$dir" || exit 1
+
+# Each file of a directory is linked from a subdirectory of another one, from
+# a sibling and from the top, so readdir order decides which link is first
+mkdir tree
+for i in 1 2 3 4 5 6 7 8 9 10 11 12; do
+    mkdir -p tree/d$i/s$i/t
+    head -c $((i * 1500)) /dev/zero > tree/d$i/f$i
+    head -c $((i * 4100)) /dev/zero > tree/d$i/s$i/g$i
+done
+for i in 1 2 3 4 5 6 7 8 9 10 11 12; do
+    j=$((i * 5 % 12 + 1))
+    ln tree/d$i/f$i tree/d$j/s$j/t/l$i
+    ln tree/d$i/s$i/g$i tree/d$j/m$i
+    ln tree/d$i/f$i tree/x$i
+done
+
+status=0
+for args in "" "-a" "-ab" "-aS" "-a --max-depth=1"; do
+    du $args tree > du.out
+    for mode in "" "--threads=1" "--threads=4"; do
+        "$SIMPLEDU" $args $mode tree > simpledu.out 2>&1
+        if ! cmp -s du.out simpledu.out; then
+            echo "FAIL: simpledu $args $mode differs from du"
+            diff du.out simpledu.out | head -n 10
+            status=1
+        fi
+    done
+done
+# Subprocesses read at the same time can't count links in output order
+if "$SIMPLEDU" --jobs=4 tree > /dev/null 2>&1; then
+    echo "FAIL: simpledu --jobs=4 without -l was accepted"
+    status=1
+fi
+exit $status
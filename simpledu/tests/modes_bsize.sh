@@ -0,0 +1,32 @@
+#!/bin/sh
+# Sizes are summed in blocks of 512 bytes and rounded once to the unit of -B,
+# so the process mode and the thread mode print the same sizes for any unit
+SIMPLEDU=$(realpath "${1:-./bin/simpledu}")
+dir=$(mktemp -d)
+trap 'rm -rf "$dir"' EXIT
+cd "$dir" || exit 1
+
+mkdir tree
+for i in 1 2 3 4 5 6 7 8; do
+    mkdir -p tree/d$i/s$i
+    for j in 1 2 3; do
+        head -c $((i * j * 1337)) /dev/urandom > tree/d$i/f$j
+        head -c $((i * j * 4099 + 1)) /dev/urandom > tree/d$i/s$i/g$j
+    done
+    ln -s f1 tree/d$i/l$i
+done
+
+status=0
+for args in "-la -B 3" "-la -B 7" "-l -B 1000" "-la -B 513" "-lab -B 7" \
+            "-laS -B 3" "-la -B 3 --max-depth=1"; do
+    "$SIMPLEDU" $args tree > process.out 2>&1
+    for mode in "--threads=1" "--threads=4" "--jobs=4"; do
+        "$SIMPLEDU" $args $mode tree > other.out 2>&1
+        if ! cmp -s process.out other.out; then
+            echo "FAIL: simpledu $args $mode differs from the process mode"
+            diff process.out other.out | head -n 10
+            status=1
+        fi
+    done
+done
+exit $status
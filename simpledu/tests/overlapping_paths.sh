@@ -0,0 +1,42 @@
+#!/bin/sh
+# Paths given more than once or inside another path, and directories reached
+# again through -L, are counted by the first path written, like du, in both
+# modes and whatever the number of threads or of paths read at once
+SIMPLEDU=$(realpath "${1:-./bin/simpledu}")
+dir=$(mktemp -d)
+trap 'rm -rf "$dir"' EXIT
+cd "$dir" || exit 1
+
+mkdir tree
+for i in 1 2 3 4 5 6; do
+    mkdir -p tree/d$i/s$i
+    head -c $((i * 2100)) /dev/zero > tree/d$i/f$i
+    head -c $((i * 5300)) /dev/zero > tree/d$i/s$i/g$i
+done
+ln tree/d1/f1 tree/d4/s4/l1
+ln -s ../d2 tree/d5/to2
+ln -s s3/g3 tree/d3/to3
+
+status=0
+for paths in "tree tree" "tree tree/d2" "tree/d2 tree" "tree/d3/s3 tree/d3" \
+             "tree/d1/f1 tree/d4 tree/d1" "tree/d5 tree/d2/s2 tree"; do
+    for args in "" "-a" "-ab" "-aS" "-a --max-depth=1" "-aL"; do
+        du $args $paths > du.out
+        for mode in "" "--threads=1" "--threads=4" "--workers=2" \
+                    "--threads=4 --device-jobs=2"; do
+            "$SIMPLEDU" $args $mode $paths > simpledu.out 2>&1
+            if ! cmp -s du.out simpledu.out; then
+                echo "FAIL: simpledu $args $mode $paths differs from du"
+                diff du.out simpledu.out | head -n 10
+                status=1
+            fi
+        done
+    done
+done
+
+# The process mode would count a shared link by whichever path reads it first
+if "$SIMPLEDU" --device-jobs=2 tree tree/d4 > simpledu.out 2>&1; then
+    echo "FAIL: --device-jobs=2 without -l accepted in the process mode"
+    status=1
+fi
+exit $status
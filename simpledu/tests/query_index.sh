@@ -0,0 +1,27 @@
+#!/bin/sh
+# simpledu query prints every field of the entries as the scan wrote them,
+# the depth aside (a path queried is printed at depth 0)
+SIMPLEDU=$(realpath "${1:-./bin/simpledu}")
+dir=$(mktemp -d)
+trap 'rm -rf "$dir"' EXIT
+cd "$dir" || exit 1
+
+mkdir -p tree/a/b tree/c
+head -c 5000 /dev/zero > tree/a/f
+head -c 70000 /dev/zero > tree/a/b/g
+head -c 123 /dev/zero > tree/c/h
+
+status=0
+for args in "-a" "-ab" "-a -B 3"; do
+    "$SIMPLEDU" $args --save-index=tree.idx --format=ndjson tree |
+        sed 's/"depth":[0-9]*,//' | sort > scan.out
+    for path in tree tree/a tree/a/b tree/a/f tree/a/b/g tree/c tree/c/h; do
+        "$SIMPLEDU" query tree.idx "$path" --format=ndjson
+    done | sed 's/"depth":[0-9]*,//' | sort > query.out
+    if ! cmp -s scan.out query.out; then
+        echo "FAIL: simpledu query $args differs from the scan"
+        diff scan.out query.out | head -n 10
+        status=1
+    fi
+done
+exit $status
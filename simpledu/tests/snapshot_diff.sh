@@ -0,0 +1,66 @@
+#!/bin/sh
+# simpledu diff prints the entries whose size changed between two indexes,
+# created and removed ones included, the same as comparing the output of du
+# before and after, and ranks them by the size of the change
+SIMPLEDU=$(realpath "${1:-./bin/simpledu}")
+dir=$(mktemp -d)
+trap 'rm -rf "$dir"' EXIT
+cd "$dir" || exit 1
+
+mkdir -p tree/a/b tree/c tree/e
+head -c 5000 /dev/zero > tree/a/f
+head -c 9000 /dev/zero > tree/c/h
+head -c 1200 /dev/zero > tree/e/k
+"$SIMPLEDU" -ab --save-index=old.idx tree > /dev/null
+du -ab tree > old.du
+
+head -c 70000 /dev/zero > tree/a/b/g
+rm tree/c/h
+mkdir tree/d
+head -c 300 /dev/zero > tree/d/x
+"$SIMPLEDU" -ab --save-index=new.idx tree > /dev/null
+du -ab tree > new.du
+
+# DELTA, OLD, NEW and PATH of every path whose size differs
+awk -F '\t' '
+    FNR == NR { old[$2] = $1; next }
+    { new[$2] = $1 }
+    END {
+        for (p in old) if (!(p in new)) printf "%+d\t%s\t-\t%s\n", -old[p], old[p], p
+        for (p in new) {
+            if (!(p in old)) printf "%+d\t-\t%s\t%s\n", new[p], new[p], p
+            else if (old[p] != new[p])
+                printf "%+d\t%s\t%s\t%s\n", new[p] - old[p], old[p], new[p], p
+        }
+    }' old.du new.du | sort > expected.out
+
+status=0
+"$SIMPLEDU" diff old.idx new.idx --top=0 > diff.out
+sort diff.out > sorted.out
+if ! cmp -s expected.out sorted.out; then
+    echo "FAIL: simpledu diff --top=0 differs from du"
+    diff expected.out sorted.out | head -n 10
+    status=1
+fi
+
+"$SIMPLEDU" diff old.idx new.idx > ranked.out
+if ! sort ranked.out | cmp -s expected.out -; then
+    echo "FAIL: simpledu diff doesn't rank every change"
+    diff expected.out ranked.out | head -n 10
+    status=1
+fi
+if ! awk -F '\t' '{ d = $1 < 0 ? -$1 : $1 }
+                  NR > 1 && d > last { exit 1 } { last = d }' ranked.out; then
+    echo "FAIL: simpledu diff doesn't print the largest changes first"
+    head -n 10 ranked.out
+    status=1
+fi
+
+"$SIMPLEDU" diff old.idx new.idx --threshold=9000 --top=0 | sort > big.out
+awk -F '\t' '{ d = $1 < 0 ? -$1 : $1 } d > 9000' expected.out > expected_big.out
+if ! cmp -s expected_big.out big.out; then
+    echo "FAIL: simpledu diff --threshold=9000 differs from du"
+    diff expected_big.out big.out | head -n 10
+    status=1
+fi
+exit $status
@@ -0,0 +1,33 @@
+#!/bin/sh
+# With -L symbolic links back to an ancestor are reported and skipped like du
+# does, the thread modes open each level relative to its parent so the kernel
+# never stops the loop by itself
+SIMPLEDU=$(realpath "${1:-./bin/simpledu}")
+dir=$(mktemp -d)
+trap 'rm -rf "$dir"' EXIT
+cd "$dir" || exit 1
+
+mkdir -p tree/a/b/c
+head -c 5000 /dev/zero > tree/a/f
+head -c 9000 /dev/zero > tree/a/b/c/g
+ln -s ../.. tree/a/b/up
+ln -s .. tree/a/b/c/side
+ln -s ../../.. tree/a/b/c/top
+
+status=0
+for args in "-L" "-aL" "-aLb" "-L --max-depth=2"; do
+    du $args tree > du.out
+    for mode in "--threads=1" "--threads=4" "--workers=2"; do
+        timeout 20 "$SIMPLEDU" $args $mode tree > simpledu.out 2> error.out
+        ret=$?
+        if [ $ret -ne 0 ] || ! cmp -s du.out simpledu.out; then
+            echo "FAIL: simpledu $args $mode differs from du (status $ret)"
+            diff du.out simpledu.out | head -n 10
+            status=1
+        elif [ "$(grep -c 'directory cycle' error.out)" -ne 3 ]; then
+            echo "FAIL: simpledu $args $mode didn't report the 3 cycles"
+            status=1
+        fi
+    done
+done
+exit $status
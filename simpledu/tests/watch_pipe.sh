@@ -0,0 +1,34 @@
+#!/bin/sh
+# --watch takes its commands from a pipe and writes to a pipe, like any other
+# run of a shell pipeline, and dumps the sizes of du -l after a change
+SIMPLEDU=$(realpath "${1:-./bin/simpledu}")
+dir=$(mktemp -d)
+trap 'rm -rf "$dir"' EXIT
+cd "$dir" || exit 1
+
+mkdir tree
+for i in 1 2 3 4; do
+    mkdir -p tree/d$i/s$i
+    head -c $((i * 3000)) /dev/zero > tree/d$i/f$i
+    head -c $((i * 7000)) /dev/zero > tree/d$i/s$i/g$i
+done
+du -l tree > before.out
+
+status=0
+# Events are applied once none arrives for 50 ms
+{
+    sleep 1
+    head -c 90000 /dev/zero > tree/d2/s2/new
+    sleep 1
+    echo dump
+    echo quit
+} | "$SIMPLEDU" --watch tree 2> error.out | cat > simpledu.out
+du -l tree > after.out
+cat before.out after.out > du.out
+if [ -s error.out ] || ! cmp -s du.out simpledu.out; then
+    echo "FAIL: simpledu --watch through pipes differs from du -l"
+    cat error.out
+    diff du.out simpledu.out | head -n 10
+    status=1
+fi
+exit $status